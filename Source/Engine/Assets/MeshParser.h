@@ -24,7 +24,8 @@ public:
 
 	enum {
 		SinkStage = pkg::SS_Parser,
-		AssetType = AT_Mesh
+		AssetType = AT_Mesh,
+		SinkAsync = 1
 	};
 
 	MeshParser();
@@ -30,7 +30,8 @@ public:
 
 	enum {
 		SinkStage = pkg::SS_Parser,
-		AssetType = AT_SkAnimSet
+		AssetType = AT_SkAnimSet,
+		SinkAsync = 1
 	};
 
 	SkAnimSetParser();
@@ -58,8 +58,8 @@ int SkModelCooker::Compile(int flags) {
 	if (!ska || !ska->valid)
 		return SR_ParseError;
 
-	// AnimSet import index
-	AddImport(s->c_str);
+	// AnimSet import index, the skeleton and animations are baked from it.
+	AddDependency(s->c_str);
 
 	s = asset->entry->KeyValue<String>("AnimStates.Source", flags);
 	if (!s)
@@ -28,7 +28,8 @@ public:
 
 	enum {
 		SinkStage = pkg::SS_Parser,
-		AssetType = AT_Sound
+		AssetType = AT_Sound,
+		SinkAsync = 1
 	};
 
 	SoundParser();
@@ -24,7 +24,8 @@ public:
 
 	enum {
 		SinkStage = pkg::SS_Parser,
-		AssetType = AT_StringTable
+		AssetType = AT_StringTable,
+		SinkAsync = 1
 	};
 
 	StringTableParser();
@@ -36,8 +36,7 @@
 #include <Runtime/ImageCodec/Dds.h>
 #include <Runtime/ImageCodec/Bmp.h>
 #include <Runtime/ImageCodec/Png.h>
-#include "../Renderer/GL/GLTable.h"
-#include "../Renderer/GL/GLTexture.h"
+#include <Runtime/ImageCodec/Resample.h>
 enum {
 	kMinMipSize = 1
 };
@@ -771,6 +770,38 @@ int TextureParser::Format(const char *name) {
 	return -1;
 }
 
+namespace {
+
+void GetResampleOptions(
+	const pkg::Asset::Ref &asset,
+	int flags,
+	const char *filterKey,
+	const char *gammaKey,
+	bool normalMap,
+	image_codec::resample::Filter &filter,
+	int &resampleFlags
+) {
+	// Both keys are optional, older texture definitions predate them.
+	filter = image_codec::resample::kFilter_Kaiser;
+	resampleFlags = 0;
+
+	if (flags&P_FastCook) {
+		filter = image_codec::resample::kFilter_Box;
+	} else {
+		const String *s = asset->entry->KeyValue<String>(filterKey, P_TARGET_FLAGS(flags));
+		if (s)
+			filter = image_codec::resample::FilterForName(s->c_str);
+	}
+
+	if (!normalMap) { // normals are not colors.
+		const bool *b = asset->entry->KeyValue<bool>(gammaKey, P_TARGET_FLAGS(flags));
+		if (b && *b)
+			resampleFlags |= image_codec::resample::kFlag_Gamma;
+	}
+}
+
+} // namespace
+
 int TextureParser::Resize(
 	Engine &engine,
 	const xtime::TimeSlice &time,
@@ -804,19 +835,9 @@ int TextureParser::Resize(
 			// format supports resize?
 			if (RAD_IMAGECODEC_FAMILY(m_header.format) != image_codec::DDSFamily) {
 				if (flags&(P_Load|P_Parse)) {
-					GLenum internal, format, type;
-					r::GLImageFormat(m_header.format, internal, format, type, GL_ALPHA);
-
-					// Use temp buffer as gluScaleImage corrupts memory (overruns)
-					// when non-power-of 2
-					// height+2: http://xscreensaver.sourcearchive.com/documentation/5.07-0ubuntu2/grab-ximage_8c-source.html
-
-					void *temp = safe_zone_malloc(
-						image_codec::ZImageCodec, 
-						PowerOf2(*w)*
-						(PowerOf2(*h)+2) *
-						m_images[0]->bpp
-					);
+					image_codec::resample::Filter filter;
+					int resampleFlags;
+					GetResampleOptions(asset, flags, "Resize.Filter", "Resize.Gamma", kNormalMap, filter, resampleFlags);
 
 					for (ImageVec::iterator it = m_images.begin(); it != m_images.end(); ++it) {
 						image_codec::Image::Ref &img = *it;
@@ -835,26 +856,21 @@ int TextureParser::Resize(
 							FormatSize(a, (AddrSize)(m_header.width*m_header.height*src.bpp));
 							FormatSize(b, (AddrSize)(*w)*(*h)*src.bpp);
 
-							{
-								r::GLTable::Lock L(r::gl.mutex);
-
-								gluScaleImage(
-									format,
-									(GLint)m_header.width,
-									(GLint)m_header.height,
-									type,
-									src.frames[i].mipmaps[0].data,
-									*w,
-									*h,
-									type,
-									temp
-								);
+							if (!image_codec::resample::Resize(
+								src.frames[i].mipmaps[0],
+								img->frames[i].mipmaps[0],
+								src.format,
+								filter,
+								resampleFlags,
+								1 // cook threads already run in parallel.
+							)) {
+								return SR_InvalidFormat;
 							}
 
 							if (kNormalMap) {
 								RAD_ASSERT(src.bpp >= 3);
 								NormalizeNormalMap(
-									temp,
+									img->frames[i].mipmaps[0].data,
 									*w,
 									*h,
 									src.bpp,
@@ -862,14 +878,10 @@ int TextureParser::Resize(
 								);
 							}
 
-							memcpy(img->frames[i].mipmaps[0].data, temp, img->frames[i].mipmaps[0].dataSize);
-
 							COut(C_Info) << "Resized: " << asset->path.get() << " from (" << 
 								m_header.width << "x" << m_header.height << "x" << src.bpp << ") @ " << a << " to (" << *w << "x" << *h << "x" << src.bpp << ") @ " << b << "..." << std::endl;
 						}
 					}
-
-					zone_free(temp);
 				}
 				
 				m_header.width = *w;
@@ -940,20 +952,10 @@ int TextureParser::Mipmap(
 		return SR_Success;
 
 	if (numMips > 1) {
-		GLenum internal, format, type;
-		r::GLImageFormat(m_header.format, internal, format, type, GL_ALPHA);
-
-		// Use temp buffer as gluScaleImage corrupts memory (overruns)
-		// when non-power-of 2
-		// height+2: http://xscreensaver.sourcearchive.com/documentation/5.07-0ubuntu2/grab-ximage_8c-source.html
-
-		void *temp = safe_zone_malloc(
-			image_codec::ZImageCodec, 
-			PowerOf2(m_header.width)*
-			(PowerOf2(m_header.height)+2) *
-			m_images[0]->bpp
-		);
-			
+		image_codec::resample::Filter filter;
+		int resampleFlags;
+		GetResampleOptions(asset, flags, "Mipmap.Filter", "Mipmap.Gamma", kNormalMap, filter, resampleFlags);
+
 		for (ImageVec::iterator it = m_images.begin(); it != m_images.end(); ++it) {
 			image_codec::Image::Ref &img = *it;
 			image_codec::Image src;
@@ -976,46 +978,6 @@ int TextureParser::Mipmap(
 				img->AllocateMipmaps(i, numMips);
 				for (int m = 0; m < numMips; ++m) {
 					img->AllocateMipmap(i, m, w, h, w*src.bpp, w*h*src.bpp);
-						
-					if (w == m_header.width && h == m_header.height) {
-						memcpy(
-							img->frames[i].mipmaps[m].data,
-							src.frames[i].mipmaps[0].data,
-							w*h*src.bpp
-						);
-					} else {
-						{
-							r::GLTable::Lock L(r::gl.mutex);
-							gluScaleImage(
-								format,
-								(GLint)m_header.width,
-								(GLint)m_header.height,
-								type,
-								src.frames[i].mipmaps[0].data,
-								w,
-								h,
-								type,
-								temp
-							);
-						}
-
-						if (kNormalMap) {
-							RAD_ASSERT(src.bpp >= 3);
-							NormalizeNormalMap(
-								temp,
-								w,
-								h,
-								src.bpp,
-								0
-							);
-						}
-
-						memcpy(
-							img->frames[i].mipmaps[m].data,
-							temp,
-							w*h*src.bpp
-						);
-					}
 
 					if (w > kMinMipSize)
 						w >>= 1;
@@ -1025,10 +987,47 @@ int TextureParser::Mipmap(
 					w = std::max<int>(w, kMinMipSize);
 					h = std::max<int>(h, kMinMipSize);
 				}
+
+				{ // the source may be padded, the mipmaps are packed.
+					const image_codec::Mipmap &srcMip = src.frames[i].mipmaps[0];
+					image_codec::Mipmap &dstMip = img->frames[i].mipmaps[0];
+					const AddrSize kRowSize = (AddrSize)m_header.width*src.bpp;
+					for (int y = 0; y < m_header.height; ++y) {
+						memcpy(
+							((U8*)dstMip.data) + y*dstMip.stride,
+							((const U8*)srcMip.data) + y*srcMip.stride,
+							kRowSize
+						);
+					}
+				}
+
+				// each level is filtered from the one above it, no GL context required
+				// so cook threads don't serialize here.
+				if (!image_codec::resample::GenerateMipmaps(
+					img->frames[i],
+					src.format,
+					filter,
+					resampleFlags,
+					1 // cook threads already run in parallel.
+				)) {
+					return SR_InvalidFormat;
+				}
+
+				if (kNormalMap) {
+					RAD_ASSERT(src.bpp >= 3);
+					for (int m = 1; m < numMips; ++m) {
+						const image_codec::Mipmap &mip = img->frames[i].mipmaps[m];
+						NormalizeNormalMap(
+							mip.data,
+							mip.width,
+							mip.height,
+							src.bpp,
+							0
+						);
+					}
+				}
 			}
 		}
-
-		zone_free(temp);
 	}
 
 	return SR_Success;
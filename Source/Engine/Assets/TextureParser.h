@@ -46,7 +46,8 @@ public:
 
 	enum  { 
 		SinkStage = pkg::SS_Parser,
-		AssetType = AT_Texture
+		AssetType = AT_Texture,
+		SinkAsync = 1
 	};
 
 	struct Header {
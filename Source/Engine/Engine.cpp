@@ -49,6 +49,14 @@ bool Engine::PreInit() {
 	COut(C_Info) << "hyper-threading enabled: " << (thread::details::IsHyperThreadingOn() ? "true" : "false") << std::endl;
 	COut(C_Info) << SIMD->name << " driver bound." << std::endl;
 
+	int numJobThreads = 0;
+	const char *jobThreads = App::Get()->ArgArg("-jobthreads");
+	if (jobThreads)
+		numJobThreads = atoi(jobThreads);
+
+	m_comTable.jobs.reset(new (ZEngine) thread::JobScheduler(numJobThreads));
+	COut(C_Info) << "job threads: " << m_comTable.jobs->numThreads.get() << std::endl;
+
 	const char *baseDir = App::Get()->ArgArg("-base");
 	if (!baseDir)
 		baseDir = "Base";
@@ -62,7 +70,8 @@ bool Engine::PreInit() {
 	CVarZone::Globals().Open("@r:/cvars.dat");
 
 	sys->r->Initialize();
-	m_comTable.alDriver = ALDriver::New(ALDRIVER_SIG 0);
+	// -sounddevice software (or wav:<path>) runs the software mixer without an audio device.
+	m_comTable.alDriver = ALDriver::New(ALDRIVER_SIG App::Get()->ArgArg("-sounddevice"));
 
 	if (!m_comTable.alDriver) {
 		COut(C_Info) << "Error initializing sound system!" << std::endl;
@@ -96,10 +105,15 @@ void Engine::Finalize()
 	
 	CVarZone::Globals().Close();
 	m_comTable.files.reset();
+	m_comTable.jobs.reset();
 }
 
 void Engine::Tick(float elapsed)
 {
+	if (m_comTable.packages) {
+		xtime::TimeSlice time(kAsyncLoadTickMs);
+		m_comTable.packages->TickAsyncLoads(time);
+	}
 }
 
 #if defined(RAD_OPT_PC)
@@ -10,6 +10,7 @@
 #include <Runtime/String.h>
 #include <Runtime/File.h>
 #include <Runtime/Interface/ComponentManager.h>
+#include <Runtime/Thread/JobScheduler.h>
 #include "Packages/Packages.h"
 #include "Renderer/Renderer.h"
 #include "COut.h"
@@ -33,6 +34,7 @@ public:
 		HComponentManager    components;
 		ALDriverRef          alDriver;
 		Persistence::Ref     globals;
+		thread::JobScheduler::Ref jobs;
 	};
 
 	static Engine *New();
@@ -55,6 +57,10 @@ public:
 
 private:
 
+	enum {
+		kAsyncLoadTickMs = 4 // main thread time given to background loads each frame.
+	};
+
 	RAD_DECLARE_GET(argc, int);
 	RAD_DECLARE_GET(sys, const ComTable*) { 
 		return &m_comTable; 
@@ -163,6 +163,7 @@ int GSLoadMap::Tick(Game &game, float dt, const xtime::TimeSlice &outerTime, int
 				game.Play();
 			
 			App::DumpMemStats(C_Debug);
+			App::Get()->engine->sys->packages->LogAsyncLoadStats(COut(C_Debug));
 		} else {
 			// TODO: handle failed loading
 			COut(C_ErrMsgBox) << "Error loading map!" << std::endl;
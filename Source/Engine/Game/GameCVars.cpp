@@ -8,6 +8,12 @@
 #include RADPCH
 #include "GameCVars.h"
 #include "../Renderer/Common.h"
+#if defined(RAD_OPT_TOOLS)
+#include "Game.h"
+#include "../App.h"
+#include "../COut.h"
+#include <sstream>
+#endif
 
 // cvar defaults
 GameCVars::GameCVars(Game &game, CVarZone &zone) : 
@@ -26,6 +32,7 @@ r_showlightpasses(zone, "r_showlightpasses", false, false),
 r_showlightcounts(zone, "r_showlightcounts", false, false),
 r_fly(zone, "r_fly", false, false),
 r_lockvis(zone, "r_lockvis", false, false),
+r_viscache(zone, "r_viscache", true, false),
 r_showfrustum(zone, "r_showfrustum", false, false),
 r_viewunifiedlighttexturematrix(zone, "r_viewunifiedlighttexturematrix", false, false),
 r_viewunifiedlightprojectionmatrix(zone, "r_viewunifiedlightprojectionmatrix", false, false),
@@ -39,6 +46,98 @@ r_showviewcontroller(zone, "r_showviewcontroller", false, false),
 r_drawworld(zone, "r_drawworld", true, false),
 r_drawentities(zone, "r_drawentities", true, false),
 r_drawoccupants(zone, "r_drawoccupants", true, false),
-r_drawfog(zone, "r_drawfog", true, false) {
+r_drawfog(zone, "r_drawfog", true, false)
+#if defined(RAD_OPT_TOOLS)
+, r_capturecamera(game, zone),
+r_drawbenchmark(game, zone)
+#endif
+{
 }
 
+#if defined(RAD_OPT_TOOLS)
+
+GameCVars::CaptureCameraFunc::CaptureCameraFunc(Game &game, CVarZone &zone) :
+CVarFunc(zone, "r_capturecamera"), m_game(&game), m_capturing(false) {
+}
+
+void GameCVars::CaptureCameraFunc::Execute(const char *cmdline) {
+	world::World::Ref world = m_game->world;
+	if (!world) {
+		COut(C_Error) << "r_capturecamera: there is no world loaded." << std::endl;
+		return;
+	}
+
+	if (!m_capturing) {
+		if (!cmdline || !cmdline[0]) {
+			COut(C_Error) << "usage: r_capturecamera <file>, run again to stop and save." << std::endl;
+			return;
+		}
+
+		m_path = cmdline;
+		m_capturing = true;
+		world->BeginCameraCapture();
+		COut(C_Info) << "r_capturecamera: recording to '" << m_path.c_str.get() << "'" << std::endl;
+		return;
+	}
+
+	m_capturing = false;
+
+	world::CameraPath path;
+	world->EndCameraCapture(path);
+
+	std::ostringstream out;
+	path.Write(out);
+	const std::string kText(out.str());
+
+	FILE *fp = App::Get()->engine->sys->files->fopen(m_path.c_str, "wb");
+	if (!fp) {
+		COut(C_Error) << "r_capturecamera: unable to open '" << m_path.c_str.get() << "' for writing." << std::endl;
+		return;
+	}
+
+	fwrite(kText.c_str(), 1, kText.length(), fp);
+	fclose(fp);
+
+	COut(C_Info) << "r_capturecamera: saved " << path.cameras.size() << " frame(s) to '" << m_path.c_str.get() << "'" << std::endl;
+}
+
+GameCVars::DrawBenchmarkFunc::DrawBenchmarkFunc(Game &game, CVarZone &zone) :
+CVarFunc(zone, "r_drawbenchmark"), m_game(&game) {
+}
+
+void GameCVars::DrawBenchmarkFunc::Execute(const char *cmdline) {
+	world::World::Ref world = m_game->world;
+	if (!world) {
+		COut(C_Error) << "r_drawbenchmark: there is no world loaded." << std::endl;
+		return;
+	}
+
+	if (!cmdline || !cmdline[0]) {
+		COut(C_Error) << "usage: r_drawbenchmark <file>, the file is saved by r_capturecamera." << std::endl;
+		return;
+	}
+
+	FILE *fp = App::Get()->engine->sys->files->fopen(cmdline, "rb");
+	if (!fp) {
+		COut(C_Error) << "r_drawbenchmark: unable to open '" << cmdline << "'." << std::endl;
+		return;
+	}
+
+	std::string text;
+	char buf[1024];
+	for (size_t n; (n = fread(buf, 1, sizeof(buf), fp)) > 0;)
+		text.append(buf, n);
+	fclose(fp);
+
+	std::istringstream in(text);
+	world::CameraPath path;
+	if (!path.Read(in)) {
+		COut(C_Error) << "r_drawbenchmark: '" << cmdline << "' is not a camera path." << std::endl;
+		return;
+	}
+
+	world->DrawBenchmark(COut(C_Info), path);
+}
+
+#endif
+
@@ -29,6 +29,7 @@ public:
 	CVarBool r_showlightcounts;
 	CVarBool r_fly;
 	CVarBool r_lockvis;
+	CVarBool r_viscache;
 	CVarBool r_viewunifiedlighttexturematrix;
 	CVarBool r_viewunifiedlightprojectionmatrix;
 	CVarBool r_showfrustum;
@@ -44,6 +45,32 @@ public:
 	CVarBool r_drawoccupants;
 	CVarBool r_drawfog;
 
+#if defined(RAD_OPT_TOOLS)
+	//! r_capturecamera <file> records the world camera of every drawn frame, run it again
+	//! without a file to stop and save the path.
+	class CaptureCameraFunc : public CVarFunc {
+	public:
+		CaptureCameraFunc(Game &game, CVarZone &zone);
+		virtual void Execute(const char *cmdline);
+	private:
+		Game *m_game;
+		String m_path;
+		bool m_capturing;
+	};
+
+	//! r_drawbenchmark <file> replays a captured camera path, see world::World::DrawBenchmark().
+	class DrawBenchmarkFunc : public CVarFunc {
+	public:
+		DrawBenchmarkFunc(Game &game, CVarZone &zone);
+		virtual void Execute(const char *cmdline);
+	private:
+		Game *m_game;
+	};
+
+	CaptureCameraFunc r_capturecamera;
+	DrawBenchmarkFunc r_drawbenchmark;
+#endif
+
 	void AddLuaVar(const CVar::Ref &cvar) {
 		m_vec.push_back(cvar);
 		m_set.insert(cvar.get());
@@ -46,157 +46,286 @@ RADENG_API int RADENG_CALL luaL_typerror (lua_State *L, int narg, const char *tn
 namespace lua {
 
 #if !defined(LUA_JIT)
-struct LuaPools {
+//! Small block allocator owned by a single lua::State.
+/*! A lua_State is only ever touched by one thread at a time so nothing here is locked.
+	Blocks up to kMaxBlockSize are rounded up to a size class and carved off of large
+	slabs with a bump pointer. Freed blocks go on an intrusive free list for their class
+	and are reused before the slab is bumped again. Slabs are returned when the state
+	is closed, or by Compact() once every block carved from them is free. */
+class State::Allocator {
+public:
 
 	enum {
-		kNumPools = 10,
-		kBasePoolSize = 8,
-		kMaxPoolSize = kBasePoolSize<<(kNumPools-1)
+		kGranularity = 16,
+		kMaxBlockSize = 4*kKilo,
+		kSlabSize = 64*kKilo,
+		kSlabHeaderSize = kGranularity,
+		kMaxClasses = 48
 	};
 
-	static inline int PoolIndex(size_t size) {
-		if (size > kMaxPoolSize)
-			return -1;
+	Allocator(Metrics &m) : m_m(m), m_slabs(0), m_bump(0), m_bumpEnd(0) {
+		RAD_STATIC_ASSERT(sizeof(Slab) <= kSlabHeaderSize);
+
+		// 16 byte steps up to 256 bytes, then 4 classes per power of 2.
+		int numClasses = 0;
+		int size = kGranularity;
+		while (size <= kMaxBlockSize) {
+			RAD_ASSERT(numClasses < kMaxClasses);
+			m_classSize[numClasses++] = size;
+			if (size < 256) {
+				size += kGranularity;
+			} else {
+				int step = 1;
+				while ((step<<2) <= size)
+					step <<= 1;
+				size += step;
+			}
+		}
+
+		int c = 0;
+		for (int i = 0; i <= kMaxBlockSize/kGranularity; ++i) {
+			while (m_classSize[c] < i*kGranularity)
+				++c;
+			m_classForSize[i] = (U8)c;
+		}
 
-		BOOST_STATIC_ASSERT(kNumPools==10);
-		BOOST_STATIC_ASSERT(kBasePoolSize==8);
+		memset(m_free, 0, sizeof(m_free));
+	}
+
+	~Allocator() {
+		while (m_slabs) {
+			Slab *next = m_slabs->next;
+			zone_free(m_slabs);
+			m_slabs = next;
+		}
+	}
+
+	void *Alloc(void *ptr, size_t osize, size_t nsize) {
+		if (!ptr)
+			osize = 0;
 
-		if (size <= 8)
-			return 0;
-		if (size <= 16)
-			return 1;
-		if (size <= 32)
-			return 2;
-		if (size <= 64)
-			return 3;
-		if (size <= 128)
-			return 4;
-		if (size <= 256)
-			return 5;
-		if (size <= 512)
-			return 6;
-		if (size <= 1024)
-			return 7;
-		if (size <= 2048)
-			return 8;
-		RAD_ASSERT(size<=4096);
-		return 9;
-	}
-
-	static void *Alloc(void *ptr, size_t osize, size_t nsize) {
 		if (!nsize) {
-			if (ptr&&osize) {
-				--s_numAllocs;
-
-				int opool = PoolIndex(osize);
-				if (opool < 0)
-					zone_free(ptr);
-				else
-					s_pools[opool].ReturnChunk(ptr);
-			}
+			if (osize)
+				Free(ptr, osize);
 			return 0;
 		}
 
-		if (nsize < s_min)
-			s_min = nsize;
-		if (nsize > s_max)
-			s_max = nsize;
-
-		int npool = PoolIndex(nsize);
-		
-		if (ptr&&osize) { 
-			// existing allocation
-			int opool = PoolIndex(osize);
-			if (npool < 0) { 
-				// heap
-				if (opool < 0) { 
-					// heap
-					return safe_zone_realloc(ZLuaRuntime, ptr, nsize);
-				}
+		if (osize) {
+			const int kOldClass = ClassForSize(osize);
+			const int kNewClass = ClassForSize(nsize);
 
-				void *nptr = safe_zone_malloc(ZLuaRuntime, nsize);
-				memcpy(nptr, ptr, std::min(osize, nsize));
-				s_pools[opool].ReturnChunk(ptr);
-				return nptr;
-			} else { 
-				// pool
-				if (opool < 0) { 
-					// heap
-					void *nptr = s_pools[npool].SafeGetChunk();
-					memcpy(nptr, ptr, nsize);
-					zone_free(ptr);
-					return nptr;
-				} else if (npool != opool) { 
-					// moving pools
-					void *nptr = s_pools[npool].SafeGetChunk();
-					memcpy(nptr, ptr, std::min(osize, nsize));
-					s_pools[opool].ReturnChunk(ptr);
-					return nptr;
-				}
+			if (kOldClass < 0 && kNewClass < 0) {
+				m_m.heapBytes += nsize - osize;
+				Account(osize, nsize);
+				return safe_zone_realloc(ZLuaRuntime, ptr, nsize);
+			}
 
+			if (kOldClass == kNewClass) {
+				Account(osize, nsize);
 				return ptr;
 			}
-		} else { 
-			// new allocation
-			++s_numAllocs;
-			if (npool < 0)
-				return safe_zone_malloc(ZLuaRuntime, nsize);
-			return s_pools[npool].SafeGetChunk();
+
+			void *nptr = New(nsize);
+			memcpy(nptr, ptr, std::min(osize, nsize));
+			Free(ptr, osize);
+			return nptr;
 		}
+
+		return New(nsize);
 	}
 
-	static void Open() {
-		if (++s_refs == 1) {
-			for (int i = 0; i < kNumPools; ++i) {
-				AddrSize chunkSize = kBasePoolSize<<i;
+	//! Frees every slab but the one being bumped whose blocks are all on the free lists.
+	void Compact() {
+		SlabUseVec slabs;
+		for (Slab *slab = m_slabs ? m_slabs->next : 0; slab; slab = slab->next) {
+			SlabUse use;
+			use.slab = slab;
+			use.free = 0;
+			slabs.push_back(use);
+		}
+
+		if (slabs.empty())
+			return;
 
-				char sz[64];
-				sprintf(sz, "lua_pool_%d", (int)chunkSize);
+		std::sort(slabs.begin(), slabs.end());
 
-				s_pools[i].Create(
-					ZLuaRuntime,
-					sz,
-					chunkSize,
-					std::max<int>((int)((32*kKilo)/chunkSize), 4)
-				);
+		for (int c = 0; c < kMaxClasses; ++c) {
+			for (Block *block = m_free[c]; block; block = block->next) {
+				SlabUse *use = FindSlab(slabs, block);
+				if (use)
+					use->free += m_classSize[c];
+			}
+		}
+
+		int numFree = 0;
+		for (SlabUseVec::iterator it = slabs.begin(); it != slabs.end(); ++it) {
+			if (it->free == it->slab->size)
+				++numFree;
+		}
+
+		if (!numFree)
+			return;
+
+		// unlink the blocks of the released slabs.
+		for (int c = 0; c < kMaxClasses; ++c) {
+			Block **prev = &m_free[c];
+			while (*prev) {
+				SlabUse *use = FindSlab(slabs, *prev);
+				if (use && (use->free == use->slab->size)) {
+					*prev = (*prev)->next;
+				} else {
+					prev = &(*prev)->next;
+				}
+			}
+		}
+
+		Slab **prev = &m_slabs->next;
+		while (*prev) {
+			Slab *slab = *prev;
+			SlabUse *use = FindSlab(slabs, slab);
+			if (use->free == slab->size) {
+				*prev = slab->next;
+				zone_free(slab);
+				m_m.slabBytes -= kSlabSize;
+			} else {
+				prev = &slab->next;
 			}
 		}
 	}
 
-	static void Close() {
-		RAD_ASSERT(s_refs>0);
-		if (--s_refs == 0) {
-			for (int i = 0; i < kNumPools; ++i)
-				s_pools[i].Destroy();
-		} else {
-			Compact();
+private:
+
+	struct Slab {
+		Slab *next;
+		AddrSize size; // bytes carved into blocks, set when the slab is retired.
+	};
+
+	struct Block {
+		Block *next;
+	};
+
+	struct SlabUse {
+		Slab *slab;
+		AddrSize free;
+
+		bool operator < (const SlabUse &other) const {
+			return slab < other.slab;
 		}
+	};
+
+	typedef zone_vector<SlabUse, ZLuaRuntimeT>::type SlabUseVec;
+
+	static U8 *SlabData(Slab *slab) {
+		return reinterpret_cast<U8*>(slab) + kSlabHeaderSize;
 	}
 
-	static void Compact() {
-		for (int i = 0; i < kNumPools; ++i)
-			s_pools[i].Compact();
+	//! Returns the slab p was carved from, or null if it is not in slabs.
+	static SlabUse *FindSlab(SlabUseVec &slabs, const void *p) {
+		SlabUse key;
+		key.slab = (Slab*)p;
+		SlabUseVec::iterator it = std::upper_bound(slabs.begin(), slabs.end(), key);
+		if (it == slabs.begin())
+			return 0;
+		--it;
+		if ((const U8*)p >= ((const U8*)it->slab) + kSlabSize)
+			return 0;
+		return &(*it);
 	}
-	
-#if defined(RAD_OPT_IOS)
-	typedef boost::array<MemoryPool, kNumPools> PoolsArray;
-#else
-	typedef boost::array<ThreadSafeMemoryPool, kNumPools> PoolsArray;
-#endif
-	
-	static int s_refs;
-	static int s_numAllocs;
-	static size_t s_min;
-	static size_t s_max;
-	static PoolsArray s_pools;
-};
 
-int LuaPools::s_refs = 0;
-int LuaPools::s_numAllocs = 0;
-size_t LuaPools::s_max = std::numeric_limits<size_t>::min();
-size_t LuaPools::s_min = std::numeric_limits<size_t>::max();
-LuaPools::PoolsArray LuaPools::s_pools;
+	int ClassForSize(size_t size) const {
+		if (size > kMaxBlockSize)
+			return -1;
+		return m_classForSize[(size+kGranularity-1)/kGranularity];
+	}
+
+	void Account(size_t osize, size_t nsize) {
+		m_m.bytesInUse += nsize;
+		m_m.bytesInUse -= osize;
+		if (m_m.bytesInUse > m_m.peakBytesInUse)
+			m_m.peakBytesInUse = m_m.bytesInUse;
+		if ((int)nsize < m_m.smallest)
+			m_m.smallest = (int)nsize;
+		if ((int)nsize > m_m.biggest)
+			m_m.biggest = (int)nsize;
+		if (nsize > osize)
+			m_m.totalBytes += nsize - osize;
+	}
+
+	void *New(size_t size) {
+		++m_m.numAllocs;
+		++m_m.totalAllocs;
+		Account(0, size);
+
+		const int kClass = ClassForSize(size);
+		if (kClass < 0) {
+			m_m.heapBytes += size;
+			return safe_zone_malloc(ZLuaRuntime, size);
+		}
+
+		Block *block = m_free[kClass];
+		if (block) {
+			m_free[kClass] = block->next;
+			return block;
+		}
 
+		const int kSize = m_classSize[kClass];
+		if (m_bump + kSize > m_bumpEnd)
+			NewSlab();
+
+		void *p = m_bump;
+		m_bump += kSize;
+		return p;
+	}
+
+	void Free(void *ptr, size_t size) {
+		--m_m.numAllocs;
+		m_m.bytesInUse -= size;
+
+		const int kClass = ClassForSize(size);
+		if (kClass < 0) {
+			m_m.heapBytes -= size;
+			zone_free(ptr);
+			return;
+		}
+
+		Block *block = reinterpret_cast<Block*>(ptr);
+		block->next = m_free[kClass];
+		m_free[kClass] = block;
+	}
+
+	void NewSlab() {
+		// hand the tail of the old slab to the free lists so it isn't lost.
+		while (m_bumpEnd - m_bump >= kGranularity) {
+			int c = ClassForSize(m_bumpEnd - m_bump);
+			if (m_classSize[c] > m_bumpEnd - m_bump)
+				--c;
+			Block *block = reinterpret_cast<Block*>(m_bump);
+			block->next = m_free[c];
+			m_free[c] = block;
+			m_bump += m_classSize[c];
+		}
+
+		if (m_slabs)
+			m_slabs->size = (AddrSize)(m_bump - SlabData(m_slabs));
+
+		Slab *slab = (Slab*)safe_zone_malloc(ZLuaRuntime, kSlabSize, 0, kGranularity);
+		slab->next = m_slabs;
+		slab->size = 0;
+		m_slabs = slab;
+		m_m.slabBytes += kSlabSize;
+
+		m_bump = SlabData(slab);
+		m_bumpEnd = reinterpret_cast<U8*>(slab) + kSlabSize;
+	}
+
+	Metrics &m_m;
+	Slab *m_slabs;
+	U8 *m_bump;
+	U8 *m_bumpEnd;
+	int m_classSize[kMaxClasses];
+	U8 m_classForSize[kMaxBlockSize/kGranularity+1];
+	Block *m_free[kMaxClasses];
+};
 #endif
 
 State::State(const char *name) {
@@ -205,9 +334,15 @@ State::State(const char *name) {
 	m_m.numAllocs = 0;
 	m_m.smallest = std::numeric_limits<int>::max();
 	m_m.biggest = std::numeric_limits<int>::min();
+	m_m.bytesInUse = 0;
+	m_m.peakBytesInUse = 0;
+	m_m.slabBytes = 0;
+	m_m.heapBytes = 0;
+	m_m.totalAllocs = 0;
+	m_m.totalBytes = 0;
 
 #if !defined(LUA_JIT)
-	LuaPools::Open();
+	m_alloc = new (ZLuaRuntime) Allocator(m_m);
 #endif
 
 #if defined(LUA_JIT)
@@ -232,31 +367,20 @@ State::~State() {
 	if (m_s)
 		::lua_close(m_s);
 #if !defined(LUA_JIT)
-	LuaPools::Close();
+	delete m_alloc;
 #endif
 }
 
 void State::CompactPools() {
 #if !defined(LUA_JIT)
-	LuaPools::Compact();
+	m_alloc->Compact();
 #endif
 }
 
 #if !defined(LUA_JIT)
 void *State::LuaAlloc(void *ud, void *ptr, size_t osize, size_t nsize) {
 	State *s = reinterpret_cast<State*>(ud);
-	if (!nsize) {
-		if (ptr&&osize)
-			--s->m_m.numAllocs;
-	} else {
-		if ((int)nsize < s->m_m.smallest)
-			s->m_m.smallest = (int)nsize;
-		if ((int)nsize > s->m_m.biggest)
-			s->m_m.biggest = (int)nsize;
-
-		if (!osize)
-			++s->m_m.numAllocs;
-	}
+	void *p = s->m_alloc->Alloc(ptr, osize, nsize);
 
 #if defined(LOG_ALLOCS)
 #if defined(RAD_OPT_PC)
@@ -274,7 +398,7 @@ void *State::LuaAlloc(void *ud, void *ptr, size_t osize, size_t nsize) {
 #endif
 #endif
 
-	return LuaPools::Alloc(ptr, osize, nsize);
+	return p;
 }
 #endif
 
@@ -36,22 +36,33 @@ public:
 
 	typedef StateRef Ref;
 
+	//! Allocation counters, updated live by the state's allocator.
+	/*! totalAllocs and totalBytes only ever grow: sample them once per tick and
+		take the difference to see how much garbage scripts are generating. */
 	struct Metrics {
 		int numAllocs;
 		int smallest;
 		int biggest;
+		AddrSize bytesInUse;
+		AddrSize peakBytesInUse;
+		AddrSize slabBytes; // reserved by the small block slabs
+		AddrSize heapBytes; // blocks too big for a size class
+		U64 totalAllocs;
+		U64 totalBytes;
 	};
 
 	State(const char *name);
 	~State();
 
-	static void CompactPools();
+	//! Returns slabs that have no blocks in use, best called after a full collect.
+	void CompactPools();
 
 	RAD_DECLARE_READONLY_PROPERTY(State, L, lua_State*);
 	RAD_DECLARE_READONLY_PROPERTY(State, metrics, const Metrics*);
 private:
 
 #if !defined(LUA_JIT)
+	class Allocator;
 	static void *LuaAlloc(void *ud, void *ptr, size_t, size_t size);
 #endif
 
@@ -61,6 +72,9 @@ private:
 	char m_sz[64];
 	lua_State *m_s;
 	Metrics m_m;
+#if !defined(LUA_JIT)
+	Allocator *m_alloc;
+#endif
 };
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,402 @@
+/*! \file CookDatabase.cpp
+	\copyright Copyright (c) 2013 Sunside Inc., All Rights Reserved.
+	\copyright See Radiance/LICENSE for licensing terms.
+	\author Joe Riedel
+	\ingroup packages
+*/
+
+#include RADPCH
+#include "CookDatabase.h"
+#include "../App.h"
+#include "../Engine.h"
+#include <Runtime/File.h>
+#include <Runtime/Stream.h>
+#include <iostream>
+#include <stdio.h>
+
+#if defined(RAD_OPT_TOOLS)
+
+namespace pkg {
+
+namespace {
+
+const CookDatabase::Hash kFNVPrime = (CookDatabase::Hash(0x00000100) << 32) | CookDatabase::Hash(0x000001b3);
+
+bool ReadStrings(stream::InputStream &is, StringVec &vec) {
+	U32 num;
+	if (!is.Read(&num))
+		return false;
+	vec.reserve(num);
+	for (U32 i = 0; i < num; ++i) {
+		String s;
+		if (!is.Read(&s))
+			return false;
+		vec.push_back(s);
+	}
+	return true;
+}
+
+bool WriteStrings(stream::OutputStream &os, const StringVec &vec) {
+	if (!os.Write((U32)vec.size()))
+		return false;
+	for (StringVec::const_iterator it = vec.begin(); it != vec.end(); ++it) {
+		if (!os.Write(*it))
+			return false;
+	}
+	return true;
+}
+
+float Percent(int x, int total) {
+	return total ? (x * 100.f / total) : 0.f;
+}
+
+} // namespace
+
+CookDatabase::CookDatabase() {
+}
+
+void CookDatabase::Load(const char *path) {
+	RAD_ASSERT(path);
+
+	Lock L(m_m);
+
+	m_files.clear();
+	m_assets.clear();
+	m_paks.clear();
+
+	FILE *fp = App::Get()->engine->sys->files->fopen(path, "rb");
+	if (!fp)
+		return;
+
+	file::FILEInputBuffer ib(fp);
+	stream::InputStream is(ib);
+
+	bool valid = false;
+
+	for (;;) {
+		U32 tag, version;
+		if (!is.Read(&tag) || (tag != kTag))
+			break;
+		if (!is.Read(&version) || (version != kVersion))
+			break;
+
+		U32 num;
+		if (!is.Read(&num))
+			break;
+
+		U32 i;
+		for (i = 0; i < num; ++i) {
+			String s;
+			File f;
+			if (!is.Read(&s) || !f.time.Read(is) || !is.Read(&f.size) || !is.Read(&f.hash))
+				break;
+			m_files[s] = f;
+		}
+
+		if (i != num || !is.Read(&num))
+			break;
+
+		for (i = 0; i < num; ++i) {
+			String s;
+			Asset a;
+			if (!is.Read(&s) || !is.Read(&a.keys))
+				break;
+			if (!ReadStrings(is, a.sources) || !ReadStrings(is, a.imports))
+				break;
+
+			U32 numDeps;
+			if (!is.Read(&numDeps))
+				break;
+
+			U32 k;
+			for (k = 0; k < numDeps; ++k) {
+				String dep;
+				Hash digest;
+				if (!is.Read(&dep) || !is.Read(&digest))
+					break;
+				a.dependencies[dep] = digest;
+			}
+
+			if (k != numDeps)
+				break;
+
+			m_assets[s] = a;
+		}
+
+		if (i != num || !is.Read(&num))
+			break;
+
+		for (i = 0; i < num; ++i) {
+			String s;
+			Hash digest;
+			if (!is.Read(&s) || !is.Read(&digest))
+				break;
+			m_paks[s] = digest;
+		}
+
+		valid = i == num;
+		break;
+	}
+
+	fclose(fp);
+
+	if (!valid) {
+		// rebuild from scratch rather than trust a partial database.
+		m_files.clear();
+		m_assets.clear();
+		m_paks.clear();
+	}
+}
+
+bool CookDatabase::Save(const char *path) {
+	RAD_ASSERT(path);
+
+	Lock L(m_m);
+
+	FILE *fp = App::Get()->engine->sys->files->fopen(path, "wb");
+	if (!fp)
+		return false;
+
+	file::FILEOutputBuffer ob(fp);
+	stream::OutputStream os(ob);
+
+	bool r = false;
+
+	for (;;) {
+		if (!os.Write((U32)kTag) || !os.Write((U32)kVersion))
+			break;
+
+		if (!os.Write((U32)m_files.size()))
+			break;
+
+		FileMap::const_iterator fileIt;
+		for (fileIt = m_files.begin(); fileIt != m_files.end(); ++fileIt) {
+			const File &f = fileIt->second;
+			if (!os.Write(fileIt->first) || !f.time.Write(os) || !os.Write(f.size) || !os.Write(f.hash))
+				break;
+		}
+
+		if (fileIt != m_files.end() || !os.Write((U32)m_assets.size()))
+			break;
+
+		AssetMap::const_iterator assetIt;
+		for (assetIt = m_assets.begin(); assetIt != m_assets.end(); ++assetIt) {
+			const Asset &a = assetIt->second;
+			if (!os.Write(assetIt->first) || !os.Write(a.keys))
+				break;
+			if (!WriteStrings(os, a.sources) || !WriteStrings(os, a.imports))
+				break;
+			if (!os.Write((U32)a.dependencies.size()))
+				break;
+
+			Asset::DependencyMap::const_iterator depIt;
+			for (depIt = a.dependencies.begin(); depIt != a.dependencies.end(); ++depIt) {
+				if (!os.Write(depIt->first) || !os.Write(depIt->second))
+					break;
+			}
+
+			if (depIt != a.dependencies.end())
+				break;
+		}
+
+		if (assetIt != m_assets.end() || !os.Write((U32)m_paks.size()))
+			break;
+
+		PakMap::const_iterator pakIt;
+		for (pakIt = m_paks.begin(); pakIt != m_paks.end(); ++pakIt) {
+			if (!os.Write(pakIt->first) || !os.Write(pakIt->second))
+				break;
+		}
+
+		r = pakIt == m_paks.end();
+		break;
+	}
+
+	fclose(fp);
+	return r;
+}
+
+bool CookDatabase::FileHash(const char *path, Hash &hash) {
+	RAD_ASSERT(path);
+
+	file::FileSystem::Ref files = App::Get()->engine->sys->files;
+
+	File f;
+	if (!files->GetFileTime(path, f.time))
+		return false;
+
+	FILE *fp = files->fopen(path, "rb");
+	if (!fp)
+		return false;
+
+	fseek(fp, 0, SEEK_END);
+	f.size = (S64)ftell(fp);
+
+	const String kPath(CStr(path));
+
+	{
+		Lock L(m_m);
+		FileMap::const_iterator it = m_files.find(kPath);
+		if ((it != m_files.end()) && (it->second.size == f.size) && (it->second.time == f.time)) {
+			++m_stats.fileHashHits;
+			hash = it->second.hash;
+			fclose(fp);
+			return true;
+		}
+	}
+
+	fseek(fp, 0, SEEK_SET);
+
+	enum { kBufSize = 64*kKilo };
+	U8 *buf = (U8*)safe_zone_malloc(ZPackages, kBufSize);
+
+	f.hash = HashInt(f.size);
+	for (;;) {
+		size_t n = fread(buf, 1, kBufSize, fp);
+		if (n < 1)
+			break;
+		f.hash = HashBytes(buf, (AddrSize)n, f.hash);
+	}
+
+	const bool kError = ferror(fp) != 0;
+	zone_free(buf);
+	fclose(fp);
+
+	if (kError)
+		return false;
+
+	hash = f.hash;
+
+	Lock L(m_m);
+	m_files[kPath] = f;
+	++m_stats.filesHashed;
+	return true;
+}
+
+CookDatabase::Hash CookDatabase::AssetDigest(const char *assetPath, Hash keysHash) {
+	RAD_ASSERT(assetPath);
+
+	StringVec sources;
+
+	{
+		Lock L(m_m);
+		AssetMap::const_iterator it = m_assets.find(CStr(assetPath));
+		if (it != m_assets.end())
+			sources = it->second.sources;
+	}
+
+	Hash digest = HashInt((S64)keysHash);
+
+	for (StringVec::const_iterator it = sources.begin(); it != sources.end(); ++it) {
+		Hash hash;
+		digest = HashString((*it).c_str, digest);
+		if (FileHash((*it).c_str, hash)) {
+			digest = HashInt((S64)hash, digest);
+		} else {
+			digest = HashInt(0, digest); // missing source.
+		}
+	}
+
+	return digest;
+}
+
+bool CookDatabase::FindAsset(const char *assetPath, Asset &asset) {
+	RAD_ASSERT(assetPath);
+	Lock L(m_m);
+	AssetMap::const_iterator it = m_assets.find(CStr(assetPath));
+	if (it == m_assets.end())
+		return false;
+	asset = it->second;
+	return true;
+}
+
+void CookDatabase::SetAsset(const char *assetPath, const Asset &asset) {
+	RAD_ASSERT(assetPath);
+	Lock L(m_m);
+	m_assets[CStr(assetPath)] = asset;
+}
+
+bool CookDatabase::PakUpToDate(const char *name, Hash digest) {
+	RAD_ASSERT(name);
+	Lock L(m_m);
+	PakMap::const_iterator it = m_paks.find(CStr(name));
+	return (it != m_paks.end()) && (it->second == digest);
+}
+
+void CookDatabase::SetPak(const char *name, Hash digest) {
+	RAD_ASSERT(name);
+	Lock L(m_m);
+	m_paks[CStr(name)] = digest;
+}
+
+void CookDatabase::LogStats(std::ostream &out) {
+	Lock L(m_m);
+
+	const int kNumAssets = m_stats.assetsUpToDate + m_stats.assetsCooked;
+	const int kNumFiles = m_stats.fileHashHits + m_stats.filesHashed;
+	const int kNumPaks = m_stats.paksUpToDate + m_stats.paksBuilt;
+
+	char sz[256];
+
+	out << "------ Cook Database ------" << std::endl;
+	sprintf(
+		sz,
+		"Assets: %d of %d up to date (%.1f%%), %d cooked (%d for changed dependencies).",
+		(int)m_stats.assetsUpToDate,
+		kNumAssets,
+		Percent((int)m_stats.assetsUpToDate, kNumAssets),
+		(int)m_stats.assetsCooked,
+		(int)m_stats.dependencyCooks
+	);
+	out << sz << std::endl;
+	sprintf(
+		sz,
+		"File hashes: %d of %d reused (%.1f%%), %d file(s) read.",
+		(int)m_stats.fileHashHits,
+		kNumFiles,
+		Percent((int)m_stats.fileHashHits, kNumFiles),
+		(int)m_stats.filesHashed
+	);
+	out << sz << std::endl;
+	sprintf(
+		sz,
+		"Pak files: %d of %d up to date (%.1f%%), %d built.",
+		(int)m_stats.paksUpToDate,
+		kNumPaks,
+		Percent((int)m_stats.paksUpToDate, kNumPaks),
+		(int)m_stats.paksBuilt
+	);
+	out << sz << std::endl;
+}
+
+CookDatabase::Hash CookDatabase::HashBytes(const void *data, AddrSize size, Hash hash) {
+	const U8 *bytes = reinterpret_cast<const U8*>(data);
+	for (AddrSize i = 0; i < size; ++i) {
+		hash ^= (Hash)bytes[i];
+		hash *= kFNVPrime;
+	}
+	return hash;
+}
+
+CookDatabase::Hash CookDatabase::HashString(const char *sz, Hash hash) {
+	RAD_ASSERT(sz);
+	// include the terminator so "ab","c" and "a","bc" differ.
+	return HashBytes(sz, (AddrSize)(string::len(sz)+1), hash);
+}
+
+CookDatabase::Hash CookDatabase::HashInt(S64 val, Hash hash) {
+	U8 bytes[8];
+	for (int i = 0; i < 8; ++i)
+		bytes[i] = (U8)((U64)val >> (i*8));
+	return HashBytes(bytes, 8, hash);
+}
+
+String CookDatabase::HashToString(Hash hash) {
+	char sz[32];
+	sprintf(sz, "%08x%08x", (U32)(hash >> 32), (U32)(hash & 0xffffffff));
+	return String(sz);
+}
+
+} // pkg
+
+#endif
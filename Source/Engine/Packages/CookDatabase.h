@@ -0,0 +1,151 @@
+/*! \file CookDatabase.h
+	\copyright Copyright (c) 2013 Sunside Inc., All Rights Reserved.
+	\copyright See Radiance/LICENSE for licensing terms.
+	\author Joe Riedel
+	\ingroup packages
+*/
+
+#pragma once
+
+#include "PackagesDef.h"
+#include <Runtime/Container/ZoneMap.h>
+#include <Runtime/Container/ZoneVector.h>
+#include <Runtime/Thread/Locks.h>
+#include <Runtime/Thread/Interlocked.h>
+#include <Runtime/Time/Time.h>
+#include <iosfwd>
+#include <Runtime/PushPack.h>
+
+#if defined(RAD_OPT_TOOLS)
+
+namespace pkg {
+
+//! Persistent state of a cook, stored next to the cooked data of a target.
+/*! The database records a content hash for every source and output file seen by a
+	cook so later cooks can tell real changes from touched files (and catch edits that
+	don't move a file's timestamp forward). A file is only read again when its size or
+	time differs from the recorded one.
+
+	For each cooked asset it records the source files and key values the cooker
+	compared, and the assets it declared as build dependencies (see Cooker::AddDependency()).
+	An asset is rebuilt when the digest of any of its dependencies differs from the one it
+	was cooked against.
+
+	Pak files record the digest of the files they were built from and are only rebuilt
+	when that changes.
+
+	All methods are thread safe. */
+class CookDatabase {
+public:
+	typedef boost::shared_ptr<CookDatabase> Ref;
+	typedef U64 Hash;
+
+	//! Cook counters, updated by the cook threads.
+	struct Stats {
+		Stats() {
+			Clear();
+		}
+
+		void Clear() {
+			assetsUpToDate = 0;
+			assetsCooked = 0;
+			dependencyCooks = 0;
+			filesHashed = 0;
+			fileHashHits = 0;
+			paksUpToDate = 0;
+			paksBuilt = 0;
+		}
+
+		thread::Interlocked<int> assetsUpToDate;
+		thread::Interlocked<int> assetsCooked;
+		thread::Interlocked<int> dependencyCooks; // cooked only because a dependency changed.
+		thread::Interlocked<int> filesHashed;
+		thread::Interlocked<int> fileHashHits;
+		thread::Interlocked<int> paksUpToDate;
+		thread::Interlocked<int> paksBuilt;
+	};
+
+	struct Asset {
+		typedef zone_map<String, Hash, ZPackagesT>::type DependencyMap;
+
+		Asset() : keys(0) {}
+
+		Hash keys;
+		StringVec sources;
+		StringVec imports;
+		DependencyMap dependencies; // digest of each dependency when this asset was cooked.
+	};
+
+	CookDatabase();
+
+	//! Loads a database, a missing or out of date file is an empty database.
+	void Load(const char *path);
+	bool Save(const char *path);
+
+	//! Returns the content hash of a file given as an absolute path.
+	/*! Returns false if the file does not exist or cannot be read. */
+	bool FileHash(const char *path, Hash &hash);
+
+	//! Returns the digest of a cooked asset's sources and key values (from keysHash).
+	/*! Source files are hashed in their current state, assets that have not been cooked
+		have a digest of their key values only. */
+	Hash AssetDigest(const char *assetPath, Hash keysHash);
+
+	bool FindAsset(const char *assetPath, Asset &asset);
+	void SetAsset(const char *assetPath, const Asset &asset);
+
+	//! Returns true if a pak file was last built from files with the specified digest.
+	bool PakUpToDate(const char *name, Hash digest);
+	void SetPak(const char *name, Hash digest);
+
+	void LogStats(std::ostream &out);
+
+	RAD_DECLARE_READONLY_PROPERTY(CookDatabase, stats, Stats*);
+
+	static Hash HashBytes(const void *data, AddrSize size, Hash hash = DefaultSeed());
+	static Hash HashString(const char *sz, Hash hash = DefaultSeed());
+	static Hash HashInt(S64 val, Hash hash = DefaultSeed());
+	static String HashToString(Hash hash);
+
+	//! FNV-1a 64 bit offset basis.
+	static Hash DefaultSeed() {
+		return (Hash(0xcbf29ce4) << 32) | Hash(0x84222325);
+	}
+
+private:
+
+	RAD_DECLARE_GET(stats, Stats*) {
+		return &m_stats;
+	}
+
+	enum {
+		kTag = RAD_FOURCC('C', 'K', 'D', 'B'),
+		kVersion = 1
+	};
+
+	struct File {
+		File() : size(0), hash(0) {}
+
+		xtime::TimeDate time;
+		S64 size;
+		Hash hash;
+	};
+
+	typedef zone_map<String, File, ZPackagesT>::type FileMap;
+	typedef zone_map<String, Asset, ZPackagesT>::type AssetMap;
+	typedef zone_map<String, Hash, ZPackagesT>::type PakMap;
+	typedef boost::mutex Mutex;
+	typedef boost::lock_guard<Mutex> Lock;
+
+	FileMap m_files;
+	AssetMap m_assets;
+	PakMap m_paks;
+	mutable Stats m_stats; // counted by the cook threads through stats.
+	Mutex m_m;
+};
+
+} // pkg
+
+#endif
+
+#include <Runtime/PopPack.h>
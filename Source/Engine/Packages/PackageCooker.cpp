@@ -48,11 +48,167 @@ const char *ErrorString(int r) {
 		return "SR_CompilerError";
 	case SR_ScriptError:
 		return "SR_ScriptError";
+	case SR_Cancelled:
+		return "SR_Cancelled";
 	}
 
 	return "Unknown Error";
 }
 
+//! Hashes the key values of an entry that apply to a target.
+CookDatabase::Hash EntryKeysHash(const Package::Entry &entry, int target) {
+	target &= P_AllTargets;
+
+	CookDatabase::Hash hash = CookDatabase::HashInt((S64)entry.type.get());
+
+	const KeyVal::Map &keys = entry.Keys();
+	for (KeyVal::Map::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+		const KeyVal::Ref &key = it->second;
+		if (!key->def || !key->val.Valid())
+			continue; // not saved with the package.
+		if (key->flags && !(key->flags&target))
+			continue; // other platform.
+
+		hash = CookDatabase::HashString(key->path.c_str, hash);
+
+		const String *s = static_cast<const String*>(key->val);
+		if (s) {
+			hash = CookDatabase::HashString(s->c_str, hash);
+			continue;
+		}
+
+		const int *i = static_cast<const int*>(key->val);
+		if (i) {
+			hash = CookDatabase::HashInt(*i, hash);
+			continue;
+		}
+
+		const bool *b = static_cast<const bool*>(key->val);
+		if (b)
+			hash = CookDatabase::HashInt(*b ? 1 : 0, hash);
+	}
+
+	return hash;
+}
+
+enum {
+	kPakLumpsPerThread = 8 // files read ahead per job thread when building a pak.
+};
+
+//! A file read and compressed by a PakLumpJob.
+struct PakLump {
+	PakLump() : data(0), zipData(0), size(0), zipSize(0), usecs(0), error(SR_Success) {}
+
+	String name;
+	String nativePath;
+	void *data;
+	void *zipData; // null if the file was stored uncompressed.
+	AddrSize size;
+	AddrSize zipSize;
+	U32 usecs;
+	int error;
+};
+
+typedef zone_vector<PakLump, ZPackagesT>::type PakLumpVec;
+
+//! Reads and compresses the files of a pak batch, each job only touches its own lumps.
+struct PakLumpJob {
+	PakLump *lumps;
+	int compression;
+
+	void operator () (int first, int count) {
+		for (int i = first; i < first+count; ++i)
+			Load(lumps[i]);
+	}
+
+	void Load(PakLump &lump) {
+		xtime::MicroTimer timer;
+		timer.Start();
+
+		FILE *fp = fopen(lump.nativePath.c_str, "rb");
+		if (!fp) {
+			lump.error = SR_FileNotFound;
+			return;
+		}
+
+		fseek(fp, 0, SEEK_END);
+		lump.size = (AddrSize)ftell(fp);
+		fseek(fp, 0, SEEK_SET);
+
+		if (lump.size < 1) {
+			fclose(fp);
+			return;
+		}
+
+		lump.data = safe_zone_malloc(ZPackages, lump.size);
+		if (fread(lump.data, 1, lump.size, fp) != lump.size) {
+			fclose(fp);
+			lump.error = SR_IOError;
+			return;
+		}
+
+		fclose(fp);
+
+		if (compression)
+			Compress(lump);
+
+		timer.Stop();
+		lump.usecs = (U32)timer.Elapsed();
+	}
+
+	//! Compresses a lump in file::kPakBlockSize blocks, see file::PakBlockTag.
+	void Compress(PakLump &lump) {
+		const AddrSize kNumBlocks = (lump.size + file::kPakBlockSize - 1) / file::kPakBlockSize;
+		const AddrSize kTableSize = (kNumBlocks + 1) * sizeof(U32);
+
+		lump.zipSize = kTableSize + (kNumBlocks * data_codec::zlib::PredictEncodeSize(file::kPakBlockSize));
+		lump.zipData = safe_zone_malloc(ZPackages, lump.zipSize);
+
+		U32 *offsets = reinterpret_cast<U32*>(lump.zipData);
+		AddrSize ofs = kTableSize;
+
+		for (AddrSize i = 0; i < kNumBlocks; ++i) {
+			const U8 *src = reinterpret_cast<const U8*>(lump.data) + (i * file::kPakBlockSize);
+			const AddrSize kSrcSize = std::min<AddrSize>(file::kPakBlockSize, lump.size - (i * file::kPakBlockSize));
+			U8 *dst = reinterpret_cast<U8*>(lump.zipData) + ofs;
+
+			// every block has room for its predicted size, which Encode() expects.
+			AddrSize dstSize = data_codec::zlib::PredictEncodeSize(kSrcSize);
+			if (!data_codec::zlib::Encode(src, kSrcSize, compression, dst, &dstSize)) {
+				lump.error = SR_CompilerError;
+				return;
+			}
+
+			if (dstSize >= kSrcSize) {
+				// incompressible blocks are stored raw.
+				memcpy(dst, src, kSrcSize);
+				dstSize = kSrcSize;
+			}
+
+			offsets[i] = (U32)ofs;
+			ofs += dstSize;
+		}
+
+		offsets[kNumBlocks] = (U32)ofs;
+		lump.zipSize = ofs;
+
+		if (lump.zipSize >= lump.size) {
+			// incompressible data is stored raw.
+			zone_free(lump.zipData);
+			lump.zipData = 0;
+		}
+	}
+};
+
+void FreePakLump(PakLump &lump) {
+	if (lump.data)
+		zone_free(lump.data);
+	if (lump.zipData)
+		zone_free(lump.zipData);
+	lump.data = 0;
+	lump.zipData = 0;
+}
+
 }
 
 #if defined(RAD_OPT_PC_TOOLS)
@@ -142,6 +298,77 @@ int PackageMan::CookThread::ThreadProc() {
 	return 0;
 }
 
+bool PackageMan::CookDependenciesChanged(const Cooker::Ref &cooker) {
+	CookDatabase::Asset record;
+	if (!m_cookState->db->FindAsset(cooker->m_assetPath.c_str, record))
+		return false;
+
+	for (CookDatabase::Asset::DependencyMap::const_iterator it = record.dependencies.begin(); it != record.dependencies.end(); ++it) {
+		Package::Entry::Ref entry = Resolve(it->first.c_str);
+		if (!entry)
+			return true;
+
+		CookDatabase::Hash digest = m_cookState->db->AssetDigest(
+			it->first.c_str, 
+			EntryKeysHash(*entry, m_cookState->ptargets)
+		);
+
+		if (digest != it->second)
+			return true;
+	}
+
+	return false;
+}
+
+void PackageMan::UpdateCookDatabase() {
+	CookDatabase &db = *m_cookState->db;
+
+	// sources and imports first, dependency digests are made from them.
+	for (CookerMap::const_iterator it = m_cookState->cookers.begin(); it != m_cookState->cookers.end(); ++it) {
+		const Cooker::Ref &cooker = it->second;
+		Package::Entry::Ref entry = Resolve(cooker->m_assetPath.c_str);
+		if (!entry)
+			continue;
+
+		CookDatabase::Asset record;
+		db.FindAsset(cooker->m_assetPath.c_str, record);
+
+		if (cooker->m_compiled) {
+			record.sources = cooker->m_sources;
+			record.dependencies.clear();
+			for (StringVec::const_iterator dep = cooker->m_dependencies.begin(); dep != cooker->m_dependencies.end(); ++dep)
+				record.dependencies[*dep] = 0;
+		} else {
+			for (StringVec::const_iterator src = cooker->m_sources.begin(); src != cooker->m_sources.end(); ++src) {
+				if (std::find(record.sources.begin(), record.sources.end(), *src) == record.sources.end())
+					record.sources.push_back(*src);
+			}
+		}
+
+		record.keys = EntryKeysHash(*entry, m_cookState->ptargets);
+		record.imports.clear();
+		for (Cooker::ImportVec::const_iterator imp = cooker->m_imports.begin(); imp != cooker->m_imports.end(); ++imp)
+			record.imports.push_back((*imp).path);
+
+		db.SetAsset(cooker->m_assetPath.c_str, record);
+	}
+
+	for (CookerMap::const_iterator it = m_cookState->cookers.begin(); it != m_cookState->cookers.end(); ++it) {
+		const Cooker::Ref &cooker = it->second;
+
+		CookDatabase::Asset record;
+		if (!db.FindAsset(cooker->m_assetPath.c_str, record) || record.dependencies.empty())
+			continue;
+
+		for (CookDatabase::Asset::DependencyMap::iterator dep = record.dependencies.begin(); dep != record.dependencies.end(); ++dep) {
+			Package::Entry::Ref entry = Resolve(dep->first.c_str);
+			dep->second = entry ? db.AssetDigest(dep->first.c_str, EntryKeysHash(*entry, m_cookState->ptargets)) : 0;
+		}
+
+		db.SetAsset(cooker->m_assetPath.c_str, record);
+	}
+}
+
 void PackageMan::CreateCookThreads(tools::editor::GLWidget &glContext, std::ostream &out) {
 	if (m_cookState->numThreads > 0) {
 		out << "Starting multithreaded cook with " << m_cookState->numThreads << " thread(s)." << std::endl;
@@ -264,6 +491,10 @@ int PackageMan::Cook(
 		return SR_ErrorGeneric;
 	}
 
+	const String kCookDatabasePath(m_cookState->targetPath + CStr("/cook.db"));
+	m_cookState->db.reset(new (ZPackages) CookDatabase());
+	m_cookState->db->Load(kCookDatabasePath.c_str);
+
 	{ // show languages
 		bool sep = false;
 
@@ -322,11 +553,19 @@ int PackageMan::Cook(
 
 			r::Material::EndCook();
 
+			// record what was cooked even if there were errors, failed
+			// assets did not save their state and will be cooked again.
+			UpdateCookDatabase();
+
 			if (r == SR_Success)
 				r = BuildPakFiles(ptargets, compression);
 		}
 	}
 
+	if (!m_cookState->db->Save(kCookDatabasePath.c_str))
+		out << "WARNING: failed to write '" << kCookDatabasePath << "', the next cook will not be incremental." << std::endl;
+	m_cookState->db->LogStats(out);
+
 	xtime::TimeVal totalTime = xtime::ReadMilliseconds() - startTime;
 	UReg days, hours, minutes;
 	FReg seconds;
@@ -382,7 +621,15 @@ int PackageMan::CookPakFileSources(
 			return SR_CompilerError;
 		}
 
+		if ((status == CS_UpToDate) && CookDependenciesChanged(cooker)) {
+			status = CS_NeedRebuild;
+			++m_cookState->db->stats->dependencyCooks;
+			Lock L(m_cookState->ioMutex);
+			out << (*it) << ": Dependencies changed." << std::endl;
+		}
+
 		if (status == CS_NeedRebuild) {
+			++m_cookState->db->stats->assetsCooked;
 
 			bool queued = false;
 
@@ -433,14 +680,17 @@ int PackageMan::CookPakFileSources(
 			}
 
 		} else if (status == CS_UpToDate) {
+			++m_cookState->db->stats->assetsUpToDate;
 			Lock L(m_cookState->mutex);
 			if (m_cookState->error != SR_Success)
 				return m_cookState->error;
 
 			cooker->LoadImports();
+			cooker->SaveGlobals(); // source and key hashes.
 			Lock L2(m_cookState->ioMutex);
 			out << (*it) << ": Up to date." << std::endl;
 		} else {
+			++m_cookState->db->stats->assetsUpToDate;
 			Lock L(m_cookState->mutex);
 			if (m_cookState->error != SR_Success)
 				return m_cookState->error;
@@ -538,7 +788,15 @@ int PackageMan::CookPakFileSources(
 						return SR_CompilerError;
 					}
 
+					if ((status == CS_UpToDate) && CookDependenciesChanged(impCooker)) {
+						status = CS_NeedRebuild;
+						++m_cookState->db->stats->dependencyCooks;
+						Lock L(m_cookState->ioMutex);
+						out << imp.path << ": Dependencies changed." << std::endl;
+					}
+
 					if (status == CS_NeedRebuild) {
+						++m_cookState->db->stats->assetsCooked;
 						bool queued = false;
 
 						if (m_cookState->numThreads > 0) {
@@ -587,13 +845,16 @@ int PackageMan::CookPakFileSources(
 						}
 					}
 					else if (status == CS_UpToDate) {
+						++m_cookState->db->stats->assetsUpToDate;
 						Lock L(m_cookState->mutex);
 						if (m_cookState->error != SR_Success)
 							return m_cookState->error;
 						impCooker->LoadImports();
+						impCooker->SaveGlobals(); // source and key hashes.
 						Lock L2(m_cookState->ioMutex);
 						out << imp.path << ": Up to date." << std::endl;
 					} else {
+						++m_cookState->db->stats->assetsUpToDate;
 						Lock L(m_cookState->mutex);
 						if (m_cookState->error != SR_Success)
 							return m_cookState->error;
@@ -656,6 +917,15 @@ int PackageMan::BuildPakFile(const char *name, int compression) {
 	const String filepath(m_cookState->targetPath + CStr("/Base/") + filename);
 	*m_cookState->cout << "------ Packaging '" << filepath << "' ------" << std::endl;
 
+	const String kPakDir(m_cookState->targetPath + CStr("/Pak/") + name);
+	const CookDatabase::Hash kDigest = PakDigest(kPakDir.c_str, CookDatabase::HashInt(file::kPakBlockSize, CookDatabase::HashInt(compression)));
+
+	if (m_cookState->db->PakUpToDate(name, kDigest) && m_engine.sys->files->FileExists(filepath.c_str)) {
+		++m_cookState->db->stats->paksUpToDate;
+		*m_cookState->cout << "Up to date." << std::endl;
+		return SR_Success;
+	}
+
 	String nativePath;
 		
 	if (!m_engine.sys->files->ExpandToNativePath(
@@ -678,8 +948,6 @@ int PackageMan::BuildPakFile(const char *name, int compression) {
 	data_codec::lmp::Writer lumpWriter;
 
 	lumpWriter.Begin(file::kDPakSig, file::kDPakMagic, os);
-
-	const String kPakDir(m_cookState->targetPath + CStr("/Pak/") + name);
 	
 	int r = PakDirectory(kPakDir.c_str, "Cooked/", compression, lumpWriter);
 	if (r != SR_Success) {
@@ -699,6 +967,9 @@ int PackageMan::BuildPakFile(const char *name, int compression) {
 		m_engine.sys->files->DeleteFile(nativePath.c_str, file::kFileOption_NativePath);
 	}
 
+	++m_cookState->db->stats->paksBuilt;
+	m_cookState->db->SetPak(name, kDigest);
+
 	return SR_Success;
 }
 
@@ -722,87 +993,122 @@ int PackageMan::PakDirectory(
 	if (!s)
 		return SR_Success;
 
+	// sorted so the pak layout does not depend on the file system.
+	StringVec files;
 	String filename;
 	while (s->NextFile(filename)) {
 		if ((filename.StrStr(".svn/") != -1) || (filename.StrStr(".cvs/") != -1) || (filename.StrStr(".git/") != -1))
 			continue;
-				
-		String fpath(path + "/" + filename);
-		
-		String lumpName(CStr(prefix));
-		lumpName += filename;
+		files.push_back(filename);
+	}
 
-		*m_cookState->cout << lumpName << "... " << std::flush;
+	std::sort(files.begin(), files.end());
 
-		String nativePath;
-		m_engine.sys->files->ExpandToNativePath(fpath.c_str, nativePath, file::kFileMask_Base);
+	thread::JobScheduler *jobs = m_engine.sys->jobs.get();
+	const int kNumThreads = jobs ? jobs->numThreads.get() : 1;
+	
+	// Files are read and compressed a batch at a time across the job threads, then
+	// written in order on this thread. Batches bound how much data is held in memory.
+	const int kBatchSize = std::max(1, kNumThreads) * kPakLumpsPerThread;
 
-		FILE *fp = fopen(nativePath.c_str, "rb");
-		if (!fp) {
-			*m_cookState->cout << std::endl << "ERROR failed to load '" << nativePath << "'!" << std::endl;
-			return SR_IOError;
-		}
+	PakLumpVec lumps;
+	lumps.reserve(kBatchSize);
 
-		fseek(fp, 0, SEEK_END);
-		size_t size = ftell(fp);
-		fseek(fp, 0, SEEK_SET);
+	PakLumpJob job;
+	job.compression = compression;
 
-		if (size < 1) {
-			fclose(fp);
-			*m_cookState->cout << "(SKIPPING ZERO LENGTH FILE)!" << std::endl;
-			continue;
-		}
+	xtime::MicroTimer wallTimer;
+	wallTimer.Start();
 
-		void *data = safe_zone_malloc(ZPackages, size);
-		if (fread(data, 1, size, fp) != size) {
-			zone_free(data);
-			fclose(fp);
-			*m_cookState->cout << std::endl << "ERROR failed to read " << size << " byte(s) from '" << nativePath << "'!" << std::endl;
-			return SR_IOError;
-		}
+	S64 totalSize = 0;
+	S64 totalZipSize = 0;
+	U64 totalUsecs = 0;
+	int numLumps = 0;
+	int r = SR_Success;
 
-		fclose(fp);
+	for (size_t batch = 0; (batch < files.size()) && (r == SR_Success); batch += kBatchSize) {
+		const size_t kBatchEnd = std::min(files.size(), batch + kBatchSize);
 
-		bool compressed = false;
+		lumps.clear();
+		lumps.resize(kBatchEnd - batch);
 
-		if (compression) {
-			AddrSize zipSize = data_codec::zlib::PredictEncodeSize(size);
-			void *zipData = safe_zone_malloc(ZPackages, zipSize);
+		for (size_t i = batch; i < kBatchEnd; ++i) {
+			PakLump &lump = lumps[i-batch];
+			lump.name = CStr(prefix) + files[i];
+			m_engine.sys->files->ExpandToNativePath((path + "/" + files[i]).c_str, lump.nativePath, file::kFileMask_Base);
+		}
 
-			if (!data_codec::zlib::Encode(data, size, compression, zipData, &zipSize)) {
-				zone_free(data);
-				zone_free(zipData);
-				*m_cookState->cout << "ERROR compression failure!" << std::endl;
-				return SR_IOError;
-			}
+		job.lumps = &lumps[0];
+		if (jobs) {
+			jobs->ParallelFor((int)lumps.size(), 1, job);
+		} else {
+			job(0, (int)lumps.size());
+		}
 
-			if (zipSize < size) {
-				// compression is good
-				data_codec::lmp::Writer::Lump *l = 
-					lumpWriter.WriteLump(lumpName.c_str, zipData, zipSize, 16);
-				data_codec::lmp::LOfs *uncSize = (data_codec::lmp::LOfs*)l->AllocateTagData(sizeof(data_codec::lmp::LOfs));
-				*uncSize = (data_codec::lmp::LOfs)size;
+		for (PakLumpVec::iterator it = lumps.begin(); it != lumps.end(); ++it) {
+			PakLump &lump = *it;
 
-				float ratio = (1.0f - ((float)zipSize / (float)size)) * 100.0f;
-				char nums[16];
-				sprintf(nums, "%.1f", ratio);
-				*m_cookState->cout << "(" << nums << "%)" << std::endl;
+			if (r == SR_Success) {
+				*m_cookState->cout << lump.name << "... ";
 
-				compressed = true;
-			}
+				if (lump.error == SR_CompilerError) {
+					*m_cookState->cout << "ERROR compression failure!" << std::endl;
+					r = SR_IOError;
+				} else if (lump.error != SR_Success) {
+					*m_cookState->cout << std::endl << "ERROR failed to load '" << lump.nativePath << "'!" << std::endl;
+					r = SR_IOError;
+				} else if (lump.size < 1) {
+					*m_cookState->cout << "(SKIPPING ZERO LENGTH FILE)!" << std::endl;
+				} else {
+					char nums[64];
+
+					if (lump.zipData) {
+						data_codec::lmp::Writer::Lump *l = 
+							lumpWriter.WriteLump(lump.name.c_str, lump.zipData, lump.zipSize, 16);
+						file::PakBlockTag *tag = (file::PakBlockTag*)l->AllocateTagData(sizeof(file::PakBlockTag));
+						tag->size = (U32)lump.size;
+						tag->blockSize = (U32)file::kPakBlockSize;
+
+						float ratio = (1.0f - ((float)lump.zipSize / (float)lump.size)) * 100.0f;
+						sprintf(nums, "(%.1f%%, %.2f ms)", ratio, lump.usecs / 1000.0);
+						totalZipSize += (S64)lump.zipSize;
+					} else {
+						lumpWriter.WriteLump(lump.name.c_str, lump.data, lump.size, 16);
+						sprintf(nums, "(0%%, %.2f ms)", lump.usecs / 1000.0);
+						totalZipSize += (S64)lump.size;
+					}
 
-			zone_free(zipData);
-		}
+					*m_cookState->cout << nums << std::endl;
+
+					totalSize += (S64)lump.size;
+					totalUsecs += lump.usecs;
+					++numLumps;
+				}
+			}
 
-		if (!compressed) {
-			lumpWriter.WriteLump(lumpName.c_str, data, size, 16);
-			*m_cookState->cout << "(0%)" << std::endl;
+			FreePakLump(lump);
 		}
+	}
 
-		zone_free(data);
+	wallTimer.Stop();
+
+	if ((r == SR_Success) && (numLumps > 0)) {
+		char sz[256];
+		sprintf(
+			sz,
+			"%d file(s), %lld -> %lld byte(s) (%.1f%%), %.2f ms compressing on %d thread(s) in %.2f ms.",
+			numLumps,
+			(long long)totalSize,
+			(long long)totalZipSize,
+			(totalSize > 0) ? ((1.0 - ((double)totalZipSize / (double)totalSize)) * 100.0) : 0.0,
+			totalUsecs / 1000.0,
+			kNumThreads,
+			wallTimer.Elapsed() / 1000.0
+		);
+		*m_cookState->cout << sz << std::endl;
 	}
 
-	return SR_Success;
+	return r;
 }
 
 int PackageMan::LoadCookTxt(int flags, std::ostream &out) {
@@ -1244,6 +1550,20 @@ int PackageMan::BuildManifest(int compression) {
 	const String filepath(m_cookState->targetPath + CStr("/Base/manifest.pak"));
 	*m_cookState->cout << "------ Packaging '" << filepath << "' ------" << std::endl;
 
+	const String kPakDir(m_cookState->targetPath + CStr("/Packages/"));
+	const String kShaderDir(m_cookState->targetPath + CStr("/Shaders/"));
+
+	// a pak file named manifest would collide with manifest.pak regardless.
+	CookDatabase::Hash digest = CookDatabase::HashInt(file::kPakBlockSize, CookDatabase::HashInt(compression));
+	digest = PakDigest(kPakDir.c_str, digest);
+	digest = PakDigest(kShaderDir.c_str, digest);
+
+	if (m_cookState->db->PakUpToDate("manifest", digest) && m_engine.sys->files->FileExists(filepath.c_str)) {
+		++m_cookState->db->stats->paksUpToDate;
+		*m_cookState->cout << "Up to date." << std::endl;
+		return SR_Success;
+	}
+
 	String nativePath;
 		
 	if (!m_engine.sys->files->ExpandToNativePath(
@@ -1266,9 +1586,6 @@ int PackageMan::BuildManifest(int compression) {
 	data_codec::lmp::Writer lumpWriter;
 
 	lumpWriter.Begin(file::kDPakSig, file::kDPakMagic, os);
-
-	const String kPakDir(m_cookState->targetPath + CStr("/Packages/"));
-	const String kShaderDir(m_cookState->targetPath + CStr("/Shaders/"));
 	
 	int r = PakDirectory(kPakDir.c_str, "Packages/", compression, lumpWriter);
 	if (r != SR_Success) {
@@ -1294,9 +1611,51 @@ int PackageMan::BuildManifest(int compression) {
 		return SR_CompilerError;
 	}
 
+	++m_cookState->db->stats->paksBuilt;
+	m_cookState->db->SetPak("manifest", digest);
+
 	return SR_Success;
 }
 
+CookDatabase::Hash PackageMan::PakDigest(const char *_path, CookDatabase::Hash hash) {
+	RAD_ASSERT(_path);
+
+	String path(CStr(_path));
+
+	file::FileSearch::Ref s = m_engine.sys->files->OpenSearch(
+		(path + "/*.*").c_str,
+		file::kSearchOption_Recursive,
+		file::kFileOptions_None,
+		file::kFileMask_Base
+	);
+	
+	if (!s)
+		return hash;
+
+	// search order is up to the file system.
+	StringVec files;
+	String filename;
+	while (s->NextFile(filename)) {
+		if ((filename.StrStr(".svn/") != -1) || (filename.StrStr(".cvs/") != -1) || (filename.StrStr(".git/") != -1))
+			continue;
+		files.push_back(filename);
+	}
+
+	std::sort(files.begin(), files.end());
+
+	for (StringVec::const_iterator it = files.begin(); it != files.end(); ++it) {
+		CookDatabase::Hash fileHash;
+		hash = CookDatabase::HashString((*it).c_str, hash);
+		if (m_cookState->db->FileHash((path + "/" + *it).c_str, fileHash)) {
+			hash = CookDatabase::HashInt((S64)fileHash, hash);
+		} else {
+			hash = CookDatabase::HashInt(0, hash);
+		}
+	}
+
+	return hash;
+}
+
 void PackageMan::CancelCook() {
 	m_cancelCook = true;
 }
@@ -1413,9 +1772,12 @@ void Cooker::RAD_IMPLEMENT_SET(pakfile) (const char *value) {
 
 int Cooker::Cook(int flags) {
 	RAD_ASSERT(flags&P_AllTargets); // must specify a target
+	m_dependencies.clear();
 	int r = Compile(flags);
-	if (r == SR_Success)
+	if (r == SR_Success) {
 		SaveState();
+		m_compiled = true;
+	}
 	return r;
 }
 
@@ -1650,6 +2012,40 @@ bool Cooker::HasTag() {
 	return engine->sys->files->FileExists(spath.c_str);
 }
 
+int Cooker::AddDependency(const char *path) {
+	
+	if (!m_cooking)
+		return 0;
+
+	RAD_ASSERT(path);
+	const String kPath(CStr(path));
+	if (std::find(m_dependencies.begin(), m_dependencies.end(), kPath) == m_dependencies.end())
+		m_dependencies.push_back(kPath);
+
+	return AddImport(path);
+}
+
+void Cooker::AddSource(const String &path) {
+	if (!m_cooking)
+		return;
+	if (std::find(m_sources.begin(), m_sources.end(), path) == m_sources.end())
+		m_sources.push_back(path);
+}
+
+bool Cooker::SourceHash(const char *path, CookDatabase::Hash &hash) {
+#if defined(RAD_OPT_PC_TOOLS)
+	if (m_cooking && m_pkgMan->m_cookState && m_pkgMan->m_cookState->db)
+		return m_pkgMan->m_cookState->db->FileHash(path, hash);
+#endif
+	// intermediate cookers run outside of a cook.
+	CookDatabase db;
+	return db.FileHash(path, hash);
+}
+
+CookDatabase::Hash Cooker::KeysHash(int target) {
+	return EntryKeysHash(*asset->entry.get(), target);
+}
+
 int Cooker::AddImport(const char *path) {
 	
 	if (!m_cooking)
@@ -1675,6 +2071,7 @@ Engine *Cooker::RAD_IMPLEMENT_GET(engine) {
 void Cooker::UpdateModifiedTime(int target) {
 	target &= P_AllTargets;
 	String key(TargetPath(target)+"__cookerModifiedTime");
+	(*globals.get())[TargetPath(target)+"__cookerKeysHash"].sVal = CookDatabase::HashToString(KeysHash(target));
 	
 	Persistence::KeyValue::Map::iterator it = globals->find(key);
 	if (it == globals->end()) {
@@ -1722,17 +2119,34 @@ int Cooker::CompareVersion(int target, bool updateIfNewer) {
 int Cooker::CompareModifiedTime(int target, bool updateIfNewer) {
 	target &= P_AllTargets;
 	String key(TargetPath(target)+"__cookerModifiedTime");
+	String hashKey(TargetPath(target)+"__cookerKeysHash");
+	const String kHash(CookDatabase::HashToString(KeysHash(target)));
 
-	Persistence::KeyValue::Map::iterator it = globals->find(key);
+	// The entry time changes whenever the asset is touched in the editor,
+	// only a change to its key values can change what is cooked.
+	Persistence::KeyValue::Map::iterator it = globals->find(hashKey);
+	if (it != globals->end()) {
+		int r = (it->second.sVal == kHash) ? 0 : -1;
+		if (r < 0 && updateIfNewer) {
+			it->second.sVal = kHash;
+			(*globals.get())[key].sVal = asset->entry->modifiedTime->ToString();
+		}
+		return r;
+	}
+
+	it = globals->find(key);
 	if (it == globals->end()) {
 		(*globals.get())[key].sVal = asset->entry->modifiedTime->ToString();
+		(*globals.get())[hashKey].sVal = kHash;
 		return -1; // always older
 	}
 
+	// cooked before key hashes were recorded.
 	TimeDate td = TimeDate::FromString(it->second.sVal.c_str);
 	int r = td.Compare(*asset->entry->modifiedTime.get());
-	if ((r < 0 && updateIfNewer) || (r > 0)) {
+	if ((r < 0 && updateIfNewer) || (r >= 0)) {
 		(*globals.get())[key].sVal = asset->entry->modifiedTime->ToString();
+		(*globals.get())[hashKey].sVal = kHash;
 	}
 
 	return r;
@@ -1772,13 +2186,36 @@ int Cooker::CompareCachedFileTime(int target, const char *key, const char *path,
 		return -1; // always older
 	}
 
-	int c = m ? selfTime.Compare(fileTime) : -1;
+	AddSource(spath);
+
+	// The file time only says the file may have changed, compare contents.
+	const String skeyHash(skey+"_hash");
+	CookDatabase::Hash hash;
+	const bool kHashed = SourceHash(spath.c_str, hash);
+	const String kHash(kHashed ? CookDatabase::HashToString(hash) : String());
+
+	Persistence::KeyValue::Map::const_iterator hashIt = globals->find(skeyHash);
+	
+	int c;
+	if (m && kHashed && (hashIt != globals->end())) {
+		c = (hashIt->second.sVal == kHash) ? 0 : -1;
+	} else {
+		// cooked before source hashes were recorded.
+		c = m ? selfTime.Compare(fileTime) : -1;
+	}
+
 	if (force)
 		c = -1;
 
-	if ((c < 0 && updateIfNewer) || (c > 0)) { 
-		// this can happen from DST or someone reverted a file version.
+	if ((c < 0 && updateIfNewer) || (c >= 0)) { 
+		// c > 0 can happen from DST or someone reverted a file version,
+		// c == 0 records the time of a touched but unchanged file.
 		(*globals.get())[skey].sVal = fileTime.ToString();
+		if (kHashed) {
+			(*globals.get())[skeyHash].sVal = kHash;
+		} else {
+			globals->erase(skeyHash);
+		}
 	}
 
 	return c;
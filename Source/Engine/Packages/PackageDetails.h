@@ -23,6 +23,7 @@ struct SinkFactoryBase {
 	typedef boost::shared_ptr<SinkFactoryBase> Ref;
 	virtual SinkBase *New() = 0;
 	virtual int Stage() const = 0;
+	virtual bool Async() const = 0;
 
 	SinkBase *Cast(const AssetRef &asset);
 	AssetIdWMap assets[Z_Max];
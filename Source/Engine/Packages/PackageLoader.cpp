@@ -0,0 +1,368 @@
+/*! \file PackageLoader.cpp
+	\copyright Copyright (c) 2013 Sunside Inc., All Rights Reserved.
+	\copyright See Radiance/LICENSE for licensing terms.
+	\author Joe Riedel
+	\ingroup packages
+*/
+
+#include RADPCH
+#include "Packages.h"
+#include "../Engine.h"
+#include <iostream>
+#include <stdio.h>
+
+namespace pkg {
+
+namespace {
+
+double AverageMs(double micros, int count) {
+	return count ? (micros / (count * 1000.0)) : 0.0;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+AsyncLoad::AsyncLoad(
+	PackageMan &pm,
+	const Asset::Ref &asset,
+	int flags,
+	int priority
+) :
+m_asset(asset),
+m_pm(&pm),
+m_requestTime(xtime::ReadMicroseconds()),
+m_queueTime(0),
+m_threadTime(0),
+m_mainTime(0),
+m_flags(flags),
+m_priority(priority),
+m_mainStage(SS_Max+1),
+m_threadResult(SR_Success),
+m_result(SR_Pending),
+m_state(S_Queued),
+m_cancel(false) {
+}
+
+int AsyncLoad::Wait(const xtime::TimeSlice &time) {
+	return m_pm->CompleteAsyncLoad(*this, time);
+}
+
+void AsyncLoad::Cancel() {
+	m_pm->CancelAsyncLoad(*this);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+PackageMan::AsyncLoadThread::AsyncLoadThread(PackageMan *_pkgMan) : pkgMan(_pkgMan) {
+}
+
+int PackageMan::AsyncLoadThread::ThreadProc() {
+	for (;;) {
+		AsyncLoad *load;
+
+		{
+			boost::unique_lock<Mutex> L(pkgMan->m_asyncMutex);
+			while (!pkgMan->m_asyncQuit && pkgMan->m_asyncQueue.empty())
+				pkgMan->m_asyncCond.wait(L);
+
+			if (pkgMan->m_asyncQuit)
+				break;
+
+			AsyncLoadQueue::iterator it = pkgMan->m_asyncQueue.begin();
+			load = it->second;
+			pkgMan->m_asyncQueue.erase(it);
+			load->m_state = AsyncLoad::S_Loading;
+		}
+
+		pkgMan->RunAsyncSinks(*load);
+	}
+
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+AsyncLoad::Ref PackageMan::LoadAsync(
+	const Asset::Ref &asset,
+	int flags,
+	int priority
+) {
+	RAD_ASSERT(asset);
+	RAD_ASSERT(!(flags&(P_Unload|P_SAlloc)));
+
+	AsyncLoad::Ref load(new (ZPackages) AsyncLoad(*this, asset, flags, priority));
+
+	// Sinks are allocated here, the loader thread only runs them. The loader thread
+	// takes the async sinks up to the first one that isn't, everything from there on
+	// runs on the main thread.
+	const SinkFactoryMap &factories = TypeSinks(asset->m_entry->type);
+
+	for (SinkFactoryMap::const_iterator it = factories.begin(); it != factories.end(); ++it) {
+		const details::SinkFactoryBase::Ref &f = it->second;
+
+		SinkBase *sink = f->Cast(asset);
+		if (!sink)
+			sink = AllocSink(f, asset);
+		if (!sink)
+			continue;
+
+		if (load->m_mainStage <= SS_Max)
+			continue;
+
+		if (f->Async()) {
+			load->m_sinks.push_back(sink);
+		} else {
+			load->m_mainStage = it->first;
+		}
+	}
+
+	m_asyncLoads.push_back(load);
+
+	if (load->m_sinks.empty()) {
+		load->m_state = AsyncLoad::S_Main;
+		return load;
+	}
+
+	if (!m_asyncThread) {
+		m_asyncThread.reset(new (ZPackages) AsyncLoadThread(this));
+		m_asyncThread->Run();
+	}
+
+	{
+		Lock L(m_asyncMutex);
+		m_asyncQueue.insert(AsyncLoadQueue::value_type(priority, load.get()));
+	}
+
+	m_asyncCond.notify_all();
+	return load;
+}
+
+void PackageMan::TickAsyncLoads(const xtime::TimeSlice &time) {
+	for (AsyncLoadList::iterator it = m_asyncLoads.begin(); it != m_asyncLoads.end();) {
+		AsyncLoad &load = **it;
+
+		int r = load.m_result;
+		if ((r == SR_Pending) && time.remaining)
+			r = CompleteAsyncLoad(load, time);
+
+		if (r != SR_Pending) {
+			it = m_asyncLoads.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void PackageMan::RunAsyncSinks(AsyncLoad &load) {
+	load.m_queueTime = xtime::ReadMicroseconds() - load.m_requestTime;
+
+	xtime::MicroTimer timer;
+	timer.Start();
+
+	int r = SR_Success;
+
+	for (AsyncLoad::SinkVec::const_iterator it = load.m_sinks.begin(); it != load.m_sinks.end(); ++it) {
+		if (load.m_cancel) {
+			r = SR_Cancelled;
+			break;
+		}
+
+		do {
+			r = (*it)->_Process(
+				xtime::TimeSlice::Infinite,
+				m_engine,
+				load.m_asset,
+				load.m_flags
+			);
+		} while (r == SR_Pending);
+
+		if (r != SR_Success)
+			break;
+	}
+
+	timer.Stop();
+
+	{
+		Lock L(m_asyncMutex);
+		load.m_threadTime = timer.Elapsed();
+		load.m_threadResult = r;
+		load.m_state = AsyncLoad::S_Main;
+	}
+
+	m_asyncCond.notify_all();
+}
+
+int PackageMan::CompleteAsyncLoad(AsyncLoad &load, const xtime::TimeSlice &time) {
+	bool runHere = false;
+
+	{
+		boost::unique_lock<Mutex> L(m_asyncMutex);
+
+		if (load.m_state == AsyncLoad::S_Done)
+			return load.m_result;
+
+		if (time.infinite) {
+			if (load.m_state == AsyncLoad::S_Queued) {
+				// don't wait behind the rest of the queue.
+				DequeueAsyncLoad(load);
+				load.m_state = AsyncLoad::S_Loading;
+				runHere = true;
+			} else {
+				while (load.m_state == AsyncLoad::S_Loading)
+					m_asyncCond.wait(L);
+			}
+		}
+
+		if (!runHere && (load.m_state != AsyncLoad::S_Main))
+			return SR_Pending;
+	}
+
+	if (runHere)
+		RunAsyncSinks(load);
+
+	int r = load.m_threadResult;
+
+	// cancelled after the loader thread ran its last sink.
+	if ((r == SR_Success) && load.m_cancel)
+		r = SR_Cancelled;
+
+	if (r == SR_Success) {
+		xtime::MicroTimer timer;
+		timer.Start();
+
+		r = Process(
+			time,
+			load.m_asset,
+			load.m_flags,
+			SS_Max,
+			load.m_mainStage
+		);
+
+		timer.Stop();
+		load.m_mainTime += timer.Elapsed();
+
+		if (r == SR_Pending)
+			return r;
+	}
+
+	FinishAsyncLoad(load, r);
+	return r;
+}
+
+void PackageMan::CancelAsyncLoad(AsyncLoad &load) {
+	{
+		Lock L(m_asyncMutex);
+
+		if (load.m_state == AsyncLoad::S_Done)
+			return;
+
+		load.m_cancel = true;
+
+		// the loader thread checks m_cancel before each sink, Wait() or TickAsyncLoads() finish it.
+		if (load.m_state == AsyncLoad::S_Loading)
+			return;
+
+		if (load.m_state == AsyncLoad::S_Queued)
+			DequeueAsyncLoad(load);
+	}
+
+	FinishAsyncLoad(load, SR_Cancelled);
+}
+
+void PackageMan::FinishAsyncLoad(AsyncLoad &load, int result) {
+	{
+		Lock L(m_asyncMutex);
+		load.m_result = result;
+		load.m_state = AsyncLoad::S_Done;
+	}
+
+	if (result == SR_Cancelled)
+		return;
+
+	AsyncLoadStats &stats = m_asyncStats[load.m_asset->type.get()];
+	++stats.numLoads;
+	if (result < SR_Success)
+		++stats.numErrors;
+	stats.queueTime += load.m_queueTime;
+	stats.threadTime += load.m_threadTime;
+	stats.mainTime += load.m_mainTime;
+	stats.totalTime += xtime::ReadMicroseconds() - load.m_requestTime;
+}
+
+void PackageMan::DequeueAsyncLoad(AsyncLoad &load) {
+	std::pair<AsyncLoadQueue::iterator, AsyncLoadQueue::iterator> range = m_asyncQueue.equal_range(load.m_priority);
+	for (AsyncLoadQueue::iterator it = range.first; it != range.second; ++it) {
+		if (it->second == &load) {
+			m_asyncQueue.erase(it);
+			break;
+		}
+	}
+}
+
+void PackageMan::StopAsyncLoads() {
+	if (!m_asyncThread)
+		return;
+
+	{
+		Lock L(m_asyncMutex);
+		m_asyncQuit = true;
+	}
+
+	m_asyncCond.notify_all();
+	m_asyncThread->Join();
+	m_asyncThread.reset();
+
+	AsyncLoadQueue queue;
+
+	{
+		Lock L(m_asyncMutex);
+		queue.swap(m_asyncQueue);
+		m_asyncQuit = false;
+	}
+
+	for (AsyncLoadQueue::const_iterator it = queue.begin(); it != queue.end(); ++it) {
+		it->second->m_cancel = true;
+		FinishAsyncLoad(*it->second, SR_Cancelled);
+	}
+}
+
+void PackageMan::LogAsyncLoadStats(std::ostream &out) const {
+	char sz[256];
+
+	out << "------ Background Loads (avg ms) ------" << std::endl;
+
+	for (int i = 0; i < asset::AT_Max; ++i) {
+		const AsyncLoadStats &stats = m_asyncStats[i];
+		if (stats.numLoads < 1)
+			continue;
+
+#if defined(RAD_OPT_TOOLS)
+		const char *typeName = asset::TypeString((asset::Type)i);
+#else
+		char typeName[16]; // type names are a tools feature.
+		sprintf(typeName, "Type %d", i);
+#endif
+
+		sprintf(
+			sz,
+			"%-16s %5d load(s), %d error(s), queued %.2f, thread %.2f, main %.2f, total %.2f",
+			typeName,
+			stats.numLoads,
+			stats.numErrors,
+			AverageMs(stats.queueTime, stats.numLoads),
+			AverageMs(stats.threadTime, stats.numLoads),
+			AverageMs(stats.mainTime, stats.numLoads),
+			AverageMs(stats.totalTime, stats.numLoads)
+		);
+
+		out << sz << std::endl;
+	}
+}
+
+void PackageMan::ClearAsyncLoadStats() {
+	for (int i = 0; i < asset::AT_Max; ++i)
+		m_asyncStats[i].Clear();
+}
+
+} // pkg
@@ -298,7 +298,8 @@ PackageMan::Ref PackageMan::New(Engine &engine, const char *pkgDir) {
 PackageMan::PackageMan(Engine &engine, const char *pkgDir) :
 m_engine(engine),
 m_pkgDir(pkgDir),
-m_nextId(0)
+m_nextId(0),
+m_asyncQuit(false)
 #if defined(RAD_OPT_PC_TOOLS)
 , m_ui(0),
 m_resavePackages(false)
@@ -307,6 +308,7 @@ m_resavePackages(false)
 }
 
 PackageMan::~PackageMan() {
+	StopAsyncLoads();
 }
 
 bool PackageMan::Initialize() {
@@ -411,7 +413,8 @@ int PackageMan::Process(
 	const xtime::TimeSlice &time,
 	const Asset::Ref &asset,
 	int flags,
-	int maxStage
+	int maxStage,
+	int minStage
 ) {
 	RAD_ASSERT(!(flags&P_Unload));
 
@@ -420,7 +423,7 @@ int PackageMan::Process(
 
 	for (SinkFactoryMap::const_iterator it = factories.begin(); it != factories.end(); ++it) {
 		const details::SinkFactoryBase::Ref &f = it->second;
-		if (it->first > maxStage)
+		if (it->first > maxStage || it->first < minStage)
 			continue;
 
 		SinkBase *sink = f->Cast(asset);
@@ -40,6 +40,9 @@
 #include <Runtime/DataCodec/LmpReader.h>
 #include <Runtime/ReflectDef.h>
 #include <Runtime/Base/ObjectPool.h>
+#include <Runtime/Thread/Thread.h>
+#include <boost/thread/condition_variable.hpp>
+#include <iosfwd>
 
 #if defined(RAD_OPT_PC_TOOLS)
 	#include "../Renderer/Renderer.h"
@@ -48,7 +51,6 @@
 	#include <Runtime/Event.h>
 	#include <Runtime/Time.h>
 	#include <Runtime/DataCodec/LmpDef.h>
-	#include <Runtime/Thread/Thread.h>
 	#include <stdio.h>
 namespace tools {
 namespace editor {
@@ -58,6 +60,7 @@ namespace editor {
 #endif
 
 #if defined(RAD_OPT_TOOLS)
+	#include "CookDatabase.h"
 	#include <iostream>
 #endif
 
@@ -284,6 +287,14 @@ private:
 template <typename T>
 class Sink : public SinkBase {
 public:
+
+	// Sinks that only read files and do CPU work (no rendering or sound objects, no
+	// processing of other assets) declare SinkAsync = 1 alongside SinkStage so
+	// PackageMan::LoadAsync() can run them on the package loader thread.
+	enum {
+		SinkAsync = 0
+	};
+
 	static T *Cast(const AssetRef &asset);
 
 	void *operator new(size_t size);
@@ -336,7 +347,7 @@ public:
 	typedef CookerRef Ref;
 	typedef zone_vector<Ref, ZPackagesT>::type Vec;
 
-	Cooker(int version) : m_version(version), m_languages(0) {}
+	Cooker(int version) : m_compiled(false), m_languages(0), m_version(version) {}
 	virtual ~Cooker() {}
 
 	virtual CookStatus Status(int flags) = 0;
@@ -365,9 +376,14 @@ protected:
 	BinFile::Ref OpenWrite(const char *path);
 	BinFile::Ref OpenTagWrite();
 	int AddImport(const char *path);
+	//! Imports an asset whose data is used to build this asset.
+	/*! The asset is rebuilt when the dependency's key values or source files change. */
+	int AddDependency(const char *path);
 	void UpdateModifiedTime(int target);
 
 	// Compares: -1 == source is newer, 1 == cook is newer, 0 == same
+	// Key values (CompareModifiedTime) and source files (CompareCachedFileTime) are
+	// compared by content hash, touching them without changing them is not a change.
 
 	int CompareVersion(int target, bool updateIfNewer=true);
 	int CompareModifiedTime(int target, bool updateIfNewer=true);
@@ -454,9 +470,15 @@ private:
 	void SaveImports();
 	void SaveGlobals();
 
+	CookDatabase::Hash KeysHash(int target);
+	bool SourceHash(const char *path, CookDatabase::Hash &hash);
+	void AddSource(const String &path);
+
 	std::ostream *m_cout;
 	AssetRef m_asset;
 	ImportVec m_imports;
+	StringVec m_sources;
+	StringVec m_dependencies;
 	PackageMan *m_pkgMan;
 	PackageRef m_pkg;
 	String m_assetPath;
@@ -470,6 +492,7 @@ private:
 	String m_pakfile;
 	String m_originalPakfile;
 	bool m_cooking;
+	bool m_compiled;
 	int m_languages;
 	int m_version;
 };
@@ -883,6 +906,87 @@ private:
 
 ///////////////////////////////////////////////////////////////////////////////
 
+//! A load started by PackageMan::LoadAsync().
+/*! The leading sinks of the asset that declare SinkAsync are run on the package
+	loader thread, the remaining sinks are run on the main thread by Wait() or
+	PackageMan::TickAsyncLoads() after they complete. */
+class RADENG_CLASS AsyncLoad : public boost::noncopyable {
+public:
+	typedef AsyncLoadRef Ref;
+
+	RAD_DECLARE_READONLY_PROPERTY(AsyncLoad, asset, const Asset::Ref&);
+	RAD_DECLARE_READONLY_PROPERTY(AsyncLoad, flags, int);
+	RAD_DECLARE_READONLY_PROPERTY(AsyncLoad, priority, int);
+	//! pkg::SR_Pending until the load has completed.
+	RAD_DECLARE_READONLY_PROPERTY(AsyncLoad, result, int);
+
+	//! Runs the main thread sinks of the load for up to the specified time.
+	/*! Returns the result of the load, or pkg::SR_Pending if it has not completed.
+		With an infinite time slice this blocks until the loader thread is done with
+		the asset, or runs its loader thread sinks here if they have not been started.
+		Must be called from the main thread. */
+	int Wait(const xtime::TimeSlice &time = xtime::TimeSlice::Infinite);
+
+	//! Cancels the load, it completes with pkg::SR_Cancelled.
+	/*! A queued load, or one waiting on its main thread sinks, completes immediately. A load
+		on the loader thread stops after the sink that is running and completes from Wait() or
+		PackageMan::TickAsyncLoads(). Must be called from the main thread. */
+	void Cancel();
+
+private:
+
+	friend class PackageMan;
+
+	typedef zone_vector<SinkBase*, ZPackagesT>::type SinkVec;
+
+	enum State {
+		S_Queued,
+		S_Loading,
+		S_Main,
+		S_Done
+	};
+
+	AsyncLoad(
+		PackageMan &pm,
+		const Asset::Ref &asset,
+		int flags,
+		int priority
+	);
+
+	RAD_DECLARE_GET(asset, const Asset::Ref&) { 
+		return m_asset; 
+	}
+
+	RAD_DECLARE_GET(flags, int) { 
+		return m_flags; 
+	}
+
+	RAD_DECLARE_GET(priority, int) { 
+		return m_priority; 
+	}
+
+	RAD_DECLARE_GET(result, int) { 
+		return m_result; 
+	}
+
+	SinkVec m_sinks; // run on the loader thread, in stage order.
+	Asset::Ref m_asset;
+	PackageMan *m_pm;
+	xtime::TimeVal m_requestTime;
+	xtime::TimeVal m_queueTime;
+	xtime::TimeVal m_threadTime;
+	xtime::TimeVal m_mainTime;
+	int m_flags;
+	int m_priority;
+	int m_mainStage; // first stage run on the main thread.
+	int m_threadResult;
+	int m_result;
+	int m_state;
+	volatile bool m_cancel;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
 class RADENG_CLASS PackageMan :
 	public boost::enable_shared_from_this<PackageMan>,
 	public boost::noncopyable {
@@ -954,6 +1058,27 @@ public:
 		int flags = 0
 	);
 
+	//! Starts loading an asset on the package loader thread.
+	/*! Requests with a higher priority are started first, requests of the same priority
+		in the order they were made. Must be called from the main thread. */
+	AsyncLoad::Ref LoadAsync(
+		const Asset::Ref &asset,
+		int flags = P_Load,
+		int priority = 0
+	);
+
+	//! Runs the main thread sinks of background loads for up to the specified time.
+	void TickAsyncLoads(const xtime::TimeSlice &time);
+
+	//! Prints the load times of completed background loads by asset type.
+	void LogAsyncLoadStats(std::ostream &out) const;
+	void ClearAsyncLoadStats();
+
+	//! Stops the package loader thread.
+	/*! Waits for the loader thread to finish the load it is running, queued loads are cancelled.
+		The next LoadAsync() starts the thread again. Must be called from the main thread. */
+	void StopAsyncLoads();
+
 	int ProcessAll(
 		Zone z,
 		const xtime::TimeSlice &time,
@@ -974,12 +1099,17 @@ private:
 	struct SinkFactory : public details::SinkFactoryBase {
 		virtual SinkBase *New();
 		virtual int Stage() const;
+		virtual bool Async() const;
 	};
 
 	friend class Binding;
 	friend class Asset;
+	friend class AsyncLoad;
 	friend class Package;
 
+	typedef boost::mutex Mutex;
+	typedef boost::lock_guard<Mutex> Lock;
+
 	typedef zone_map<int, details::SinkFactoryBase::Ref, ZPackagesT>::type SinkFactoryMap; // for order
 	typedef zone_map<asset::Type, SinkFactoryMap, ZPackagesT>::type TypeSinkFactoryMap;
 
@@ -992,9 +1122,53 @@ private:
 		const xtime::TimeSlice &time,
 		const Asset::Ref &asset,
 		int flags,
-		int maxStage
+		int maxStage,
+		int minStage = 0
 	);
 
+	struct AsyncLoadThread : public thread::Thread {
+		typedef boost::shared_ptr<AsyncLoadThread> Ref;
+
+		AsyncLoadThread(PackageMan *pkgMan);
+
+		virtual int ThreadProc();
+
+		PackageMan *pkgMan;
+	};
+
+	struct AsyncLoadStats {
+		AsyncLoadStats() {
+			Clear();
+		}
+
+		void Clear() {
+			numLoads = 0;
+			numErrors = 0;
+			queueTime = 0;
+			threadTime = 0;
+			mainTime = 0;
+			totalTime = 0;
+		}
+
+		int numLoads;
+		int numErrors;
+		// microseconds
+		double queueTime; // waiting for the loader thread.
+		double threadTime; // in loader thread sinks.
+		double mainTime; // in main thread sinks.
+		double totalTime; // from LoadAsync() to completion.
+	};
+
+	typedef zone_multimap<int, AsyncLoad*, ZPackagesT, std::greater<int> >::type AsyncLoadQueue;
+	typedef zone_list<AsyncLoad::Ref, ZPackagesT>::type AsyncLoadList;
+
+	void RunAsyncSinks(AsyncLoad &load);
+	int CompleteAsyncLoad(AsyncLoad &load, const xtime::TimeSlice &time);
+	void CancelAsyncLoad(AsyncLoad &load);
+	void FinishAsyncLoad(AsyncLoad &load, int result);
+	//! Removes a queued load from m_asyncQueue, m_asyncMutex must be held.
+	void DequeueAsyncLoad(AsyncLoad &load);
+
 	void Unbind(Binding *binding);
 	SinkFactoryMap &TypeSinks(asset::Type type);
 	SinkBase *AllocSink(const details::SinkFactoryBase::Ref &f, const Asset::Ref &asset);
@@ -1065,9 +1239,6 @@ private:
 #endif
 
 #if defined(RAD_OPT_PC_TOOLS)
-	typedef boost::mutex Mutex;
-	typedef boost::lock_guard<Mutex> Lock;
-
 	tools::UIProgress *m_ui;
 	// Delete, Rename, UpdateImports are not thread safe.
     void Delete(const Package::Ref &pkg);
@@ -1120,6 +1291,7 @@ private:
 		CookerMap cookers;
 		CookPakFile::Map pakfiles;
 		CookPakFile::IdMap assetPakFiles;
+		CookDatabase::Ref db;
 		std::set<int> cooked;
 		std::ostream *cout;
 		int flags;
@@ -1155,6 +1327,10 @@ private:
 		std::ostream &out
 	);
 
+	bool CookDependenciesChanged(const Cooker::Ref &cooker);
+	void UpdateCookDatabase();
+	CookDatabase::Hash PakDigest(const char *path, CookDatabase::Hash hash);
+
 	void CreateCookThreads(tools::editor::GLWidget &glContext, std::ostream &out);
 	void ResetCooker(const Cooker::Ref &cooker);
 
@@ -1197,6 +1373,14 @@ private:
 	String m_pkgDir;
 	Engine &m_engine;
 
+	AsyncLoadQueue m_asyncQueue;
+	AsyncLoadList m_asyncLoads;
+	AsyncLoadStats m_asyncStats[asset::AT_Max];
+	AsyncLoadThread::Ref m_asyncThread;
+	boost::condition_variable m_asyncCond;
+	Mutex m_asyncMutex;
+	bool m_asyncQuit;
+
 #if defined(RAD_OPT_TOOLS)
 	StringSet m_packageDir;
 #endif
@@ -432,6 +432,11 @@ inline int PackageMan::SinkFactory<T>::Stage() const {
 	return T::SinkStage;
 }
 
+template <typename T>
+inline bool PackageMan::SinkFactory<T>::Async() const {
+	return T::SinkAsync != 0;
+}
+
 template <typename T>
 Binding::Ref PackageMan::Bind() {
 	SinkFactoryMap &map = TypeSinks((asset::Type)T::AssetType);
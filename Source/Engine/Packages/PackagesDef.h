@@ -80,7 +80,8 @@ enum SinkResult
 	SR_CorruptFile = -7, /*!< Corrupt file data or unrecognized file type. */
 	SR_IOError = -8, /*!< Generic error related to file system or IO. */
 	SR_CompilerError = -9, /*!< Error occurred during compilation. */
-	SR_ScriptError = -10 /*!< Syntax or logic error during script processing. */
+	SR_ScriptError = -10, /*!< Syntax or logic error during script processing. */
+	SR_Cancelled = -11 /*!< The request was cancelled, see pkg::AsyncLoad::Cancel(). */
 };
 
 //! Defines the relative order of stages of sink processing.
@@ -247,6 +248,7 @@ enum KFlags
 class Package;
 class PackageMan;
 class Asset;
+class AsyncLoad;
 class Binding;
 class SinkBase;
 
@@ -274,6 +276,7 @@ typedef zone_map<string::String, AssetWRef, ZPackagesT>::type AssetWMap;
 typedef zone_map<int, AssetRef, ZPackagesT>::type AssetIdMap;
 typedef zone_map<int, AssetWRef, ZPackagesT>::type AssetIdWMap;
 typedef zone_vector<AssetRef, ZPackagesT>::type AssetVec;
+typedef boost::shared_ptr<AsyncLoad> AsyncLoadRef;
 typedef zone_map<string::String, int, ZPackagesT>::type StringIdMap;
 typedef zone_set<string::String, ZPackagesT>::type StringSet;
 typedef boost::shared_ptr<SinkBase> SinkBaseRef;
@@ -48,6 +48,7 @@ public:
 	void Bind(MaterialGeometrySource source, int index);
 	void BindIndices(bool force=false);
 	void Draw(int firstTri, int numTris);
+	int NumTris() const;
 
 	void ResetStreamState();
 	void Release();
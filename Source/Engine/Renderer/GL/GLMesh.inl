@@ -45,6 +45,10 @@ inline void GLMesh::BindIndices(bool force) {
 	gls.BindBuffer(GL_ELEMENT_ARRAY_BUFFER_ARB, m_i.vb, force);
 }
 
+inline int GLMesh::NumTris() const {
+	return m_i.vb ? (m_i.count / 3) : 0;
+}
+
 inline void GLMesh::ResetStreamState() {
 	gls.DisableAllMGSources();
 }
@@ -821,6 +821,38 @@ void GLWorldDraw::BindLitMaterialStates(r::Material &mat, bool lightStencil) {
 	mat.BindStates(flags, bm);
 }
 
+void GLWorldDraw::BindMaterialStates(r::Material &mat) {
+	mat.BindStates();
+}
+
+void GLWorldDraw::BindMaterialTextures(r::Material &mat, asset::MaterialLoader *loader) {
+	mat.BindTextures(loader);
+}
+
+void GLWorldDraw::BeginMaterialPass(r::Material &mat, r::Shader::Pass pass) {
+	mat.shader->Begin(pass, mat);
+}
+
+void GLWorldDraw::EndMaterialPass(r::Material &mat) {
+	mat.shader->End();
+}
+
+void GLWorldDraw::BindMaterialUniforms(
+	r::Material &mat,
+	const r::Shader::Uniforms &uniforms
+) {
+	mat.shader->BindStates(uniforms);
+}
+
+void GLWorldDraw::DrawBatch(
+	MBatchDraw &draw,
+	r::Material &mat,
+	const r::Shader::Uniforms &uniforms,
+	bool sampleMaterialColor
+) {
+	SubmitBatch(draw, *mat.shader.get(), uniforms, sampleMaterialColor);
+}
+
 void GLWorldDraw::SetWorldStates() {
 }
 
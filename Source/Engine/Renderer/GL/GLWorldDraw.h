@@ -73,6 +73,23 @@ public:
 		bool lightStencil
 	);
 
+	virtual void BindMaterialStates(r::Material &mat);
+	virtual void BindMaterialTextures(r::Material &mat, asset::MaterialLoader *loader);
+	virtual void BeginMaterialPass(r::Material &mat, r::Shader::Pass pass);
+	virtual void EndMaterialPass(r::Material &mat);
+
+	virtual void BindMaterialUniforms(
+		r::Material &mat,
+		const r::Shader::Uniforms &uniforms
+	);
+
+	virtual void DrawBatch(
+		MBatchDraw &draw,
+		r::Material &mat,
+		const r::Shader::Uniforms &uniforms,
+		bool sampleMaterialColor
+	);
+
 	virtual void BeginFog();
 	virtual void BeginFogDepthWrite(r::Material &fog, bool front);
 	virtual void BeginFogDraw(r::Material &fog);
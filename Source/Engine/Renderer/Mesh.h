@@ -113,6 +113,7 @@ public:
 	void FlushArrayStates(Shader *shader);
 
 	void Draw(int firstTri = 0, int numTris = -1); // -1 == all tris
+	int NumTris() const; // tris drawn by Draw() with default arguments
 	void Release();
 
 	void Reserve(int numStreams);
@@ -75,6 +75,10 @@ inline void Mesh::Draw(int firstTri, int numTris) {
 	m_imp.Draw(firstTri, numTris);
 }
 
+inline int Mesh::NumTris() const {
+	return m_imp.NumTris();
+}
+
 inline void Mesh::Release() {
 	m_imp.Release();
 }
@@ -7,28 +7,164 @@
 
 #include RADPCH
 #include "Particles.h"
+#include <Runtime/Base/SIMD.h>
+
+#if defined(RAD_OPT_SSE2)
+#include <emmintrin.h>
+#elif defined(RAD_OPT_NEON)
+#include <arm_neon.h>
+#endif
 
 namespace r {
 
+namespace {
+
+// Particles are simulated kWidth at a time, the SoA streams are padded to a
+// multiple of 4 so the tail lanes can be processed without a remainder loop.
+
+#if defined(RAD_OPT_SSE2)
+
+typedef __m128 Float4;
+enum { kWidth = 4 };
+
+inline Float4 Load(const float *p) { return _mm_load_ps(p); }
+inline void Store(float *p, Float4 x) { _mm_store_ps(p, x); }
+inline Float4 Splat(float x) { return _mm_set1_ps(x); }
+inline Float4 Add(Float4 a, Float4 b) { return _mm_add_ps(a, b); }
+inline Float4 Sub(Float4 a, Float4 b) { return _mm_sub_ps(a, b); }
+inline Float4 Mul(Float4 a, Float4 b) { return _mm_mul_ps(a, b); }
+inline Float4 Min(Float4 a, Float4 b) { return _mm_min_ps(a, b); }
+inline Float4 Max(Float4 a, Float4 b) { return _mm_max_ps(a, b); }
+
+inline Float4 Abs(Float4 x) {
+	return _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+}
+
+inline Float4 RSqrt(Float4 x) {
+	return _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(x));
+}
+
+//! x - floor(x)
+inline Float4 Frac(Float4 x) {
+	Float4 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+	t = _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.f)));
+	return _mm_sub_ps(x, t);
+}
+
+//! Keeps an angle in [-2PI, 2PI]
+inline Float4 WrapAngle(Float4 x) {
+	const Float4 k2Pi = _mm_set1_ps(math::Constants<float>::_2_PI());
+	const Float4 kNeg2Pi = _mm_set1_ps(-math::Constants<float>::_2_PI());
+	x = _mm_sub_ps(x, _mm_and_ps(_mm_cmpgt_ps(x, k2Pi), k2Pi));
+	return _mm_add_ps(x, _mm_and_ps(_mm_cmplt_ps(x, kNeg2Pi), k2Pi));
+}
+
+#elif defined(RAD_OPT_NEON)
+
+typedef float32x4_t Float4;
+enum { kWidth = 4 };
+
+inline Float4 Load(const float *p) { return vld1q_f32(p); }
+inline void Store(float *p, Float4 x) { vst1q_f32(p, x); }
+inline Float4 Splat(float x) { return vdupq_n_f32(x); }
+inline Float4 Add(Float4 a, Float4 b) { return vaddq_f32(a, b); }
+inline Float4 Sub(Float4 a, Float4 b) { return vsubq_f32(a, b); }
+inline Float4 Mul(Float4 a, Float4 b) { return vmulq_f32(a, b); }
+inline Float4 Min(Float4 a, Float4 b) { return vminq_f32(a, b); }
+inline Float4 Max(Float4 a, Float4 b) { return vmaxq_f32(a, b); }
+inline Float4 Abs(Float4 x) { return vabsq_f32(x); }
+
+inline Float4 RSqrt(Float4 x) {
+	Float4 e = vrsqrteq_f32(x);
+	e = vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(x, e), e));
+	return vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(x, e), e));
+}
+
+inline Float4 Frac(Float4 x) {
+	Float4 t = vcvtq_f32_s32(vcvtq_s32_f32(x));
+	t = vbslq_f32(vcgtq_f32(t, x), vsubq_f32(t, vdupq_n_f32(1.f)), t);
+	return vsubq_f32(x, t);
+}
+
+inline Float4 WrapAngle(Float4 x) {
+	const Float4 k2Pi = vdupq_n_f32(math::Constants<float>::_2_PI());
+	const Float4 kNeg2Pi = vdupq_n_f32(-math::Constants<float>::_2_PI());
+	x = vbslq_f32(vcgtq_f32(x, k2Pi), vsubq_f32(x, k2Pi), x);
+	return vbslq_f32(vcltq_f32(x, kNeg2Pi), vaddq_f32(x, k2Pi), x);
+}
+
+#else
+
+typedef float Float4;
+enum { kWidth = 1 };
+
+inline Float4 Load(const float *p) { return *p; }
+inline void Store(float *p, Float4 x) { *p = x; }
+inline Float4 Splat(float x) { return x; }
+inline Float4 Add(Float4 a, Float4 b) { return a + b; }
+inline Float4 Sub(Float4 a, Float4 b) { return a - b; }
+inline Float4 Mul(Float4 a, Float4 b) { return a * b; }
+inline Float4 Min(Float4 a, Float4 b) { return (a < b) ? a : b; }
+inline Float4 Max(Float4 a, Float4 b) { return (a > b) ? a : b; }
+inline Float4 Abs(Float4 x) { return math::Abs(x); }
+inline Float4 RSqrt(Float4 x) { return 1.f / math::SquareRoot(x); }
+inline Float4 Frac(Float4 x) { return x - math::Floor(x); }
+
+inline Float4 WrapAngle(Float4 x) {
+	if (x > math::Constants<float>::_2_PI()) {
+		x -= math::Constants<float>::_2_PI();
+	} else if (x < -math::Constants<float>::_2_PI()) {
+		x += math::Constants<float>::_2_PI();
+	}
+	return x;
+}
+
+#endif
+
+//! Returns sin(-PI + t*2PI) for t in [0, 1).
+/*! Parabolic approximation, accurate to ~0.001 which is finer than the
+	FastSin() table it replaces. */
+inline Float4 Wave(Float4 t) {
+	const Float4 x = Add(
+		Splat(-math::Constants<float>::PI()), 
+		Mul(t, Splat(math::Constants<float>::_2_PI()))
+	);
+	const float kB = 4.f / math::Constants<float>::PI();
+	const float kC = -4.f / (math::Constants<float>::PI()*math::Constants<float>::PI());
+	Float4 y = Add(Mul(Splat(kB), x), Mul(Splat(kC), Mul(x, Abs(x))));
+	return Add(Mul(Splat(0.225f), Sub(Mul(y, Abs(y)), y)), y);
+}
+
+//! Velocity limit for particles that don't have one.
+const float kNoMaxVel = 1e30f;
+
+} // namespace
+
 ParticleEmitter::ParticleEmitter() : 
+m_streams(0),
+m_streamSize(0),
 m_numParticles(0), 
 m_skinFrame(-1), 
 m_tickFrame(-1), 
-m_allocBatch(-1),
 m_particlesToEmit(0.f),
+m_rand(0),
 m_pos(Vec3::Zero) {
 	RAD_DEBUG_ONLY(m_init = false);
-	m_particles[0] = m_particles[1] = 0;
 }
 
 ParticleEmitter::ParticleEmitter(
 	const ParticleEmitterStyle &emitterStyle,
 	const ParticleStyle &particleStyle
-) {
+) : m_streams(0), m_streamSize(0) {
 	RAD_DEBUG_ONLY(m_init = false);
 	Init(emitterStyle, particleStyle);
 }
 
+ParticleEmitter::~ParticleEmitter() {
+	if (m_streams)
+		zone_free(m_streams);
+}
+
 void ParticleEmitter::Init(
 	const ParticleEmitterStyle &emitterStyle,
 	const ParticleStyle &particleStyle
@@ -39,10 +175,10 @@ void ParticleEmitter::Init(
 	m_dir = Vec3(0.f, 0.f, 1.f);
 	m_skinFrame = -1;
 	m_tickFrame = -1;
-	m_allocBatch = -1;
 	m_numParticles = 0;
-	m_particles[0] = m_particles[1] = 0;
-	m_allocBatch = 0;
+	m_particlesToEmit = 0.f;
+	// emitters are ticked on job threads, each one walks its own random sequence.
+	m_rand = FloatToInt(math::FastFloatRand()*65535.f);
 	
 	m_dir.FrameVecs(m_up, m_left);
 
@@ -68,10 +204,13 @@ void ParticleEmitter::UpdateStyle(const ParticleEmitterStyle &emitterStyle) {
 		Reset();
 		m_batches.clear();
 
+		AllocateStreams(emitterStyle.maxParticles);
+
 		int numParticlesToAllocate = emitterStyle.maxParticles;
 		while (numParticlesToAllocate) {
 			int maxSprites = math::Min<int>(numParticlesToAllocate, SpriteBatch::kMaxSprites);
-			SpriteBatch::Ref batch(new (ZRender) SpriteBatch(sizeof(Particle), maxSprites, maxSprites));
+			// particles are skinned directly from our streams, the batches don't store them.
+			SpriteBatch::Ref batch(new (ZRender) SpriteBatch(0, maxSprites, maxSprites));
 			m_batches.push_back(batch);
 			numParticlesToAllocate -= maxSprites;
 		}
@@ -121,13 +260,10 @@ void ParticleEmitter::Tick(float dt) {
 		}
 	}
 
-	for (Particle *p = m_particles[0]; p;) {
-		Particle *n = p->next;
-		if (!p->Move(dt, m_particleStyle)) {
-			FreeParticle(p);
-		}
-		p = n;
-	}
+	if (UpdateStates(dt) > 0)
+		Move(dt);
+
+	UpdateBatches();
 }
 
 void ParticleEmitter::Skin() {
@@ -135,8 +271,47 @@ void ParticleEmitter::Skin() {
 		return;
 	m_skinFrame = m_tickFrame;
 
+	const float *posX = Stream(kStream_PosX);
+	const float *posY = Stream(kStream_PosY);
+	const float *posZ = Stream(kStream_PosZ);
+	const float *alpha = Stream(kStream_Alpha);
+	const float *sizeX = Stream(kStream_SizeX);
+	const float *sizeY = Stream(kStream_SizeY);
+	const float *rot = Stream(kStream_Rotate);
+
+	const float r = m_particleStyle.rgba[0];
+	const float g = m_particleStyle.rgba[1];
+	const float b = m_particleStyle.rgba[2];
+
+	int first = 0;
+
 	for (BatchVec::const_iterator it = m_batches.begin(); it != m_batches.end(); ++it) {
-		(*it)->Skin();
+		SpriteBatch &batch = *(*it);
+		const int kLast = first + batch.numSprites;
+		if (first == kLast)
+			break;
+
+		SpriteVertex *v = batch.MapVertices();
+
+		for (int i = first; i < kLast; ++i) {
+			for (int k = 0; k < 4; ++k, ++v) {
+				v->pos[0] = posX[i];
+				v->pos[1] = posY[i];
+				v->pos[2] = posZ[i];
+				v->rgba[0] = r;
+				v->rgba[1] = g;
+				v->rgba[2] = b;
+				v->rgba[3] = alpha[i];
+				v->skin[0] = sizeX[i];
+				v->skin[1] = sizeY[i];
+				v->skin[2] = rot[i];
+				v->skin[3] = (float)k;
+				v->padd0 = 0.f;
+			}
+		}
+
+		batch.UnmapVertices();
+		first = kLast;
 	}
 }
 
@@ -145,309 +320,312 @@ void ParticleEmitter::Spawn(int numParticles) {
 		if (!SpawnParticle())
 			break;
 	}
+	UpdateBatches();
 }
 
 void ParticleEmitter::Reset() {
-	while (m_particles[0]) {
-		FreeParticle(m_particles[0]);
-	}
+	m_numParticles = 0;
 	m_particlesToEmit = 0.f;
+	UpdateBatches();
 }
 
-ParticleEmitter::Particle *ParticleEmitter::SpawnParticle() {
-	Particle *p = AllocateParticle();
-	if (!p)
-		return 0;
-
-	p->time = 0.f;
-	p->rotationDriftTime = 0.f;
-	p->driftTime[0] = math::FastFloatRand(m_particleStyle.xdriftPhase[0], m_particleStyle.xdriftPhase[1]);
-	p->driftTime[1] = math::FastFloatRand(m_particleStyle.ydriftPhase[0], m_particleStyle.ydriftPhase[1]);
-	p->driftTime[2] = math::FastFloatRand(m_particleStyle.zdriftPhase[0], m_particleStyle.zdriftPhase[1]);
-	p->scaleTime[0] = 0.f;
-	p->scaleTime[1] = 0.f;
-	p->state = Particle::kFadeIn;
-
-	p->mass = math::FastFloatRand(m_particleStyle.mass[0], m_particleStyle.mass[1]);
-	p->gravity = math::FastFloatRand(m_particleStyle.cgravity[0], m_particleStyle.cgravity[1]);
-	p->drag = math::FastFloatRand(m_particleStyle.cdrag[0], m_particleStyle.cdrag[1]);
-	
-	p->doDrag = p->drag != 0.f;
-
-	p->maxvel = math::FastFloatRand(m_particleStyle.maxvel[0], m_particleStyle.maxvel[1]);
-	p->doMaxVel = p->maxvel > 0.f;
-
-	p->fadein = math::FastFloatRand(m_particleStyle.fadein[0], m_particleStyle.fadein[1]);
-	p->fadeout = math::FastFloatRand(m_particleStyle.fadeout[0], m_particleStyle.fadeout[1]);
-	p->lifetime = math::FastFloatRand(m_particleStyle.lifetime[0], m_particleStyle.lifetime[1]);
-
-	p->rot = math::FastFloatRand(m_particleStyle.rotation[0], m_particleStyle.rotation[1]);
-	p->origRotate = p->rot;
-
-	p->rotationRate = math::FastFloatRand(m_particleStyle.rotationRate[0], m_particleStyle.rotationRate[1]);
-	p->rotationDrift = math::FastFloatRand(m_particleStyle.rotationDrift[0], m_particleStyle.rotationDrift[1]);
-	p->rotationDrift *= math::Constants<float>::_2_PI();
-
-	p->rotationDriftSpeed = math::FastFloatRand(m_particleStyle.rotationDriftTime[0], m_particleStyle.rotationDriftTime[1]);
-	
-	if (p->rotationDriftSpeed != 0.f)
-		p->rotationDriftSpeed = 1.f/p->rotationDriftSpeed;
-
-	p->doRotate = p->rotationRate != 0.f;
-	p->doRotateDrift = p->rotationDrift != 0.f;
-
-	p->force[0] = math::FastFloatRand(m_particleStyle.xforce[0], m_particleStyle.xforce[1]);
-	p->force[1] = math::FastFloatRand(m_particleStyle.yforce[0], m_particleStyle.yforce[1]);
-	p->force[2] = math::FastFloatRand(m_particleStyle.zforce[0], m_particleStyle.zforce[1]);
-
-	p->drift[0] = math::FastFloatRand(m_particleStyle.xdrift[0], m_particleStyle.xdrift[1]);
-	p->drift[1] = math::FastFloatRand(m_particleStyle.ydrift[0], m_particleStyle.ydrift[1]);
-	p->drift[2] = math::FastFloatRand(m_particleStyle.zdrift[0], m_particleStyle.zdrift[1]);
-
-	p->driftSpeed[0] = math::FastFloatRand(m_particleStyle.xdriftTime[0], m_particleStyle.xdriftTime[1]);
-	p->driftSpeed[1] = math::FastFloatRand(m_particleStyle.ydriftTime[0], m_particleStyle.ydriftTime[1]);
-	p->driftSpeed[2] = math::FastFloatRand(m_particleStyle.zdriftTime[0], m_particleStyle.zdriftTime[1]);
-	
-	if (p->driftSpeed[0] != 0.f)
-		p->driftSpeed[0] = 1.f/p->driftSpeed[0];
-	if (p->driftSpeed[1] != 0.f)
-		p->driftSpeed[1] = 1.f/p->driftSpeed[1];
-	if (p->driftSpeed[2] != 0.f)
-		p->driftSpeed[2] = 1.f/p->driftSpeed[2];
-
-	p->drift0 = p->drift[0] != 0.f;
-	p->drift1 = p->drift[1] != 0.f;
-	p->drift2 = p->drift[2] != 0.f;
-
-	p->rgba = Vec4(
-		m_particleStyle.rgba[0], 
-		m_particleStyle.rgba[1], 
-		m_particleStyle.rgba[2], 
-		0.f
-	);
-
-	p->origSize[0] = math::FastFloatRand(m_particleStyle.sizeX[0], m_particleStyle.sizeX[1]);
-	p->origSize[1] = math::FastFloatRand(m_particleStyle.sizeY[0], m_particleStyle.sizeY[1]);
-
-	p->scaleSpeed[0] = math::FastFloatRand(m_particleStyle.sizeScaleXTime[0], m_particleStyle.sizeScaleXTime[1]);
-	p->scaleSpeed[1] = math::FastFloatRand(m_particleStyle.sizeScaleYTime[0], m_particleStyle.sizeScaleYTime[1]);
-
-	p->doScaleX = (m_particleStyle.sizeScaleX[1] != 0.f) && (p->scaleSpeed[0] > 0.f);
-	p->doScaleY = (m_particleStyle.sizeScaleY[1] != 0.f) && (p->scaleSpeed[1] > 0.f);
-
-	if (p->scaleSpeed[0] != 0.f)
-		p->scaleSpeed[0] = 1.f/p->scaleSpeed[0];
-	if (p->scaleSpeed[1] != 0.f)
-		p->scaleSpeed[1] = 1.f/p->scaleSpeed[1];
-
-	p->size[0] = p->origSize[0] * m_particleStyle.sizeScaleX[0];
-	p->size[1] = p->origSize[1] * m_particleStyle.sizeScaleY[0];
-
-	p->orgPos = m_pos;
+bool ParticleEmitter::SpawnParticle() {
+	if (m_numParticles >= m_emitterStyle.maxParticles)
+		return false;
+
+	const int kIdx = m_numParticles++;
+	const ParticleStyle &style = m_particleStyle;
+
+#define P(_stream) Stream(_stream)[kIdx]
+
+	P(kStream_Time) = 0.f;
+	P(kStream_State) = (float)kState_FadeIn;
+	P(kStream_Alpha) = 0.f;
+	P(kStream_FadeIn) = math::FastFloatRand(m_rand, style.fadein[0], style.fadein[1]);
+	P(kStream_FadeOut) = math::FastFloatRand(m_rand, style.fadeout[0], style.fadeout[1]);
+	P(kStream_Lifetime) = math::FastFloatRand(m_rand, style.lifetime[0], style.lifetime[1]);
+
+	P(kStream_InvMass) = 1.f / math::FastFloatRand(m_rand, style.mass[0], style.mass[1]);
+	P(kStream_Gravity) = math::FastFloatRand(m_rand, style.cgravity[0], style.cgravity[1]);
+	P(kStream_Drag) = math::FastFloatRand(m_rand, style.cdrag[0], style.cdrag[1]);
+
+	float maxvel = math::FastFloatRand(m_rand, style.maxvel[0], style.maxvel[1]);
+	P(kStream_MaxVel) = (maxvel > 0.f) ? maxvel : kNoMaxVel;
+
+	// zero rates and amplitudes leave the value unchanged, the simulation doesn't branch on them.
+	float rot = math::FastFloatRand(m_rand, style.rotation[0], style.rotation[1]);
+	P(kStream_Rotate) = rot;
+	P(kStream_OrigRotate) = rot;
+	P(kStream_RotationRate) = math::FastFloatRand(m_rand, style.rotationRate[0], style.rotationRate[1]);
+	P(kStream_RotationDrift) = math::FastFloatRand(m_rand, style.rotationDrift[0], style.rotationDrift[1]) * math::Constants<float>::_2_PI();
+	P(kStream_RotationDriftTime) = 0.f;
+
+	float speed = math::FastFloatRand(m_rand, style.rotationDriftTime[0], style.rotationDriftTime[1]);
+	P(kStream_RotationDriftSpeed) = (speed != 0.f) ? (1.f/speed) : 0.f;
+
+	P(kStream_ForceX) = math::FastFloatRand(m_rand, style.xforce[0], style.xforce[1]);
+	P(kStream_ForceY) = math::FastFloatRand(m_rand, style.yforce[0], style.yforce[1]);
+	P(kStream_ForceZ) = math::FastFloatRand(m_rand, style.zforce[0], style.zforce[1]);
+
+	P(kStream_DriftX) = math::FastFloatRand(m_rand, style.xdrift[0], style.xdrift[1]);
+	P(kStream_DriftY) = math::FastFloatRand(m_rand, style.ydrift[0], style.ydrift[1]);
+	P(kStream_DriftZ) = math::FastFloatRand(m_rand, style.zdrift[0], style.zdrift[1]);
+
+	P(kStream_DriftTimeX) = math::FastFloatRand(m_rand, style.xdriftPhase[0], style.xdriftPhase[1]);
+	P(kStream_DriftTimeY) = math::FastFloatRand(m_rand, style.ydriftPhase[0], style.ydriftPhase[1]);
+	P(kStream_DriftTimeZ) = math::FastFloatRand(m_rand, style.zdriftPhase[0], style.zdriftPhase[1]);
+
+	speed = math::FastFloatRand(m_rand, style.xdriftTime[0], style.xdriftTime[1]);
+	P(kStream_DriftSpeedX) = (speed != 0.f) ? (1.f/speed) : 0.f;
+	speed = math::FastFloatRand(m_rand, style.ydriftTime[0], style.ydriftTime[1]);
+	P(kStream_DriftSpeedY) = (speed != 0.f) ? (1.f/speed) : 0.f;
+	speed = math::FastFloatRand(m_rand, style.zdriftTime[0], style.zdriftTime[1]);
+	P(kStream_DriftSpeedZ) = (speed != 0.f) ? (1.f/speed) : 0.f;
+
+	P(kStream_OrigSizeX) = math::FastFloatRand(m_rand, style.sizeX[0], style.sizeX[1]);
+	P(kStream_OrigSizeY) = math::FastFloatRand(m_rand, style.sizeY[0], style.sizeY[1]);
+	P(kStream_SizeX) = P(kStream_OrigSizeX) * style.sizeScaleX[0];
+	P(kStream_SizeY) = P(kStream_OrigSizeY) * style.sizeScaleY[0];
+	P(kStream_ScaleTimeX) = 0.f;
+	P(kStream_ScaleTimeY) = 0.f;
+
+	speed = math::FastFloatRand(m_rand, style.sizeScaleXTime[0], style.sizeScaleXTime[1]);
+	bool scale = (style.sizeScaleX[1] != 0.f) && (speed > 0.f);
+	P(kStream_ScaleX) = scale ? 1.f : 0.f;
+	P(kStream_ScaleSpeedX) = scale ? (1.f/speed) : 0.f;
+
+	speed = math::FastFloatRand(m_rand, style.sizeScaleYTime[0], style.sizeScaleYTime[1]);
+	scale = (style.sizeScaleY[1] != 0.f) && (speed > 0.f);
+	P(kStream_ScaleY) = scale ? 1.f : 0.f;
+	P(kStream_ScaleSpeedY) = scale ? (1.f/speed) : 0.f;
+
+	Vec3 pos(m_pos);
 
 	if (m_volume) {
 		if (m_emitterStyle.volume[0] > 0.f)
-			p->orgPos[0] += -m_emitterStyle.volume[0] + math::FastFloatRand()*m_emitterStyle.volume[0]*2.f;
+			pos[0] += -m_emitterStyle.volume[0] + math::FastFloatRand(m_rand)*m_emitterStyle.volume[0]*2.f;
 		if (m_emitterStyle.volume[1] > 0.f)
-			p->orgPos[1] += -m_emitterStyle.volume[1] + math::FastFloatRand()*m_emitterStyle.volume[1]*2.f;
+			pos[1] += -m_emitterStyle.volume[1] + math::FastFloatRand(m_rand)*m_emitterStyle.volume[1]*2.f;
 		if (m_emitterStyle.volume[2] > 0.f)
-			p->orgPos[2] += -m_emitterStyle.volume[2] + math::FastFloatRand()*m_emitterStyle.volume[2]*2.f;
+			pos[2] += -m_emitterStyle.volume[2] + math::FastFloatRand(m_rand)*m_emitterStyle.volume[2]*2.f;
 	}
 
-	p->pos = p->orgPos;
+	P(kStream_PosX) = P(kStream_OrgPosX) = pos[0];
+	P(kStream_PosY) = P(kStream_OrgPosY) = pos[1];
+	P(kStream_PosZ) = P(kStream_OrgPosZ) = pos[2];
+
+	Vec3 vel(Vec3::Zero);
 
 	if (m_velocity) {
 
-		p->vel = m_dir;
+		vel = m_dir;
 
 		if (m_cone) {
-			Vec3 up = m_up * (-m_emitterStyle.spread + math::FastFloatRand()*m_emitterStyle.spread*2.f);
-			Vec3 left = m_left * (-m_emitterStyle.spread + math::FastFloatRand()*m_emitterStyle.spread*2.f);
-			p->vel += up+left;
-			p->vel.Normalize();
+			Vec3 up = m_up * (-m_emitterStyle.spread + math::FastFloatRand(m_rand)*m_emitterStyle.spread*2.f);
+			Vec3 left = m_left * (-m_emitterStyle.spread + math::FastFloatRand(m_rand)*m_emitterStyle.spread*2.f);
+			vel += up+left;
+			vel.Normalize();
 		}
 
-		p->vel = p->vel * math::FastFloatRand(m_particleStyle.vel[0], m_particleStyle.vel[1]);
-
-	} else {
-		p->vel = Vec3::Zero;
+		vel = vel * math::FastFloatRand(m_rand, style.vel[0], style.vel[1]);
 	}
 
-	return p;
-}
+	P(kStream_VelX) = vel[0];
+	P(kStream_VelY) = vel[1];
+	P(kStream_VelZ) = vel[2];
 
-ParticleEmitter::Particle *ParticleEmitter::AllocateParticle() {
-	Particle *p = 0;
-	
-	const int kSize = (int)m_batches.size();
-
-	for (int i = 0; i < kSize; ++i) {
-		int idx = m_allocBatch + i;
-		if (idx >= kSize)
-			idx -= kSize;
-
-		p = (Particle*)m_batches[idx]->AllocateSprite();
-		if (p) {
-			m_allocBatch = i;
-			p->batch = idx;
-			p->prev = 0;
-			p->next = m_particles[0];
-			if (m_particles[0])
-				m_particles[0]->prev = p;
-			if (!m_particles[1])
-				m_particles[1] = p;
-			m_particles[0] = p;
-			++m_numParticles;
-			break;
-		}
-	}
-	return p;
-}
+#undef P
 
-void ParticleEmitter::FreeParticle(Particle *p) {
-	if (p->next)
-		p->next->prev = p->prev;
-	if (p->prev)
-		p->prev->next = p->next;
-	if (p == m_particles[0])
-		m_particles[0] = p->next;
-	if (p == m_particles[1])
-		m_particles[1] = p->prev;
-
-	m_allocBatch = p->batch;
-	m_batches[p->batch]->FreeSprite(p);
-	--m_numParticles;
+	return true;
 }
 
-///////////////////////////////////////////////////////////////////////////////
-
-bool ParticleEmitter::Particle::Move(float dt, const ParticleStyle &style) {
-
-	time += dt;
-	switch (state) {
-	case kFadeIn:
-		if (time < fadein) {
-			rgba[3] = style.rgba[3] * (time/fadein);
-		} else {
-			rgba[3] = style.rgba[3];
-			time = 0.f;
-			state = kMove;
-		} break;
-	case kMove:
-		if (time >= lifetime) {
-			time = 0.f;
-			state = kFadeOut;
-		} break;
-	case kFadeOut:
-		if (time >= fadeout) {
-			rgba[3] = 0.f;
-			return false;
-		} else {
-			rgba[3] = style.rgba[3] * (1.f - (time/fadeout));
-		} break;
-	}
-
-	if (doRotate) {
-		origRotate += rotationRate*dt;
-		if (origRotate > math::Constants<float>::_2_PI()) {
-			origRotate -= math::Constants<float>::_2_PI();
-		} else if (origRotate < -math::Constants<float>::_2_PI()) {
-			origRotate += math::Constants<float>::_2_PI();
-		}
-		rot = origRotate;
-	}
-
-	if (doRotateDrift) {
-		rotationDriftTime += dt*rotationDriftSpeed;
-		while (rotationDriftTime >= 1.f) {
-			rotationDriftTime -= 1.f;
-		}
-		
-		float multiplier = math::FastSin(-math::Constants<float>::PI() + rotationDriftTime*math::Constants<float>::_2_PI());
-		rot = origRotate + multiplier*rotationDrift;
-	}
-
-	if (doScaleX) {
-		scaleTime[0] += dt*scaleSpeed[0];
-		while (scaleTime[0] >= 1.f) {
-			scaleTime[0] -= 1.f;
-		}
-		float multiplier = math::FastSin(-math::Constants<float>::PI() + scaleTime[0]*math::Constants<float>::_2_PI());
-		size[0] = origSize[0] * (style.sizeScaleX[0] + math::Abs(multiplier)*style.sizeScaleX[1]);
-	}
-
-	if (doScaleY) {
-		scaleTime[1] += dt*scaleSpeed[1];
-		while (scaleTime[1] >= 1.f) {
-			scaleTime[1] -= 1.f;
-		}
-		float multiplier = math::FastSin(-math::Constants<float>::PI() + scaleTime[1]*math::Constants<float>::_2_PI());
-		size[1] = origSize[1] * (style.sizeScaleY[0] + math::Abs(multiplier)*style.sizeScaleY[1]);
+void ParticleEmitter::FreeParticle(int idx) {
+	RAD_ASSERT(idx < m_numParticles);
+	const int kLast = --m_numParticles;
+	if (idx != kLast) {
+		float *s = m_streams;
+		for (int i = 0; i < kNumStreams; ++i, s += m_streamSize)
+			s[idx] = s[kLast];
 	}
-
-	UpdatePos(dt);
-
-	return true;
 }
 
-void ParticleEmitter::Particle::UpdatePos(float dt) {
+void ParticleEmitter::AllocateStreams(int maxParticles) {
+	if (m_streams)
+		zone_free(m_streams);
 
-	Vec3 force(this->force[0], this->force[1], this->force[2]-gravity);
-	
-	if (doDrag)
-		force -= vel*drag;
-	
-	vel += (force/mass)*dt;
+	m_streamSize = (maxParticles+3) & ~3;
+	const AddrSize kSize = sizeof(float)*m_streamSize*kNumStreams;
+	m_streams = (float*)safe_zone_malloc(ZRender, kSize, 0, SIMDDriver::kAlignment);
+	// padding lanes are simulated too, keep them finite.
+	memset(m_streams, 0, kSize);
+}
 
-	if (doMaxVel) {
-		float m = vel.Normalize();
-		if (m > maxvel)
-			m = maxvel;
-		vel = vel*m;
+void ParticleEmitter::UpdateBatches() {
+	int numParticles = m_numParticles;
+	for (BatchVec::const_iterator it = m_batches.begin(); it != m_batches.end(); ++it) {
+		const int kNum = math::Min<int>(numParticles, SpriteBatch::kMaxSprites);
+		(*it)->SetNumSprites(kNum);
+		numParticles -= kNum;
 	}
+}
 
-	orgPos += vel*dt;
-
-	if (drift0||drift1||drift2) {
-
-		if (drift0) {
-			driftTime[0] += dt*driftSpeed[0];
-			while (driftTime[0] >= 1.f) {
-				driftTime[0] -= 1.f;
-			}
-
-			float multiplier = math::FastSin(-math::Constants<float>::PI() + driftTime[0]*math::Constants<float>::_2_PI());
-			pos[0] = orgPos[0] + drift[0]*multiplier;
-		} else {
-			pos[0] = orgPos[0];
-		}
+///////////////////////////////////////////////////////////////////////////////
 
-		if (drift1) {
-			driftTime[1] += dt*driftSpeed[1];
-			while (driftTime[1] >= 1.f) {
-				driftTime[1] -= 1.f;
+int ParticleEmitter::UpdateStates(float dt) {
+	float *time = Stream(kStream_Time);
+	float *state = Stream(kStream_State);
+	float *alpha = Stream(kStream_Alpha);
+	const float *fadein = Stream(kStream_FadeIn);
+	const float *fadeout = Stream(kStream_FadeOut);
+	const float *lifetime = Stream(kStream_Lifetime);
+	const float kAlpha = m_particleStyle.rgba[3];
+
+	for (int i = 0; i < m_numParticles;) {
+		float t = time[i] + dt;
+
+		switch ((int)state[i]) {
+		case kState_FadeIn:
+			if (t < fadein[i]) {
+				alpha[i] = kAlpha * (t/fadein[i]);
+			} else {
+				alpha[i] = kAlpha;
+				t = 0.f;
+				state[i] = (float)kState_Move;
+			} break;
+		case kState_Move:
+			if (t >= lifetime[i]) {
+				t = 0.f;
+				state[i] = (float)kState_FadeOut;
+			} break;
+		case kState_FadeOut:
+			if (t >= fadeout[i]) {
+				FreeParticle(i); // swaps in the last particle, which hasn't been updated yet.
+				continue;
 			}
-
-			float multiplier = math::FastSin(-math::Constants<float>::PI() + driftTime[1]*math::Constants<float>::_2_PI());
-			pos[1] = orgPos[1] + drift[1]*multiplier;
-		} else {
-			pos[1] = orgPos[1];
+			alpha[i] = kAlpha * (1.f - (t/fadeout[i]));
+			break;
 		}
 
-		if (drift2) {
-			driftTime[2] += dt*driftSpeed[2];
-			while (driftTime[2] >= 1.f) {
-				driftTime[2] -= 1.f;
-			}
+		time[i] = t;
+		++i;
+	}
 
-			float multiplier = math::FastSin(-math::Constants<float>::PI() + driftTime[2]*math::Constants<float>::_2_PI());
-			pos[2] = orgPos[2] + drift[2]*multiplier;
-		} else {
-			pos[2] = orgPos[2];
-		}
+	return m_numParticles;
+}
 
-	} else {
-		pos = orgPos;
+void ParticleEmitter::Move(float dt) {
+	float *posX = Stream(kStream_PosX);
+	float *posY = Stream(kStream_PosY);
+	float *posZ = Stream(kStream_PosZ);
+	float *orgX = Stream(kStream_OrgPosX);
+	float *orgY = Stream(kStream_OrgPosY);
+	float *orgZ = Stream(kStream_OrgPosZ);
+	float *velX = Stream(kStream_VelX);
+	float *velY = Stream(kStream_VelY);
+	float *velZ = Stream(kStream_VelZ);
+	const float *forceX = Stream(kStream_ForceX);
+	const float *forceY = Stream(kStream_ForceY);
+	const float *forceZ = Stream(kStream_ForceZ);
+	const float *driftX = Stream(kStream_DriftX);
+	const float *driftY = Stream(kStream_DriftY);
+	const float *driftZ = Stream(kStream_DriftZ);
+	const float *driftSpeedX = Stream(kStream_DriftSpeedX);
+	const float *driftSpeedY = Stream(kStream_DriftSpeedY);
+	const float *driftSpeedZ = Stream(kStream_DriftSpeedZ);
+	float *driftTimeX = Stream(kStream_DriftTimeX);
+	float *driftTimeY = Stream(kStream_DriftTimeY);
+	float *driftTimeZ = Stream(kStream_DriftTimeZ);
+	float *sizeX = Stream(kStream_SizeX);
+	float *sizeY = Stream(kStream_SizeY);
+	const float *origSizeX = Stream(kStream_OrigSizeX);
+	const float *origSizeY = Stream(kStream_OrigSizeY);
+	const float *scaleX = Stream(kStream_ScaleX);
+	const float *scaleY = Stream(kStream_ScaleY);
+	const float *scaleSpeedX = Stream(kStream_ScaleSpeedX);
+	const float *scaleSpeedY = Stream(kStream_ScaleSpeedY);
+	float *scaleTimeX = Stream(kStream_ScaleTimeX);
+	float *scaleTimeY = Stream(kStream_ScaleTimeY);
+	float *rot = Stream(kStream_Rotate);
+	float *origRot = Stream(kStream_OrigRotate);
+	const float *rotRate = Stream(kStream_RotationRate);
+	const float *rotDrift = Stream(kStream_RotationDrift);
+	const float *rotDriftSpeed = Stream(kStream_RotationDriftSpeed);
+	float *rotDriftTime = Stream(kStream_RotationDriftTime);
+	const float *invMass = Stream(kStream_InvMass);
+	const float *gravity = Stream(kStream_Gravity);
+	const float *drag = Stream(kStream_Drag);
+	const float *maxVel = Stream(kStream_MaxVel);
+
+	const Float4 kDt = Splat(dt);
+	const Float4 kOne = Splat(1.f);
+	const Float4 kMinLenSq = Splat(1e-20f);
+	const Float4 kScaleX0 = Splat(m_particleStyle.sizeScaleX[0]);
+	const Float4 kScaleX1 = Splat(m_particleStyle.sizeScaleX[1]);
+	const Float4 kScaleY0 = Splat(m_particleStyle.sizeScaleY[0]);
+	const Float4 kScaleY1 = Splat(m_particleStyle.sizeScaleY[1]);
+
+	for (int i = 0; i < m_numParticles; i += kWidth) {
+		// rotation
+		Float4 orot = WrapAngle(Add(Load(origRot+i), Mul(Load(rotRate+i), kDt)));
+		Store(origRot+i, orot);
+		Float4 t = Frac(Add(Load(rotDriftTime+i), Mul(Load(rotDriftSpeed+i), kDt)));
+		Store(rotDriftTime+i, t);
+		Store(rot+i, Add(orot, Mul(Wave(t), Load(rotDrift+i))));
+
+		// scale
+		t = Frac(Add(Load(scaleTimeX+i), Mul(Load(scaleSpeedX+i), kDt)));
+		Store(scaleTimeX+i, t);
+		Float4 scale = Add(kScaleX0, Mul(Mul(Abs(Wave(t)), kScaleX1), Load(scaleX+i)));
+		Store(sizeX+i, Mul(Load(origSizeX+i), scale));
+
+		t = Frac(Add(Load(scaleTimeY+i), Mul(Load(scaleSpeedY+i), kDt)));
+		Store(scaleTimeY+i, t);
+		scale = Add(kScaleY0, Mul(Mul(Abs(Wave(t)), kScaleY1), Load(scaleY+i)));
+		Store(sizeY+i, Mul(Load(origSizeY+i), scale));
+
+		// forces: vel += ((force - gravity - vel*drag)/mass)*dt
+		const Float4 kAccel = Mul(Load(invMass+i), kDt);
+		const Float4 kDrag = Load(drag+i);
+
+		Float4 vx = Load(velX+i);
+		Float4 vy = Load(velY+i);
+		Float4 vz = Load(velZ+i);
+
+		vx = Add(vx, Mul(Sub(Load(forceX+i), Mul(vx, kDrag)), kAccel));
+		vy = Add(vy, Mul(Sub(Load(forceY+i), Mul(vy, kDrag)), kAccel));
+		vz = Add(vz, Mul(Sub(Sub(Load(forceZ+i), Load(gravity+i)), Mul(vz, kDrag)), kAccel));
+
+		// clamp to max velocity
+		Float4 lenSq = Add(Add(Mul(vx, vx), Mul(vy, vy)), Mul(vz, vz));
+		scale = Min(kOne, Mul(Load(maxVel+i), RSqrt(Max(lenSq, kMinLenSq))));
+		vx = Mul(vx, scale);
+		vy = Mul(vy, scale);
+		vz = Mul(vz, scale);
+
+		Store(velX+i, vx);
+		Store(velY+i, vy);
+		Store(velZ+i, vz);
+
+		Float4 ox = Add(Load(orgX+i), Mul(vx, kDt));
+		Float4 oy = Add(Load(orgY+i), Mul(vy, kDt));
+		Float4 oz = Add(Load(orgZ+i), Mul(vz, kDt));
+
+		Store(orgX+i, ox);
+		Store(orgY+i, oy);
+		Store(orgZ+i, oz);
+
+		// drift
+		t = Frac(Add(Load(driftTimeX+i), Mul(Load(driftSpeedX+i), kDt)));
+		Store(driftTimeX+i, t);
+		Store(posX+i, Add(ox, Mul(Load(driftX+i), Wave(t))));
+
+		t = Frac(Add(Load(driftTimeY+i), Mul(Load(driftSpeedY+i), kDt)));
+		Store(driftTimeY+i, t);
+		Store(posY+i, Add(oy, Mul(Load(driftY+i), Wave(t))));
+
+		t = Frac(Add(Load(driftTimeZ+i), Mul(Load(driftSpeedZ+i), kDt)));
+		Store(driftTimeZ+i, t);
+		Store(posZ+i, Add(oz, Mul(Load(driftZ+i), Wave(t))));
 	}
 }
 
@@ -81,6 +81,7 @@ public:
 		const ParticleEmitterStyle &emitterStyle,
 		const ParticleStyle &particleStyle
 	);
+	~ParticleEmitter();
 
 	void Init(
 		const ParticleEmitterStyle &emitterStyle,
@@ -137,63 +138,81 @@ private:
 
 	typedef zone_vector<SpriteBatch::Ref, ZRenderT>::type BatchVec;
 
-	class Particle : public Sprite {
-	public:
-		Particle *next, *prev;
-		int batch;
-
-		enum State {
-			kFadeIn,
-			kMove,
-			kFadeOut
-		};
-
-		// returns false when particle expires.
-		bool Move(float dt, const ParticleStyle &style); 
-
-		Vec3 vel;
-		Vec3 orgPos;
-		float time;
-		float rotationDriftTime;
-		float driftTime[3];
-		float scaleTime[2];
-
-		float mass;
-		float gravity;
-		float drag;
-		float maxvel;
-		float fadein;
-		float fadeout;
-		float lifetime;
-		float rotationRate;
-		float rotationDrift;
-		float rotationDriftSpeed;
-		float force[3];
-		float drift[3];
-		float driftSpeed[3];
-		float scaleSpeed[2];
-		float origSize[2];
-		float origRotate;
-		State state;
-
-		unsigned drift0 : 1;
-		unsigned drift1 : 1;
-		unsigned drift2 : 1;
-		unsigned doDrag : 1;
-		unsigned doRotate : 1;
-		unsigned doRotateDrift : 1;
-		unsigned doScaleX : 1;
-		unsigned doScaleY : 1;
-		unsigned doMaxVel : 1;
-
-	private:
-
-		void UpdatePos(float dt);
+	// Particles are stored as a structure of arrays, one float stream per
+	// field, so they can be simulated 4 at a time. Live particles are packed
+	// at the front of each stream, expired particles are swapped with the last.
+	enum Stream {
+		kStream_PosX,
+		kStream_PosY,
+		kStream_PosZ,
+		kStream_OrgPosX,
+		kStream_OrgPosY,
+		kStream_OrgPosZ,
+		kStream_VelX,
+		kStream_VelY,
+		kStream_VelZ,
+		kStream_ForceX,
+		kStream_ForceY,
+		kStream_ForceZ,
+		kStream_DriftX,
+		kStream_DriftY,
+		kStream_DriftZ,
+		kStream_DriftSpeedX,
+		kStream_DriftSpeedY,
+		kStream_DriftSpeedZ,
+		kStream_DriftTimeX,
+		kStream_DriftTimeY,
+		kStream_DriftTimeZ,
+		kStream_SizeX,
+		kStream_SizeY,
+		kStream_OrigSizeX,
+		kStream_OrigSizeY,
+		kStream_ScaleX, // 1 if size x is animated, 0 otherwise
+		kStream_ScaleY,
+		kStream_ScaleSpeedX,
+		kStream_ScaleSpeedY,
+		kStream_ScaleTimeX,
+		kStream_ScaleTimeY,
+		kStream_Rotate,
+		kStream_OrigRotate,
+		kStream_RotationRate,
+		kStream_RotationDrift,
+		kStream_RotationDriftSpeed,
+		kStream_RotationDriftTime,
+		kStream_InvMass,
+		kStream_Gravity,
+		kStream_Drag,
+		kStream_MaxVel,
+		kStream_Alpha,
+		kStream_Time,
+		kStream_State,
+		kStream_FadeIn,
+		kStream_FadeOut,
+		kStream_Lifetime,
+		kNumStreams
 	};
 
-	Particle *SpawnParticle();
-	Particle *AllocateParticle();
-	void FreeParticle(Particle *p);
+	enum State {
+		kState_FadeIn,
+		kState_Move,
+		kState_FadeOut
+	};
+
+	float *Stream(int stream) {
+		return m_streams + stream*m_streamSize;
+	}
+
+	const float *Stream(int stream) const {
+		return m_streams + stream*m_streamSize;
+	}
+
+	bool SpawnParticle();
+	void FreeParticle(int idx);
+	void AllocateStreams(int maxParticles);
+	void UpdateBatches();
+	// returns the number of live particles.
+	int UpdateStates(float dt);
+	void Move(float dt);
 
 	ParticleEmitterStyle m_emitterStyle;
 	ParticleStyle m_particleStyle;
@@ -202,12 +221,13 @@ private:
 	Vec3 m_up;
 	Vec3 m_left;
 	BatchVec m_batches;
-	Particle *m_particles[2];
+	float *m_streams;
 	float m_particlesToEmit;
 	int m_numParticles;
+	int m_streamSize;
 	int m_tickFrame;
 	int m_skinFrame;
-	int m_allocBatch;
+	int m_rand;
 
 	unsigned m_cone : 1;
 	unsigned m_volume : 1;
@@ -12,12 +12,6 @@
 namespace r {
 
 namespace {
-struct SpriteVertex {
-	float pos[3];
-	float rgba[4];
-	float skin[4];
-	float padd0; // 16 bytes
-};
 BOOST_STATIC_ASSERT(sizeof(SpriteVertex) == (sizeof(float)*12));
 BOOST_STATIC_ASSERT(sizeof(Sprite) >= sizeof(SpriteVertex));
 
@@ -33,7 +27,8 @@ m_numSprites(0),
 m_minSprites(0), 
 m_maxSprites(0),
 m_meshSprites(0),
-m_vertStream(0) {
+m_vertStream(0),
+m_external(false) {
 	RAD_DEBUG_ONLY(m_init = false);
 }
 
@@ -48,7 +43,7 @@ SpriteBatch::SpriteBatch(
 
 void SpriteBatch::Init(int spriteSize, int minSprites, int maxSprites) {
 	RAD_ASSERT(!m_init);
-	RAD_ASSERT(spriteSize >= sizeof(Sprite));
+	RAD_ASSERT((spriteSize == 0) || (spriteSize >= sizeof(Sprite)));
 	RAD_DEBUG_ONLY(m_init = true);
 
 	m_head = 0;
@@ -57,6 +52,7 @@ void SpriteBatch::Init(int spriteSize, int minSprites, int maxSprites) {
 	m_meshSprites = 0;
 	m_vertStream = 0;
 	m_minSprites = minSprites;
+	m_external = spriteSize == 0;
 
 	int spritesInChunk;
 	int maxBlocks;
@@ -73,6 +69,9 @@ void SpriteBatch::Init(int spriteSize, int minSprites, int maxSprites) {
 		m_maxSprites = spritesInChunk;
 	}
 
+	if (m_external)
+		return;
+
 	m_p.Create(
 		ZRender,
 		"spritebatch",
@@ -85,6 +84,7 @@ void SpriteBatch::Init(int spriteSize, int minSprites, int maxSprites) {
 
 Sprite *SpriteBatch::AllocateSprite() {
 	RAD_ASSERT(m_init);
+	RAD_ASSERT(!m_external);
 	Sprite *sprite = (Sprite*)m_p.GetChunk();
 	if (sprite) {
 		sprite->prev = m_tail;
@@ -118,11 +118,13 @@ void SpriteBatch::FreeSprite(Sprite *sprite) {
 
 void SpriteBatch::Compact() {
 	RAD_ASSERT(m_init);
-	m_p.Compact();
+	if (!m_external)
+		m_p.Compact();
 }
 
 void SpriteBatch::Skin() {
 	RAD_ASSERT(m_init);
+	RAD_ASSERT(!m_external);
 
 	AllocateMesh();
 
@@ -143,6 +145,30 @@ void SpriteBatch::Skin() {
 	vb.reset();
 }
 
+void SpriteBatch::SetNumSprites(int numSprites) {
+	RAD_ASSERT(m_init);
+	RAD_ASSERT(m_external);
+	RAD_ASSERT(numSprites <= m_maxSprites);
+	m_numSprites = numSprites;
+}
+
+SpriteVertex *SpriteBatch::MapVertices() {
+	RAD_ASSERT(m_init);
+	RAD_ASSERT(m_external);
+	RAD_ASSERT(!m_vb);
+
+	AllocateMesh();
+
+	m_m.SwapChain();
+	m_vb = m_m.Map(m_vertStream);
+	return (SpriteVertex*)m_vb->ptr.get();
+}
+
+void SpriteBatch::UnmapVertices() {
+	RAD_ASSERT(m_vb);
+	m_vb.reset();
+}
+
 void SpriteBatch::Draw() {
 	m_m.Draw(0, m_numSprites * 2);
 }
@@ -14,6 +14,15 @@
 namespace r {
 
 class SpriteBatch;
+
+//! Vertex format of a SpriteBatch vertex stream, each sprite is 4 vertices.
+struct SpriteVertex {
+	float pos[3];
+	float rgba[4];
+	float skin[4]; // size[2], rot, corner index
+	float padd0; // 16 bytes
+};
+
 class Sprite {
 public:
 	Vec3 pos;
@@ -44,6 +53,9 @@ public:
 		int maxSprites = 0
 	); // 0 == no-limit/kMaxSprites
 
+	// A spriteSize of 0 creates a batch with no sprite storage, the
+	// owner sets the sprite count and writes vertices via MapVertices().
+
 	void Init(
 		int spriteSize,
 		int minSprites, 
@@ -60,6 +72,12 @@ public:
 	void Skin();
 	void Draw();
 
+	// Externally skinned batches.
+	void SetNumSprites(int numSprites);
+	//! Returns numSprites*4 vertices to be written, UnmapVertices() must be called after.
+	SpriteVertex *MapVertices();
+	void UnmapVertices();
+
 private:
 	
 	RAD_DECLARE_GET(mesh, Mesh*) {
@@ -74,6 +92,7 @@ private:
 
 	MemoryPool m_p;
 	Mesh m_m;
+	Mesh::StreamPtr::Ref m_vb;
 	Sprite *m_head;
 	Sprite *m_tail;
 	int m_numSprites;
@@ -81,6 +100,7 @@ private:
 	int m_maxSprites;
 	int m_meshSprites;
 	int m_vertStream;
+	bool m_external;
 	RAD_DEBUG_ONLY(bool m_init);
 };
 
@@ -20,6 +20,8 @@ namespace ska {
 
 BOOST_STATIC_ASSERT(sizeof(Mat4)==(16*sizeof(float)));
 BOOST_STATIC_ASSERT(sizeof(DSkTag)==6);
+// BoneTM's are blended by the SIMDDriver as flat float arrays.
+BOOST_STATIC_ASSERT(sizeof(BoneTM)==(SIMDDriver::kNumBoneTMFloats*sizeof(float)));
 
 namespace details {
 
@@ -36,15 +38,13 @@ void BlendBones(BoneTM *out, const BoneTM *src, const BoneTM *dst, float weight,
 		return;
 	}
 
-	for (int i = 0; i < num; ++i) {
-		BoneTM &tm = out[i+first];
-		const BoneTM &x = src[i+first];
-		const BoneTM &y = dst[i+first];
-
-		tm.r = math::Slerp(x.r, y.r, weight);
-		tm.s = math::Lerp(x.s, y.s, weight);
-		tm.t = math::Lerp(x.t, y.t, weight);
-	}
+	SIMD->BlendBones(
+		reinterpret_cast<float*>(out+first),
+		reinterpret_cast<const float*>(src+first),
+		reinterpret_cast<const float*>(dst+first),
+		weight,
+		num
+	);
 }
 
 void IdentBones(BoneTM *out, int first, int num) {
@@ -206,6 +206,129 @@ inline bool CompareMatrices(const float *a, const Mat4 &b) {
 
 ///////////////////////////////////////////////////////////////////////////////
 
+namespace {
+RAD_THREAD_VAR NotifyQueue *t_notifyQueue = 0;
+}
+
+void Notify::PostTag(const Ref &notify, const AnimTagEventData &data) {
+	NotifyQueue *q = t_notifyQueue;
+	if (!q) {
+		notify->EmitTag(data);
+		return;
+	}
+
+	if (notify->m_masked&kMaskFlag_Tags)
+		return;
+
+	q->m_events.resize(q->m_events.size()+1);
+	NotifyQueue::QueuedEvent &e = q->m_events.back();
+	e.notify = notify;
+	e.tag = data;
+	e.type = NotifyQueue::kEventType_Tag;
+}
+
+void Notify::PostEndFrame(const Ref &notify, const AnimStateEventData &data) {
+	NotifyQueue *q = t_notifyQueue;
+	if (!q) {
+		notify->EmitEndFrame(data);
+		return;
+	}
+
+	if (notify->m_masked&kMaskFlag_EndFrame)
+		return;
+
+	q->m_events.resize(q->m_events.size()+1);
+	NotifyQueue::QueuedEvent &e = q->m_events.back();
+	e.notify = notify;
+	e.state = data;
+	e.type = NotifyQueue::kEventType_EndFrame;
+}
+
+void Notify::PostFinish(const Ref &notify, const AnimStateEventData &data, bool masked) {
+	NotifyQueue *q = t_notifyQueue;
+	if (!q) {
+		notify->EmitFinish(data, masked);
+		return;
+	}
+
+	if (notify->m_masked&kMaskFlag_Finished)
+		return;
+
+	q->m_events.resize(q->m_events.size()+1);
+	NotifyQueue::QueuedEvent &e = q->m_events.back();
+	e.notify = notify;
+	e.state = data;
+	e.type = NotifyQueue::kEventType_Finish;
+	e.masked = masked;
+}
+
+void Ska::PostTag(const AnimTagEventData &data) {
+	NotifyQueue *q = t_notifyQueue;
+	if (!q) {
+		OnTag.Trigger(data);
+		return;
+	}
+
+	q->m_events.resize(q->m_events.size()+1);
+	NotifyQueue::QueuedEvent &e = q->m_events.back();
+	e.tag = data;
+	e.type = NotifyQueue::kEventType_SkaTag;
+}
+
+NotifyQueue::NotifyQueue() {
+}
+
+NotifyQueue::~NotifyQueue() {
+	RAD_ASSERT(t_notifyQueue != this);
+}
+
+void NotifyQueue::Bind() {
+	RAD_ASSERT(!t_notifyQueue);
+	t_notifyQueue = this;
+}
+
+void NotifyQueue::Unbind() {
+	RAD_ASSERT(t_notifyQueue == this);
+	t_notifyQueue = 0;
+}
+
+void NotifyQueue::Dispatch() {
+	RAD_ASSERT(t_notifyQueue != this);
+
+	// handlers may post new events or destroy this queue's owner,
+	// take the events first.
+	QueuedEventVec events;
+	events.swap(m_events);
+
+	for (QueuedEventVec::const_iterator it = events.begin(); it != events.end(); ++it) {
+		const QueuedEvent &e = *it;
+		switch (e.type) {
+		case kEventType_Tag:
+			e.notify->EmitTag(e.tag);
+			break;
+		case kEventType_EndFrame:
+			e.notify->EmitEndFrame(e.state);
+			break;
+		case kEventType_Finish:
+			e.notify->EmitFinish(e.state, e.masked);
+			break;
+		case kEventType_SkaTag:
+			e.tag.ska->OnTag.Trigger(e.tag);
+			break;
+		}
+	}
+}
+
+void NotifyQueue::Clear() {
+	m_events.clear();
+}
+
+NotifyQueue *NotifyQueue::Bound() {
+	return t_notifyQueue;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 Animation::Animation(Ska &ska, const DSkAnim &anim) :
 m_ska(&ska),
 m_vtm(0),
@@ -251,27 +374,17 @@ inline int DecodeI(const U8 *src, int ofs) {
 	return endian::SwapLittle(*reinterpret_cast<const int*>(src+ofs*kEncBytes))&kEncMask;
 }
 
-inline Quat DecodeQ(const S16 *table, int idx) {
-	static const float s_decodeMag = 1.0f / std::numeric_limits<S16>::max();
+enum {
+	kDecodeBatchSize = 64
+};
 
-	table += idx*4;
-
-	return Quat(
-		table[0]*s_decodeMag,
-		table[1]*s_decodeMag,
-		table[2]*s_decodeMag,
-		table[3]*s_decodeMag
-	);
-}
-
-inline Vec3 DecodeV(const S16 *table, int idx, float decodeMag) {
-	table += idx*3;
-
-	return Vec3(
-		table[0]*decodeMag,
-		table[1]*decodeMag,
-		table[2]*decodeMag
-	);
+//! Unpacks the rotation, scale and translation table indices for numBones bones.
+inline void DecodeIndices(int *indices, const U8 *rFrames, const U8 *sFrames, const U8 *tFrames, int numBones) {
+	for (int i = 0; i < numBones; ++i) {
+		indices[i] = DecodeI(rFrames, i);
+		indices[i+numBones] = DecodeI(sFrames, i);
+		indices[i+numBones*2] = DecodeI(tFrames, i);
+	}
 }
 
 } // namespace
@@ -281,10 +394,20 @@ void Animation::BlendFrames(int frameSrc, int frameDst, float blend, BoneTM *out
 
 	RAD_ASSERT(frameSrc < m_dska->numFrames);
 	RAD_ASSERT(frameDst < m_dska->numFrames);
-	 
-	const S16 *rTable = m_dska->rTable;
-	const S16 *sTable = m_dska->sTable;
-	const S16 *tTable = m_dska->tTable;
+
+	if (blend > 0.99f) {
+		frameSrc = frameDst;
+		blend = 0.f;
+	} else if (blend < 0.01f) {
+		blend = 0.f;
+	}
+
+	const float kDecodeMags[3] = {
+		1.0f / std::numeric_limits<S16>::max(),
+		m_dska->sDecodeMag,
+		m_dska->tDecodeMag
+	};
+
 	const U8 *srcRFrames = m_dska->rFrames+((frameSrc*(int)dska.numBones)+firstBone)*kEncBytes;
 	const U8 *srcSFrames = m_dska->sFrames+((frameSrc*(int)dska.numBones)+firstBone)*kEncBytes;
 	const U8 *srcTFrames = m_dska->tFrames+((frameSrc*(int)dska.numBones)+firstBone)*kEncBytes;
@@ -292,38 +415,29 @@ void Animation::BlendFrames(int frameSrc, int frameDst, float blend, BoneTM *out
 	const U8 *dstSFrames = m_dska->sFrames+((frameDst*(int)dska.numBones)+firstBone)*kEncBytes;
 	const U8 *dstTFrames = m_dska->tFrames+((frameDst*(int)dska.numBones)+firstBone)*kEncBytes;
 
-	if (blend < 0.01f) {
-		for (int i = 0; i < numBones; ++i) {
-			BoneTM &tm = out[i];
-			tm.r = DecodeQ(rTable, DecodeI(srcRFrames, i));
-			tm.s = DecodeV(sTable, DecodeI(srcSFrames, i), m_dska->sDecodeMag);
-			tm.t = DecodeV(tTable, DecodeI(srcTFrames, i), m_dska->tDecodeMag);
-		}
-	} else if (blend > 0.99f) {
-		for (int i = 0; i < numBones; ++i) {
-			BoneTM &tm = out[i];
-			tm.r = DecodeQ(rTable, DecodeI(dstRFrames, i));
-			tm.s = DecodeV(sTable, DecodeI(dstSFrames, i), m_dska->sDecodeMag);
-			tm.t = DecodeV(tTable, DecodeI(dstTFrames, i), m_dska->tDecodeMag);
-		}
-	} else {
-		BoneTM x, y;
-
-		for (int i = 0; i < numBones; ++i) {
-			BoneTM &tm = out[i];
-
-			x.r = DecodeQ(rTable, DecodeI(srcRFrames, i));
-			x.s = DecodeV(sTable, DecodeI(srcSFrames, i), m_dska->sDecodeMag);
-			x.t = DecodeV(tTable, DecodeI(srcTFrames, i), m_dska->tDecodeMag);
-
-			y.r = DecodeQ(rTable, DecodeI(dstRFrames, i));
-			y.s = DecodeV(sTable, DecodeI(dstSFrames, i), m_dska->sDecodeMag);
-			y.t = DecodeV(tTable, DecodeI(dstTFrames, i), m_dska->tDecodeMag);
-
-			tm.r = math::Slerp(x.r, y.r, blend);
-			tm.s = math::Lerp(x.s, y.s, blend);
-			tm.t = math::Lerp(x.t, y.t, blend);
-		}
+	int srcIndices[kDecodeBatchSize*3];
+	int dstIndices[kDecodeBatchSize*3];
+
+	// keyframe indices are unpacked in batches, the SIMDDriver decodes and blends them.
+	for (int i = 0; i < numBones; i += kDecodeBatchSize) {
+		const int kNumBones = std::min<int>(kDecodeBatchSize, numBones-i);
+		const int kOfs = i*kEncBytes;
+
+		DecodeIndices(srcIndices, srcRFrames+kOfs, srcSFrames+kOfs, srcTFrames+kOfs, kNumBones);
+		if (blend > 0.f)
+			DecodeIndices(dstIndices, dstRFrames+kOfs, dstSFrames+kOfs, dstTFrames+kOfs, kNumBones);
+
+		SIMD->DecodeBones(
+			reinterpret_cast<float*>(out+i),
+			m_dska->rTable,
+			m_dska->sTable,
+			m_dska->tTable,
+			kDecodeMags,
+			srcIndices,
+			dstIndices,
+			blend,
+			kNumBones
+		);
 	}
 }
 
@@ -410,8 +524,8 @@ void Animation::EmitTags(
 
 			tag.tag = tagStr;
 			if (notify)
-				notify->EmitTag(tag);
-			m_ska->OnTag.Trigger(tag);
+				Notify::PostTag(notify, tag);
+			m_ska->PostTag(tag);
 		}
 	}
 }
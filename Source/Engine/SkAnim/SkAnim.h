@@ -66,6 +66,11 @@ public:
 			OnFinish(data, masked);
 	}
 
+	// Emits the event, or records it if a NotifyQueue is bound to the calling thread.
+	static void PostTag(const Ref &notify, const AnimTagEventData &data);
+	static void PostEndFrame(const Ref &notify, const AnimStateEventData &data);
+	static void PostFinish(const Ref &notify, const AnimStateEventData &data, bool masked);
+
 protected:
 	virtual void OnTag(const AnimTagEventData &data) = 0;
 	virtual void OnEndFrame(const AnimStateEventData &data) = 0;
@@ -84,6 +89,53 @@ private:
 	int m_masked;
 };
 
+// Records notify events so that animations can be ticked off the main thread.
+// While bound to a thread any events posted on that thread are recorded, Dispatch()
+// emits them in the order they were posted.
+class RADENG_CLASS NotifyQueue {
+public:
+
+	NotifyQueue();
+	~NotifyQueue();
+
+	void Bind();
+	void Unbind();
+	void Dispatch();
+	void Clear();
+
+	RAD_DECLARE_READONLY_PROPERTY(NotifyQueue, empty, bool);
+
+	static NotifyQueue *Bound();
+
+private:
+
+	friend class Notify;
+	friend class Ska;
+
+	enum EventType {
+		kEventType_Tag,
+		kEventType_EndFrame,
+		kEventType_Finish,
+		kEventType_SkaTag
+	};
+
+	struct QueuedEvent {
+		Notify::Ref notify;
+		AnimTagEventData tag;
+		AnimStateEventData state;
+		EventType type;
+		bool masked;
+	};
+
+	typedef zone_vector<QueuedEvent, ZSkaT>::type QueuedEventVec;
+
+	RAD_DECLARE_GET(empty, bool) {
+		return m_events.empty();
+	}
+
+	QueuedEventVec m_events;
+};
+
 struct BoneTM {
 	typedef boost::shared_array<BoneTM> ArrayRef;
 	Quat r;
@@ -365,6 +417,8 @@ public:
 	RAD_DECLARE_READONLY_PROPERTY(Ska, absMotion, const BoneTM*);
 	RAD_DECLARE_PROPERTY(Ska, root, const ControllerRef&, const ControllerRef&);
 
+	// NOTE: triggered on the thread calling Tick(), unless a NotifyQueue is bound to that
+	// thread. Then it is recorded and triggered by NotifyQueue::Dispatch().
 	AnimTagEvent OnTag;
 	AnimStateEvent OnFinished;
 	AnimStateEvent OnMasked;
@@ -403,6 +457,8 @@ private:
 	friend class Animation;
 	friend class Controller;
 	void Init();
+
+	void PostTag(const AnimTagEventData &data);
 	
 	Animation::Map m_anims;
 	ControllerRef m_root;
@@ -488,6 +544,8 @@ private:
 	friend class Animation;
 	friend class Controller;
 	void Init();
+
+	void PostTag(const AnimTagEventData &data);
 	
 	Animation::Map m_anims;
 	ControllerRef m_root;
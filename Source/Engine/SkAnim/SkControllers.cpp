@@ -257,7 +257,7 @@ void AnimationSource::OnActivate(bool active) {
 			AnimStateEventData d;
 			d.ska = ska;
 			d.anim = m_anim;
-			m_notify->EmitFinish(d, true);
+			Notify::PostFinish(m_notify, d, true);
 		}
 	}
 }
@@ -363,7 +363,7 @@ bool AnimationSource::Tick(
 			AnimStateEventData d;
 			d.ska = ska;
 			d.anim = m_anim;
-			m_notify->EmitEndFrame(d);
+			Notify::PostEndFrame(m_notify, d);
 			m_emitEndFrame = false; // done
 		}
 	}
@@ -530,7 +530,7 @@ void BlendToController::OnActivate(bool active) {
 		AnimStateEventData d;
 		d.ska = ska;
 		d.anim = 0;
-		m_notify->EmitFinish(d, true);
+		Notify::PostFinish(m_notify, d, true);
 	}
 }
 
@@ -989,7 +989,7 @@ void AnimationVariantsSource::ChooseAnim() {
 				d.ska = ska;
 				d.vtm = vtm;
 				d.anim = m_source->animation;
-				m_notify->EmitEndFrame(d);
+				Notify::PostEndFrame(m_notify, d);
 			}
 		}
 		return;
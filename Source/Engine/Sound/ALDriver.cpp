@@ -5,8 +5,10 @@
 
 #include RADPCH
 #include "ALDriver.h"
+#include "SoftMixer.h"
 #include "../COut.h"
 #include <Runtime/StringBase.h>
+#include <Runtime/Time.h>
 
 #if defined(RAD_OPT_OSX)
 #define alSpeedOfSound alDopplerVelocity
@@ -122,17 +124,33 @@ ALDriver::Ref ALDriver::New(ALDRIVER_PARAMS const char *deviceName) {
 }
 
 ALDriver::ALDriver() : 
-m_head(0), m_tail(0), m_quit(false), m_suspended(false), m_alc(0), m_ald(0), m_enabled(true, false) {
+m_ringRead(0),
+m_ringWrite(0),
+m_ringQueued(0),
+m_frame(1),
+m_frameDepth(0),
+m_frameCommands(0),
+m_frameCoalesced(0),
+m_frameDropped(0),
+m_enabled(true, false),
+m_head(0), m_tail(0), m_ald(0), m_alc(0), m_mixer(0), m_quit(false), m_suspended(false), m_disabled(false) {
 	m_cmdPool.Create(ZSound, "alDriverCmds", 64);
+	m_ring = new (ZSound) Command[kRingSize];
+	m_ringTimes = (xtime::TimeVal*)safe_zone_malloc(ZSound, kRingSize*sizeof(xtime::TimeVal));
+	memset(m_coalesce, 0, sizeof(m_coalesce));
+	memset(&m_counters, 0, sizeof(m_counters));
 }
 
 ALDriver::~ALDriver() {
 	m_quit = true;
 	Wake();
 	Join();
+	delete [] m_ring;
+	zone_free(m_ringTimes);
 }
 
 void ALDriver::Enable(bool enabled) {
+	m_disabled = !enabled;
 	if (enabled) {
 		m_enabled.Open();
 	} else {
@@ -140,6 +158,111 @@ void ALDriver::Enable(bool enabled) {
 	}
 }
 
+void ALDriver::BeginFrame() {
+	if (m_frameDepth++ == 0)
+		m_producer = thread::ThreadId();
+}
+
+void ALDriver::EndFrame() {
+	RAD_ASSERT(m_frameDepth > 0);
+	if (--m_frameDepth == 0) {
+		m_counters.numCommands = m_frameCommands;
+		m_counters.numCoalesced = m_frameCoalesced;
+		m_counters.numDropped = m_frameDropped;
+		m_frameCommands = 0;
+		m_frameCoalesced = 0;
+		m_frameDropped = 0;
+		Publish();
+	}
+}
+
+ALDriver::Command *ALDriver::Queue(Command::FN fn, ALuint handle, ALenum param, bool coalesce) {
+	RAD_ASSERT(!m_frameDepth || (m_producer == thread::ThreadId()));
+
+	CoalesceSlot *slot = 0;
+
+	if (coalesce && m_frameDepth) {
+		U32 hash = (U32)handle * 2654435761u;
+		hash ^= (U32)param * 40503u;
+
+		for (int i = 0; i < kCoalesceProbes; ++i) {
+			CoalesceSlot &x = m_coalesce[(hash+i)&kCoalesceMask];
+			if (x.frame != m_frame) {
+				if (!slot)
+					slot = &x; // free
+				continue;
+			}
+			if ((x.fn == fn) && (x.handle == handle) && (x.param == param)) {
+				++m_frameCoalesced;
+				return &m_ring[x.index&kRingMask];
+			}
+		}
+	}
+
+	if (m_ringQueued - m_ringRead >= kRingSize) {
+		// ring is full, let the driver thread catch up.
+		Publish();
+		while (m_ringQueued - m_ringRead >= kRingSize) {
+			if (m_disabled) {
+				// a disabled driver doesn't drain the ring.
+				++m_frameDropped;
+				m_discard.m_fn = fn;
+				m_discard.handle = handle;
+				m_discard.param = param;
+				return &m_discard;
+			}
+			thread::Sleep(1);
+		}
+		slot = 0; // Publish() cleared the frame.
+	}
+
+	if (slot) {
+		slot->fn = fn;
+		slot->handle = handle;
+		slot->param = param;
+		slot->frame = m_frame;
+		slot->index = m_ringQueued;
+	} else if (!coalesce) {
+		// property writes queued before this command can't be moved after it.
+		++m_frame;
+	}
+
+	++m_frameCommands;
+
+	Command *c = &m_ring[m_ringQueued&kRingMask];
+	++m_ringQueued;
+
+	c->m_fn = fn;
+	c->handle = handle;
+	c->param = param;
+	return c;
+}
+
+void ALDriver::Commit() {
+	if (!m_frameDepth)
+		Publish();
+}
+
+void ALDriver::Publish() {
+	const U32 kWrite = m_ringWrite;
+	if (kWrite == m_ringQueued)
+		return;
+
+	const xtime::TimeVal kNow = xtime::ReadMicroseconds();
+	for (U32 i = kWrite; i != m_ringQueued; ++i)
+		m_ringTimes[i&kRingMask] = kNow;
+
+	++m_frame; // published commands can't be coalesced.
+	m_ringWrite = m_ringQueued;
+	Wake();
+}
+
+void ALDriver::PublishSync() {
+	// a Sync command must see every command this thread issued before it.
+	if (m_frameDepth && (m_producer == thread::ThreadId()))
+		Publish();
+}
+
 int ALDriver::ThreadProc() {
 
 	while (!m_quit) {
@@ -153,11 +276,19 @@ int ALDriver::ThreadProc() {
 			m_tail = 0;
 		}
 
+		// The ring is read after taking the list: a thread publishes its ring commands
+		// before submitting a Sync command so they execute first.
+		ExecRing(m_ringWrite);
 		Exec(head);
+		if (m_mixer)
+			m_mixer->Update();
 		DoCallbacks();
 		m_enabled.Wait();
 	}
 
+	delete m_mixer;
+	m_mixer = 0;
+
 	alcMakeContextCurrent(0);
 
 	if (m_alc)
@@ -176,6 +307,31 @@ void ALDriver::Exec(Command *head) {
 	}
 }
 
+void ALDriver::ExecRing(U32 end) {
+	U32 read = m_ringRead;
+	if (read == end)
+		return;
+
+	const xtime::TimeVal kNow = xtime::ReadMicroseconds();
+	xtime::TimeVal total = 0;
+	xtime::TimeVal worst = 0;
+	const int kNumCommands = (int)(end - read);
+
+	for (; read != end; ++read) {
+		Command &c = m_ring[read&kRingMask];
+		const xtime::TimeVal kWait = kNow - m_ringTimes[read&kRingMask];
+		total += kWait;
+		worst = std::max(worst, kWait);
+		c.m_fn(*this, &c);
+	}
+
+	m_ringRead = end;
+
+	m_counters.numExecuted = kNumCommands;
+	m_counters.avgLatency = (total / (float)kNumCommands) / 1000.f;
+	m_counters.maxLatency = worst / 1000.f;
+}
+
 void ALDriver::DoCallbacks() {
 	Lock L(m_mcb);
 
@@ -225,52 +381,49 @@ void ALDriver::SyncFlush(ALDRIVER_VOID_PARAMS) {
 }
 
 void ALDriver::DopplerFactor(ALDRIVER_PARAMS ALfloat factor) {
-	Command *c = CreateCommand(&fn_DopplerFactor);
+	Command *c = Queue(&fn_DopplerFactor);
 	ALDRIVER_CMD_SIG(*c);
 	c->args.fval = factor;
-	Submit(*c);
+	Commit();
 }
 
 void ALDriver::SpeedOfSound(ALDRIVER_PARAMS ALfloat speed) {
-	Command *c = CreateCommand(&fn_SpeedOfSound);
+	Command *c = Queue(&fn_SpeedOfSound);
 	ALDRIVER_CMD_SIG(*c);
 	c->args.fval = speed;
-	Submit(*c);
+	Commit();
 }
 
 void ALDriver::DistanceModel(ALDRIVER_PARAMS ALenum value) {
-	Command *c = CreateCommand(&fn_DistanceModel);
+	Command *c = Queue(&fn_DistanceModel);
 	ALDRIVER_CMD_SIG(*c);
 	c->param = value;
-	Submit(*c);
+	Commit();
 }
 
 void ALDriver::Listenerfv(ALDRIVER_PARAMS ALenum param, ALfloat *values) {
 	RAD_ASSERT(param == AL_ORIENTATION);
-	Command *c = CreateCommand(&fn_Listenerfv);
+	Command *c = Queue(&fn_Listenerfv, 0, param, true);
 	ALDRIVER_CMD_SIG(*c);
-	c->param = param;
 	for (int i = 0; i < 6; ++i)
 		c->args.fvvals[i] = values[i];
-	Submit(*c);
+	Commit();
 }
 
 void ALDriver::Listenerf(ALDRIVER_PARAMS ALenum param, ALfloat value) {
-	Command *c = CreateCommand(&fn_Listenerf);
+	Command *c = Queue(&fn_Listenerf, 0, param, true);
 	ALDRIVER_CMD_SIG(*c);
-	c->param = param;
 	c->args.fval = value;
-	Submit(*c);
+	Commit();
 }
 
 void ALDriver::Listener3f(ALDRIVER_PARAMS ALenum param, ALfloat x, ALfloat y, ALfloat z) {
-	Command *c = CreateCommand(&fn_Listener3f);
+	Command *c = Queue(&fn_Listener3f, 0, param, true);
 	ALDRIVER_CMD_SIG(*c);
-	c->param = param;
 	c->args.fvvals[0] = x;
 	c->args.fvvals[1] = y;
 	c->args.fvvals[2] = z;
-	Submit(*c);
+	Commit();
 }
 
 bool ALDriver::SyncGenBuffers(ALDRIVER_PARAMS ALsizei n, ALuint *buffers) {
@@ -332,60 +485,97 @@ void ALDriver::SyncDeleteSources(ALDRIVER_PARAMS ALsizei n, ALuint *sources) {
 }
 
 void ALDriver::SourcePlay(ALDRIVER_PARAMS ALuint source) {
-	Command *c = CreateCommand(&fn_SourcePlay);
+	Command *c = Queue(&fn_SourcePlay);
 	ALDRIVER_CMD_SIG(*c);
 	c->handle = source;
-	Submit(*c);
+	Commit();
 }
 
 void ALDriver::SourcePause(ALDRIVER_PARAMS ALuint source) {
-	Command *c = CreateCommand(&fn_SourcePause);
+	Command *c = Queue(&fn_SourcePause);
 	ALDRIVER_CMD_SIG(*c);
 	c->handle = source;
-	Submit(*c);
+	Commit();
 }
 
 void ALDriver::SourceStop(ALDRIVER_PARAMS ALuint source) {
-	Command *c = CreateCommand(&fn_SourceStop);
+	Command *c = Queue(&fn_SourceStop);
 	ALDRIVER_CMD_SIG(*c);
 	c->handle = source;
-	Submit(*c);
+	Commit();
 }
 
 void ALDriver::Sourcei(ALDRIVER_PARAMS ALuint source, ALenum param, ALint value) {
-	Command *c = CreateCommand(&fn_Sourcei);
+	Command *c = Queue(&fn_Sourcei, source, param);
 	ALDRIVER_CMD_SIG(*c);
-	c->handle = source;
-	c->param = param;
 	c->args.ival = value;
-	Submit(*c);
+	Commit();
 }
 
 void ALDriver::Sourcef(ALDRIVER_PARAMS ALuint source, ALenum param, ALfloat value) {
-	Command *c = CreateCommand(&fn_Sourcef);
+	Command *c = Queue(&fn_Sourcef, source, param, true);
 	ALDRIVER_CMD_SIG(*c);
-	c->handle = source;
-	c->param = param;
 	c->args.fval = value;
-	Submit(*c);
+	Commit();
 }
 
 void ALDriver::Source3f(ALDRIVER_PARAMS ALuint source, ALenum param, ALfloat x, ALfloat y, ALfloat z) {
-	Command *c = CreateCommand(&fn_Source3f);
+	Command *c = Queue(&fn_Source3f, source, param, true);
 	ALDRIVER_CMD_SIG(*c);
-	c->handle = source;
-	c->param = param;
 	c->args.fvvals[0] = x;
 	c->args.fvvals[1] = y;
 	c->args.fvvals[2] = z;
-	Submit(*c);
+	Commit();
 }
 
 void ALDriver::SourceRewind(ALDRIVER_PARAMS ALuint source) {
-	Command *c = CreateCommand(&fn_SourceRewind);
+	Command *c = Queue(&fn_SourceRewind);
 	ALDRIVER_CMD_SIG(*c);
 	c->handle = source;
-	Submit(*c);
+	Commit();
+}
+
+void ALDriver::ExecSourcePlay(ALuint source) {
+	if (m_alc)
+		alSourcePlay(source);
+	else if (m_mixer)
+		m_mixer->SourcePlay(source);
+}
+
+void ALDriver::ExecSourceStop(ALuint source) {
+	if (m_alc)
+		alSourceStop(source);
+	else if (m_mixer)
+		m_mixer->SourceStop(source);
+}
+
+void ALDriver::ExecGetSourcei(ALuint source, ALenum param, ALint *value) {
+	*value = 0;
+	if (m_alc)
+		alGetSourcei(source, param, value);
+	else if (m_mixer)
+		m_mixer->GetSourcei(source, param, value);
+}
+
+void ALDriver::ExecSourceQueueBuffers(ALuint source, ALsizei n, const ALuint *buffers) {
+	if (m_alc)
+		alSourceQueueBuffers(source, n, buffers);
+	else if (m_mixer)
+		m_mixer->SourceQueueBuffers(source, n, buffers);
+}
+
+void ALDriver::ExecSourceUnqueueBuffers(ALuint source, ALsizei n, ALuint *buffers) {
+	if (m_alc)
+		alSourceUnqueueBuffers(source, n, buffers);
+	else if (m_mixer)
+		m_mixer->SourceUnqueueBuffers(source, n, buffers);
+}
+
+void ALDriver::ExecBufferData(ALuint buffer, ALenum format, const ALvoid *data, ALsizei size, ALsizei freq) {
+	if (m_alc)
+		alBufferData(buffer, format, data, size, freq);
+	else if (m_mixer)
+		m_mixer->BufferData(buffer, format, data, size, freq);
 }
 
 ALDriver::Command *ALDriver::CreateCommand(Command::FN fn) {
@@ -397,6 +587,8 @@ void ALDriver::DestroyCommand(Command *cmd) {
 }
 
 void ALDriver::Submit(Command &command) {
+	PublishSync();
+
 	{
 		Lock L(m_m);
 		
@@ -412,9 +604,34 @@ void ALDriver::Submit(Command &command) {
 	Wake();
 }
 
+void ALDriver::Post(Command &command) {
+	Command *c = Queue(&fn_Post);
+	if (c == &m_discard) {
+		// the command must still execute, it releases itself.
+		Submit(command);
+		return;
+	}
+	c->args.pvoid = &command;
+	Commit();
+}
+
 void ALDriver::fn_Create(ALDriver &driver, Command *cmd) {
 
-	if (!cmd->args.pvoid || string::cmp((const char*)cmd->args.pvoid, "null")) {
+	const char *deviceName = (const char*)cmd->args.pvoid;
+
+	if (deviceName && !string::cmp(deviceName, "software")) {
+		driver.m_mixer = new (ZSound) SoftMixer(new (ZSound) SoftMixer::NullSink());
+		cmd->args.ival = 1;
+	} else if (deviceName && !string::ncmp(deviceName, "wav:", 4)) {
+		SoftMixer::WavSink *sink = new (ZSound) SoftMixer::WavSink(deviceName+4, SoftMixer::kDefaultRate);
+		if (sink->IsOpen()) {
+			driver.m_mixer = new (ZSound) SoftMixer(sink);
+			cmd->args.ival = 1;
+		} else {
+			delete sink;
+			cmd->args.ival = 0;
+		}
+	} else if (!deviceName || string::cmp(deviceName, "null")) {
 		driver.m_ald = alcOpenDevice((const char*)cmd->args.pvoid);
 		if (driver.m_ald) {
 			driver.m_alc = alcCreateContext(driver.m_ald, 0);
@@ -453,42 +670,44 @@ void ALDriver::fn_DopplerFactor(ALDriver &driver, Command *cmd) {
 	if (driver.m_alc)
 		alDopplerFactor(cmd->args.fval);
 	CHECK_AL_ERRORS(*cmd);
-	driver.DestroyCommand(cmd);
 }
 
 void ALDriver::fn_SpeedOfSound(ALDriver &driver, Command *cmd) {
 	if (driver.m_alc)
 		alSpeedOfSound(cmd->args.fval);
 	CHECK_AL_ERRORS(*cmd);
-	driver.DestroyCommand(cmd);
 }
 
 void ALDriver::fn_DistanceModel(ALDriver &driver, Command *cmd) {
 	if (driver.m_alc)
 		alDistanceModel(cmd->param);
+	else if (driver.m_mixer)
+		driver.m_mixer->DistanceModel(cmd->param);
 	CHECK_AL_ERRORS(*cmd);
-	driver.DestroyCommand(cmd);
 }
 
 void ALDriver::fn_Listenerfv(ALDriver &driver, Command *cmd) {
 	if (driver.m_alc)
 		alListenerfv(cmd->param, cmd->args.fvvals);
+	else if (driver.m_mixer)
+		driver.m_mixer->Listenerfv(cmd->param, cmd->args.fvvals);
 	CHECK_AL_ERRORS(*cmd);
-	driver.DestroyCommand(cmd);
 }
 
 void ALDriver::fn_Listenerf(ALDriver &driver, Command *cmd) {
 	if (driver.m_alc)
 		alListenerf(cmd->param, cmd->args.fval);
+	else if (driver.m_mixer)
+		driver.m_mixer->Listenerf(cmd->param, cmd->args.fval);
 	CHECK_AL_ERRORS(*cmd);
-	driver.DestroyCommand(cmd);
 }
 
 void ALDriver::fn_Listener3f(ALDriver &driver, Command *cmd) {
 	if (driver.m_alc)
 		alListener3f(cmd->param, cmd->args.fvvals[0], cmd->args.fvvals[1], cmd->args.fvvals[2]);
+	else if (driver.m_mixer)
+		driver.m_mixer->Listener3f(cmd->param, cmd->args.fvvals[0], cmd->args.fvvals[1], cmd->args.fvvals[2]);
 	CHECK_AL_ERRORS(*cmd);
-	driver.DestroyCommand(cmd);
 }
 
 void ALDriver::fn_GenBuffers(ALDriver &driver, Command *cmd) {
@@ -500,6 +719,8 @@ void ALDriver::fn_GenBuffers(ALDriver &driver, Command *cmd) {
 			memset(gc->args.puint, 0, gc->num*sizeof(ALuint));
 			gc->args.puint = 0; // flag error.
 		}
+	} else if (driver.m_mixer) {
+		driver.m_mixer->GenBuffers(gc->num, gc->args.puint);
 	} else {
 		memset(gc->args.puint, 1, gc->num*sizeof(ALuint));
 	}
@@ -510,6 +731,8 @@ void ALDriver::fn_DeleteBuffers(ALDriver &driver, Command *cmd) {
 	GenCommand *gc = static_cast<GenCommand*>(cmd);
 	if (driver.m_alc)
 		alDeleteBuffers(gc->num, gc->args.puint);
+	else if (driver.m_mixer)
+		driver.m_mixer->DeleteBuffers(gc->num, gc->args.puint);
 	CHECK_AL_ERRORS(*cmd);
 }
 
@@ -521,6 +744,9 @@ void ALDriver::fn_BufferData(ALDriver &driver, Command *cmd) {
 		if (alGetError() != AL_NO_ERROR) {
 			bdc->args.pvoid = 0; // flag error.
 		}
+	} else if (driver.m_mixer) {
+		if (!driver.m_mixer->BufferData(bdc->handle, bdc->format, bdc->args.pvoid, bdc->size, bdc->freq))
+			bdc->args.pvoid = 0; // flag error.
 	}
 	CLEAR_AL_ERRORS();
 }
@@ -534,6 +760,8 @@ void ALDriver::fn_GenSources(ALDriver &driver, Command *cmd) {
 			memset(gc->args.puint, 0, gc->num*sizeof(ALuint));
 			gc->args.puint = 0; // flag error.
 		}
+	} else if (driver.m_mixer) {
+		driver.m_mixer->GenSources(gc->num, gc->args.puint);
 	} else {
 		memset(gc->args.puint, 1, gc->num*sizeof(ALuint));
 	}
@@ -544,54 +772,68 @@ void ALDriver::fn_DeleteSources(ALDriver &driver, Command *cmd) {
 	GenCommand *gc = static_cast<GenCommand*>(cmd);
 	if (driver.m_alc)
 		alDeleteSources(gc->num, gc->args.puint);
+	else if (driver.m_mixer)
+		driver.m_mixer->DeleteSources(gc->num, gc->args.puint);
 	CHECK_AL_ERRORS(*cmd);
 }
 
 void ALDriver::fn_SourcePlay(ALDriver &driver, Command *cmd) {
 	if (driver.m_alc)
 		alSourcePlay(cmd->handle);
+	else if (driver.m_mixer)
+		driver.m_mixer->SourcePlay(cmd->handle);
 	CHECK_AL_ERRORS(*cmd);
-	driver.DestroyCommand(cmd);
 }
 
 void ALDriver::fn_SourcePause(ALDriver &driver, Command *cmd) {
 	if (driver.m_alc)
 		alSourcePause(cmd->handle);
+	else if (driver.m_mixer)
+		driver.m_mixer->SourcePause(cmd->handle);
 	CHECK_AL_ERRORS(*cmd);
-	driver.DestroyCommand(cmd);
 }
 
 void ALDriver::fn_SourceStop(ALDriver &driver, Command *cmd) {
 	if (driver.m_alc)
 		alSourceStop(cmd->handle);
+	else if (driver.m_mixer)
+		driver.m_mixer->SourceStop(cmd->handle);
 	CHECK_AL_ERRORS(*cmd);
-	driver.DestroyCommand(cmd);
 }
 
 void ALDriver::fn_Sourcei(ALDriver &driver, Command *cmd) {
 	if (driver.m_alc)
 		alSourcei(cmd->handle, cmd->param, cmd->args.ival);
+	else if (driver.m_mixer)
+		driver.m_mixer->Sourcei(cmd->handle, cmd->param, cmd->args.ival);
 	CHECK_AL_ERRORS(*cmd);
-	driver.DestroyCommand(cmd);
 }
 
 void ALDriver::fn_Sourcef(ALDriver &driver, Command *cmd) {
 	if (driver.m_alc)
 		alSourcef(cmd->handle, cmd->param, cmd->args.fval);
+	else if (driver.m_mixer)
+		driver.m_mixer->Sourcef(cmd->handle, cmd->param, cmd->args.fval);
 	CHECK_AL_ERRORS(*cmd);
-	driver.DestroyCommand(cmd);
 }
 
 void ALDriver::fn_Source3f(ALDriver &driver, Command *cmd) {
 	if (driver.m_alc)
 		alSource3f(cmd->handle, cmd->param, cmd->args.fvvals[0], cmd->args.fvvals[1], cmd->args.fvvals[2]);
+	else if (driver.m_mixer)
+		driver.m_mixer->Source3f(cmd->handle, cmd->param, cmd->args.fvvals[0], cmd->args.fvvals[1], cmd->args.fvvals[2]);
 	CHECK_AL_ERRORS(*cmd);
-	driver.DestroyCommand(cmd);
 }
 
 void ALDriver::fn_SourceRewind(ALDriver &driver, Command *cmd) {
 	if (driver.m_alc)
 		alSourceRewind(cmd->handle);
+	else if (driver.m_mixer)
+		driver.m_mixer->SourceRewind(cmd->handle);
 	CHECK_AL_ERRORS(*cmd);
-	driver.DestroyCommand(cmd);
+}
+
+void ALDriver::fn_Post(ALDriver &driver, Command *cmd) {
+	Command *posted = reinterpret_cast<Command*>(cmd->args.pvoid);
+	posted->m_fn(driver, posted);
 }
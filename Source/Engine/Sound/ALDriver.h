@@ -8,11 +8,15 @@
 #include "ALDriverDef.h"
 #include <Runtime/Thread.h>
 #include <Runtime/Thread/Locks.h>
+#include <Runtime/Thread/Interlocked.h>
+#include <Runtime/TimeDef.h>
 #include <Runtime/Base/ObjectPool.h>
 #include <Runtime/Container/ZoneSet.h>
 #include <OpenAL/al.h>
 #include <OpenAL/alc.h>
 
+class SoftMixer;
+
 #if defined(RAD_OPT_ALERRORS)
 
 #define ALDRIVER_SIG __FILE__, __LINE__,
@@ -56,6 +60,10 @@ bool CheckALErrors(const char *file, int line);
 	streaming. Streaming sounds must be decoded and queued on a seperate thread forcing
 	all calls into OpenAL to be synchronized. The ALDriver is an AL command stream that
 	runs on its own thread where all AL commands are submitted and music streaming occurs.
+
+	Commands that don't return a result are written into a fixed size single producer
+	ring and must all be issued from one thread (the thread that ticks the SoundContext).
+	Sync* commands and Submit() may be called from any thread.
 */
 class ALDriver : protected thread::Thread {
 public:
@@ -70,8 +78,8 @@ public:
 		\note Callback objects are automatically removed from the alDriver object when
 		their last shared_ptr is destroyed. 
 
-		A null device can be bound. Check the context to see if it is non-null before
-		calling OpenAL functions.
+		A null device or the software mixer can be bound. Check the context to see if it
+		is non-null before calling OpenAL functions, or use the Exec* methods.
 	*/
 	class Callback {
 	public:
@@ -97,11 +105,38 @@ public:
 	~ALDriver();
 
 	//! Creates an alDriver object.
+	/*! deviceName is passed to alcOpenDevice() except for these names:
+		- "null" binds no device.
+		- "software" mixes in software and discards the output.
+		- "wav:<path>" mixes in software and writes the output to a .wav file.
+	*/
 	static Ref New(ALDRIVER_PARAMS const char *deviceName);
 
+	//! Command stream counters.
+	/*! Written as the stream runs without locking, values may be a frame apart. */
+	struct Counters {
+		int numCommands; //!< Commands published by the last frame.
+		int numCoalesced; //!< Property writes folded into an earlier write by the last frame.
+		int numDropped; //!< Commands dropped by the last frame, the ring was full while the driver was disabled.
+		int numExecuted; //!< Ring commands executed by the last pass of the driver thread.
+		float avgLatency; //!< Average milliseconds those commands waited after being published.
+		float maxLatency; //!< Longest wait in milliseconds.
+	};
+
 	//! Enables/Disables the alDriver (shuts off calls to al* function).
+	/*! Commands are held while the driver is disabled, commands that don't fit in the
+		ring are dropped. */
 	void Enable(bool enable = true);
 
+	//! Opens a command frame.
+	/*! Commands issued inside a frame are held until EndFrame() and handed to the driver
+		thread together. Repeated Sourcef/Source3f/Listener writes of the same property
+		inside a frame overwrite the queued value instead of adding a command, unless
+		any other command was queued between them. Frames may be nested. */
+	void BeginFrame();
+	//! Closes a command frame, publishing the queued commands.
+	void EndFrame();
+
 	//! Adds a processing callback.
 	void AddCallback(Callback &callback);
 	
@@ -159,9 +194,23 @@ public:
 	//! alSourceRewind
 	void SourceRewind(ALDRIVER_PARAMS ALuint source);
 
+	//! alSourcePlay, executed immediately. Must be called from the driver thread.
+	void ExecSourcePlay(ALuint source);
+	//! alSourceStop, executed immediately. Must be called from the driver thread.
+	void ExecSourceStop(ALuint source);
+	//! alGetSourcei, executed immediately. Must be called from the driver thread.
+	void ExecGetSourcei(ALuint source, ALenum param, ALint *value);
+	//! alSourceQueueBuffers, executed immediately. Must be called from the driver thread.
+	void ExecSourceQueueBuffers(ALuint source, ALsizei n, const ALuint *buffers);
+	//! alSourceUnqueueBuffers, executed immediately. Must be called from the driver thread.
+	void ExecSourceUnqueueBuffers(ALuint source, ALsizei n, ALuint *buffers);
+	//! alBufferData, executed immediately. Must be called from the driver thread.
+	void ExecBufferData(ALuint buffer, ALenum format, const ALvoid *data, ALsizei size, ALsizei freq);
+
 	//! Command class.
 	/*! Driver commands are executed on the OpenAL thread. They should call OpenAL API methods
-		directly. You can write custom commands to insert into the command stream.
+		directly, or the Exec* methods which also work with the software mixer. You can write
+		custom commands to insert into the command stream.
 
 		\note A null device can be bound. Check the context to see if it is non-null before
 		calling OpenAL functions.
@@ -192,6 +241,8 @@ public:
 
 		friend class ALDriver;
 
+		Command() : m_fn(0) {}
+
 		Command *m_next;
 		FN m_fn;
 	};
@@ -204,12 +255,20 @@ public:
 	//! Submits a command. The command is responsible for releasing itself after execution.
 	void Submit(Command &command);
 
+	//! Submits a command in order with the property commands.
+	/*! Like Submit() but must be called from the thread issuing property commands, the command
+		executes after every property command issued before it. */
+	void Post(Command &command);
+
 	//! Wakes the driver to do processing.
 	void Wake();
 
 	RAD_DECLARE_READONLY_PROPERTY(ALDriver, device, ALCdevice*);
 	RAD_DECLARE_READONLY_PROPERTY(ALDriver, context, ALCcontext*);
 	RAD_DECLARE_READONLY_PROPERTY(ALDriver, suspended, bool);
+	RAD_DECLARE_READONLY_PROPERTY(ALDriver, counters, const Counters*);
+	//! The software mixer, null unless one was requested from New().
+	RAD_DECLARE_READONLY_PROPERTY(ALDriver, mixer, SoftMixer*);
 
 private:
 
@@ -245,14 +304,60 @@ private:
 		ALsizei freq;
 	};
 
+	enum {
+		kRingSize = 4096, // power of 2
+		kRingMask = kRingSize-1,
+		kCoalesceSize = 512, // power of 2
+		kCoalesceMask = kCoalesceSize-1,
+		kCoalesceProbes = 8
+	};
+
+	//! Last queued write of a property in the open frame.
+	/*! Slots are valid while frame matches m_frame, which is advanced by publishing and by
+		every command that isn't a property write. */
+	struct CoalesceSlot {
+		Command::FN fn;
+		ALuint handle;
+		ALenum param;
+		U32 frame;
+		U32 index;
+	};
+
 	ALDriver();
 	void RemoveCallback(Callback &callback);
 	void Exec(Command *head);
+	void ExecRing(U32 end);
 	void DoCallbacks();
 
+	//! Reserves the next ring command, or returns the queued write of the same property.
+	Command *Queue(Command::FN fn, ALuint handle = 0, ALenum param = 0, bool coalesce = false);
+	//! Publishes the queued commands unless a frame is open.
+	void Commit();
+	void Publish();
+	void PublishSync();
+
 	RAD_DECLARE_GET(device, ALCdevice*) { return m_ald; }
 	RAD_DECLARE_GET(context, ALCcontext*) { return m_alc; }
 	RAD_DECLARE_GET(suspended, bool) { return m_suspended; }
+	RAD_DECLARE_GET(counters, const Counters*) { return &m_counters; }
+	RAD_DECLARE_GET(mixer, SoftMixer*) { return m_mixer; }
+
+	// ring commands, [m_ringRead, m_ringWrite) is owned by the driver thread,
+	// [m_ringWrite, m_ringQueued) is the open frame.
+	Command *m_ring;
+	xtime::TimeVal *m_ringTimes;
+	thread::Interlocked<U32> m_ringRead;
+	thread::Interlocked<U32> m_ringWrite;
+	U32 m_ringQueued;
+	U32 m_frame;
+	int m_frameDepth;
+	int m_frameCommands;
+	int m_frameCoalesced;
+	int m_frameDropped;
+	thread::Id m_producer;
+	CoalesceSlot m_coalesce[kCoalesceSize];
+	Counters m_counters;
+	Command m_discard; // returned by Queue() when the ring is full while disabled.
 
 	CommandPool m_cmdPool;
 	CallbackSet m_callbacks;
@@ -263,8 +368,10 @@ private:
 	Command *m_tail;
 	ALCdevice *m_ald;
 	ALCcontext *m_alc;
+	SoftMixer *m_mixer;
 	bool m_quit;
 	bool m_suspended;
+	volatile bool m_disabled;
 
 	static void fn_Create(ALDriver &driver, Command *cmd);
 	static void fn_Process(ALDriver &driver, Command *cmd);
@@ -288,4 +395,5 @@ private:
 	static void fn_Sourcef(ALDriver &driver, Command *cmd);
 	static void fn_Source3f(ALDriver &driver, Command *cmd);
 	static void fn_SourceRewind(ALDriver &driver, Command *cmd);
+	static void fn_Post(ALDriver &driver, Command *cmd);
 };
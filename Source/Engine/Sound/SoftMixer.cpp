@@ -0,0 +1,716 @@
+/*! \file SoftMixer.cpp
+	\copyright Copyright (c) 2013 Sunside Inc., All Rights Reserved.
+	\copyright See Radiance/LICENSE for licensing terms.
+	\author Joe Riedel
+	\ingroup sound
+*/
+
+#include RADPCH
+#include "SoftMixer.h"
+#include <Runtime/Base/SIMD.h>
+#include <Runtime/Time.h>
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+namespace {
+
+const float kVirtualGain = 0.001f; // -60db
+const float kPi = 3.14159265358979323846f;
+
+inline float Dot(const float *a, const float *b) {
+	return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+inline void Cross(float *out, const float *a, const float *b) {
+	out[0] = a[1]*b[2] - a[2]*b[1];
+	out[1] = a[2]*b[0] - a[0]*b[2];
+	out[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+inline float Clamp(float x, float a, float b) {
+	return (x < a) ? a : ((x > b) ? b : x);
+}
+
+struct LouderVoice {
+	template <typename T>
+	bool operator () (const T *a, const T *b) const {
+		return a->loudness > b->loudness;
+	}
+};
+
+void PutU16(U8 *dst, U16 x) {
+	dst[0] = (U8)(x&0xff);
+	dst[1] = (U8)(x>>8);
+}
+
+void PutU32(U8 *dst, U32 x) {
+	PutU16(dst, (U16)(x&0xffff));
+	PutU16(dst+2, (U16)(x>>16));
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+SoftMixer::WavSink::WavSink(const char *path, int rate) : m_rate(rate), m_numBytes(0) {
+	m_fp = fopen(path, "wb");
+	if (m_fp)
+		WriteHeader();
+}
+
+SoftMixer::WavSink::~WavSink() {
+	if (m_fp) {
+		fseek(m_fp, 0, SEEK_SET);
+		WriteHeader();
+		fclose(m_fp);
+	}
+}
+
+void SoftMixer::WavSink::Write(const S16 *frames, int numFrames) {
+	if (!m_fp)
+		return;
+
+	U8 buf[1024];
+	const S16 *end = frames + numFrames*2;
+
+	while (frames < end) {
+		int n = 0;
+		for (; (n < 1024) && (frames < end); n += 2, ++frames)
+			PutU16(buf+n, (U16)*frames);
+		fwrite(buf, 1, n, m_fp);
+		m_numBytes += (U32)n;
+	}
+}
+
+void SoftMixer::WavSink::WriteHeader() {
+	U8 h[44];
+	memcpy(h, "RIFF", 4);
+	PutU32(h+4, 36 + m_numBytes);
+	memcpy(h+8, "WAVEfmt ", 8);
+	PutU32(h+16, 16);
+	PutU16(h+20, 1); // PCM
+	PutU16(h+22, 2);
+	PutU32(h+24, (U32)m_rate);
+	PutU32(h+28, (U32)m_rate*4);
+	PutU16(h+32, 4);
+	PutU16(h+34, 16);
+	memcpy(h+36, "data", 4);
+	PutU32(h+40, m_numBytes);
+	fwrite(h, 1, sizeof(h), m_fp);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+SoftMixer::Voice::Voice() :
+current(0),
+pos(0),
+state(AL_INITIAL),
+looping(false),
+relative(false),
+gain(1.f),
+minGain(0.f),
+maxGain(1.f),
+pitch(1.f),
+refDistance(1.f),
+maxDistance(std::numeric_limits<float>::max()),
+rolloff(1.f),
+coneInner(360.f),
+coneOuter(360.f),
+coneOuterGain(0.f),
+loudness(0.f) {
+	pos3[0] = pos3[1] = pos3[2] = 0.f;
+	dir3[0] = dir3[1] = dir3[2] = 0.f;
+	mixGains[0] = mixGains[1] = 0.f;
+}
+
+SoftMixer::SoftMixer(Sink *sink, int rate, int maxMixedVoices) :
+m_sink(sink),
+m_distanceModel(AL_INVERSE_DISTANCE_CLAMPED),
+m_listenerGain(1.f),
+m_rate(rate),
+m_maxMixedVoices(maxMixedVoices),
+m_lastUpdate(0),
+m_updateRemainder(0) {
+	memset(&m_counters, 0, sizeof(m_counters));
+	m_listenerPos[0] = m_listenerPos[1] = m_listenerPos[2] = 0.f;
+	m_listenerAt[0] = m_listenerAt[1] = 0.f;
+	m_listenerAt[2] = -1.f;
+	m_listenerUp[0] = m_listenerUp[2] = 0.f;
+	m_listenerUp[1] = 1.f;
+}
+
+SoftMixer::~SoftMixer() {
+	for (BufferVec::iterator it = m_buffers.begin(); it != m_buffers.end(); ++it)
+		delete *it;
+	for (VoiceVec::iterator it = m_voices.begin(); it != m_voices.end(); ++it)
+		delete *it;
+	delete m_sink;
+}
+
+void SoftMixer::GenBuffers(ALsizei n, ALuint *buffers) {
+	for (ALsizei i = 0; i < n; ++i) {
+		Buffer *b = new (ZSound) Buffer();
+		b->channels = 1;
+		b->rate = m_rate;
+		b->numFrames = 0;
+
+		// ids are slot+1, reuse free slots.
+		BufferVec::iterator it = std::find(m_buffers.begin(), m_buffers.end(), (Buffer*)0);
+		if (it != m_buffers.end()) {
+			*it = b;
+		} else {
+			it = m_buffers.insert(m_buffers.end(), b);
+		}
+
+		buffers[i] = (ALuint)(it - m_buffers.begin()) + 1;
+	}
+}
+
+void SoftMixer::DeleteBuffers(ALsizei n, const ALuint *buffers) {
+	for (ALsizei i = 0; i < n; ++i) {
+		Buffer *b = BufferForId(buffers[i]);
+		if (b) {
+			delete b;
+			m_buffers[buffers[i]-1] = 0;
+		}
+	}
+}
+
+bool SoftMixer::BufferData(ALuint buffer, ALenum format, const ALvoid *data, ALsizei size, ALsizei freq) {
+	Buffer *b = BufferForId(buffer);
+	if (!b || (freq < 1))
+		return false;
+
+	int channels;
+	int bytesPerSample;
+
+	switch (format) {
+	case AL_FORMAT_MONO8:
+		channels = 1;
+		bytesPerSample = 1;
+		break;
+	case AL_FORMAT_MONO16:
+		channels = 1;
+		bytesPerSample = 2;
+		break;
+	case AL_FORMAT_STEREO8:
+		channels = 2;
+		bytesPerSample = 1;
+		break;
+	case AL_FORMAT_STEREO16:
+		channels = 2;
+		bytesPerSample = 2;
+		break;
+	default:
+		return false;
+	}
+
+	const int kNumFrames = size / (channels*bytesPerSample);
+
+	b->channels = channels;
+	b->rate = freq;
+	b->numFrames = kNumFrames;
+	b->samples.resize((kNumFrames+1)*channels);
+
+	if (bytesPerSample == 2) {
+		if (kNumFrames > 0)
+			memcpy(&b->samples[0], data, kNumFrames*channels*sizeof(S16));
+	} else {
+		const U8 *src = (const U8*)data;
+		for (int i = 0; i < kNumFrames*channels; ++i)
+			b->samples[i] = (S16)(((int)src[i] - 128) << 8);
+	}
+
+	// the resampler reads one frame ahead.
+	for (int i = 0; i < channels; ++i)
+		b->samples[kNumFrames*channels+i] = (kNumFrames > 0) ? b->samples[(kNumFrames-1)*channels+i] : 0;
+
+	return true;
+}
+
+void SoftMixer::GenSources(ALsizei n, ALuint *sources) {
+	for (ALsizei i = 0; i < n; ++i) {
+		Voice *v = new (ZSound) Voice();
+
+		VoiceVec::iterator it = std::find(m_voices.begin(), m_voices.end(), (Voice*)0);
+		if (it != m_voices.end()) {
+			*it = v;
+		} else {
+			it = m_voices.insert(m_voices.end(), v);
+		}
+
+		sources[i] = (ALuint)(it - m_voices.begin()) + 1;
+	}
+}
+
+void SoftMixer::DeleteSources(ALsizei n, const ALuint *sources) {
+	for (ALsizei i = 0; i < n; ++i) {
+		Voice *v = VoiceForId(sources[i]);
+		if (v) {
+			delete v;
+			m_voices[sources[i]-1] = 0;
+		}
+	}
+}
+
+void SoftMixer::SourcePlay(ALuint source) {
+	Voice *v = VoiceForId(source);
+	if (!v)
+		return;
+
+	if (v->state != AL_PAUSED) {
+		v->current = 0;
+		v->pos = 0;
+	}
+
+	v->state = v->queue.empty() ? AL_STOPPED : AL_PLAYING;
+}
+
+void SoftMixer::SourcePause(ALuint source) {
+	Voice *v = VoiceForId(source);
+	if (v && (v->state == AL_PLAYING))
+		v->state = AL_PAUSED;
+}
+
+void SoftMixer::SourceStop(ALuint source) {
+	Voice *v = VoiceForId(source);
+	if (v && (v->state != AL_INITIAL)) {
+		v->state = AL_STOPPED;
+		v->current = (int)v->queue.size();
+		v->pos = 0;
+	}
+}
+
+void SoftMixer::SourceRewind(ALuint source) {
+	Voice *v = VoiceForId(source);
+	if (v) {
+		v->state = AL_INITIAL;
+		v->current = 0;
+		v->pos = 0;
+	}
+}
+
+void SoftMixer::Sourcei(ALuint source, ALenum param, ALint value) {
+	Voice *v = VoiceForId(source);
+	if (!v)
+		return;
+
+	switch (param) {
+	case AL_BUFFER:
+		v->queue.clear();
+		if (value)
+			v->queue.push_back((ALuint)value);
+		v->current = 0;
+		v->pos = 0;
+		break;
+	case AL_LOOPING:
+		v->looping = value != AL_FALSE;
+		break;
+	case AL_SOURCE_RELATIVE:
+		v->relative = value != AL_FALSE;
+		break;
+	default:
+		Sourcef(source, param, (ALfloat)value);
+		break;
+	}
+}
+
+void SoftMixer::Sourcef(ALuint source, ALenum param, ALfloat value) {
+	Voice *v = VoiceForId(source);
+	if (!v)
+		return;
+
+	switch (param) {
+	case AL_GAIN:
+		v->gain = value;
+		break;
+	case AL_MIN_GAIN:
+		v->minGain = value;
+		break;
+	case AL_MAX_GAIN:
+		v->maxGain = value;
+		break;
+	case AL_PITCH:
+		v->pitch = value;
+		break;
+	case AL_REFERENCE_DISTANCE:
+		v->refDistance = value;
+		break;
+	case AL_MAX_DISTANCE:
+		v->maxDistance = value;
+		break;
+	case AL_ROLLOFF_FACTOR:
+		v->rolloff = value;
+		break;
+	case AL_CONE_INNER_ANGLE:
+		v->coneInner = value;
+		break;
+	case AL_CONE_OUTER_ANGLE:
+		v->coneOuter = value;
+		break;
+	case AL_CONE_OUTER_GAIN:
+		v->coneOuterGain = value;
+		break;
+	default:
+		break;
+	}
+}
+
+void SoftMixer::Source3f(ALuint source, ALenum param, ALfloat x, ALfloat y, ALfloat z) {
+	Voice *v = VoiceForId(source);
+	if (!v)
+		return;
+
+	float *dst;
+
+	switch (param) {
+	case AL_POSITION:
+		dst = v->pos3;
+		break;
+	case AL_DIRECTION:
+		dst = v->dir3;
+		break;
+	default: // AL_VELOCITY, doppler is not simulated.
+		return;
+	}
+
+	dst[0] = x;
+	dst[1] = y;
+	dst[2] = z;
+}
+
+void SoftMixer::GetSourcei(ALuint source, ALenum param, ALint *value) {
+	Voice *v = VoiceForId(source);
+	if (!v)
+		return;
+
+	switch (param) {
+	case AL_SOURCE_STATE:
+		*value = v->state;
+		break;
+	case AL_BUFFERS_QUEUED:
+		*value = (ALint)v->queue.size();
+		break;
+	case AL_BUFFERS_PROCESSED:
+		*value = (v->state == AL_INITIAL) ? 0 : v->current;
+		break;
+	case AL_BUFFER:
+		*value = (v->current < (int)v->queue.size()) ? (ALint)v->queue[v->current] : 0;
+		break;
+	case AL_LOOPING:
+		*value = v->looping ? AL_TRUE : AL_FALSE;
+		break;
+	case AL_SOURCE_RELATIVE:
+		*value = v->relative ? AL_TRUE : AL_FALSE;
+		break;
+	case AL_SAMPLE_OFFSET:
+		*value = (ALint)(v->pos >> 16);
+		break;
+	default:
+		break;
+	}
+}
+
+void SoftMixer::SourceQueueBuffers(ALuint source, ALsizei n, const ALuint *buffers) {
+	Voice *v = VoiceForId(source);
+	if (!v)
+		return;
+
+	v->queue.insert(v->queue.end(), buffers, buffers+n);
+}
+
+void SoftMixer::SourceUnqueueBuffers(ALuint source, ALsizei n, ALuint *buffers) {
+	Voice *v = VoiceForId(source);
+	if (!v)
+		return;
+
+	ALint processed;
+	GetSourcei(source, AL_BUFFERS_PROCESSED, &processed);
+	if (n > processed)
+		return; // AL_INVALID_VALUE
+
+	std::copy(v->queue.begin(), v->queue.begin()+n, buffers);
+	v->queue.erase(v->queue.begin(), v->queue.begin()+n);
+	v->current -= (int)n;
+}
+
+void SoftMixer::Listenerf(ALenum param, ALfloat value) {
+	if (param == AL_GAIN)
+		m_listenerGain = value;
+}
+
+void SoftMixer::Listener3f(ALenum param, ALfloat x, ALfloat y, ALfloat z) {
+	if (param == AL_POSITION) {
+		m_listenerPos[0] = x;
+		m_listenerPos[1] = y;
+		m_listenerPos[2] = z;
+	}
+}
+
+void SoftMixer::Listenerfv(ALenum param, const ALfloat *values) {
+	if (param == AL_ORIENTATION) {
+		for (int i = 0; i < 3; ++i) {
+			m_listenerAt[i] = values[i];
+			m_listenerUp[i] = values[i+3];
+		}
+	} else {
+		Listener3f(param, values[0], values[1], values[2]);
+	}
+}
+
+void SoftMixer::DistanceModel(ALenum value) {
+	m_distanceModel = value;
+}
+
+SoftMixer::Buffer *SoftMixer::BufferForId(ALuint id) const {
+	if (id < 1 || id > (ALuint)m_buffers.size())
+		return 0;
+	return m_buffers[id-1];
+}
+
+SoftMixer::Voice *SoftMixer::VoiceForId(ALuint id) const {
+	if (id < 1 || id > (ALuint)m_voices.size())
+		return 0;
+	return m_voices[id-1];
+}
+
+SoftMixer::Buffer *SoftMixer::CurrentBuffer(const Voice &v) const {
+	if (v.current >= (int)v.queue.size())
+		return 0;
+	return BufferForId(v.queue[v.current]);
+}
+
+float SoftMixer::DistanceGain(const Voice &v, float distance) const {
+	// OpenAL 1.1 specification, section 3.4
+	switch (m_distanceModel) {
+	case AL_INVERSE_DISTANCE_CLAMPED:
+		distance = Clamp(distance, v.refDistance, v.maxDistance);
+		// fall through
+	case AL_INVERSE_DISTANCE: {
+		const float kDen = v.refDistance + v.rolloff * (distance - v.refDistance);
+		return (kDen > 0.f) ? (v.refDistance / kDen) : 1.f;
+	}
+	case AL_LINEAR_DISTANCE_CLAMPED:
+		distance = Clamp(distance, v.refDistance, v.maxDistance);
+		// fall through
+	case AL_LINEAR_DISTANCE: {
+		const float kRange = v.maxDistance - v.refDistance;
+		if (kRange <= 0.f)
+			return 1.f;
+		return std::max(0.f, 1.f - v.rolloff * (distance - v.refDistance) / kRange);
+	}
+	case AL_EXPONENT_DISTANCE_CLAMPED:
+		distance = Clamp(distance, v.refDistance, v.maxDistance);
+		// fall through
+	case AL_EXPONENT_DISTANCE:
+		if ((distance <= 0.f) || (v.refDistance <= 0.f))
+			return 1.f;
+		return powf(distance / v.refDistance, -v.rolloff);
+	default:
+		break;
+	}
+
+	return 1.f;
+}
+
+void SoftMixer::ComputeGains(Voice &v) const {
+	const Buffer *b = CurrentBuffer(v);
+
+	if (b && (b->channels == 2)) {
+		// stereo sources are not spatialized.
+		const float kGain = Clamp(v.gain, v.minGain, v.maxGain) * m_listenerGain;
+		v.mixGains[0] = kGain;
+		v.mixGains[1] = kGain;
+		v.loudness = kGain;
+		return;
+	}
+
+	float d[3];
+	float right;
+
+	if (v.relative) {
+		// relative sources are in the listeners frame: +x right, -z forward.
+		d[0] = v.pos3[0];
+		d[1] = v.pos3[1];
+		d[2] = v.pos3[2];
+		right = d[0];
+	} else {
+		float r[3];
+		Cross(r, m_listenerAt, m_listenerUp);
+		const float kLen = sqrtf(Dot(r, r));
+		for (int i = 0; i < 3; ++i)
+			d[i] = v.pos3[i] - m_listenerPos[i];
+		right = (kLen > 0.f) ? (Dot(d, r) / kLen) : 0.f;
+	}
+
+	const float kDistance = sqrtf(Dot(d, d));
+
+	float gain = v.gain * DistanceGain(v, kDistance);
+
+	if (((v.coneInner < 360.f) || (v.coneOuter < 360.f)) && (kDistance > 0.f)) {
+		const float kDirLen = sqrtf(Dot(v.dir3, v.dir3));
+		if (kDirLen > 0.f) {
+			const float kCos = Clamp(-Dot(v.dir3, d) / (kDirLen * kDistance), -1.f, 1.f);
+			const float kAngle = acosf(kCos) * (360.f / kPi); // full cone angle in degrees
+			if (kAngle > v.coneInner) {
+				if (kAngle < v.coneOuter) {
+					const float kT = (kAngle - v.coneInner) / (v.coneOuter - v.coneInner);
+					gain *= 1.f + (v.coneOuterGain - 1.f) * kT;
+				} else {
+					gain *= v.coneOuterGain;
+				}
+			}
+		}
+	}
+
+	gain = Clamp(gain, v.minGain, v.maxGain) * m_listenerGain;
+
+	// equal power pan.
+	const float kPan = (kDistance > 0.f) ? Clamp(right / kDistance, -1.f, 1.f) : 0.f;
+	const float kTheta = (kPan + 1.f) * (kPi / 4.f);
+	v.mixGains[0] = gain * cosf(kTheta);
+	v.mixGains[1] = gain * sinf(kTheta);
+	v.loudness = gain;
+}
+
+bool SoftMixer::EndOfBuffer(Voice &v) {
+	if (v.current+1 < (int)v.queue.size()) {
+		++v.current;
+		return true;
+	}
+
+	if (v.looping) {
+		v.current = 0;
+		return true;
+	}
+
+	v.state = AL_STOPPED;
+	v.current = (int)v.queue.size();
+	v.pos = 0;
+	return false;
+}
+
+void SoftMixer::Render(Voice &v, float *out, int numFrames, bool mix) {
+	int done = 0;
+	int empty = 0;
+
+	while (done < numFrames) {
+		const Buffer *b = CurrentBuffer(v);
+		const U64 kEnd = b ? ((U64)b->numFrames << 16) : 0;
+
+		if (v.pos >= kEnd) {
+			v.pos -= kEnd;
+			if (kEnd == 0) {
+				// a queue of empty buffers would never advance.
+				if (++empty > (int)v.queue.size()) {
+					v.state = AL_STOPPED;
+					v.current = (int)v.queue.size();
+					v.pos = 0;
+					break;
+				}
+			}
+			if (!EndOfBuffer(v))
+				break;
+			continue;
+		}
+
+		empty = 0;
+
+		U64 step = (U64)((double)b->rate * v.pitch * 65536.0 / m_rate);
+		step = std::max<U64>(1, std::min<U64>(step, kMaxStep));
+
+		const U64 kAvail = (kEnd - v.pos + step - 1) / step;
+		const int kNum = (int)std::min<U64>(kAvail, (U64)(numFrames - done));
+
+		if (mix) {
+			const S16 *src = &b->samples[(size_t)(v.pos >> 16) * b->channels];
+			SIMD->ResampleMix(
+				out + done*2,
+				kNum,
+				src,
+				b->channels,
+				(U32)(v.pos & 0xffff),
+				(U32)step,
+				v.mixGains
+			);
+		}
+
+		v.pos += step * kNum;
+		done += kNum;
+	}
+}
+
+void SoftMixer::MixBlock(int numFrames) {
+	RAD_ASSERT(numFrames <= kBlockFrames);
+	memset(m_mix, 0, sizeof(float)*numFrames*2);
+
+	m_playing.clear();
+	for (VoiceVec::iterator it = m_voices.begin(); it != m_voices.end(); ++it) {
+		Voice *v = *it;
+		if (v && (v->state == AL_PLAYING)) {
+			ComputeGains(*v);
+			m_playing.push_back(v);
+		}
+	}
+
+	const int kNumPlaying = (int)m_playing.size();
+	if (kNumPlaying > m_maxMixedVoices) {
+		std::nth_element(
+			m_playing.begin(),
+			m_playing.begin() + m_maxMixedVoices,
+			m_playing.end(),
+			LouderVoice()
+		);
+	}
+
+	int numMixed = 0;
+	for (int i = 0; i < kNumPlaying; ++i) {
+		Voice &v = *m_playing[i];
+		const bool kMix = (i < m_maxMixedVoices) && (v.loudness >= kVirtualGain);
+		Render(v, m_mix, numFrames, kMix);
+		if (kMix)
+			++numMixed;
+	}
+
+	for (int i = 0; i < numFrames*2; ++i) {
+		const float kSample = m_mix[i] * 32767.f;
+		m_out[i] = (S16)Clamp(kSample, -32768.f, 32767.f);
+	}
+
+	m_sink->Write(m_out, numFrames);
+
+	m_counters.numPlaying = kNumPlaying;
+	m_counters.numMixed = numMixed;
+	m_counters.numVirtual = kNumPlaying - numMixed;
+	m_counters.numFrames += (U64)numFrames;
+	m_counters.numVoiceFrames += (U64)numFrames * numMixed;
+}
+
+void SoftMixer::Mix(int numFrames) {
+	while (numFrames > 0) {
+		const int kNum = std::min<int>(numFrames, kBlockFrames);
+		MixBlock(kNum);
+		numFrames -= kNum;
+	}
+}
+
+void SoftMixer::Update() {
+	const U32 kNow = xtime::ReadMicroseconds();
+	if (!m_lastUpdate) {
+		m_lastUpdate = kNow;
+		return;
+	}
+
+	const U32 kElapsed = kNow - m_lastUpdate;
+	m_lastUpdate = kNow;
+
+	m_updateRemainder += (U64)kElapsed * (U64)m_rate;
+	U64 numFrames = m_updateRemainder / 1000000;
+	m_updateRemainder -= numFrames * 1000000;
+
+	// don't try to catch up after a stall (disabled driver, debugger).
+	numFrames = std::min<U64>(numFrames, (U64)(m_rate/4));
+
+	Mix((int)numFrames);
+}
@@ -0,0 +1,192 @@
+/*! \file SoftMixer.h
+	\copyright Copyright (c) 2013 Sunside Inc., All Rights Reserved.
+	\copyright See Radiance/LICENSE for licensing terms.
+	\author Joe Riedel
+	\ingroup sound
+*/
+
+#pragma once
+
+#include "../Types.h"
+#include "../Zones.h"
+#include <Runtime/Container/ZoneVector.h>
+#include <OpenAL/al.h>
+#include <stdio.h>
+#include <Runtime/PushPack.h>
+
+//! Software implementation of the OpenAL calls made through ALDriver.
+/*! Mixes 16 bit mono and stereo buffers into a stereo sink with the OpenAL distance models
+	and sound cones. Voices that are inaudible, or that fall outside the loudest
+	maxMixedVoices, are virtualized: their playback position advances without reading or
+	mixing any samples, so they resume in the right place when they become audible.
+
+	Doppler is not simulated. All methods must be called from the ALDriver thread.
+*/
+class SoftMixer {
+public:
+
+	//! Receives mixed output.
+	class Sink {
+	public:
+		virtual ~Sink() {}
+		//! Writes numFrames interleaved 16 bit left/right frames.
+		virtual void Write(const S16 *frames, int numFrames) = 0;
+	};
+
+	//! Discards the mix.
+	class NullSink : public Sink {
+	public:
+		virtual void Write(const S16 *frames, int numFrames) {}
+	};
+
+	//! Writes the mix to a 16 bit stereo .wav file.
+	class WavSink : public Sink {
+	public:
+		WavSink(const char *path, int rate);
+		virtual ~WavSink();
+
+		virtual void Write(const S16 *frames, int numFrames);
+
+		bool IsOpen() const {
+			return m_fp != 0;
+		}
+
+	private:
+		void WriteHeader();
+
+		FILE *m_fp;
+		int m_rate;
+		U32 m_numBytes;
+	};
+
+	struct Counters {
+		int numPlaying; //!< Voices playing in the last mixed block.
+		int numMixed; //!< Voices mixed in the last mixed block.
+		int numVirtual; //!< Playing voices that were not mixed in the last block.
+		U64 numFrames; //!< Output frames mixed.
+		U64 numVoiceFrames; //!< Output frames mixed summed over every mixed voice.
+	};
+
+	enum {
+		kDefaultRate = 44100,
+		kDefaultMaxMixedVoices = 32
+	};
+
+	//! The mixer takes ownership of the sink.
+	SoftMixer(Sink *sink, int rate = kDefaultRate, int maxMixedVoices = kDefaultMaxMixedVoices);
+	~SoftMixer();
+
+	void GenBuffers(ALsizei n, ALuint *buffers);
+	void DeleteBuffers(ALsizei n, const ALuint *buffers);
+	bool BufferData(ALuint buffer, ALenum format, const ALvoid *data, ALsizei size, ALsizei freq);
+
+	void GenSources(ALsizei n, ALuint *sources);
+	void DeleteSources(ALsizei n, const ALuint *sources);
+	void SourcePlay(ALuint source);
+	void SourcePause(ALuint source);
+	void SourceStop(ALuint source);
+	void SourceRewind(ALuint source);
+	void Sourcei(ALuint source, ALenum param, ALint value);
+	void Sourcef(ALuint source, ALenum param, ALfloat value);
+	void Source3f(ALuint source, ALenum param, ALfloat x, ALfloat y, ALfloat z);
+	void GetSourcei(ALuint source, ALenum param, ALint *value);
+	void SourceQueueBuffers(ALuint source, ALsizei n, const ALuint *buffers);
+	void SourceUnqueueBuffers(ALuint source, ALsizei n, ALuint *buffers);
+
+	void Listenerf(ALenum param, ALfloat value);
+	void Listener3f(ALenum param, ALfloat x, ALfloat y, ALfloat z);
+	void Listenerfv(ALenum param, const ALfloat *values);
+	void DistanceModel(ALenum value);
+
+	//! Mixes numFrames frames into the sink.
+	void Mix(int numFrames);
+
+	//! Mixes the frames that are due by the wall clock since the last Update().
+	void Update();
+
+	RAD_DECLARE_READONLY_PROPERTY(SoftMixer, counters, const Counters*);
+	RAD_DECLARE_READONLY_PROPERTY(SoftMixer, rate, int);
+
+private:
+
+	enum {
+		kBlockFrames = 512,
+		kMaxStep = 64<<16 // 16.16 fixed point
+	};
+
+	struct Buffer {
+		typedef zone_vector<S16, ZSoundT>::type SampleVec;
+		SampleVec samples;
+		int channels;
+		int rate;
+		int numFrames; // samples holds one extra frame repeating the last.
+	};
+
+	typedef zone_vector<Buffer*, ZSoundT>::type BufferVec;
+	typedef zone_vector<ALuint, ZSoundT>::type BufferIdVec;
+
+	struct Voice {
+		Voice();
+
+		BufferIdVec queue;
+		int current; // index into queue, also the number of processed buffers.
+		U64 pos; // 48.16 fixed point frame in the current buffer.
+		ALenum state;
+		bool looping;
+		bool relative;
+		float gain;
+		float minGain;
+		float maxGain;
+		float pitch;
+		float refDistance;
+		float maxDistance;
+		float rolloff;
+		float coneInner;
+		float coneOuter;
+		float coneOuterGain;
+		float pos3[3];
+		float dir3[3];
+		float mixGains[2];
+		float loudness;
+	};
+
+	typedef zone_vector<Voice*, ZSoundT>::type VoiceVec;
+
+	Buffer *BufferForId(ALuint id) const;
+	Voice *VoiceForId(ALuint id) const;
+	Buffer *CurrentBuffer(const Voice &v) const;
+	void ComputeGains(Voice &v) const;
+	float DistanceGain(const Voice &v, float distance) const;
+	//! Advances the voice numFrames, adding it into out if mix is true.
+	void Render(Voice &v, float *out, int numFrames, bool mix);
+	//! Moves past the end of the current buffer, returns false if the voice stopped.
+	bool EndOfBuffer(Voice &v);
+	void MixBlock(int numFrames);
+
+	RAD_DECLARE_GET(counters, const Counters*) {
+		return &m_counters;
+	}
+
+	RAD_DECLARE_GET(rate, int) {
+		return m_rate;
+	}
+
+	Sink *m_sink;
+	BufferVec m_buffers;
+	VoiceVec m_voices;
+	VoiceVec m_playing;
+	Counters m_counters;
+	ALenum m_distanceModel;
+	float m_listenerGain;
+	float m_listenerPos[3];
+	float m_listenerAt[3];
+	float m_listenerUp[3];
+	float m_mix[kBlockFrames*2];
+	S16 m_out[kBlockFrames*2];
+	int m_rate;
+	int m_maxMixedVoices;
+	U32 m_lastUpdate;
+	U64 m_updateRemainder; // microseconds * rate not yet mixed
+};
+
+#include <Runtime/PopPack.h>
@@ -23,8 +23,7 @@ enum {
 	kMaxSimultaneousSounds = 32,
 	kDefaultReferenceDistance = 50,
 	kDefaultMaxDistance = 150,
-	kStreamingBufferSize = 16*kKilo,
-	kMaxBytesDecodedPerTick = kKilo
+	kStreamingBufferSize = 16*kKilo
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -38,8 +37,8 @@ SoundContext::StreamCallback::~StreamCallback() {
 }
 
 void SoundContext::StreamCallback::Tick(ALDriver &alDriver) {
-	if (m_ctx.TickStreams(alDriver))
-		alDriver.Wake(); // don't sleep we are still working.
+	// the decoder threads wake the driver when they finish a block.
+	m_ctx.TickStreams(alDriver);
 }
 
 SoundContext::Ref SoundContext::New(const ALDriver::Ref &driver) {
@@ -125,6 +124,9 @@ void SoundContext::Tick(float dt, bool positional)
 {
 	if (m_alDriver->suspended)
 		return;
+
+	// source updates from this tick are handed to the driver thread together.
+	m_alDriver->BeginFrame();
 	
 	if (m_time[1] > 0.f) {
 		m_time[0] += dt;
@@ -220,6 +222,8 @@ void SoundContext::Tick(float dt, bool positional)
 		}
 	}
 
+	m_alDriver->EndFrame();
+
 	// completion callbacks
 
 	for(Source::StackPtrVec::const_iterator it = callbacks->begin(); it != callbacks->end(); ++it) {
@@ -243,10 +247,8 @@ void SoundContext::Tick(float dt, bool positional)
 	}
 }
 
-int SoundContext::TickStreams(ALDriver &driver)
+void SoundContext::TickStreams(ALDriver &driver)
 {
-	int numBusy = 0;
-
 	ReadLock L(m_m);
 
 	for (Source::List::const_iterator it = m_streams.begin(); it != m_streams.end();) {
@@ -257,12 +259,8 @@ int SoundContext::TickStreams(ALDriver &driver)
 			UpgradeToWriteLock WL(m_m);
 			UnmapSource(*s);
 			s->doNotify = true;
-		} else if (r == Sound::kStreamResult_Decoding) {
-			++numBusy;
 		}
 	}
-
-	return numBusy;
 }
 
 void SoundContext::FadeMasterVolume(float volume, float time) {
@@ -418,9 +416,9 @@ m_maxDistance(-1.f),
 m_refDistance(-1.0f),
 m_is(0),
 m_vbd(0),
-m_blockData(0),
-m_decodeOfs(0),
+m_decoder(0),
 m_eos(false),
+m_streamStarted(false),
 m_fadeOutAndStop(false),
 m_bsi(0) {
 	m_pos[0] = Vec3::Zero;
@@ -434,7 +432,7 @@ m_bsi(0) {
 	m_time[0] = m_time[1] = 0.f;
 
 	memset(m_sbufs, 0, sizeof(ALuint)*kNumStreamingBuffers);
-	m_availBuf[0] = m_availBuf[1] = 0;
+	m_numFreeBufs = 0;
 }
 
 Sound::~Sound() {
@@ -472,6 +470,10 @@ Sound::~Sound() {
 
 	}
 
+	// stop the decode-ahead thread before its decoder and stream go away.
+	if (m_decoder)
+		delete m_decoder;
+
 	m_ib.reset();
 	
 	if (m_vbd)
@@ -480,8 +482,6 @@ Sound::~Sound() {
 		delete m_bsi;
 	if (m_is)
 		delete m_is;
-	if (m_blockData)
-		zone_free(m_blockData);
 }
 
 bool Sound::Init(
@@ -559,10 +559,15 @@ bool Sound::InitStreaming(
 	ZMusic.Get().Inc(kNumStreamingBuffers*kStreamingBufferSize, 0);
 
 	memcpy(m_rbufs, m_sbufs, sizeof(ALuint)*kNumStreamingBuffers);
-	m_availBuf[0] = 0;
-	m_availBuf[1] = kNumStreamingBuffers;
+	m_numFreeBufs = kNumStreamingBuffers;
 
-	m_blockData = safe_zone_malloc(ZMusic, kStreamingBufferSize);
+	m_decoder = new (ZMusic) StreamDecoder(
+		*m_vbd,
+		kStreamingBufferSize,
+		StreamDecoder::kDefaultNumBlocks,
+		m_alDriver.get()
+	);
+	m_decoder->loop = m_loop;
 
 	// make streaming source.
 	m_sources.resize(1);
@@ -667,8 +672,8 @@ void Sound::Rewind() {
 
 		if (m_is) { // rewind ogg playback
 			
-			RAD_ASSERT(m_vbd);
-			m_vbd->SeekBytes(0, false);
+			RAD_ASSERT(m_decoder);
+			m_decoder->Rewind();
 
 			// iOS5 bug, just delete the source entirely.
 			if (source.source) {
@@ -683,10 +688,10 @@ void Sound::Rewind() {
 				);
 			}
 			
-			m_availBuf[0] = 0;
-			m_availBuf[1] = kNumStreamingBuffers;
+			m_numFreeBufs = kNumStreamingBuffers;
 			memcpy(m_rbufs, m_sbufs, sizeof(ALuint)*kNumStreamingBuffers);
 			m_eos = false;
+			m_streamStarted = false;
 		} else {
 			m_alDriver->SourceRewind(ALDRIVER_SIG source.source);
 		}
@@ -819,7 +824,7 @@ bool Sound::Tick(
 		ALDriver::Command *cmd = m_alDriver->CreateCommand(&fn_GetSourceStatus);
 		ALDRIVER_CMD_SIG_SRC(*cmd);
 		cmd->args.pvoid = &source;
-		m_alDriver->Submit(*cmd);
+		m_alDriver->Post(*cmd);
 	}
 
 	return false;
@@ -828,14 +833,14 @@ bool Sound::Tick(
 void Sound::fn_GetSourceStatus(ALDriver &driver, ALDriver::Command *cmd) {
 	SoundContext::Source *source = reinterpret_cast<SoundContext::Source*>(cmd->args.pvoid);
 	ALint status;
-	alGetSourcei(source->source, AL_SOURCE_STATE, &status);
+	driver.ExecGetSourcei(source->source, AL_SOURCE_STATE, &status);
 	source->status = status;
 	CHECK_AL_ERRORS(*cmd);
 	driver.DestroyCommand(cmd);
 }
 
 Sound::StreamResult Sound::TickStream(SoundContext::Source &source)
-{ // NOTE: Called on ALDriver thread, safe to call OpenAL directly in this function.
+{ // NOTE: Called on ALDriver thread, safe to call the ALDriver Exec* methods in this function.
 	SoundContext::Ref ctx = m_ctx.lock();
 	if (!ctx)
 		return kStreamResult_Finished;
@@ -847,102 +852,60 @@ Sound::StreamResult Sound::TickStream(SoundContext::Source &source)
 
 	if (m_volume[3] == 0.f && m_fadeOutAndStop) {
 		if (source.mapped) {
-			m_alDriver->SourceStop(ALDRIVER_SIG source.source);
+			m_alDriver->ExecSourceStop(source.source);
 		}
 		return kStreamResult_Finished;
 	}
 	
-	if (m_eos) {
-		ALint num;
-		alGetSourcei(source.source, AL_BUFFERS_PROCESSED, &num);
-		if (num > 0)
-			alSourceUnqueueBuffers(source.source, num, m_rbufs);
-		alGetSourcei(source.source, AL_BUFFERS_QUEUED, &num);
-		return (num > 0) ? kStreamResult_Playing : kStreamResult_Finished;
-	}
-	
-	// unqueue AL buffers if we don't have anything to read in.
-	// i.e. all buffers are full of data.
-	if (m_availBuf[0] == m_availBuf[1]) {
-		ALint num;
-		alGetSourcei(source.source, AL_BUFFERS_PROCESSED, &num);
-		if (num < 1) {
-			ALint state;
-			alGetSourcei(source.source, AL_SOURCE_STATE, &state);
-			if (state != AL_PLAYING)
-				alSourcePlay(source.source);
-			return kStreamResult_Playing;
-		}
-		alSourceUnqueueBuffers(source.source, num, m_rbufs);
-		m_availBuf[1] = num;
-		m_availBuf[0] = 0;
+	// reclaim the AL buffers that finished playing.
+	ALint num;
+	m_alDriver->ExecGetSourcei(source.source, AL_BUFFERS_PROCESSED, &num);
+	if (num > 0) {
+		RAD_ASSERT(m_numFreeBufs+num <= kNumStreamingBuffers);
+		m_alDriver->ExecSourceUnqueueBuffers(source.source, num, m_rbufs+m_numFreeBufs);
+		m_numFreeBufs += num;
 	}
 
-	AddrSize bytesDecoded = 0;
-	
-	while ((m_availBuf[0] != m_availBuf[1]) && !m_eos && (bytesDecoded < kMaxBytesDecodedPerTick)) {
-		// decode another block.
-		
-		while ((m_decodeOfs < kStreamingBufferSize) && (bytesDecoded < kMaxBytesDecodedPerTick)) {
-			AddrSize x;
+	// queue blocks the decoder thread has finished, this thread never decodes.
+	while ((m_numFreeBufs > 0) && !m_eos) {
+		const StreamDecoder::Block *block = m_decoder->Front();
+		if (!block)
+			break;
 
-			AddrSize bytesToDecode = std::min(kStreamingBufferSize-m_decodeOfs, kMaxBytesDecodedPerTick-bytesDecoded);
-			RAD_ASSERT(bytesToDecode > 0);
-			
-			m_vbd->Decode(
-				((U8*)m_blockData)+m_decodeOfs,
-				bytesToDecode,
-				audio_codec::ogg_vorbis::EM_Little,
-				audio_codec::ogg_vorbis::ST_16Bit,
-				audio_codec::ogg_vorbis::DT_Signed,
-				0,
-				x
+		if (block->size > 0) {
+			ALuint buf = m_rbufs[--m_numFreeBufs];
+
+			m_alDriver->ExecBufferData(
+				buf,
+				(m_bsi->channels==2) ? AL_FORMAT_STEREO16 : AL_FORMAT_MONO16,
+				block->data,
+				(ALsizei)block->size,
+				m_bsi->rate
 			);
-			
-			if (0 == x) {
-				if (m_loop) {
-					m_vbd->SeekBytes(0, false);
-				} else {
-					m_eos = true;
-					break;
-				}
-			}
-			
-			m_decodeOfs += x;
-			bytesDecoded += x;
-		}
-		
-		if ((m_decodeOfs > 0) && (m_eos || (m_decodeOfs == kStreamingBufferSize))) {
-			int idx = m_availBuf[0]++;
-			RAD_ASSERT(idx < kNumStreamingBuffers);
-			
-			if (idx < kNumStreamingBuffers) {
-				ALuint buf = m_rbufs[idx];
-				
-				alBufferData(
-					buf,
-					(m_bsi->channels==2) ? AL_FORMAT_STEREO16 : AL_FORMAT_MONO16,
-					m_blockData,
-					(ALsizei)m_decodeOfs,
-					m_bsi->rate
-				);
-				
-				if (source.source)
-					alSourceQueueBuffers(source.source, 1, &buf);
-			}
 
-			m_decodeOfs = 0;
+			m_alDriver->ExecSourceQueueBuffers(source.source, 1, &buf);
 		}
+
+		m_eos = block->eos;
+		m_decoder->Pop();
 	}
 
-	if (source.mapped && source.source) {
+	m_alDriver->ExecGetSourcei(source.source, AL_BUFFERS_QUEUED, &num);
+	if (num < 1)
+		return m_eos ? kStreamResult_Finished : kStreamResult_Playing;
+
+	if (source.mapped) {
 		ALint state;
-		alGetSourcei(source.source, AL_SOURCE_STATE, &state);
-		if (state != AL_PLAYING)
-			alSourcePlay(source.source);
+		m_alDriver->ExecGetSourcei(source.source, AL_SOURCE_STATE, &state);
+		if (state != AL_PLAYING) {
+			if (m_streamStarted)
+				m_decoder->Underrun(); // the source played everything we queued.
+			m_alDriver->ExecSourcePlay(source.source);
+			m_streamStarted = true;
+		}
 	}
 
-	return kStreamResult_Decoding;
+	return kStreamResult_Playing;
 }
 
 void Sound::Pause(SoundContext::Source &source, bool pause)
@@ -982,8 +945,11 @@ void Sound::RAD_IMPLEMENT_SET(loop)(bool value)
 		return;
 	m_loop = value;
 
-	if (m_is)
-		return; // streaming sources loop manually.
+	if (m_is) { // streaming sources loop in the decoder.
+		if (m_decoder)
+			m_decoder->loop = value;
+		return;
+	}
 
 	SoundContext::Ref ctx = m_ctx.lock();
 	if (!ctx)
@@ -9,6 +9,7 @@
 #include "../Packages/PackagesDef.h"
 #include "SoundDef.h"
 #include "ALDriver.h"
+#include "StreamDecoder.h"
 #include <Runtime/File.h>
 #include <Runtime/Container/ZoneVector.h>
 #include <Runtime/Container/ZoneList.h>
@@ -165,7 +166,7 @@ private:
 	bool Evict(int priority);
 	bool MapSource(Source &source);
 	void UnmapSource(Source &source);
-	int TickStreams(ALDriver &alDriver);
+	void TickStreams(ALDriver &alDriver);
 
 	typedef thread::SharedMutex Mutex;
 	typedef boost::lock_guard<Mutex> WriteLock;
@@ -215,6 +216,8 @@ public:
 	RAD_DECLARE_READONLY_PROPERTY(Sound, paused, bool);
 	RAD_DECLARE_READONLY_PROPERTY(Sound, context, SoundContext::Ref);
 	RAD_DECLARE_READONLY_PROPERTY(Sound, asset, const pkg::AssetRef&);
+	//! Decode-ahead counters of a streaming sound, null for other sounds.
+	RAD_DECLARE_READONLY_PROPERTY(Sound, streamCounters, const StreamDecoder::Counters*);
 
 	void FadeVolume(float volume, float time);
 	void FadeOutAndStop(float time);
@@ -338,6 +341,10 @@ private:
 		return m_asset; 
 	}
 
+	RAD_DECLARE_GET(streamCounters, const StreamDecoder::Counters*) {
+		return m_decoder ? m_decoder->counters.get() : 0;
+	}
+
 	Sound();
 
 	enum {
@@ -346,7 +353,6 @@ private:
 
 	enum StreamResult {
 		kStreamResult_Playing,
-		kStreamResult_Decoding,
 		kStreamResult_Finished
 	};
 
@@ -387,18 +393,18 @@ private:
 	Quat m_rot[2];
 	ALuint m_sbufs[kNumStreamingBuffers];
 	ALuint m_rbufs[kNumStreamingBuffers];
-	int m_availBuf[2];
+	int m_numFreeBufs;
 	stream::InputStream *m_is;
 	audio_codec::ogg_vorbis::Decoder *m_vbd;
 	audio_codec::ogg_vorbis::BSI *m_bsi;
+	StreamDecoder *m_decoder;
 	file::MMFileInputBuffer::Ref m_ib;
-	void *m_blockData;
-	AddrSize m_decodeOfs;
 	SourceVec m_sources;
 	SoundContext::WRef m_ctx;
 	ALDriver::Ref m_alDriver;
 	pkg::AssetRef m_asset;
 	bool m_eos;
+	bool m_streamStarted;
 	bool m_loop;
 	bool m_relative;
 	bool m_fadeOutAndStop;
@@ -0,0 +1,174 @@
+/*! \file StreamDecoder.cpp
+	\copyright Copyright (c) 2013 Sunside Inc., All Rights Reserved.
+	\copyright See Radiance/LICENSE for licensing terms.
+	\author Joe Riedel
+	\ingroup sound
+*/
+
+#include RADPCH
+#include "StreamDecoder.h"
+#include "ALDriver.h"
+#include "../Zones.h"
+#include <Runtime/AudioCodec/Vorbis.h>
+#include <Runtime/Time.h>
+#include <algorithm>
+
+using namespace audio_codec;
+
+StreamDecoder::StreamDecoder(
+	ogg_vorbis::Decoder &decoder,
+	AddrSize blockSize,
+	int numBlocks,
+	ALDriver *driver
+) :
+m_decoder(decoder),
+m_driver(driver),
+m_blockSize(blockSize),
+m_numBlocks(numBlocks),
+m_read(0),
+m_write(0),
+m_totalDecodeMs(0.0),
+m_totalLatencyMs(0.0),
+m_numPopped(0),
+m_loop(false),
+m_eos(false),
+m_quit(false) {
+	RAD_ASSERT(numBlocks > 0);
+	memset(&m_counters, 0, sizeof(m_counters));
+
+	m_blocks = (Block*)safe_zone_malloc(ZMusic, sizeof(Block)*numBlocks);
+	m_data = safe_zone_malloc(ZMusic, blockSize*numBlocks);
+
+	for (int i = 0; i < numBlocks; ++i) {
+		m_blocks[i].data = ((U8*)m_data) + blockSize*i;
+		m_blocks[i].size = 0;
+		m_blocks[i].time = 0;
+		m_blocks[i].eos = false;
+	}
+
+	Run();
+}
+
+StreamDecoder::~StreamDecoder() {
+	m_quit = true;
+	m_sema.Put();
+	Join();
+	zone_free(m_blocks);
+	zone_free(m_data);
+}
+
+const StreamDecoder::Block *StreamDecoder::Front() {
+	const U32 kRead = m_read;
+	if (kRead == m_write) {
+		if (!m_eos)
+			++m_counters.numStarved;
+		return 0;
+	}
+
+	return &m_blocks[kRead % m_numBlocks];
+}
+
+void StreamDecoder::Pop() {
+	const U32 kRead = m_read;
+	RAD_ASSERT(kRead != m_write);
+
+	const Block &block = m_blocks[kRead % m_numBlocks];
+	const float kLatency = (xtime::ReadMicroseconds() - block.time) / 1000.f;
+	m_totalLatencyMs += kLatency;
+	++m_numPopped;
+	m_counters.avgLatencyMs = (float)(m_totalLatencyMs / m_numPopped);
+	m_counters.maxLatencyMs = std::max(m_counters.maxLatencyMs, kLatency);
+
+	m_read = kRead + 1;
+	m_counters.numAhead = (int)(m_write - m_read);
+	m_sema.Put(); // a block is free.
+}
+
+void StreamDecoder::Rewind() {
+	{
+		Lock L(m_m);
+		m_decoder.SeekBytes(0, false);
+		m_read = 0;
+		m_write = 0;
+		m_eos = false;
+		m_counters.numAhead = 0;
+	}
+
+	m_sema.Put();
+}
+
+int StreamDecoder::ThreadProc() {
+	while (!m_quit) {
+		if (m_eos || ((m_write - m_read) >= (U32)m_numBlocks)) {
+			m_sema.Get();
+			continue;
+		}
+
+		{
+			Lock L(m_m);
+			// Rewind() may have run while we waited for the lock.
+			if (m_quit || m_eos || ((m_write - m_read) >= (U32)m_numBlocks))
+				continue;
+
+			const U32 kWrite = m_write;
+			Block &block = m_blocks[kWrite % m_numBlocks];
+
+			xtime::MicroTimer timer;
+			timer.Start();
+			Decode(block);
+			const float kMs = timer.Elapsed() / 1000.f;
+
+			++m_counters.numBlocks;
+			m_totalDecodeMs += kMs;
+			m_counters.avgDecodeMs = (float)(m_totalDecodeMs / m_counters.numBlocks);
+			m_counters.maxDecodeMs = std::max(m_counters.maxDecodeMs, kMs);
+
+			// publish the block after its counters so a consumer that sees it sees them.
+			block.time = xtime::ReadMicroseconds();
+			m_write = kWrite + 1;
+			m_counters.numAhead = (int)(m_write - m_read);
+		}
+
+		if (m_driver)
+			m_driver->Wake();
+	}
+
+	return 0;
+}
+
+void StreamDecoder::Decode(Block &block) {
+	block.size = 0;
+	block.eos = false;
+
+	bool rewound = false;
+
+	while (block.size < m_blockSize) {
+		AddrSize x;
+
+		m_decoder.Decode(
+			((U8*)block.data)+block.size,
+			m_blockSize-block.size,
+			ogg_vorbis::EM_Little,
+			ogg_vorbis::ST_16Bit,
+			ogg_vorbis::DT_Signed,
+			0,
+			x
+		);
+
+		if (0 == x) {
+			// a looping stream that decodes nothing after a rewind would spin forever.
+			if (m_loop && !rewound) {
+				m_decoder.SeekBytes(0, false);
+				rewound = true;
+				continue;
+			}
+
+			block.eos = true;
+			m_eos = true;
+			break;
+		}
+
+		rewound = false;
+		block.size += x;
+	}
+}
@@ -0,0 +1,127 @@
+/*! \file StreamDecoder.h
+	\copyright Copyright (c) 2013 Sunside Inc., All Rights Reserved.
+	\copyright See Radiance/LICENSE for licensing terms.
+	\author Joe Riedel
+	\ingroup sound
+*/
+
+#pragma once
+
+#include "../Types.h"
+#include <Runtime/Thread.h>
+#include <Runtime/Thread/Locks.h>
+#include <Runtime/Thread/Interlocked.h>
+#include <Runtime/TimeDef.h>
+#include <Runtime/AudioCodec/VorbisDef.h>
+#include <Runtime/PushPack.h>
+
+class ALDriver;
+
+//! Decodes a Vorbis stream ahead of playback on a worker thread.
+/*! The worker keeps up to numBlocks blocks of 16 bit PCM decoded in a single producer, single
+	consumer ring. The consumer (the ALDriver thread for music) only copies finished blocks
+	into its buffers with Front() and Pop(), and never waits on the decoder.
+*/
+class StreamDecoder : protected thread::Thread {
+public:
+
+	struct Block {
+		void *data;
+		AddrSize size;
+		xtime::TimeVal time; //!< When the block finished decoding.
+		bool eos; //!< Last block of the stream, size may be zero.
+	};
+
+	//! Decode-ahead counters, written without locking.
+	struct Counters {
+		int numBlocks; //!< Blocks decoded.
+		int numAhead; //!< Blocks decoded and waiting for the consumer.
+		int numStarved; //!< Times the consumer wanted a block and the ring was empty.
+		int numUnderruns; //!< Times playback ran dry, reported by the consumer.
+		float avgDecodeMs; //!< Average milliseconds spent decoding a block.
+		float maxDecodeMs;
+		float avgLatencyMs; //!< Average milliseconds a block waited in the ring.
+		float maxLatencyMs;
+	};
+
+	enum {
+		kDefaultNumBlocks = 4
+	};
+
+	//! Starts decoding immediately. The decoder must stay valid until this object is destroyed.
+	/*! If driver is not null it is woken each time a block is ready. */
+	StreamDecoder(
+		audio_codec::ogg_vorbis::Decoder &decoder,
+		AddrSize blockSize,
+		int numBlocks = kDefaultNumBlocks,
+		ALDriver *driver = 0
+	);
+
+	~StreamDecoder();
+
+	//! Returns the oldest decoded block, or null if none are ready. Consumer thread only.
+	const Block *Front();
+	//! Releases the block returned by Front(). Consumer thread only.
+	void Pop();
+
+	//! Records a playback underrun in the counters. Consumer thread only.
+	void Underrun() {
+		++m_counters.numUnderruns;
+	}
+
+	//! Discards decoded blocks and restarts decoding at the start of the stream.
+	/*! The consumer must not be calling Front() or Pop() during a Rewind(). */
+	void Rewind();
+
+	RAD_DECLARE_PROPERTY(StreamDecoder, loop, bool, bool);
+	RAD_DECLARE_READONLY_PROPERTY(StreamDecoder, blockSize, AddrSize);
+	RAD_DECLARE_READONLY_PROPERTY(StreamDecoder, counters, const Counters*);
+
+protected:
+
+	virtual int ThreadProc();
+
+private:
+
+	typedef boost::mutex Mutex;
+	typedef boost::lock_guard<Mutex> Lock;
+
+	void Decode(Block &block);
+
+	RAD_DECLARE_GET(loop, bool) {
+		return m_loop;
+	}
+
+	RAD_DECLARE_SET(loop, bool) {
+		m_loop = value;
+	}
+
+	RAD_DECLARE_GET(blockSize, AddrSize) {
+		return m_blockSize;
+	}
+
+	RAD_DECLARE_GET(counters, const Counters*) {
+		return &m_counters;
+	}
+
+	audio_codec::ogg_vorbis::Decoder &m_decoder;
+	ALDriver *m_driver;
+	Block *m_blocks;
+	void *m_data;
+	AddrSize m_blockSize;
+	int m_numBlocks;
+	// [m_read, m_write) are decoded blocks owned by the consumer.
+	thread::Interlocked<U32> m_read;
+	thread::Interlocked<U32> m_write;
+	thread::Semaphore m_sema;
+	Mutex m_m;
+	Counters m_counters;
+	double m_totalDecodeMs;
+	double m_totalLatencyMs;
+	int m_numPopped;
+	volatile bool m_loop;
+	volatile bool m_eos;
+	volatile bool m_quit;
+};
+
+#include <Runtime/PopPack.h>
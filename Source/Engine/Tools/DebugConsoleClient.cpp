@@ -9,6 +9,7 @@
 #include "DebugConsoleClient.h"
 #include "../COut.h"
 #include <Runtime/Time.h>
+#include <Runtime/DataCodec/ZLib.h>
 
 namespace tools {
 
@@ -78,7 +79,7 @@ void DebugConsoleClient::ProcessMessages() {
 
 	if (s_broadcast) {
 		int len;
-		U8 buf[kDebugConsoleBroadcastPacketSize];
+		U8 buf[kDebugConsoleLogPacketSize];
 		sockaddr_in addr;
 
 		while((len=ReadBroadcastPacket(buf, sizeof(buf), addr)) > 0) {
@@ -99,7 +100,8 @@ void DebugConsoleClient::ProcessMessages() {
 				continue;
 
 			if ((cmds[2] != kDebugConsoleNetMessageId_Broadcast) &&
-				(cmds[2] != kDebugConsoleNetMessageId_Log)) {
+				(cmds[2] != kDebugConsoleNetMessageId_Log) &&
+				(cmds[2] != kDebugConsoleNetMessageId_LogBatch)) {
 				continue;
 			}
 
@@ -110,6 +112,9 @@ void DebugConsoleClient::ProcessMessages() {
 			case kDebugConsoleNetMessageId_Log:
 				HandleLogMessage(is, addr);
 				break;
+			case kDebugConsoleNetMessageId_LogBatch:
+				HandleLogBatch(is, addr);
+				break;
 			default:
 				break;
 			}
@@ -366,16 +371,74 @@ void DebugConsoleClient::HandleLogMessage(stream::InputStream &is, const sockadd
 	if (!is.Read(buf, (stream::SPos)len, 0))
 		return; // bad packet.
 
-	// See DebugConsoleServer.cpp DebugConsoleServer::SessionServer::BroadcastLogMessage()
 	// len is chars + null byte.
 	// RefTag string constructor wants null byte at len + 1
 	const String kMsg(buf, len - 1, string::RefTag);
+	DispatchLogMessage(kMsg, addr);
+}
+
+void DebugConsoleClient::HandleLogBatch(stream::InputStream &is, const sockaddr_in &addr) {
+
+	if (s_clients.empty())
+		return;
+
+	// See DebugConsoleServer.cpp DebugConsoleServer::SessionServer::SendLogPacket()
+	U32 flags, numDropped, numRecords, rawSize, size;
+
+	if (!is.Read(&flags) ||
+		!is.Read(&numDropped) ||
+		!is.Read(&numRecords) ||
+		!is.Read(&rawSize) ||
+		!is.Read(&size)) {
+		return; // bad packet.
+	}
+
+	if ((size > kDebugConsoleLogPacketSize) || (rawSize > kDebugConsoleLogBatchSize))
+		return; // bad packet.
+
+	if (numDropped > 0) {
+		char sz[128];
+		sprintf(sz, "DebugConsoleServer: %u log messages dropped.\n", numDropped);
+		DispatchLogMessage(String(sz, string::RefTag), addr);
+	}
+
+	U8 data[kDebugConsoleLogPacketSize];
+	if ((size > 0) && (is.Read(data, (stream::SPos)size, 0) != (stream::SPos)size))
+		return; // bad packet.
+
+	U8 raw[kDebugConsoleLogBatchSize];
+	const U8 *records = data;
+
+	if (flags & kDebugConsoleLogBatchFlag_Compressed) {
+		if (!size || !rawSize || !data_codec::zlib::Decode(data, size, raw, rawSize))
+			return; // bad packet.
+		records = raw;
+		size = rawSize;
+	}
+
+	// same layout as a kDebugConsoleNetMessageId_Log packet, once per record.
+	stream::MemInputBuffer ib(records, (stream::SPos)size);
+	stream::InputStream ris(ib);
+
+	for (U32 i = 0; i < numRecords; ++i) {
+		U32 len;
+		if (!ris.Read(&len) || (len < 1) || ((U32)ris.InPos() + len > size))
+			return; // bad packet.
+
+		const char *msg = (const char*)records + ris.InPos();
+		if (msg[len-1] || !ris.SeekIn(stream::StreamCur, (stream::SPos)len, 0))
+			return; // bad packet.
+
+		DispatchLogMessage(String(msg, (int)len - 1, string::RefTag), addr);
+	}
+}
 
+void DebugConsoleClient::DispatchLogMessage(const String &msg, const sockaddr_in &addr) {
 	// Find any active clients with matching IPs.
 	for (ClientSet::const_iterator it = s_clients.begin(); it != s_clients.end(); ++it) {
 		DebugConsoleClient *client = *it;
 		if (client->m_id.m_ip.s_addr == addr.sin_addr.s_addr) {
-			client->HandleLogMessage(kMsg);
+			client->HandleLogMessage(msg);
 		}
 	}
 }
@@ -110,6 +110,8 @@ private:
 	static int ReadBroadcastPacket(void *buf, int maxLen, sockaddr_in &addr);
 	static void HandleBroadcast(stream::InputStream &is, const sockaddr_in &addr);
 	static void HandleLogMessage(stream::InputStream &is, const sockaddr_in &addr);
+	static void HandleLogBatch(stream::InputStream &is, const sockaddr_in &addr);
+	static void DispatchLogMessage(const String &msg, const sockaddr_in &addr);
 	static int ConnectClient(const DebugConsoleServerId &id);
 
 	static net::Socket::Ref s_broadcast;
@@ -13,20 +13,26 @@ namespace tools {
 
 enum {
 	kDebugConsoleNetServerId = RAD_FOURCC_LE('r', 'r', 'd', 's'),
-	kDebugConsoleNetServerVersion = 1,
+	kDebugConsoleNetServerVersion = 2, // 2: log text is only sent in LogBatch packets
 	kDebugConsoleNetPort = 33331,
 	kDebugConsoleNetBroadcastPort = kDebugConsoleNetPort + 1,
 	kDebugConsoleNetMaxCommandLen = 4*kMeg,
 	kDebugConsoleBroadcastPacketSize = 512,
 	kDebugConsoleServerBroadcastFreq = 250,
-	kDebugConsoleServerExpiry = kDebugConsoleServerBroadcastFreq*8
+	kDebugConsoleServerExpiry = kDebugConsoleServerBroadcastFreq*8,
+	kDebugConsoleServerLogFlushFreq = 50,
+	kDebugConsoleLogPacketSize = 1400, // stays under the ethernet MTU
+	kDebugConsoleLogPacketHeaderSize = 8*sizeof(U32),
+	kDebugConsoleLogBatchSize = 8*kKilo, // log text packed into one compressed packet at most
+	kDebugConsoleLogBatchFlag_Compressed = 0x1
 };
 
 enum DebugConsoleNetMessageId {
 	kDebugConsoleNetMessageId_Broadcast,
 	kDebugConsoleNetMessageId_Log,
 	kDebugConsoleNetMessageId_Cmd,
-	kDebugConsoleNetMessageId_GetCVarList
+	kDebugConsoleNetMessageId_GetCVarList,
+	kDebugConsoleNetMessageId_LogBatch
 };
 
 }
\ No newline at end of file
@@ -11,9 +11,24 @@
 #include "../CVars.h"
 #include "../COut.h"
 #include <Runtime/Time.h>
+#include <Runtime/DataCodec/ZLib.h>
 
 namespace tools {
 
+namespace {
+
+sockaddr_in BroadcastAddr() {
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = net::GetLocalIP().s_addr;
+	addr.sin_addr.s_addr |= (0xffu<<24U); // broadcast address
+	addr.sin_port = htons(kDebugConsoleNetBroadcastPort);
+	return addr;
+}
+
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 DebugConsoleServer::SessionServer DebugConsoleServer::s_ss;
@@ -40,6 +55,14 @@ void DebugConsoleServer::BroadcastLogMessage(const char *msg) {
 	s_ss.BroadcastLogMessage(msg);
 }
 
+void DebugConsoleServer::SetLogCompression(bool compress) {
+	s_ss.compress = compress;
+}
+
+const DebugConsoleServer::LogCounters &DebugConsoleServer::Counters() {
+	return *s_ss.counters.get();
+}
+
 void DebugConsoleServer::DisconnectClients() {
 	Lock L(m_m);
 	m_clients.clear();
@@ -201,7 +224,23 @@ void DebugConsoleServer::Register(const Client::Ref &client) {
 
 ///////////////////////////////////////////////////////////////////////////////
 
-DebugConsoleServer::SessionServer::SessionServer() : m_nextSessionId(0), m_numActiveServers(0) {
+DebugConsoleServer::SessionServer::SessionServer() : 
+m_nextSessionId(0), 
+m_numActiveServers(0),
+m_logRead(0),
+m_logWrite(0),
+m_logDropped(0),
+m_logging(false),
+m_compress(false),
+m_logDroppedSent(0),
+m_logRecordLen(0),
+m_numLogBatchRecords(0),
+m_logZBuf(0),
+m_logZBufSize(0) {
+	for (int i = 0; i < kNumLogSlots; ++i)
+		m_log[i].seq = (U32)i;
+	m_logBatchOfs[0] = 0;
+	memset(&m_logCounters, 0, sizeof(m_logCounters));
 }
 
 DebugConsoleServer::SessionServer::~SessionServer() {
@@ -238,52 +277,176 @@ void DebugConsoleServer::SessionServer::Unregister(DebugConsoleServer *sv) {
 	DoBroadcast(); // update server list immediately.
 }
 
-void DebugConsoleServer::SessionServer::BroadcastLogMessage(const char *_msg) {
-	const String msg(CStr(_msg));
-
-	Lock L(m_m);
-	if (!m_broadcast)
+void DebugConsoleServer::SessionServer::BroadcastLogMessage(const char *msg) {
+	// runs on any thread that logs, this must never block or take a lock.
+	if (!m_logging)
 		return;
 
-	U8 buf[kDebugConsoleBroadcastPacketSize];
+	int len = (int)strlen(msg);
 
-	const char kNull = 0;
-	const char *ofs = _msg;
-	int bytesLeft = msg.numBytes;
+	while (len > 0) {
+		const int kLen = std::min(len, (int)kMaxLogMessage);
+		const U32 kNumSlots = (U32)((kLen + kLogSlotSize - 1) / kLogSlotSize);
 
-	while (bytesLeft > 0) {
-		stream::FixedMemOutputBuffer ob(buf, sizeof(buf));
-		stream::OutputStream os(ob);
+		if (((U32)m_logWrite - (U32)m_logRead) + kNumSlots > (U32)(kNumLogSlots - kLogSlack)) {
+			++m_logDropped;
+			return;
+		}
 
-		int bytesToStream = bytesLeft + 1; // always null terminated
-		if (bytesToStream > (sizeof(buf) - 16))
-			bytesToStream = sizeof(buf) - 16;
+		const U32 kFirst = (m_logWrite += kNumSlots) - kNumSlots;
 
-		RAD_ASSERT(bytesToStream);
-		
-		os << (U32)kDebugConsoleNetServerId;
-		os << (U32)kDebugConsoleNetServerVersion;
-		os << (U32)kDebugConsoleNetMessageId_Log;
-		os << (U32)bytesToStream;
+		for (U32 i = 0; i < kNumSlots; ++i) {
+			const U32 kTicket = kFirst + i;
+			LogSlot &slot = m_log[kTicket & kLogSlotMask];
+
+			// only waits if more than kLogSlack slots were reserved past a full ring at once.
+			while ((U32)slot.seq != kTicket)
+				thread::Yield();
+
+			const int kOfs = (int)i * kLogSlotSize;
+			slot.size = (U16)std::min(kLen - kOfs, (int)kLogSlotSize);
+			slot.last = (i+1) == kNumSlots;
+			memcpy(slot.data, msg + kOfs, slot.size);
+			slot.seq = kTicket + 1; // publish.
+		}
+
+		// wake the session server early when the ring is half full.
+		const U32 kQueued = (kFirst + kNumSlots) - (U32)m_logRead;
+		if ((kQueued >= kNumLogSlots/2) && ((kQueued - kNumSlots) < kNumLogSlots/2))
+			m_logSema.Put();
+
+		msg += kLen;
+		len -= kLen;
+	}
+}
+
+void DebugConsoleServer::SessionServer::SendLogMessages() {
+	m_logCounters.numDropped = (int)(U32)m_logDropped;
+
+	U32 read = m_logRead;
+
+	for (;;) {
+		LogSlot &slot = m_log[read & kLogSlotMask];
+		if ((U32)slot.seq != (read + 1))
+			break; // empty, or still being written.
+
+		RAD_ASSERT(m_logRecordLen + slot.size <= kMaxLogMessage);
+		memcpy(m_logRecord + m_logRecordLen, slot.data, slot.size);
+		m_logRecordLen += slot.size;
+		const bool kLast = slot.last;
+
+		slot.seq = read + kNumLogSlots; // free for the ticket one lap ahead.
+		m_logRead = ++read;
+
+		if (kLast) {
+			AddLogRecord(m_logRecord, m_logRecordLen);
+			m_logRecordLen = 0;
+		}
+	}
+
+	if (m_numLogBatchRecords || ((U32)m_logDropped != m_logDroppedSent))
+		FlushLogBatch();
+}
+
+void DebugConsoleServer::SessionServer::AddLogRecord(const char *msg, int len) {
+	++m_logCounters.numMessages;
+	m_logCounters.numBytes += (U64)len;
 
-		os.Write((const void*)ofs, bytesToStream - 1, 0);
+	const int kLimit = m_compress ? (int)kDebugConsoleLogBatchSize : (int)(kDebugConsoleLogPacketSize - kDebugConsoleLogPacketHeaderSize);
+
+	// a record always fits in one uncompressed packet, longer messages are split.
+	do {
+		const int kLen = std::min(len, (int)kMaxLogRecord);
+		const int kSize = (int)sizeof(U32) + kLen + 1;
+
+		if ((m_numLogBatchRecords == kMaxBatchRecords) || (m_logBatchOfs[m_numLogBatchRecords] + kSize > kLimit))
+			FlushLogBatch();
+
+		const int kOfs = m_logBatchOfs[m_numLogBatchRecords];
+		stream::FixedMemOutputBuffer ob(m_logBatch + kOfs, kSize);
+		stream::OutputStream os(ob);
+
+		const char kNull = 0;
+		os << (U32)(kLen + 1); // always null terminated.
+		os.Write((const void*)msg, kLen, 0);
 		os.Write((const void*)&kNull, 1, 0);
 
-		sockaddr_in addr;
-		addr.sin_family = AF_INET;
-		addr.sin_addr.s_addr = net::GetLocalIP().s_addr;
-		addr.sin_addr.s_addr |= (0xffu<<24U); // broadcast address
-		addr.sin_port = htons(kDebugConsoleNetBroadcastPort);
+		m_logBatchOfs[++m_numLogBatchRecords] = kOfs + kSize;
 
-		if (sendto(*m_broadcast, (const char*)buf, (int)os.OutPos(), 0, (const sockaddr*)&addr, sizeof(addr)) != (int)os.OutPos()) {
-			m_broadcast.reset(); // otherwise we recurse!
+		msg += kLen;
+		len -= kLen;
+	} while (len > 0);
+}
+
+void DebugConsoleServer::SessionServer::FlushLogBatch() {
+	if (m_broadcast) {
+		if (!SendLogBatch(0, m_numLogBatchRecords)) {
+			m_logging = false;
+			m_broadcast.reset(); // COut would queue the error for us forever.
 			COut(C_Error) << "ERROR: DebugConsoleServer: broadcast failed." << std::endl;
-			break;
 		}
+	}
 
-		ofs += bytesToStream - 1;
-		bytesLeft -= bytesToStream - 1;
+	m_numLogBatchRecords = 0;
+}
+
+bool DebugConsoleServer::SessionServer::SendLogBatch(int first, int last) {
+	const U8 *kData = m_logBatch + m_logBatchOfs[first];
+	const int kSize = m_logBatchOfs[last] - m_logBatchOfs[first];
+	const int kMaxData = kDebugConsoleLogPacketSize - kDebugConsoleLogPacketHeaderSize;
+
+	if (m_compress && (kSize > 0)) {
+		AddrSize zsize = data_codec::zlib::PredictEncodeSize((AddrSize)kSize);
+		if (zsize > m_logZBufSize) {
+			m_logZBuf = safe_zone_realloc(ZTools, m_logZBuf, zsize);
+			m_logZBufSize = zsize;
+		}
+
+		if (data_codec::zlib::Encode(kData, (AddrSize)kSize, data_codec::zlib::FastestCompression, m_logZBuf, &zsize) &&
+			((int)zsize < kSize) && ((int)zsize <= kMaxData)) {
+			return SendLogPacket(kDebugConsoleLogBatchFlag_Compressed, last-first, m_logZBuf, (int)zsize, kSize);
+		}
 	}
+
+	if ((kSize > kMaxData) && (last - first > 1)) {
+		// didn't compress enough, send it in halves.
+		const int kMid = first + (last - first) / 2;
+		return SendLogBatch(first, kMid) && SendLogBatch(kMid, last);
+	}
+
+	RAD_ASSERT(kSize <= kMaxData);
+	return SendLogPacket(0, last-first, kData, kSize, kSize);
+}
+
+bool DebugConsoleServer::SessionServer::SendLogPacket(U32 flags, int numRecords, const void *data, int size, int rawSize) {
+	U8 buf[kDebugConsoleLogPacketSize];
+	stream::FixedMemOutputBuffer ob(buf, sizeof(buf));
+	stream::OutputStream os(ob);
+
+	const U32 kDropped = m_logDropped;
+
+	os << (U32)kDebugConsoleNetServerId;
+	os << (U32)kDebugConsoleNetServerVersion;
+	os << (U32)kDebugConsoleNetMessageId_LogBatch;
+	os << flags;
+	os << (U32)(kDropped - m_logDroppedSent);
+	os << (U32)numRecords;
+	os << (U32)rawSize;
+	os << (U32)size;
+	RAD_ASSERT(os.OutPos() == kDebugConsoleLogPacketHeaderSize);
+
+	if (size > 0)
+		os.Write(data, (stream::SPos)size, 0);
+
+	const sockaddr_in kAddr = BroadcastAddr();
+
+	if (sendto(*m_broadcast, (const char*)buf, (int)os.OutPos(), 0, (const sockaddr*)&kAddr, sizeof(kAddr)) != (int)os.OutPos())
+		return false;
+
+	m_logDroppedSent = kDropped;
+	++m_logCounters.numPackets;
+	m_logCounters.numBytesSent += (U64)os.OutPos();
+	return true;
 }
 
 int DebugConsoleServer::SessionServer::ThreadProc() {
@@ -306,15 +469,24 @@ int DebugConsoleServer::SessionServer::ThreadProc() {
 		}
 
 		Accept();
+		SendLogMessages();
 		m_m.unlock();
-		thread::Sleep(200);
+		m_logSema.Get(kDebugConsoleServerLogFlushFreq, true);
 		++k;
 	}
 
+	m_logging = false;
+	SendLogMessages();
 	m_listen.reset();
 	m_broadcast.reset();
 	m_m.unlock();
 
+	if (m_logZBuf) {
+		zone_free(m_logZBuf);
+		m_logZBuf = 0;
+		m_logZBufSize = 0;
+	}
+
 	return 0;
 }
 
@@ -381,6 +553,7 @@ bool DebugConsoleServer::SessionServer::StartListening() {
 	m_broadcast.reset(new net::Socket(sd));
 	sd = -1; // don't close.
 
+	m_logging = true;
 	Run();
 
 	return true;
@@ -475,12 +648,7 @@ void DebugConsoleServer::SessionServer::DoBroadcast() {
 		os.Write(it->second->m_description, 0);
 	}
 
-	sockaddr_in addr;
-	memset(&addr, 0, sizeof(addr));
-	addr.sin_family = AF_INET;
-	addr.sin_addr.s_addr = net::GetLocalIP().s_addr;
-	addr.sin_addr.s_addr |= (0xffu<<24U); // broadcast address
-	addr.sin_port = htons(kDebugConsoleNetBroadcastPort);
+	const sockaddr_in addr = BroadcastAddr();
 	
 	if (sendto(*m_broadcast, (const char*)buf, (int)os.OutPos(), 0, (const sockaddr*)&addr, sizeof(addr)) != (int)os.OutPos()) {
 		COut(C_Error) << "ERROR: DebugConsoleServer: broadcast failed." << std::endl;
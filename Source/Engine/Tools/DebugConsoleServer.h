@@ -10,6 +10,7 @@
 #include <Runtime/Stream.h>
 #include <Runtime/Net/Socket.h>
 #include <Runtime/Thread.h>
+#include <Runtime/Thread/Interlocked.h>
 #include <Runtime/Container/ZoneSet.h>
 #include <Runtime/Container/ZoneMap.h>
 #include <Runtime/Container/ZoneVector.h>
@@ -24,11 +25,27 @@ class DebugConsoleServer : public boost::noncopyable {
 public:
 	typedef boost::shared_ptr<DebugConsoleServer> Ref;
 
+	//! Log transport counters, written by the session server thread without locking.
+	struct LogCounters {
+		int numMessages; //!< Messages sent.
+		int numDropped; //!< Messages dropped because the log ring was full.
+		int numPackets;
+		U64 numBytes; //!< Log text sent, before compression.
+		U64 numBytesSent; //!< Bytes sent including packet headers.
+	};
+
 	~DebugConsoleServer();
 
 	static Ref Start(const char *description, CVarZone *cvars);
+
+	//! Queues a log message for broadcast, never blocks on the network.
+	/*! Messages are dropped (and counted) if the session server falls behind. */
 	static void BroadcastLogMessage(const char *msg);
 
+	//! Compresses log packets, which packs more log text into each packet.
+	static void SetLogCompression(bool compress);
+	static const LogCounters &Counters();
+
 	void ProcessClients();
 	void SetDescription(const char *description);
 
@@ -64,22 +81,82 @@ private:
 		void Unregister(DebugConsoleServer *sv);
 		void BroadcastLogMessage(const char *msg);
 
+		RAD_DECLARE_PROPERTY(SessionServer, compress, bool, bool);
+		RAD_DECLARE_READONLY_PROPERTY(SessionServer, counters, const LogCounters*);
+
 	private:
+
+		enum {
+			kLogSlotSize = 120,
+			kNumLogSlots = 1024, // power of 2
+			kLogSlotMask = kNumLogSlots-1,
+			// slots left free for threads that pass the full check at the same time.
+			kLogSlack = 64,
+			kMaxLogMessage = kLogSlotSize*32, // longer messages are queued in pieces.
+			kMaxLogRecord = kDebugConsoleLogPacketSize - kDebugConsoleLogPacketHeaderSize - sizeof(U32) - 1,
+			kMaxBatchRecords = kDebugConsoleLogBatchSize / 8
+		};
+
+		//! A slot holds up to kLogSlotSize bytes of a message.
+		/*! A message fills consecutive slots, seq is the ticket that may use the slot next
+			(a producer writes when seq == ticket, the consumer reads when seq == ticket+1). */
+		struct LogSlot {
+			thread::Interlocked<U32> seq;
+			U16 size;
+			bool last;
+			char data[kLogSlotSize];
+		};
 		
 		bool StartListening();
 		void Accept();
 		void DoBroadcast();
 		void SendLogMessages();
+		void AddLogRecord(const char *msg, int len);
+		void FlushLogBatch();
+		bool SendLogBatch(int first, int last);
+		bool SendLogPacket(U32 flags, int numRecords, const void *data, int size, int rawSize);
 		void ConnectClient(int sd, const in_addr &addr);
 		
 		virtual int ThreadProc();
 
+		RAD_DECLARE_GET(compress, bool) {
+			return m_compress;
+		}
+
+		RAD_DECLARE_SET(compress, bool) {
+			m_compress = value;
+		}
+
+		RAD_DECLARE_GET(counters, const LogCounters*) {
+			return &m_logCounters;
+		}
+
 		Map m_servers;
 		Mutex m_m;
 		net::Socket::Ref m_listen;
 		net::Socket::Ref m_broadcast;
 		int m_nextSessionId;
 		volatile int m_numActiveServers;
+
+		// log ring, [m_logRead, m_logWrite) are queued (or being written) messages.
+		LogSlot m_log[kNumLogSlots];
+		thread::Interlocked<U32> m_logRead;
+		thread::Interlocked<U32> m_logWrite;
+		thread::Interlocked<U32> m_logDropped;
+		thread::Semaphore m_logSema;
+		volatile bool m_logging;
+		volatile bool m_compress;
+
+		// session server thread only.
+		LogCounters m_logCounters;
+		U32 m_logDroppedSent;
+		char m_logRecord[kMaxLogMessage];
+		int m_logRecordLen;
+		U8 m_logBatch[kDebugConsoleLogBatchSize];
+		int m_logBatchOfs[kMaxBatchRecords+1];
+		int m_numLogBatchRecords;
+		void *m_logZBuf;
+		AddrSize m_logZBufSize;
 	};
 
 	RAD_DECLARE_GET(sessionId, int) {
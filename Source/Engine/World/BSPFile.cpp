@@ -15,7 +15,7 @@ namespace bsp_file {
 
 enum  { 
 	kBspTag = RAD_FOURCC('b', 's', 'p', 't'),
-	kBspVersion  = 5
+	kBspVersion  = 6
 };
 
 RAD_ZONE_DEF(RADENG_API, ZBSPFile, "BSPFile", ZWorld);
@@ -42,6 +42,7 @@ m_waypointIndices(0),
 m_floors(0),
 m_floorTris(0),
 m_floorEdges(0),
+m_floorNodes(0),
 m_areaportalIndices(0),
 m_indices(0),
 m_actorIndices(0),
@@ -67,6 +68,7 @@ m_numWaypointConnections(0),
 m_numFloors(0),
 m_numFloorTris(0),
 m_numFloorEdges(0),
+m_numFloorNodes(0),
 m_numAreaportalIndices(0),
 m_numWaypointIndices(0),
 m_numModelIndices(0),
@@ -95,7 +97,7 @@ BSPFileParser::~BSPFileParser() {
 int BSPFileParser::Parse(const void *data, AddrSize len) {
 	// Read header
 	const U8 *bytes = reinterpret_cast<const U8*>(data);
-	CHECK_SIZE(sizeof(U32)*34);
+	CHECK_SIZE(sizeof(U32)*35);
 	U32 tag = *reinterpret_cast<const U32*>(bytes);
 	U32 version  = *reinterpret_cast<const U32*>(bytes+sizeof(U32));
 	if (tag != kBspTag || version != kBspVersion)
@@ -159,6 +161,9 @@ int BSPFileParser::Parse(const void *data, AddrSize len) {
 	m_numFloorEdges = *reinterpret_cast<const U32*>(bytes);
 	bytes += sizeof(U32);
 	
+	m_numFloorNodes = *reinterpret_cast<const U32*>(bytes);
+	bytes += sizeof(U32);
+	
 	m_numPlanes = *reinterpret_cast<const U32*>(bytes);
 	bytes += sizeof(U32);
 	
@@ -266,6 +271,10 @@ int BSPFileParser::Parse(const void *data, AddrSize len) {
 	m_floorEdges = reinterpret_cast<const BSPFloorEdge*>(bytes);
 	bytes += sizeof(BSPFloorEdge)*m_numFloorEdges;
 	
+	CHECK_SIZE(sizeof(BSPFloorNode)*m_numFloorNodes);
+	m_floorNodes = reinterpret_cast<const BSPFloorNode*>(bytes);
+	bytes += sizeof(BSPFloorNode)*m_numFloorNodes;
+	
 	CHECK_SIZE(sizeof(BSPPlane)*m_numPlanes);
 	m_planes = reinterpret_cast<const BSPPlane*>(bytes);
 	bytes += sizeof(BSPPlane)*m_numPlanes;
@@ -428,6 +437,7 @@ int BSPFileBuilder::Write(stream::OutputStream &os) {
 	os << (U32)m_floors.size();
 	os << (U32)m_floorTris.size();
 	os << (U32)m_floorEdges.size();
+	os << (U32)m_floorNodes.size();
 	os << (U32)m_planes.size();
 	os << (U32)m_vertices.size();
 	os << (U32)m_areaportalIndices.size();
@@ -507,6 +517,10 @@ int BSPFileBuilder::Write(stream::OutputStream &os) {
 	len = (stream::SPos)(sizeof(BSPFloorEdge)*m_floorEdges.size());
 	if (len && os.Write(&m_floorEdges[0], len, 0) != len)
 		return pkg::SR_IOError;
+
+	len = (stream::SPos)(sizeof(BSPFloorNode)*m_floorNodes.size());
+	if (len && os.Write(&m_floorNodes[0], len, 0) != len)
+		return pkg::SR_IOError;
 	
 	len = (stream::SPos)(sizeof(BSPPlane)*m_planes.size());
 	if (len && os.Write(&m_planes[0], len, 0) != len)
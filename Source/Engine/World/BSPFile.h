@@ -27,7 +27,8 @@ enum {
 	RAD_FLAG(kAffectedByWorldLights),
 	RAD_FLAG(kCastShadows),
 	RAD_FLAG(kSkyActor),
-	kMaxUVChannels = 2
+	kMaxUVChannels = 2,
+	kMaxFloorNodeTris = 4
 };
 
 /*
@@ -221,6 +222,8 @@ struct BSPFloor { // walkable surface
 	U32 name;
 	U32 firstTri;
 	U32 numTris;
+	U32 firstNode; // root of the floor's triangle tree
+	U32 numNodes;
 	S32 firstWaypoint;
 	S32 numWaypoints;
 };
@@ -239,6 +242,14 @@ struct BSPFloorEdge {
 	U32 planenum;
 };
 
+struct BSPFloorNode { // bounding volume tree over the triangles of a floor
+	float mins[3];
+	float maxs[3];
+	S32 children[2]; // -1 if leaf
+	U32 numTris;
+	U32 tris[kMaxFloorNodeTris]; // relative to BSPFloor::firstTri
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 
 class RADENG_CLASS BSPFile {
@@ -268,6 +279,7 @@ public:
 	RAD_DECLARE_READONLY_PROPERTY(BSPFile, numFloors, U32);
 	RAD_DECLARE_READONLY_PROPERTY(BSPFile, numFloorTris, U32);
 	RAD_DECLARE_READONLY_PROPERTY(BSPFile, numFloorEdges, U32);
+	RAD_DECLARE_READONLY_PROPERTY(BSPFile, numFloorNodes, U32);
 	RAD_DECLARE_READONLY_PROPERTY(BSPFile, numPlanes, U32);
 	RAD_DECLARE_READONLY_PROPERTY(BSPFile, numActors, U32);
 	RAD_DECLARE_READONLY_PROPERTY(BSPFile, numActorIndices, U32);
@@ -297,6 +309,7 @@ public:
 	virtual const BSPFloor *Floors() const = 0;
 	virtual const BSPFloorTri *FloorTris() const = 0;
 	virtual const BSPFloorEdge *FloorEdges() const = 0;
+	virtual const BSPFloorNode *FloorNodes() const = 0;
 	virtual const BSPPlane *Planes() const = 0;
 	virtual const BSPVertex *Vertices() const = 0;
 	virtual const U16 *Indices() const = 0;
@@ -335,6 +348,7 @@ protected:
 	virtual RAD_DECLARE_GET(numFloors, U32) = 0;
 	virtual RAD_DECLARE_GET(numFloorTris, U32) = 0;
 	virtual RAD_DECLARE_GET(numFloorEdges, U32) = 0;
+	virtual RAD_DECLARE_GET(numFloorNodes, U32) = 0;
 	virtual RAD_DECLARE_GET(numPlanes, U32) = 0;
 	virtual RAD_DECLARE_GET(numActors, U32) = 0;
 	virtual RAD_DECLARE_GET(numActorIndices, U32) = 0;
@@ -380,6 +394,7 @@ public:
 	virtual const BSPFloor *Floors() const;
 	virtual const BSPFloorTri *FloorTris() const;
 	virtual const BSPFloorEdge *FloorEdges() const;
+	virtual const BSPFloorNode *FloorNodes() const;
 	virtual const BSPPlane *Planes() const;
 	virtual const BSPVertex *Vertices() const;
 	virtual const BSPActor *Actors() const;
@@ -419,6 +434,7 @@ private:
 	virtual RAD_DECLARE_GET(numFloors, U32);
 	virtual RAD_DECLARE_GET(numFloorTris, U32);
 	virtual RAD_DECLARE_GET(numFloorEdges, U32);
+	virtual RAD_DECLARE_GET(numFloorNodes, U32);
 	virtual RAD_DECLARE_GET(numActorIndices, U32);
 	virtual RAD_DECLARE_GET(numActors, U32);
 	virtual RAD_DECLARE_GET(numPlanes, U32);
@@ -455,6 +471,7 @@ private:
 	const BSPFloor *m_floors;
 	const BSPFloorTri *m_floorTris;
 	const BSPFloorEdge *m_floorEdges;
+	const BSPFloorNode *m_floorNodes;
 	const U16 *m_indices;
 	const U32 *m_actorIndices;
 	const BSPActor *m_actors;
@@ -489,6 +506,7 @@ private:
 	U32 m_numFloors;
 	U32 m_numFloorTris;
 	U32 m_numFloorEdges;
+	U32 m_numFloorNodes;
 	U32 m_numActorIndices;
 	U32 m_numActors;
 	U32 m_numSkas;
@@ -530,6 +548,7 @@ public:
 	virtual const BSPFloor *Floors() const;
 	virtual const BSPFloorTri *FloorTris() const;
 	virtual const BSPFloorEdge *FloorEdges() const;
+	virtual const BSPFloorNode *FloorNodes() const;
 	virtual const BSPPlane *Planes() const;
 	virtual const BSPVertex *Vertices() const;
 	virtual const U16 *Indices() const;
@@ -568,6 +587,7 @@ public:
 	void ReserveFloors(int num);
 	void ReserveFloorTris(int num);
 	void ReserveFloorEdges(int num);
+	void ReserveFloorNodes(int num);
 	void ReserveActorIndices(int num);
 	void ReserveCameraTMs(int num);
 	void ReserveCameraTracks(int num);
@@ -601,6 +621,7 @@ public:
 	BSPFloor *AddFloor();
 	BSPFloorTri *AddFloorTri();
 	BSPFloorEdge *AddFloorEdge();
+	BSPFloorNode *AddFloorNode();
 	U16 *AddIndex();
 	U32 *AddActorIndex();
 	BSPCameraTM *AddCameraTM();
@@ -641,6 +662,7 @@ protected:
 	virtual RAD_DECLARE_GET(numFloors, U32);
 	virtual RAD_DECLARE_GET(numFloorTris, U32);
 	virtual RAD_DECLARE_GET(numFloorEdges, U32);
+	virtual RAD_DECLARE_GET(numFloorNodes, U32);
 	virtual RAD_DECLARE_GET(numPlanes, U32);
 	virtual RAD_DECLARE_GET(numCameraTMs, U32);
 	virtual RAD_DECLARE_GET(numCameraTracks, U32);
@@ -668,6 +690,7 @@ protected:
 	typedef zone_vector<BSPFloor, ZBSPBuilderT>::type BSPFloorVec;
 	typedef zone_vector<BSPFloorTri, ZBSPBuilderT>::type BSPFloorTriVec;
 	typedef zone_vector<BSPFloorEdge, ZBSPBuilderT>::type BSPFloorEdgeVec;
+	typedef zone_vector<BSPFloorNode, ZBSPBuilderT>::type BSPFloorNodeVec;
 	typedef zone_vector<U16, ZBSPBuilderT>::type BSPIndexVec;
 	typedef zone_vector<U32, ZBSPBuilderT>::type BSPActorIndexVec;
 	typedef zone_vector<BSPCameraTM, ZBSPBuilderT>::type BSPCameraTMVec;
@@ -701,6 +724,7 @@ protected:
 	BSPFloorVec m_floors;
 	BSPFloorTriVec m_floorTris;
 	BSPFloorEdgeVec m_floorEdges;
+	BSPFloorNodeVec m_floorNodes;
 	BSPIndexVec m_indices;
 	BSPActorIndexVec m_actorIndices;
 	BSPCameraTMVec m_cameraTMs;
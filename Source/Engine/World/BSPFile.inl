@@ -75,6 +75,10 @@ inline const BSPFloorEdge *BSPFileParser::FloorEdges() const {
 	return m_floorEdges;
 }
 
+inline const BSPFloorNode *BSPFileParser::FloorNodes() const {
+	return m_floorNodes;
+}
+
 inline const BSPPlane *BSPFileParser::Planes() const {
 	return m_planes;
 }
@@ -179,6 +183,10 @@ inline U32 BSPFileParser::RAD_IMPLEMENT_GET(numFloorEdges) {
 	return m_numFloorEdges;
 }
 
+inline U32 BSPFileParser::RAD_IMPLEMENT_GET(numFloorNodes) {
+	return m_numFloorNodes;
+}
+
 inline U32 BSPFileParser::RAD_IMPLEMENT_GET(numNodes) {
 	return m_numNodes;
 }
@@ -349,6 +357,10 @@ inline const BSPFloorEdge *BSPFileBuilder::FloorEdges() const {
 	return &m_floorEdges[0];
 }
 
+inline const BSPFloorNode *BSPFileBuilder::FloorNodes() const {
+	return &m_floorNodes[0];
+}
+
 inline const BSPPlane *BSPFileBuilder::Planes() const {
 	return &m_planes[0];
 }
@@ -420,6 +432,7 @@ inline void BSPFileBuilder::Clear() {
 	m_floors.clear();
 	m_floorTris.clear();
 	m_floorEdges.clear();
+	m_floorNodes.clear();
 	m_indices.clear();
 	m_actorIndices.clear();
 	m_cameraTMs.clear();
@@ -520,6 +533,10 @@ inline void BSPFileBuilder::ReserveFloorEdges(int num) {
 	m_floorEdges.reserve(m_floorEdges.size()+(size_t)num);
 }
 
+inline void BSPFileBuilder::ReserveFloorNodes(int num) {
+	m_floorNodes.reserve(m_floorNodes.size()+(size_t)num);
+}
+
 inline void BSPFileBuilder::ReserveIndices(int num) {
 	m_indices.reserve(m_indices.size()+(size_t)num);
 }
@@ -661,6 +678,11 @@ inline BSPFloorEdge *BSPFileBuilder::AddFloorEdge() {
 	return &m_floorEdges.back();
 }
 
+inline BSPFloorNode *BSPFileBuilder::AddFloorNode() {
+	m_floorNodes.resize(m_floorNodes.size()+1);
+	return &m_floorNodes.back();
+}
+
 inline BSPPlane *BSPFileBuilder::AddPlane() {
 	m_planes.resize(m_planes.size()+1);
 	return &m_planes.back();
@@ -776,6 +798,10 @@ inline U32 BSPFileBuilder::RAD_IMPLEMENT_GET(numFloorEdges) {
 	return (U32)m_floorEdges.size();
 }
 
+inline U32 BSPFileBuilder::RAD_IMPLEMENT_GET(numFloorNodes) {
+	return (U32)m_floorNodes.size();
+}
+
 inline U32 BSPFileBuilder::RAD_IMPLEMENT_GET(numClipModels) {
 	return (U32)m_clipModels.size();
 }
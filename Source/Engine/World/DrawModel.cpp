@@ -27,6 +27,7 @@ m_bounds(Vec3::Zero, Vec3::Zero),
 m_visible(true),
 m_markFrame(-1),
 m_visibleFrame(-1),
+m_tickIndex(-1),
 m_inView(false),
 m_attachBone(-1) {
 	m_draw = entity->world->draw;
@@ -96,6 +97,15 @@ void DrawModel::Tick(float time, float dt) {
 	}
 }
 
+void DrawModel::SyncTick() const {
+	const DrawModel *root = this;
+	for (SkMeshDrawModel::Ref parent = m_parent.lock(); parent; parent = parent->m_parent.lock())
+		root = parent.get();
+
+	if (root->m_tickIndex >= 0)
+		root->m_entity->world->SyncModelTick(*const_cast<DrawModel*>(root));
+}
+
 void DrawModel::BlendTo(const Vec4 &rgba, float time) {
 	if (time <= 0.f) {
 		m_fadeTime[1] = 0.f;
@@ -564,6 +574,7 @@ DrawModel::DrawBatch(model, matId), m_idx(idx), m_m(m) {
 }
 
 Vec3 SkMeshDrawModel::WorldBonePos(int idx) const {
+	SyncTick();
 	if (idx >= 0 && idx < m_mesh->ska->numBones) {
 		Vec3 bone = m_mesh->ska->BoneWorldMat(idx)[3];
 		Vec3 pos, rot;
@@ -578,6 +589,7 @@ Vec3 SkMeshDrawModel::WorldBonePos(int idx) const {
 }
 
 Vec3 SkMeshDrawModel::BonePos(int idx) const {
+	SyncTick();
 	if (idx >= 0 && idx < m_mesh->ska->numBones) {
 		Vec3 bone = m_mesh->ska->BoneWorldMat(idx)[3];
 		bone = (Mat4::Scaling(Scale3(scale)) * Mat4::Translation(pos)) * bone;
@@ -587,6 +599,7 @@ Vec3 SkMeshDrawModel::BonePos(int idx) const {
 }
 
 Mat4 SkMeshDrawModel::BoneMatrix(int idx) const {
+	SyncTick();
 	if (idx >= 0 && idx < m_mesh->ska->numBones) {
 		Mat4 bone = m_mesh->ska->BoneWorldMat(idx);
 		bone = bone * (Mat4::Scaling(Scale3(scale)) * Mat4::Translation(pos));
@@ -596,6 +609,7 @@ Mat4 SkMeshDrawModel::BoneMatrix(int idx) const {
 }
 
 Mat4 SkMeshDrawModel::WorldBoneMatrix(int idx) const {
+	SyncTick();
 	if (idx >= 0 && idx < m_mesh->ska->numBones) {
 		Mat4 bone = m_mesh->ska->BoneWorldMat(idx);
 		Vec3 pos, rot;
@@ -108,6 +108,10 @@ protected:
 
 	virtual void OnTick(float time, float dt) {}
 
+	//! Ticks the model tree now if its root has a tick queued for this frame.
+	/*! Call before reading state written by Tick(), such as bone matrices. */
+	void SyncTick() const;
+
 	virtual int lua_PushMaterialList(lua_State *L) = 0;
 
 	Vec m_children;
@@ -199,6 +203,7 @@ private:
 	WorldDraw *m_draw;
 	int m_markFrame;
 	int m_visibleFrame;
+	int m_tickIndex; // queued tick in World::m_modelTicks, -1 if none.
 	bool m_visible;
 	bool m_inView; // set by renderer
 };
@@ -239,6 +244,10 @@ private:
 		virtual void FlushArrayStates(r::Shader *shader);
 		virtual void Draw();
 
+		virtual RAD_DECLARE_GET(numTris, int) {
+			return m_m->NumTris();
+		}
+
 	private:
 		r::Mesh::Ref m_m;
 	};
@@ -287,6 +296,10 @@ private:
 		virtual void FlushArrayStates(r::Shader *shader);
 		virtual void Draw();
 
+		virtual RAD_DECLARE_GET(numTris, int) {
+			return m_m->NumTris();
+		}
+
 	private:
 		r::Mesh::Ref m_m;
 	};
@@ -380,6 +393,10 @@ private:
 		virtual void FlushArrayStates(r::Shader *shader);
 		virtual void Draw();
 
+		virtual RAD_DECLARE_GET(numTris, int) {
+			return m_m->Mesh(m_idx).NumTris();
+		}
+
 	private:
 		int m_idx;
 		r::SkMesh::Ref m_m;
@@ -453,6 +470,10 @@ private:
 		virtual void FlushArrayStates(r::Shader *shader);
 		virtual void Draw();
 
+		virtual RAD_DECLARE_GET(numTris, int) {
+			return m_m->Mesh(m_idx).NumTris();
+		}
+
 	private:
 		int m_idx;
 		r::VtMesh::Ref m_m;
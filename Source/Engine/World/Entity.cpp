@@ -277,9 +277,11 @@ void Entity::PrivateTick(
 }
 
 void Entity::TickDrawModels(float dt) {
+	float time = App::Get()->time;
 	for (DrawModel::Map::const_iterator it = m_models.begin(); it != m_models.end(); ++it) {
 		if (it->second->m_parent._empty()) { // roots tick their children
-			it->second->Tick(App::Get()->time, dt);
+			if (!world->QueueModelTick(it->second, time, dt))
+				it->second->Tick(time, dt);
 		}
 	}
 }
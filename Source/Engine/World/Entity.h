@@ -516,10 +516,11 @@ private:
 	TickQueue<Entity> m_scriptTasks;
 	DrawModel::Map m_models;
 	dBSPLeaf::PtrVec m_bspLeafs;
+	EntityLinkList::LinkVec m_links; // leaf and area membership.
 
 	Vec m_children;
 	Attachment m_parent;
-	IntSet m_areas;
+	IntVec m_areas;
 	SoundMap m_sounds;
 	ZoneTagWRef m_zoneTag;
 	String m_targetname;
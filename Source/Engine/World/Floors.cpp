@@ -8,6 +8,9 @@
 #include RADPCH
 #include "Floors.h"
 #include "World.h"
+#include <Runtime/Time.h>
+#include <algorithm>
+#include <iostream>
 #include <limits>
 
 namespace world {
@@ -247,7 +250,12 @@ bool FloorMove::ClampToEnd(State &state, bool posUpdate) {
 
 ///////////////////////////////////////////////////////////////////////////////
 
-Floors::Floors() : m_floodNum(-1), m_world(0) {
+Floors::Floors() : 
+m_world(0), 
+m_routeCacheUse(0), 
+m_searchNum(0), 
+m_floodNum(-1), 
+m_islandsValid(false) {
 }
 
 Floors::~Floors() {
@@ -291,6 +299,16 @@ bool Floors::Load(const bsp_file::BSPFile &bsp) {
 
 	m_floorState.resize(m_bsp->numFloors, 0);
 
+	SearchNode node;
+	node.g = 0.f;
+	node.parent = -1;
+	node.connection = -1;
+	node.query = -1;
+	node.closed = false;
+	m_searchNodes.resize(m_bsp->numWaypoints, node);
+	
+	InvalidatePlans();
+
 	return true;
 }
 
@@ -328,12 +346,16 @@ FloorMove::Ref Floors::CreateMove(
 	const FloorPosition &start,
 	const FloorPosition &end
 ) const {
+	FloorMove::Ref move(new (ZWorld) FloorMove());
+	if (FindCachedRoute(start, end, move->m_route))
+		return move;
+
 	WalkStep::Vec route;
 	if (!Walk(start, end, route))
 		return FloorMove::Ref();
 
-	FloorMove::Ref move(new (ZWorld) FloorMove());
 	GenerateFloorMove(route, move->m_route);
+	CacheRoute(start, end, move->m_route);
 	return move;
 }
 
@@ -420,7 +442,10 @@ void Floors::SetWaypointState(int waypoint, int state) {
 	if (waypoint < 0 || (waypoint >= (int)m_waypoints.size()))
 		return;
 
-	m_waypoints[waypoint].flags = state;
+	if (m_waypoints[waypoint].flags != state) {
+		m_waypoints[waypoint].flags = state;
+		InvalidatePlans();
+	}
 }
 
 IntVec Floors::WaypointsForTargetname(const char *targetname) const {
@@ -476,10 +501,12 @@ int Floors::PickWaypoint(
 		}
 	};
 
-	Trace trace;
+	typedef stackify<zone_vector<Trace, ZWorldT>::type, 16> TraceVec;
+
 	const Vec3 &fwd = m_world->camera->fwd;
 
-	Candidate::Vec waypoints;
+	Candidate::Vec candidates;
+	TraceVec traces;
 
 	for (U32 i = 0; i < m_bsp->numWaypoints; ++i) {
 		if (!(m_waypoints[i].flags&kWaypointState_Enabled))
@@ -497,17 +524,31 @@ int Floors::PickWaypoint(
 
 		if (dd <= d) {
 			// check line of sight
+			Trace trace;
 			trace.start = m_world->camera->pos;
 			trace.end = kPos;
 			trace.contents = bsp_file::kContentsFlag_SolidContents|bsp_file::kContentsFlag_Clip;
-			if (!m_world->LineTrace(trace)) {
-				// did not collide with world
-				Candidate c;
-				c.idx = (int)i;
-				c.dd = dd;
-				c.dist = fwd.Dot(kPos);
-				waypoints->push_back(c);
-			}
+			traces->push_back(trace);
+
+			Candidate c;
+			c.idx = (int)i;
+			c.dd = dd;
+			c.dist = fwd.Dot(kPos);
+			candidates->push_back(c);
+		}
+	}
+
+	Candidate::Vec waypoints;
+
+	if (!traces->empty()) {
+		// keep the waypoints whose line of sight did not collide with world.
+		stackify<zone_vector<U8, ZWorldT>::type, 16> blocked;
+		blocked->resize(traces->size());
+		m_world->LineTraces(&traces[0], (int)traces->size(), &blocked[0]);
+
+		for (int i = 0; i < (int)traces->size(); ++i) {
+			if (!blocked[i])
+				waypoints->push_back(candidates[i]);
 		}
 	}
 
@@ -572,8 +613,10 @@ int Floors::FloorState(int floor) const {
 }
 
 void Floors::SetFloorState(int floor, int state) {
-	if (floor >= 0 && (floor < (int)m_floorState.size()))
+	if (floor >= 0 && (floor < (int)m_floorState.size()) && (m_floorState[floor] != state)) {
 		m_floorState[floor] = state;
+		InvalidatePlans();
+	}
 }
 
 void Floors::WalkFloor(
@@ -1006,10 +1049,6 @@ bool Floors::Walk(
 	WalkStep::Vec &walkRoute
 ) const {
 	MovePlan plan;
-	MovePlan planStack;
-	FloorBits floors;
-	WaypointBits waypoints;
-	float bestDistance = std::numeric_limits<float>::max();
 
 	// A floor move never sets the triangle number since motion along the move is arbitrary
 	// and doing a floor intersection test is expensive for every move step. We can fill this 
@@ -1050,8 +1089,7 @@ bool Floors::Walk(
 		}
 	}
 
-	++m_floodNum;
-	if (!PlanMove(start, end, 0.f, plan, planStack, floors, waypoints, bestDistance))
+	if (!PlanMove(start, end, plan))
 		return false; // there is no path between these points.
 
 	// We have a rough movement plan from start->end, build the walk command
@@ -1291,7 +1329,323 @@ void Floors::GenerateFloorMove(const WalkStep::Vec &walkRoute, FloorMove::Route
 	}
 }
 
-inline bool Floors::PlanMove(
+bool Floors::PlanMove(
+	const FloorPosition &start,
+	const FloorPosition &end,
+	MovePlan &plan
+) const {
+	plan.start = start;
+	plan.end = end;
+	plan.steps->clear();
+
+	if ((start.m_waypoint != -1) && (start.m_waypoint == end.m_waypoint))
+		return true; // at destination
+	if ((start.m_floor != -1) && (start.m_floor == end.m_floor) && (end.m_waypoint == -1))
+		return true; // at destination.
+
+	if (!IslandsConnected(start, end))
+		return false;
+
+	++m_searchNum;
+	m_openList.clear();
+
+	SearchGoal goal;
+	goal.g = std::numeric_limits<float>::max();
+	goal.parent = -1;
+
+	if (start.m_waypoint != -1) {
+		SearchNode &node = m_searchNodes[start.m_waypoint];
+		node.g = 0.f;
+		node.parent = -1;
+		node.connection = -1;
+		node.query = m_searchNum;
+		node.closed = true;
+		ExpandWaypoint(start.m_waypoint, 0.f, end, goal, true);
+	} else {
+		// at an arbitrary position on a floor
+		RAD_ASSERT(start.m_floor != -1);
+		ExpandFloor(start.m_floor, -1, 0.f, start.m_pos, end);
+	}
+
+	bool found = false;
+
+	while (!m_openList.empty()) {
+		std::pop_heap(m_openList.begin(), m_openList.end());
+		const OpenNode kOpen = m_openList.back();
+		m_openList.pop_back();
+
+		if (kOpen.waypoint == -1) {
+			if (kOpen.g > goal.g)
+				continue; // a shorter way onto the floor was found since.
+			found = true;
+			break;
+		}
+
+		SearchNode &node = m_searchNodes[kOpen.waypoint];
+		if (node.closed || (kOpen.g > node.g))
+			continue; // already reached a shorter way.
+
+		node.closed = true;
+
+		if (kOpen.waypoint == end.m_waypoint) {
+			goal.parent = kOpen.waypoint;
+			found = true;
+			break;
+		}
+
+		ExpandWaypoint(kOpen.waypoint, kOpen.g, end, goal, false);
+	}
+
+	if (!found)
+		return false;
+
+	for (int idx = goal.parent; (idx != -1) && (idx != start.m_waypoint); idx = m_searchNodes[idx].parent) {
+		MoveStep step;
+		step.waypoint = idx;
+		step.connection = m_searchNodes[idx].connection;
+		plan.steps->push_back(step);
+	}
+
+	std::reverse(plan.steps->begin(), plan.steps->end());
+	return true;
+}
+
+void Floors::ExpandWaypoint(
+	int waypointIdx,
+	float g,
+	const FloorPosition &end,
+	SearchGoal &goal,
+	bool start
+) const {
+	const bsp_file::BSPWaypoint *waypoint = m_bsp->Waypoints() + waypointIdx;
+	const Vec3 kPos(WaypointPos(waypointIdx));
+
+	for (U32 i = 0; i < waypoint->numConnections; ++i) {
+		int connectionIdx = (int)*(m_bsp->WaypointIndices() + waypoint->firstConnection + i);
+		const bsp_file::BSPWaypointConnection *connection = m_bsp->WaypointConnections() + connectionIdx;
+			
+		int dir = connection->waypoints[0] == (U32)waypointIdx;
+		int nextWaypointIdx = (int)connection->waypoints[dir];
+
+		// waypoint is not enabled?
+		if (!(m_waypoints[nextWaypointIdx].flags&kWaypointState_Enabled))
+			continue;
+		if ((dir == 1) && !(connection->flags&bsp_file::kWaypointConnectionFlag_AtoB))
+			continue; // cannot go this way.
+		if ((dir == 0) && !(connection->flags&bsp_file::kWaypointConnectionFlag_BtoA))
+			continue; // cannot go this way.
+
+		SearchWaypoint(
+			nextWaypointIdx, 
+			waypointIdx, 
+			connectionIdx, 
+			g + (WaypointPos(nextWaypointIdx) - kPos).Magnitude(), 
+			end
+		);
+	}
+
+	if (waypoint->floorNum < 0)
+		return;
+
+	if ((end.m_waypoint == -1) && (waypoint->floorNum == end.m_floor)) {
+		// we are traveling to an arbitrary spot on this floor.
+		float distance = g + (end.m_pos - kPos).Magnitude();
+		if (distance < goal.g) {
+			goal.g = distance;
+			goal.parent = waypointIdx;
+
+			OpenNode open;
+			open.f = distance;
+			open.g = distance;
+			open.waypoint = -1;
+			m_openList.push_back(open);
+			std::push_heap(m_openList.begin(), m_openList.end());
+		}
+	}
+
+	// a move can always leave the floor it starts on.
+	if (start || (m_floorState[waypoint->floorNum]&kFloorState_Enabled))
+		ExpandFloor(waypoint->floorNum, waypointIdx, g, kPos, end);
+}
+
+void Floors::ExpandFloor(
+	int floorNum,
+	int fromWaypoint,
+	float g,
+	const Vec3 &pos,
+	const FloorPosition &end
+) const {
+	const bsp_file::BSPFloor *floor = m_bsp->Floors() + floorNum;
+
+	for (S32 i = 0; i < floor->numWaypoints; ++i) {
+		int nextWaypointIdx = (int)*(m_bsp->WaypointIndices() + floor->firstWaypoint + i);
+
+		if (nextWaypointIdx == fromWaypoint)
+			continue; // don't add ourselves
+
+		// waypoint is not enabled?
+		if (!(m_waypoints[nextWaypointIdx].flags&kWaypointState_Enabled))
+			continue;
+
+		SearchWaypoint(
+			nextWaypointIdx, 
+			fromWaypoint, 
+			-1, 
+			g + (WaypointPos(nextWaypointIdx) - pos).Magnitude(), 
+			end
+		);
+	}
+}
+
+void Floors::SearchWaypoint(
+	int waypointIdx,
+	int fromWaypoint,
+	int connection,
+	float g,
+	const FloorPosition &end
+) const {
+	SearchNode &node = m_searchNodes[waypointIdx];
+	if (node.query != m_searchNum) {
+		node.query = m_searchNum;
+		node.closed = false;
+		node.g = std::numeric_limits<float>::max();
+	}
+
+	if (node.closed || (g >= node.g))
+		return;
+
+	node.g = g;
+	node.parent = fromWaypoint;
+	node.connection = connection;
+
+	// straight line distance never overestimates.
+	OpenNode open;
+	open.g = g;
+	open.f = g + (end.m_pos - WaypointPos(waypointIdx)).Magnitude();
+	open.waypoint = waypointIdx;
+	m_openList.push_back(open);
+	std::push_heap(m_openList.begin(), m_openList.end());
+}
+
+Vec3 Floors::WaypointPos(int waypointIdx) const {
+	const bsp_file::BSPWaypoint *waypoint = m_bsp->Waypoints() + waypointIdx;
+	return Vec3(waypoint->pos[0], waypoint->pos[1], waypoint->pos[2]);
+}
+
+bool Floors::IslandsConnected(const FloorPosition &start, const FloorPosition &end) const {
+	if (!m_islandsValid)
+		BuildIslands();
+
+	const int kNumWaypoints = (int)m_waypoints.size();
+	int a = (start.m_waypoint != -1) ? start.m_waypoint : (kNumWaypoints + start.m_floor);
+	int b = (end.m_waypoint != -1) ? end.m_waypoint : (kNumWaypoints + end.m_floor);
+
+	if ((a < 0) || (b < 0))
+		return false;
+
+	return FindIsland(a) == FindIsland(b);
+}
+
+void Floors::BuildIslands() const {
+	const int kNumWaypoints = (int)m_waypoints.size();
+	const int kNumNodes = kNumWaypoints + (int)m_floorState.size();
+
+	m_islands.resize(kNumNodes);
+	for (int i = 0; i < kNumNodes; ++i)
+		m_islands[i] = i;
+
+	// Joins anything a search could cross so islands never separate a path, a move 
+	// can start on a disabled waypoint or floor.
+	for (int i = 0; i < kNumWaypoints; ++i) {
+		const bsp_file::BSPWaypoint *waypoint = m_bsp->Waypoints() + i;
+
+		if (waypoint->floorNum >= 0) {
+			int a = FindIsland(i);
+			int b = FindIsland(kNumWaypoints + waypoint->floorNum);
+			m_islands[a] = b;
+		}
+
+		for (U32 k = 0; k < waypoint->numConnections; ++k) {
+			int connectionIdx = (int)*(m_bsp->WaypointIndices() + waypoint->firstConnection + k);
+			const bsp_file::BSPWaypointConnection *connection = m_bsp->WaypointConnections() + connectionIdx;
+			
+			int other = (int)connection->waypoints[connection->waypoints[0] == (U32)i];
+			if (!(m_waypoints[other].flags&kWaypointState_Enabled) && !(m_waypoints[i].flags&kWaypointState_Enabled))
+				continue;
+			if (!(connection->flags&(bsp_file::kWaypointConnectionFlag_AtoB|bsp_file::kWaypointConnectionFlag_BtoA)))
+				continue;
+
+			int a = FindIsland(i);
+			int b = FindIsland(other);
+			m_islands[a] = b;
+		}
+	}
+
+	m_islandsValid = true;
+}
+
+int Floors::FindIsland(int node) const {
+	while (m_islands[node] != node) {
+		m_islands[node] = m_islands[m_islands[node]]; // path halving
+		node = m_islands[node];
+	}
+	return node;
+}
+
+bool Floors::FindCachedRoute(const FloorPosition &start, const FloorPosition &end, FloorMove::Route &route) const {
+	for (CachedRoute::Vec::iterator it = m_routeCache.begin(); it != m_routeCache.end(); ++it) {
+		CachedRoute &cached = *it;
+		if (!SameRouteEndpoint(cached.start, start) || !SameRouteEndpoint(cached.end, end))
+			continue;
+
+		cached.lastUse = ++m_routeCacheUse;
+		route = cached.route;
+		return true;
+	}
+
+	return false;
+}
+
+bool Floors::SameRouteEndpoint(const FloorPosition &a, const FloorPosition &b) {
+	if (a.m_waypoint != b.m_waypoint)
+		return false;
+
+	// Walk() moves waypoint endpoints onto the waypoint, whatever their floor and position.
+	if (a.m_waypoint != -1)
+		return true;
+
+	return (a.m_floor == b.m_floor) && (a.m_tri == b.m_tri) && (a.m_pos == b.m_pos);
+}
+
+void Floors::CacheRoute(const FloorPosition &start, const FloorPosition &end, const FloorMove::Route &route) const {
+	CachedRoute *cached;
+
+	if (m_routeCache.size() < kRouteCacheSize) {
+		m_routeCache.resize(m_routeCache.size()+1);
+		cached = &m_routeCache.back();
+	} else {
+		// replace the least recently used route.
+		cached = &m_routeCache[0];
+		for (CachedRoute::Vec::iterator it = m_routeCache.begin()+1; it != m_routeCache.end(); ++it) {
+			if (it->lastUse < cached->lastUse)
+				cached = &(*it);
+		}
+	}
+
+	cached->start = start;
+	cached->end = end;
+	cached->route = route;
+	cached->lastUse = ++m_routeCacheUse;
+}
+
+void Floors::InvalidatePlans() {
+	m_routeCache.clear();
+	m_islandsValid = false;
+}
+
+#if defined(RAD_OPT_TOOLS)
+
+bool Floors::FloodPlanMove(
 	const FloorPosition &start,
 	const FloorPosition &end,
 	float distance,
@@ -1675,6 +2029,129 @@ inline bool Floors::PlanMove(
 	return foundPath;
 }
 
+float Floors::PlanLength(const MovePlan &plan) const {
+	float length = 0.f;
+	Vec3 pos(plan.start.m_pos);
+
+	for (MoveStep::Vec::const_iterator it = plan.steps->begin(); it != plan.steps->end(); ++it) {
+		const Vec3 kPos(WaypointPos((*it).waypoint));
+		length += (kPos - pos).Magnitude();
+		pos = kPos;
+	}
+
+	if (plan.end.m_waypoint == -1)
+		length += (plan.end.m_pos - pos).Magnitude();
+
+	return length;
+}
+
+bool Floors::PlanBenchmark(std::ostream &out) const {
+	IntVec waypoints;
+	for (int i = 0; i < (int)m_waypoints.size(); ++i) {
+		if (m_waypoints[i].flags&kWaypointState_Enabled)
+			waypoints.push_back(i);
+	}
+
+	out << "******** Floors::PlanBenchmark ********" << std::endl;
+	out << waypoints.size() << " enabled waypoint(s), " << m_floorState.size() << " floor(s)" << std::endl;
+
+	double floodMs = 0.0;
+	double aStarMs = 0.0;
+	double floodLength = 0.0;
+	double aStarLength = 0.0;
+	int numQueries = 0;
+	int numRoutes = 0;
+	int numMissed = 0; // routed by the flood planner only.
+	int numFloodMissed = 0; // routed by A* only.
+	int numShorter = 0;
+	int numLonger = 0;
+
+	for (IntVec::const_iterator a = waypoints.begin(); a != waypoints.end(); ++a) {
+		FloorPosition start;
+		start.m_waypoint = *a;
+		start.m_floor = (int)m_bsp->Waypoints()[*a].floorNum;
+		start.m_tri = (int)m_bsp->Waypoints()[*a].triNum;
+		start.m_nextWaypoint = -1;
+		start.m_pos = WaypointPos(*a);
+
+		for (IntVec::const_iterator b = waypoints.begin(); b != waypoints.end(); ++b) {
+			if (a == b)
+				continue;
+
+			FloorPosition end;
+			end.m_waypoint = *b;
+			end.m_floor = (int)m_bsp->Waypoints()[*b].floorNum;
+			end.m_tri = (int)m_bsp->Waypoints()[*b].triNum;
+			end.m_nextWaypoint = -1;
+			end.m_pos = WaypointPos(*b);
+
+			MovePlan floodPlan;
+			MovePlan planStack;
+			FloorBits floors;
+			WaypointBits visited;
+			float bestDistance = std::numeric_limits<float>::max();
+
+			xtime::MicroTimer timer;
+			timer.Start();
+			++m_floodNum;
+			bool floodFound = FloodPlanMove(start, end, 0.f, floodPlan, planStack, floors, visited, bestDistance);
+			timer.Stop();
+			floodMs += timer.Elapsed() / 1000.0;
+
+			MovePlan aStarPlan;
+			timer.Start();
+			bool aStarFound = PlanMove(start, end, aStarPlan);
+			timer.Stop();
+			aStarMs += timer.Elapsed() / 1000.0;
+
+			++numQueries;
+
+			if (floodFound != aStarFound) {
+				if (floodFound) {
+					++numMissed;
+				} else {
+					++numFloodMissed;
+				}
+				continue;
+			}
+
+			if (!floodFound)
+				continue;
+
+			// the flood planner starts its plan at the start waypoint.
+			floodPlan.start = start;
+			floodPlan.end = end;
+
+			const float kFloodLength = PlanLength(floodPlan);
+			const float kAStarLength = PlanLength(aStarPlan);
+
+			floodLength += kFloodLength;
+			aStarLength += kAStarLength;
+			++numRoutes;
+
+			if (kAStarLength < (kFloodLength - 0.1f)) {
+				++numShorter;
+			} else if (kAStarLength > (kFloodLength + 0.1f)) {
+				++numLonger;
+			}
+		}
+	}
+
+	if (numQueries < 1)
+		return true;
+
+	out << numQueries << " queries, " << numRoutes << " routed by both planners, " << numMissed << " missed by A*, " << numFloodMissed << " missed by flood" << std::endl;
+	out << "flood: " << (floodMs * 1000.0 / numQueries) << " us/query, total route length " << floodLength << std::endl;
+	out << "A*: " << (aStarMs * 1000.0 / numQueries) << " us/query, total route length " << aStarLength << std::endl;
+	out << "A* routes shorter: " << numShorter << ", longer: " << numLonger << std::endl;
+	if (aStarMs > 0.0)
+		out << "speedup: " << (floodMs / aStarMs) << "x" << std::endl;
+
+	return (numMissed == 0) && (numLonger == 0);
+}
+
+#endif
+
 bool Floors::ClipToFloor(
 	U32 floorNum,
 	const Vec3 &start,
@@ -1682,73 +2159,154 @@ bool Floors::ClipToFloor(
 	FloorPosition &pos,
 	float &bestDistSq
 ) const {
-	// TODO: optimize this with a AA BSP
 	const bsp_file::BSPFloor *floor = m_bsp->Floors() + floorNum;
-	Trace trace;
-
+	
 	RAD_ASSERT(floor->numTris > 0);
+	RAD_ASSERT(floor->numNodes > 0);
+
+	const Vec3 kDir(end - start);
+	const float kLenSq = kDir.MagnitudeSquared();
 
 	int bestTri = -1;
 
-	for (U32 i = 0; i < floor->numTris; ++i) {
-		U32 triNum = floor->firstTri + i;
-		const bsp_file::BSPFloorTri *tri = m_bsp->FloorTris() + triNum;
+	// nearest node first so closer triangles tighten bestDistSq early.
+	enum { kMaxStack = 64 };
+	U32 stack[kMaxStack];
+	int stackSize = 1;
+	stack[0] = floor->firstNode;
 
-		const bsp_file::BSPPlane *plane = m_bsp->Planes() + tri->planenum;
-		const Plane kTriPlane(plane->p[0], plane->p[1], plane->p[2], plane->p[3]);
+	while (stackSize > 0) {
+		const bsp_file::BSPFloorNode *node = m_bsp->FloorNodes() + stack[--stackSize];
 
-		Vec3 clip;
+		float t;
+		if (!ClipToFloorNode(*node, start, kDir, t))
+			continue;
+		if ((t*t*kLenSq) >= bestDistSq)
+			continue; // can't be better
 
-		if (!kTriPlane.IntersectLineSegment(clip, start, end, 0.01f))
+		if (node->children[0] == -1) {
+			for (U32 i = 0; i < node->numTris; ++i) {
+				if (ClipToFloorTri(floorNum, node->tris[i], start, end, pos, bestDistSq))
+					bestTri = (int)node->tris[i];
+			}
 			continue;
+		}
+
+		RAD_ASSERT((stackSize+2) <= kMaxStack);
+
+		float t0, t1;
+		const bsp_file::BSPFloorNode *nodes = m_bsp->FloorNodes();
+		bool hit0 = ClipToFloorNode(nodes[node->children[0]], start, kDir, t0);
+		bool hit1 = ClipToFloorNode(nodes[node->children[1]], start, kDir, t1);
+
+		if (hit0 && hit1) {
+			int nearChild = (t0 <= t1) ? 0 : 1;
+			stack[stackSize++] = (U32)node->children[nearChild^1];
+			stack[stackSize++] = (U32)node->children[nearChild];
+		} else if (hit0) {
+			stack[stackSize++] = (U32)node->children[0];
+		} else if (hit1) {
+			stack[stackSize++] = (U32)node->children[1];
+		}
+	}
+
+	return bestTri != -1;
+}
 
-		float distSq = (clip-start).MagnitudeSquared();
-		if (distSq >= bestDistSq) // can't be better
+bool Floors::ClipToFloorNode(
+	const bsp_file::BSPFloorNode &node,
+	const Vec3 &start,
+	const Vec3 &dir,
+	float &t
+) {
+	float tmin = 0.f;
+	float tmax = 1.f;
+
+	for (int i = 0; i < 3; ++i) {
+		if (math::Abs(dir[i]) < 0.0001f) {
+			if ((start[i] < node.mins[i]) || (start[i] > node.maxs[i]))
+				return false;
 			continue;
+		}
 
-		int k;
-		
-		for (k = 0; k < 3; ++k) {
-			const bsp_file::BSPFloorEdge *edge = m_bsp->FloorEdges() + tri->edges[k];
-			plane = m_bsp->Planes() + edge->planenum;
+		const float kInvDir = 1.f / dir[i];
+		float t0 = (node.mins[i] - start[i]) * kInvDir;
+		float t1 = (node.maxs[i] - start[i]) * kInvDir;
+		if (t0 > t1)
+			std::swap(t0, t1);
 
-			int side = edge->tris[1] == triNum;
+		tmin = std::max(tmin, t0);
+		tmax = std::min(tmax, t1);
+		if (tmin > tmax)
+			return false;
+	}
 
-			Plane edgePlane(plane->p[0], plane->p[1], plane->p[2], plane->p[3]);
+	t = tmin;
+	return true;
+}
 
-			if (side)
-				edgePlane.Flip();
+bool Floors::ClipToFloorTri(
+	U32 floorNum,
+	U32 floorTriNum,
+	const Vec3 &start,
+	const Vec3 &end,
+	FloorPosition &pos,
+	float &bestDistSq
+) const {
+	const bsp_file::BSPFloor *floor = m_bsp->Floors() + floorNum;
+	const U32 kTriNum = floor->firstTri + floorTriNum;
+	const bsp_file::BSPFloorTri *tri = m_bsp->FloorTris() + kTriNum;
 
-			if ((edge->tris[0] == -1) || (edge->tris[1] == -1)) {
-				// must be well within floor edge
-				if (edgePlane.Side(clip, 0.01f) != Plane::Front)
-					break;
-			} else if (edgePlane.Side(clip) == Plane::Back) {
-				break;
-			}
-		}
+	const bsp_file::BSPPlane *plane = m_bsp->Planes() + tri->planenum;
+	const Plane kTriPlane(plane->p[0], plane->p[1], plane->p[2], plane->p[3]);
 
-		if (k == 3) {
-			// valid line trace?
-			trace.start = start;
-			trace.end = clip;
-			trace.contents = bsp_file::kContentsFlag_Solid|bsp_file::kContentsFlag_Clip;
-			
-			// debug tools don't give us a world object.
-			if (m_world && !m_world->LineTrace(trace)) {
-				// did not collide with world.
-				bestDistSq = distSq;
-				pos.m_pos = clip;
-				pos.m_floor = (int)floorNum;
-				pos.m_waypoint = -1;
-				pos.m_nextWaypoint = -1;
-				bestTri = (int)i;
-				pos.m_tri = bestTri;
-			}
+	Vec3 clip;
+
+	if (!kTriPlane.IntersectLineSegment(clip, start, end, 0.01f))
+		return false;
+
+	float distSq = (clip-start).MagnitudeSquared();
+	if (distSq >= bestDistSq) // can't be better
+		return false;
+
+	for (int k = 0; k < 3; ++k) {
+		const bsp_file::BSPFloorEdge *edge = m_bsp->FloorEdges() + tri->edges[k];
+		plane = m_bsp->Planes() + edge->planenum;
+
+		int side = edge->tris[1] == kTriNum;
+
+		Plane edgePlane(plane->p[0], plane->p[1], plane->p[2], plane->p[3]);
+
+		if (side)
+			edgePlane.Flip();
+
+		if ((edge->tris[0] == -1) || (edge->tris[1] == -1)) {
+			// must be well within floor edge
+			if (edgePlane.Side(clip, 0.01f) != Plane::Front)
+				return false;
+		} else if (edgePlane.Side(clip) == Plane::Back) {
+			return false;
 		}
 	}
 
-	return bestTri != -1;
+	// valid line trace?
+	Trace trace;
+	trace.start = start;
+	trace.end = clip;
+	trace.contents = bsp_file::kContentsFlag_Solid|bsp_file::kContentsFlag_Clip;
+	
+	// debug tools don't give us a world object.
+	if (!m_world || m_world->LineTrace(trace))
+		return false;
+	
+	// did not collide with world.
+	bestDistSq = distSq;
+	pos.m_pos = clip;
+	pos.m_floor = (int)floorNum;
+	pos.m_waypoint = -1;
+	pos.m_nextWaypoint = -1;
+	pos.m_tri = (int)floorTriNum;
+	return true;
 }
 
 } // world
@@ -15,6 +15,7 @@
 #include <Runtime/Container/StackVector.h>
 #include <Runtime/Container/ZoneMap.h>
 #include <Runtime/Container/ZoneVector.h>
+#include <iosfwd>
 #include <Runtime/PushPack.h>
 
 namespace world {
@@ -221,11 +222,23 @@ public:
 		float dropDistance
 	);
 
+#if defined(RAD_OPT_TOOLS)
+	//! Plans a move between every pair of enabled waypoints with the A* planner and the
+	//! flood planner it replaced, and reports query times and route lengths of both.
+	/*! Returns false if the A* planner missed a route the flood planner found or returned
+		a longer one. */
+	bool PlanBenchmark(std::ostream &out) const;
+#endif
+
 	RAD_DECLARE_READONLY_PROPERTY(Floors, numFloors, int);
 	RAD_DECLARE_READONLY_PROPERTY(Floors, waypointIds, const IntVec&);
 
 private:
 
+	enum {
+		kRouteCacheSize = 32
+	};
+
 	struct WalkStep {
 		typedef stackify<zone_vector<WalkStep, ZWorldT>::type, 64> Vec;
 		Vec3 pos;
@@ -276,8 +289,95 @@ private:
 		MoveStep::Vec steps;
 	};
 
-	//! Find shortest path from start->end
+	//! A* search state of a waypoint, valid when query == m_searchNum.
+	struct SearchNode {
+		typedef zone_vector<SearchNode, ZWorldT>::type Vec;
+		float g; // distance from the start
+		int parent; // previous waypoint, -1 if the start position
+		int connection; // connection crossed from the parent, -1 if walked on a floor
+		int query;
+		bool closed;
+	};
+
+	struct OpenNode {
+		typedef zone_vector<OpenNode, ZWorldT>::type Vec;
+		float f;
+		float g;
+		int waypoint; // -1 is the goal when ending on a floor position
+
+		bool operator < (const OpenNode &n) const {
+			return f > n.f; // std heaps put the largest first
+		}
+	};
+
+	struct SearchGoal {
+		float g;
+		int parent;
+	};
+
+	//! Finds the shortest path from start->end with A*.
+	/*! Floors are walked in a straight line between waypoints, connections cost the
+		distance between their waypoints. */
 	bool PlanMove(
+		const FloorPosition &start,
+		const FloorPosition &end,
+		MovePlan &plan
+	) const;
+
+	void ExpandWaypoint(
+		int waypointIdx,
+		float g,
+		const FloorPosition &end,
+		SearchGoal &goal,
+		bool start
+	) const;
+
+	void ExpandFloor(
+		int floorNum,
+		int fromWaypoint,
+		float g,
+		const Vec3 &pos,
+		const FloorPosition &end
+	) const;
+
+	void SearchWaypoint(
+		int waypointIdx,
+		int fromWaypoint,
+		int connection,
+		float g,
+		const FloorPosition &end
+	) const;
+
+	Vec3 WaypointPos(int waypointIdx) const;
+
+	//! Returns false if there is no path from start to end.
+	/*! Waypoints and floors are grouped into islands joined by enabled waypoints and
+		connections (ignoring their direction), moves between islands are rejected without
+		searching. */
+	bool IslandsConnected(const FloorPosition &start, const FloorPosition &end) const;
+	void BuildIslands() const;
+	int FindIsland(int node) const;
+
+	struct CachedRoute {
+		typedef zone_vector<CachedRoute, ZWorldT>::type Vec;
+		FloorPosition start;
+		FloorPosition end;
+		FloorMove::Route route;
+		int lastUse;
+	};
+
+	//! Finds a route planned earlier between the same endpoints.
+	/*! Waypoint endpoints match on the waypoint alone. A route starting or ending at an
+		arbitrary floor position is a spline through that exact spot, so it is only reused
+		by a repeated query from the same position (a pawn that has not moved since). */
+	bool FindCachedRoute(const FloorPosition &start, const FloorPosition &end, FloorMove::Route &route) const;
+	static bool SameRouteEndpoint(const FloorPosition &a, const FloorPosition &b);
+	void CacheRoute(const FloorPosition &start, const FloorPosition &end, const FloorMove::Route &route) const;
+	void InvalidatePlans();
+
+#if defined(RAD_OPT_TOOLS)
+	//! The depth first planner replaced by PlanMove(), kept for PlanBenchmark().
+	bool FloodPlanMove(
 		const FloorPosition &start,
 		const FloorPosition &end,
 		float distance,
@@ -288,8 +388,12 @@ private:
 		float &bestDistance
 	) const;
 
+	float PlanLength(const MovePlan &plan) const;
+#endif
+
 	//! Clips a ray to the specified floor.
-	/*! Returns true and the position of the closest intersection with the floor, otherwise false. */
+	/*! Returns true and the position of the closest intersection with the floor, otherwise false. 
+		Walks the floor's triangle tree (see bsp_file::BSPFloorNode) nearest node first. */
 	bool ClipToFloor(
 		U32 floorNum,
 		const Vec3 &start,
@@ -298,6 +402,24 @@ private:
 		float &bestDistSq
 	) const;
 
+	//! Returns true and the fraction along dir where the segment enters the node bounds.
+	static bool ClipToFloorNode(
+		const bsp_file::BSPFloorNode &node,
+		const Vec3 &start,
+		const Vec3 &dir,
+		float &t
+	);
+
+	//! Clips a ray to a floor triangle if the intersection is closer than bestDistSq.
+	bool ClipToFloorTri(
+		U32 floorNum,
+		U32 floorTriNum,
+		const Vec3 &start,
+		const Vec3 &end,
+		FloorPosition &pos,
+		float &bestDistSq
+	) const;
+
 	struct Waypoint {
 		typedef zone_multimap<String, int, ZWorldT>::type MMap;
 		typedef zone_vector<Waypoint, ZWorldT>::type Vec;
@@ -328,7 +450,14 @@ private:
 	IntVec m_waypointIds;
 	const bsp_file::BSPFile *m_bsp;
 	World *m_world;
+	mutable SearchNode::Vec m_searchNodes;
+	mutable OpenNode::Vec m_openList;
+	mutable IntVec m_islands; // union-find over waypoints followed by floors
+	mutable CachedRoute::Vec m_routeCache;
+	mutable int m_routeCacheUse;
+	mutable int m_searchNum;
 	mutable int m_floodNum;
+	mutable bool m_islandsValid;
 };
 
 } // world
@@ -194,9 +194,10 @@ private:
 	ColorStep::Vec m_spSteps;
 
 	dBSPLeaf::PtrVec m_bspLeafs;
+	LightLinkList::LinkVec m_links; // leaf and area membership.
 	details::MatInteractionChain m_matInteractionChain; // linkage to draws
 	details::LightInteraction *m_interactionHead; // linkage to objects
-	IntSet m_areas;
+	IntVec m_areas;
 	BBox m_bounds;
 	Vec3 m_spColor[2];
 	Vec3 m_dfColor[2];
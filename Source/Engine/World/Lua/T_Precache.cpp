@@ -18,6 +18,7 @@
 #include "D_Asset.h"
 #include "../../Assets/TypefaceParser.h"
 #include "../../Packages/Packages.h"
+#include "../../App.h"
 #include "../../Engine.h"
 #if defined(RAD_OPT_PC_TOOLS)
 #include "../../Tools/Editor/EditorMainWindow.h"
@@ -90,13 +91,18 @@ int T_Precache::Tick(Entity &e, float dt, const xtime::TimeSlice &time, int flag
 	const int kLoadFlags = (tools::editor::MainWindow::Get()->lowQualityPreview) ? pkg::P_FastCook : 0;
 #endif
 
-	m_r = m_asset->Process(
-		time,
-		pkg::P_Load|pkg::P_FastPath
+	if (!m_load) {
+		// file i/o and parsing happen on the package loader thread.
+		m_load = App::Get()->engine->sys->packages->LoadAsync(
+			m_asset,
+			pkg::P_Load|pkg::P_FastPath
 #if defined(RAD_OPT_PC_TOOLS)
-		| kLoadFlags
+			| kLoadFlags
 #endif
-	);
+		);
+	}
+
+	m_r = m_load->Wait(time);
 
 	if (m_r == pkg::SR_Success) { 
 		if (m_asset->type == asset::AT_Material) { // for material tick
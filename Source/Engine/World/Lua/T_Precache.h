@@ -61,6 +61,7 @@ private:
 	int m_r;
 	World *m_world;
 	pkg::AssetRef m_asset;
+	pkg::AsyncLoadRef m_load;
 };
 
 } // world
@@ -60,6 +60,7 @@ public:
 	RAD_DECLARE_READONLY_PROPERTY(MBatchDraw, visible, bool);
 	RAD_DECLARE_READONLY_PROPERTY(MBatchDraw, rgba, const Vec4&);
 	RAD_DECLARE_READONLY_PROPERTY(MBatchDraw, scale, const Vec3&);
+	RAD_DECLARE_READONLY_PROPERTY(MBatchDraw, numTris, int);
 
 	void ChangeMaterial(WorldDraw &draw, int dstMatId);
 
@@ -78,9 +79,15 @@ protected:
 	virtual RAD_DECLARE_GET(rgba, const Vec4&) = 0;
 	virtual RAD_DECLARE_GET(scale, const Vec3&) = 0;
 
+	// number of triangles drawn by Draw(), 0 if not known.
+	virtual RAD_DECLARE_GET(numTris, int) {
+		return 0;
+	}
+
 private:
 	
 	friend class WorldDraw;
+	friend class RB_WorldDraw;
 	friend struct details::MBatch;
 
 	RAD_DECLARE_GET(matId, int) { 
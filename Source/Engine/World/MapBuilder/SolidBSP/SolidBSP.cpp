@@ -27,11 +27,11 @@ namespace {
 	const ValueType kMaxBoxExtents = ValueType(4096);
 };
 
-int BSPBuilder::Node::s_num = 0;
-int BSPBuilder::Portal::s_num = 0;
-int BSPBuilder::WindingPlane::s_num = 0;
-int BSPBuilder::TriModelFrag::s_num = 0;
-int BSPBuilder::Poly::s_num = 0;
+thread::Interlocked<int> BSPBuilder::Node::s_num(0);
+thread::Interlocked<int> BSPBuilder::Portal::s_num(0);
+thread::Interlocked<int> BSPBuilder::WindingPlane::s_num(0);
+thread::Interlocked<int> BSPBuilder::TriModelFrag::s_num(0);
+thread::Interlocked<int> BSPBuilder::Poly::s_num(0);
 
 BSPBuilder::BSPBuilder() : 
 m_map(0), 
@@ -53,9 +53,12 @@ m_numInsideModels(0),
 m_numInsideTris(0),
 m_numAreaNodes(0),
 m_numAreaLeafs(0),
+m_jobs(0),
 m_flood(false),
 m_abort(false) {
 	m_result = SR_Success;
+	for (int i = 0; i < kNumStages; ++i)
+		m_stageTimes[i] = 0;
 }
 
 BSPBuilder::~BSPBuilder() {
@@ -146,8 +149,18 @@ void BSPBuilder::Build()
 		m_ui->Refresh();
 	}
 
-	if (!LoadMaterials())
-		return;
+	for (int i = 0; i < kNumStages; ++i)
+		m_stageTimes[i] = 0;
+
+	m_jobs = App::Get()->engine->sys->jobs.get();
+	// fill the debug color table before Split() creates polys on job threads.
+	RandomColor(0);
+
+	{
+		StageTimer T(*this, kStage_Materials);
+		if (!LoadMaterials())
+			return;
+	}
 
 	if (m_ui) {
 		m_ui->title = "Building Hull...";
@@ -157,7 +170,10 @@ void BSPBuilder::Build()
 	}
 
 	MarkDetail();
-	CreateRootNode();
+	{
+		StageTimer T(*this, kStage_Hull);
+		CreateRootNode();
+	}
 
 	Log(
 		"Map Extents: (%d x %d x %d) x (%d x %d x %d)\n",
@@ -189,15 +205,25 @@ void BSPBuilder::Build()
 
 	ResetProgress();
 	EmitProgress();
-	Split(m_root.get());
-	Log("\n%d node(s), %d leaf(s)\n", m_numNodes, m_numLeafs);
+	{
+		StageTimer T(*this, kStage_Hull);
+		Split(m_root.get());
+	}
+	Log("\n%d node(s), %d leaf(s)\n", (int)m_numNodes, (int)m_numLeafs);
 	
 	if (m_abort)
 		return;
 
-	Portalize();
+	{
+		StageTimer T(*this, kStage_Portals);
+		Portalize();
+	}
 
-	bool flood = FloodFill();
+	bool flood;
+	{
+		StageTimer T(*this, kStage_Flood);
+		flood = FloodFill();
+	}
 
 	if (m_debugUI)
 		DisplayPaintHandler(new (world::bsp_file::ZBSPBuilder) LeafFacesDraw());
@@ -207,7 +233,10 @@ void BSPBuilder::Build()
 
 	if (flood) {
 		m_flood = true;
-		FillOutside();
+		{
+			StageTimer T(*this, kStage_Flood);
+			FillOutside();
+		}
 
 		if (m_ui) {
 			m_ui->title = "Building Optimized Hull...";
@@ -219,7 +248,10 @@ void BSPBuilder::Build()
 		// make a better tree.
 		m_root.reset();
 
-		CreateRootNode();
+		{
+			StageTimer T(*this, kStage_Hull);
+			CreateRootNode();
+		}
 		Log("------------\n");
 		Log("Building Optimized Hull (%d structural tri(s), %d detail tri(s), %d total)\n", m_numStructural, m_numDetail, m_numStructural+m_numDetail);
 
@@ -228,26 +260,46 @@ void BSPBuilder::Build()
 
 		ResetProgress();
 		EmitProgress();
-		Split(m_root.get());
-		Log("\n%d node(s), %d leaf(s)\n", m_numNodes, m_numLeafs);
-		Portalize();
-		if (!FloodFill()) {
-			Log("ERROR: map leaked after fill pass!\n");
-			SetResult(SR_CompilerError);
-			return;
+		{
+			StageTimer T(*this, kStage_Hull);
+			Split(m_root.get());
+		}
+		Log("\n%d node(s), %d leaf(s)\n", (int)m_numNodes, (int)m_numLeafs);
+		{
+			StageTimer T(*this, kStage_Portals);
+			Portalize();
+		}
+		{
+			StageTimer T(*this, kStage_Flood);
+			if (!FloodFill()) {
+				Log("ERROR: map leaked after fill pass!\n");
+				SetResult(SR_CompilerError);
+				return;
+			}
+			FillOutside();
 		}
-		FillOutside();
 	}
 	
-	if (!AreaFlood())
-		return;
-	if (!CompileAreas())
-		return;
+	{
+		StageTimer T(*this, kStage_Areas);
+		if (!AreaFlood())
+			return;
+		if (!CompileAreas())
+			return;
+	}
 	
-	CompileClipModels();
+	{
+		StageTimer T(*this, kStage_ClipModels);
+		CompileClipModels();
+	}
 	
-	if (!EmitBSPFile())
-		return;
+	{
+		StageTimer T(*this, kStage_Emit);
+		if (!EmitBSPFile())
+			return;
+	}
+
+	LogStageTimes();
 
 	if (m_debugUI)
 		DisplayPaintHandler(new (world::bsp_file::ZBSPBuilder) AreaBSPDraw());
@@ -285,9 +337,38 @@ void BSPBuilder::Log(const char *fmt, ...) {
 	String s;
 	s.PrintfASCII_valist(fmt, args);
 	va_end(args);
+	Lock L(m_logMutex);
 	COut() << s << std::flush;
 }
 
+void BSPBuilder::LogStageTimes() {
+	static const char *kStageNames[kNumStages] = {
+		"materials",
+		"hull",
+		"portals",
+		"flood",
+		"areas",
+		"clip models",
+		"emit"
+	};
+
+	xtime::TimeVal total = 0;
+	for (int i = 0; i < kNumStages; ++i)
+		total += m_stageTimes[i];
+
+	Log("------------\n");
+	Log("Compile times (%d job thread(s)):\n", m_jobs ? m_jobs->numThreads.get() : 1);
+	for (int i = 0; i < kNumStages; ++i) {
+		Log(
+			"%-12s %9.3f sec(s) (%5.1f%%)\n", 
+			kStageNames[i],
+			m_stageTimes[i] / 1000000.0,
+			total ? (m_stageTimes[i] * 100.0 / total) : 0.0
+		);
+	}
+	Log("%-12s %9.3f sec(s)\n", "total", total / 1000000.0);
+}
+
 void BSPBuilder::SetResult(int result) {
 	m_result = result;
 }
@@ -315,9 +396,19 @@ BSPBuilder::Node *BSPBuilder::LeafForPoint(const Vec3 &pos, Node *node)
 	return LeafForPoint(pos, node->children[1].get());
 }
 
+void BSPBuilder::SplitJob::Run() {
+	SplitPlaneCache cache;
+	m_bsp->Split(m_node, cache);
+}
+
 void BSPBuilder::Split(Node *node) {
+	SplitPlaneCache cache;
+	Split(node, cache);
+}
 
-	int planenum = FindSplitPlane(node);
+void BSPBuilder::Split(Node *node, SplitPlaneCache &cache) {
+
+	int planenum = FindSplitPlane(node, cache);
 	if (planenum == kPlaneNumLeaf) {
 		LeafNode(node);
 		return;
@@ -330,8 +421,7 @@ void BSPBuilder::Split(Node *node) {
 #endif
 	node->planenum = planenum;
 
-	++m_numNodes;
-	if (m_numNodes % 1000 == 0) { 
+	if ((++m_numNodes % 1000) == 0) { 
 		EmitProgress(); 
 	}
 
@@ -368,17 +458,21 @@ void BSPBuilder::Split(Node *node) {
 			Split(m, p, planenum, front, back, kBSPSplitEpsilon);
 			if (front) {
 				node->children[0]->models.push_back(front);
+				node->children[0]->numPolys += (int)front->polys.size();
 			}
 			if (back) {
 				node->children[1]->models.push_back(back);
+				node->children[1]->numPolys += (int)back->polys.size();
 			}
 		} else {
 			switch (s) {
 			case Plane::Front:
 				node->children[0]->models.push_back(m);
+				node->children[0]->numPolys += (int)m->polys.size();
 				break;
 			case Plane::Back:
 				node->children[1]->models.push_back(m);
+				node->children[1]->numPolys += (int)m->polys.size();
 				break;
 			default:
 				SOLID_BSP_ICE();
@@ -387,8 +481,23 @@ void BSPBuilder::Split(Node *node) {
 		}
 	}
 
-	Split(node->children[0].get());
-	Split(node->children[1].get());
+	// The subtrees share no polys (crossing polys were copied above) and the plane
+	// list is not modified while splitting, so they can be built concurrently and
+	// produce the same tree as a serial build.
+	const bool kParallel = m_jobs && (m_jobs->numThreads.get() > 1) &&
+		(node->children[0]->numPolys >= kParallelSplitPolys) &&
+		(node->children[1]->numPolys >= kParallelSplitPolys);
+
+	if (kParallel) {
+		SplitJob job(*this, node->children[0].get());
+		thread::JobGroup group;
+		m_jobs->Submit(group, job);
+		Split(node->children[1].get(), cache);
+		m_jobs->Wait(group);
+	} else {
+		Split(node->children[0].get(), cache);
+		Split(node->children[1].get(), cache);
+	}
 }
 
 void BSPBuilder::SplitNodeBounds(Node *node, const Plane &p, BBox &front, WindingVec &frontVec, BBox &back, WindingVec &backVec) {
@@ -817,10 +926,21 @@ int BSPBuilder::BoxPlaneNum(Node *node) {
 	return kPlaneNumLeaf;
 }
 
-int BSPBuilder::FindSplitPlane(Node *node) {
+int BSPBuilder::FindSplitPlane(Node *node, SplitPlaneCache &cache) {
 	if (node->models.empty()) 
 		return kPlaneNumLeaf;
 
+	// Coplanar polys share a plane number, score each plane once per node.
+	// A plane that was already scored cannot win again since ties keep the
+	// first plane found.
+	const int kNumPlanePairs = ((int)m_planes.Planes().size() + 1) >> 1;
+	if ((int)cache.stamps.size() < kNumPlanePairs)
+		cache.stamps.resize(kNumPlanePairs, 0);
+	if (++cache.stamp == 0) {
+		std::fill(cache.stamps.begin(), cache.stamps.end(), 0);
+		cache.stamp = 1;
+	}
+
 	// find simple splitter
 	/*int num = BoxPlaneNum(node);
 	if (num != kPlaneNumLeaf) 
@@ -847,6 +967,11 @@ int BSPBuilder::FindSplitPlane(Node *node) {
 
 					int planenum = (*polyIt)->planenum&~1;
 
+					int &stamp = cache.stamps[planenum>>1];
+					if (stamp == cache.stamp)
+						continue;
+					stamp = cache.stamp;
+
 #if defined(RAD_OPT_DEBUG)
 					for (Node *parent = node->parent; parent; parent = parent->parent) {
 						bool alreadySplit = parent->planenum == planenum;
@@ -21,6 +21,8 @@
 #include <Runtime/Container/ZoneSet.h>
 #include <Runtime/Thread.h>
 #include <Runtime/Thread/Locks.h>
+#include <Runtime/Thread/JobScheduler.h>
+#include <Runtime/Time.h>
 #include <QtCore/QVariant>
 #include <vector>
 #include <boost/dynamic_bitset.hpp>
@@ -128,7 +130,7 @@ private:
 		int contents;
 		bool onNode;
 	
-		static int s_num;
+		static thread::Interlocked<int> s_num;
 	};
 
 	typedef boost::shared_ptr<Poly> PolyRef;
@@ -155,7 +157,7 @@ private:
 		BBox       bounds;
 		SceneFile::TriModel *original;
 
-		static int s_num;
+		static thread::Interlocked<int> s_num;
 	};
 
 	typedef boost::shared_ptr<TriModelFrag> TriModelFragRef;
@@ -179,7 +181,7 @@ private:
 		Winding winding;
 		int planenum;
 
-		static int s_num;
+		static thread::Interlocked<int> s_num;
 	};
 
 	typedef boost::shared_ptr<WindingPlane> WindingPlaneRef;
@@ -244,7 +246,7 @@ private:
 		Node   *nodes[2];
 		Vec3 color;
 
-		static int s_num;
+		static thread::Interlocked<int> s_num;
 	};
 
 	typedef math::Winding<SceneFileD::TriVert, Plane> AreaNodeWinding;
@@ -325,7 +327,7 @@ private:
 		SceneFile::TriModel *contentsOwner;
 		bool areaWarned;
 		int portalAreas[2];
-		static int s_num;
+		static thread::Interlocked<int> s_num;
 	};
 
 	/*
@@ -561,6 +563,37 @@ private:
 	typedef boost::mutex Mutex;
 	typedef boost::lock_guard<Mutex> Lock;
 
+	enum Stage {
+		kStage_Materials,
+		kStage_Hull,
+		kStage_Portals,
+		kStage_Flood,
+		kStage_Areas,
+		kStage_ClipModels,
+		kStage_Emit,
+		kNumStages
+	};
+
+	// Times a compile stage, stages that run more than once accumulate.
+	class StageTimer {
+	public:
+		StageTimer(BSPBuilder &bsp, Stage stage) : m_bsp(&bsp), m_stage(stage) {
+			m_timer.Start();
+		}
+
+		~StageTimer() {
+			m_timer.Stop();
+			m_bsp->m_stageTimes[m_stage] += m_timer.Elapsed();
+		}
+
+	private:
+		BSPBuilder *m_bsp;
+		Stage m_stage;
+		xtime::MicroTimer m_timer;
+	};
+
+	friend class StageTimer;
+
 	SceneFile *m_map;
 	SceneFile::Entity::Ref m_leakEnt;
 	PlaneHash m_planes;
@@ -570,18 +603,21 @@ private:
 	Vec3Vec m_leakpts;
 	AreaVec m_areas;
 	Mutex m_paintMutex;
+	Mutex m_logMutex;
 	PaintHandler::Ref m_paint;
+	thread::JobScheduler *m_jobs;
+	xtime::TimeVal m_stageTimes[kNumStages];
 	std::ostream *m_cout;
 	tools::UIProgress *m_ui;
 	tools::map_builder::DebugUI *m_debugUI;
 	CinematicActorCompressionMap m_caMap;
 	int m_numStructural;
 	int m_numDetail;
-	int m_numNodes;
-	int m_numLeafs;
+	thread::Interlocked<int> m_numNodes;
+	thread::Interlocked<int> m_numLeafs;
 	int m_numPortalFaces;
 	int m_numPortalSplits;
-	int m_progress;
+	thread::Interlocked<int> m_progress;
 	int m_numOutsideNodes;
 	int m_numOutsideTris;
 	int m_numOutsideModels;
@@ -613,8 +649,47 @@ private:
 
 	void DisplayPortals(const Node *node, Portal *a=0, Portal *b=0, bool leak=false, int contents=0);
 
+	/*
+	==============================================================================
+	Split
+	==============================================================================
+	*/
+
+	// Nodes with at least this many polys on both sides of their split plane
+	// build their front subtree as a job.
+	enum {
+		kParallelSplitPolys = 2048
+	};
+
+	// Marks the candidate planes (by PlaneHash number) already scored at the node
+	// being split by a thread. The plane list is fixed while the tree is built.
+	struct SplitPlaneCache {
+		typedef zone_vector<int, world::bsp_file::ZBSPBuilderT>::type IntVec;
+
+		SplitPlaneCache() : stamp(0) {}
+
+		IntVec stamps;
+		int stamp;
+	};
+
+	class SplitJob;
+	friend class SplitJob;
+
+	class SplitJob : public thread::Job {
+	public:
+		SplitJob(BSPBuilder &bsp, Node *node) : m_bsp(&bsp), m_node(node) {}
+
+		virtual void Run();
+
+	private:
+		BSPBuilder *m_bsp;
+		Node *m_node;
+	};
+
 	void LeafNode(Node *node);
 	void Split(Node *node);
+	void Split(Node *node, SplitPlaneCache &cache);
+	void LogStageTimes();
 
 	void SplitNodeBounds(
 		Node *node, 
@@ -664,7 +739,7 @@ private:
 	void CompileClipModels();
 	void DecomposeAreaModel(SceneFile::TriModel &model);
 	void DecomposeAreaPoly(Node *node, AreaPoly *poly);
-	int FindSplitPlane(Node *node);
+	int FindSplitPlane(Node *node, SplitPlaneCache &cache);
 	int BoxPlaneNum(Node *node);
 
 	/*
@@ -21,6 +21,93 @@ namespace {
 enum {
 	kMaxBatchElements = kKilo*64
 };
+
+//! Floor triangles are nearly flat, their node bounds are padded so ray tests don't miss them.
+const float kFloorNodePad = 0.5f;
+
+struct FloorTriBounds {
+	typedef zone_vector<FloorTriBounds, ZBSPBuilderT>::type Vec;
+
+	U32 tri; // floor relative
+	Vec3 mins;
+	Vec3 maxs;
+	Vec3 center;
+};
+
+struct FloorTriCenterLess {
+	int axis;
+
+	bool operator () (const FloorTriBounds &a, const FloorTriBounds &b) const {
+		return a.center[axis] < b.center[axis];
+	}
+};
+
+int NumFloorNodes(int numTris) {
+	if (numTris <= kMaxFloorNodeTris)
+		return 1;
+	const int kHalf = numTris / 2;
+	return 1 + NumFloorNodes(kHalf) + NumFloorNodes(numTris - kHalf);
+}
+
+//! Emits a node and its children depth first, splitting at the median triangle
+//! center of the longest axis.
+void EmitFloorNode(BSPFileBuilder &bspFile, FloorTriBounds *tris, int numTris) {
+	RAD_ASSERT(numTris > 0);
+
+	Vec3 mins(tris[0].mins);
+	Vec3 maxs(tris[0].maxs);
+	Vec3 centerMins(tris[0].center);
+	Vec3 centerMaxs(tris[0].center);
+
+	for (int i = 1; i < numTris; ++i) {
+		for (int k = 0; k < 3; ++k) {
+			mins[k] = std::min(mins[k], tris[i].mins[k]);
+			maxs[k] = std::max(maxs[k], tris[i].maxs[k]);
+			centerMins[k] = std::min(centerMins[k], tris[i].center[k]);
+			centerMaxs[k] = std::max(centerMaxs[k], tris[i].center[k]);
+		}
+	}
+
+	const S32 kNodeNum = (S32)bspFile.numFloorNodes.get();
+	BSPFloorNode *node = bspFile.AddFloorNode();
+	memset(node, 0, sizeof(BSPFloorNode));
+
+	for (int k = 0; k < 3; ++k) {
+		node->mins[k] = (float)mins[k] - kFloorNodePad;
+		node->maxs[k] = (float)maxs[k] + kFloorNodePad;
+	}
+
+	if (numTris <= kMaxFloorNodeTris) {
+		node->children[0] = -1;
+		node->children[1] = -1;
+		node->numTris = (U32)numTris;
+		for (int i = 0; i < numTris; ++i)
+			node->tris[i] = tris[i].tri;
+		return;
+	}
+
+	const int kHalf = numTris / 2;
+
+	// children are emitted depth first: the front child follows this node
+	// and the back child follows the whole front subtree.
+	node->children[0] = kNodeNum + 1;
+	node->children[1] = kNodeNum + 1 + NumFloorNodes(kHalf);
+	node->numTris = 0;
+
+	const Vec3 kSize(centerMaxs - centerMins);
+	FloorTriCenterLess less;
+	less.axis = 0;
+	if (kSize[1] > kSize[less.axis])
+		less.axis = 1;
+	if (kSize[2] > kSize[less.axis])
+		less.axis = 2;
+
+	std::nth_element(tris, tris + kHalf, tris + numTris, less);
+
+	EmitFloorNode(bspFile, tris, kHalf);
+	EmitFloorNode(bspFile, tris + kHalf, numTris - kHalf);
+}
+
 }
 
 bool BSPBuilder::EmitBSPFile() {
@@ -1239,6 +1326,34 @@ bool BSPBuilder::EmitBSPFloors() {
 			t->planenum = m_planes.FindPlaneNum(kPlane);
 		}
 
+		FloorTriBounds::Vec triBounds;
+		triBounds.reserve(builder.tris.size());
+
+		for (FloorBuilder::Tri::Vec::const_iterator tIt = builder.tris.begin(); tIt != builder.tris.end(); ++tIt) {
+			const FloorBuilder::Tri &tri = *tIt;
+
+			FloorTriBounds bounds;
+			bounds.tri = (U32)(tIt - builder.tris.begin());
+			bounds.mins = ToBSPType(builder.verts[tri.v[0]]);
+			bounds.maxs = bounds.mins;
+
+			for (int i = 1; i < 3; ++i) {
+				const Vec3 kVert(ToBSPType(builder.verts[tri.v[i]]));
+				for (int k = 0; k < 3; ++k) {
+					bounds.mins[k] = std::min(bounds.mins[k], kVert[k]);
+					bounds.maxs[k] = std::max(bounds.maxs[k], kVert[k]);
+				}
+			}
+
+			bounds.center = (bounds.mins + bounds.maxs) * 0.5f;
+			triBounds.push_back(bounds);
+		}
+
+		bspFloor->firstNode = m_bspFile->numFloorNodes;
+		m_bspFile->ReserveFloorNodes(NumFloorNodes((int)triBounds.size()));
+		EmitFloorNode(*m_bspFile, &triBounds[0], (int)triBounds.size());
+		bspFloor->numNodes = m_bspFile->numFloorNodes - bspFloor->firstNode;
+
 		m->emitIds[0].push_back(emitId);
 	}
 
@@ -0,0 +1,486 @@
+/*! \file NullWorldDraw.cpp
+	\copyright Copyright (c) 2013 Sunside Inc., All Rights Reserved.
+	\copyright See Radiance/LICENSE for licensing terms.
+	\author Joe Riedel
+	\ingroup world
+*/
+
+#include RADPCH
+#include "NullWorldDraw.h"
+#include "World.h"
+#include "../Game/Game.h"
+#include "../MathUtils.h"
+#include <iostream>
+#undef near
+#undef far
+
+namespace world {
+
+namespace {
+
+const Mat4 kTexAddressBias(
+	Vec4(0.5f, 0.0f, 0.0f, 0.0f),
+	Vec4(0.0f, 0.5f, 0.0f, 0.0f),
+	Vec4(0.0f, 0.0f, 0.5f, 0.0f),
+	Vec4(0.5f, 0.5f, 0.5f, 1.0f)
+);
+
+}
+
+void NullWorldDraw::Counters::Clear() {
+	materialBinds = 0;
+	materialChanges = 0;
+	textureBinds = 0;
+	shaderPasses = 0;
+	shaderChanges = 0;
+	uniformBinds = 0;
+	stateCommits = 0;
+	batches = 0;
+	numTris = 0;
+	matrixOps = 0;
+	renderTargetBinds = 0;
+	lightStencils = 0;
+	overlays = 0;
+}
+
+NullWorldDraw::NullWorldDraw(World *w) :
+RB_WorldDraw(w),
+m_prj(Mat4::Identity),
+m_material(0),
+m_passMaterial(0),
+m_pass(-1),
+m_numTris(0),
+m_flipMatrix(false),
+m_wireframe(false) {
+	m_mv.reserve(8);
+	m_mv.push_back(Mat4::Identity);
+}
+
+NullWorldDraw::~NullWorldDraw() {
+}
+
+void NullWorldDraw::ClearCounters() {
+	m_counters.Clear();
+}
+
+void NullWorldDraw::BeginFrame() {
+	// nothing is bound at the start of a frame.
+	m_material = 0;
+	m_passMaterial = 0;
+	m_pass = -1;
+}
+
+void NullWorldDraw::EndFrame() {
+}
+
+int NullWorldDraw::LoadMaterials() {
+	return pkg::SR_Success;
+}
+
+int NullWorldDraw::Precache() {
+	return pkg::SR_Success;
+}
+
+void NullWorldDraw::BeginPrecacheMaterials() {
+}
+
+void NullWorldDraw::PrecacheMaterial(const details::MatRef &mat) {
+}
+
+void NullWorldDraw::EndPrecacheMaterials() {
+}
+
+void NullWorldDraw::BindFramebuffer(bool discardHint, bool copy) {
+	++m_counters.renderTargetBinds;
+}
+
+void NullWorldDraw::BindRenderTarget() {
+	++m_counters.renderTargetBinds;
+}
+
+void NullWorldDraw::ClearBackBuffer() {
+}
+
+void NullWorldDraw::SetWorldStates() {
+}
+
+void NullWorldDraw::FlipMatrixHack(bool enable) {
+	m_flipMatrix = enable;
+}
+
+Mat4 NullWorldDraw::MakePerspectiveMatrix(
+	float left,
+	float right,
+	float top,
+	float bottom,
+	float near,
+	float far,
+	bool txAddressBias
+) {
+	Mat4 m = Mat4::PerspectiveOffCenterRH(left, right, bottom, top, near, far);
+	if (txAddressBias)
+		m = m * kTexAddressBias;
+	return m;
+}
+
+void NullWorldDraw::SetPerspectiveMatrix(
+	const Camera &camera,
+	const int viewport[4]
+) {
+	// matches GLWorldDraw::SetPerspectiveMatrix() + GLTable::Perspective()
+	float yaspect = ((float)viewport[3]/(float)viewport[2]);
+	float xaspect = 1.f / yaspect;
+	float yfov = camera.fov.get() * yaspect;
+
+	const float kNear = 4.f;
+	float ymax = kNear * math::Tan(math::DegToRad(yfov*0.5f));
+	float xmax = ymax * xaspect;
+
+	m_prj = Mat4::PerspectiveOffCenterRH(-xmax, xmax, -ymax, ymax, kNear, camera.farClip.get());
+	if (m_flipMatrix)
+		m_prj = m_prj * Mat4::Scaling(Scale3(1.f, -1.f, 1.f));
+
+	++m_counters.matrixOps;
+}
+
+void NullWorldDraw::SetPerspectiveMatrix(const Mat4 &m) {
+	m_prj = m;
+	++m_counters.matrixOps;
+}
+
+void NullWorldDraw::SetScreenLocalMatrix() {
+	int vpx, vpy, vpw, vph;
+	world->game->Viewport(vpx, vpy, vpw, vph);
+
+	m_prj = Mat4::Ortho(
+		(float)vpx,
+		(float)(vpx+vpw),
+		(float)(vpy+vph),
+		(float)vpy,
+		-1.f,
+		1.f
+	);
+
+	if (m_flipMatrix)
+		m_prj = m_prj * Mat4::Scaling(Scale3(1.f, -1.f, 1.f));
+
+	m_mv.back() = Mat4::Identity;
+	++m_counters.matrixOps;
+}
+
+void NullWorldDraw::SetOrthoMatrix(
+	float left,
+	float right,
+	float top,
+	float bottom,
+	float near,
+	float far
+) {
+	m_prj = Mat4::Ortho(left, right, bottom, top, near, far);
+	if (m_flipMatrix)
+		m_prj = m_prj * Mat4::Scaling(Scale3(1.f, -1.f, 1.f));
+	++m_counters.matrixOps;
+}
+
+void NullWorldDraw::Rotate(float degrees, const Vec3 &axis) {
+	m_mv.back() = Mat4::Rotation(Quat(axis, math::DegToRad(degrees))) * m_mv.back();
+}
+
+void NullWorldDraw::RotateForCamera(const Camera &camera) {
+	RotateForCameraBasis();
+
+	if (camera.quatMode) {
+		Mat4 rot = Mat4::Rotation(camera.rot.get());
+		rot.Transpose();
+		m_mv.back() = rot * m_mv.back();
+	} else {
+		const Vec3 &angles = camera.angles;
+		Rotate(-angles.X(), Vec3(1, 0, 0));
+		Rotate(-angles.Y(), Vec3(0, 1, 0));
+		Rotate(-angles.Z(), Vec3(0, 0, 1));
+	}
+
+	m_mv.back() = Mat4::Translation(-camera.pos.get()) * m_mv.back();
+}
+
+void NullWorldDraw::RotateForCameraBasis() {
+	m_mv.back() = Mat4::Identity;
+	Rotate(-90, Vec3(1, 0, 0)); // put Z going up
+	Rotate( 90, Vec3(0, 0, 1)); // put Z going up
+	++m_counters.matrixOps;
+}
+
+void NullWorldDraw::PushMatrix(const Vec3 &pos, const Vec3 &scale, const Vec3 &angles) {
+	Mat4 m = m_mv.back();
+	m_mv.push_back(m);
+
+	m_mv.back() = Mat4::Translation(pos) * m_mv.back();
+	Rotate(angles.Z(), Vec3(0, 0, 1));
+	Rotate(angles.X(), Vec3(1, 0, 0));
+	Rotate(angles.Y(), Vec3(0, 1, 0));
+	m_mv.back() = Mat4::Scaling(Scale3(scale.X(), scale.Y(), scale.Z())) * m_mv.back();
+	++m_counters.matrixOps;
+}
+
+void NullWorldDraw::PopMatrix() {
+	RAD_ASSERT(m_mv.size() > 1);
+	m_mv.pop_back();
+}
+
+void NullWorldDraw::ReleaseArrayStates() {
+}
+
+void NullWorldDraw::BindMaterial(const r::Material &mat) {
+	++m_counters.materialBinds;
+	if (m_material != &mat) {
+		m_material = &mat;
+		++m_counters.materialChanges;
+	}
+}
+
+void NullWorldDraw::BindLitMaterialStates(r::Material &mat, bool lightStencil) {
+	BindMaterial(mat);
+}
+
+void NullWorldDraw::BindMaterialStates(r::Material &mat) {
+	BindMaterial(mat);
+}
+
+void NullWorldDraw::BindMaterialTextures(r::Material &mat, asset::MaterialLoader *loader) {
+	++m_counters.textureBinds;
+}
+
+void NullWorldDraw::BeginMaterialPass(r::Material &mat, r::Shader::Pass pass) {
+	++m_counters.shaderPasses;
+	if ((m_passMaterial != &mat) || (m_pass != pass)) {
+		m_passMaterial = &mat;
+		m_pass = pass;
+		++m_counters.shaderChanges;
+	}
+}
+
+void NullWorldDraw::EndMaterialPass(r::Material &mat) {
+}
+
+void NullWorldDraw::BindMaterialUniforms(
+	r::Material &mat,
+	const r::Shader::Uniforms &uniforms
+) {
+	++m_counters.uniformBinds;
+}
+
+void NullWorldDraw::DrawBatch(
+	MBatchDraw &draw,
+	r::Material &mat,
+	const r::Shader::Uniforms &uniforms,
+	bool sampleMaterialColor
+) {
+	const int kNumTris = draw.numTris;
+	++m_counters.uniformBinds;
+	++m_counters.stateCommits;
+	++m_counters.batches;
+	m_counters.numTris += kNumTris;
+	m_numTris += kNumTris;
+}
+
+void NullWorldDraw::BeginFog() {
+}
+
+void NullWorldDraw::BeginFogDepthWrite(r::Material &fog, bool front) {
+	BindMaterial(fog);
+}
+
+void NullWorldDraw::BeginFogDraw(r::Material &fog) {
+	BindMaterial(fog);
+}
+
+void NullWorldDraw::EndFog() {
+}
+
+void NullWorldDraw::RenderLightStencil(
+	const ViewDef &view,
+	const Vec4 **rects,
+	int numRects
+) {
+	++m_counters.lightStencils;
+}
+
+void NullWorldDraw::BeginUnifiedShadows() {
+}
+
+void NullWorldDraw::EndUnifiedShadows() {
+}
+
+bool NullWorldDraw::BindUnifiedShadowRenderTarget(r::Material &shadowMaterial) {
+	++m_counters.renderTargetBinds;
+	BindMaterial(shadowMaterial);
+	return true;
+}
+
+bool NullWorldDraw::BindUnifiedShadowTexture(r::Material &projectedMaterial) {
+	BindMaterial(projectedMaterial);
+	return true;
+}
+
+Vec2 NullWorldDraw::BindPostFXTargets(
+	bool chain,
+	const r::Material &mat,
+	const Vec2 &srcScale,
+	const Vec2 &dstScale
+) {
+	++m_counters.renderTargetBinds;
+	return Vec2(1.f, 1.f);
+}
+
+void NullWorldDraw::BindPostFXQuad(const r::Material &mat) {
+}
+
+void NullWorldDraw::DrawPostFXQuad() {
+	++m_counters.overlays;
+}
+
+void NullWorldDraw::BindOverlay(const r::Material &mat) {
+}
+
+void NullWorldDraw::DrawOverlay() {
+	++m_counters.overlays;
+}
+
+void NullWorldDraw::CommitStates() {
+	++m_counters.stateCommits;
+}
+
+void NullWorldDraw::Finish() {
+}
+
+bool NullWorldDraw::Project(const Vec3 &p, Vec3 &out) {
+	int viewport[4];
+	world->game->Viewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	Mat4 prj = m_prj;
+	Mat4 mv = m_mv.back();
+
+	SetPerspectiveMatrix(*world->camera.get(), viewport);
+	RotateForCamera(*world->camera.get());
+	bool r = ::Project(GetModelViewProjectionMatrix(false), viewport, p, out);
+
+	m_prj = prj;
+	m_mv.back() = mv;
+	return r;
+}
+
+Vec3 NullWorldDraw::Unproject(const Vec3 &p) {
+	int viewport[4];
+	world->game->Viewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	Mat4 prj = m_prj;
+	Mat4 mv = m_mv.back();
+
+	SetPerspectiveMatrix(*world->camera.get(), viewport);
+	RotateForCamera(*world->camera.get());
+	Vec3 z = ::Unproject(GetModelViewProjectionMatrix(false), viewport, p);
+
+	m_prj = prj;
+	m_mv.back() = mv;
+	return z;
+}
+
+Mat4 NullWorldDraw::GetModelViewMatrix() {
+	return m_mv.back();
+}
+
+Mat4 NullWorldDraw::GetModelViewProjectionMatrix(bool txAddressBias) {
+	if (txAddressBias)
+		return m_mv.back() * m_prj * kTexAddressBias;
+	return m_mv.back() * m_prj;
+}
+
+#if defined(WORLD_DEBUG_DRAW)
+void NullWorldDraw::BeginDebugDraw() {
+}
+
+void NullWorldDraw::EndDebugDraw() {
+}
+
+void NullWorldDraw::DebugUploadVerts(
+	const Vec3 *verts,
+	int numVerts
+) {
+}
+
+void NullWorldDraw::DebugUploadIndices(
+	const U16 *indices,
+	int numIndices
+) {
+}
+
+int NullWorldDraw::DebugTesselateVerts(int numVerts) {
+	return (numVerts > 2) ? ((numVerts - 2) * 3) : 0;
+}
+
+void NullWorldDraw::DebugDrawLineLoop(int numVerts) {
+}
+
+void NullWorldDraw::DebugDrawLineStrip(int numVerts) {
+}
+
+void NullWorldDraw::DebugDrawIndexedTris(int numIndices) {
+}
+
+void NullWorldDraw::DebugDrawIndexedLineLoop(int numIndices) {
+}
+
+void NullWorldDraw::DebugDrawIndexedLineStrip(int numIndices) {
+}
+
+void NullWorldDraw::DebugDrawTris(int num) {
+}
+
+void NullWorldDraw::DebugDrawPoly(int num) {
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CameraPath::Write(std::ostream &out) const {
+	for (CameraVec::const_iterator it = cameras.begin(); it != cameras.end(); ++it) {
+		const Camera &c = *it;
+		const Vec3 &pos = c.pos;
+		const Vec3 &angles = c.angles;
+		const Quat &rot = c.rot;
+
+		out << pos[0] << " " << pos[1] << " " << pos[2] << " " <<
+			angles[0] << " " << angles[1] << " " << angles[2] << " " <<
+			rot.X() << " " << rot.Y() << " " << rot.Z() << " " << rot.W() << " " <<
+			c.fov.get() << " " << c.farClip.get() << " " << (c.quatMode ? 1 : 0) << std::endl;
+	}
+}
+
+bool CameraPath::Read(std::istream &in) {
+	cameras.clear();
+
+	for (;;) {
+		Vec3 pos, angles;
+		float rot[4];
+		float fov, farClip;
+		int quatMode;
+
+		in >> pos[0] >> pos[1] >> pos[2] >>
+			angles[0] >> angles[1] >> angles[2] >>
+			rot[0] >> rot[1] >> rot[2] >> rot[3] >>
+			fov >> farClip >> quatMode;
+
+		if (in.fail())
+			break;
+
+		if (quatMode) {
+			cameras.push_back(Camera(pos, Quat(rot[0], rot[1], rot[2], rot[3]), fov, farClip));
+		} else {
+			cameras.push_back(Camera(pos, angles, fov, farClip));
+		}
+	}
+
+	return in.eof() && !cameras.empty();
+}
+
+} // world
@@ -0,0 +1,244 @@
+/*! \file NullWorldDraw.h
+	\copyright Copyright (c) 2013 Sunside Inc., All Rights Reserved.
+	\copyright See Radiance/LICENSE for licensing terms.
+	\author Joe Riedel
+	\ingroup world
+*/
+
+#pragma once
+
+#include "WorldDraw.h"
+#include <iosfwd>
+#include <Runtime/PushPack.h>
+
+namespace world {
+
+///////////////////////////////////////////////////////////////////////////////
+
+// A render backend that records what WorldDraw submits instead of drawing it.
+// Transforms are tracked on the CPU exactly as the GL backend tracks them so vis,
+// culling, light interactions and batching run unchanged.
+class RADENG_CLASS NullWorldDraw : public RB_WorldDraw {
+public:
+	typedef boost::shared_ptr<NullWorldDraw> Ref;
+
+	struct Counters {
+		Counters() {
+			Clear();
+		}
+
+		void Clear();
+
+		int materialBinds;
+		int materialChanges; // binds of a different material than the last one.
+		int textureBinds;
+		int shaderPasses;
+		int shaderChanges; // passes with a different material or pass than the last one.
+		int uniformBinds;
+		int stateCommits;
+		int batches;
+		int numTris;
+		int matrixOps;
+		int renderTargetBinds;
+		int lightStencils;
+		int overlays;
+	};
+
+	NullWorldDraw(World *w);
+	virtual ~NullWorldDraw();
+
+	RAD_DECLARE_READONLY_PROPERTY(NullWorldDraw, counters, const Counters*);
+
+	void ClearCounters();
+
+	virtual void BeginFrame();
+	virtual void EndFrame();
+	virtual int LoadMaterials();
+	virtual int Precache();
+	virtual void BeginPrecacheMaterials();
+	virtual void PrecacheMaterial(const details::MatRef &mat);
+	virtual void EndPrecacheMaterials();
+	virtual void BindFramebuffer(bool discardHint, bool copy);
+	virtual void BindRenderTarget();
+	virtual void ClearBackBuffer();
+	virtual void SetWorldStates();
+	virtual void FlipMatrixHack(bool enable);
+
+	virtual Mat4 MakePerspectiveMatrix(
+		float left,
+		float right,
+		float top,
+		float bottom,
+		float near,
+		float far,
+		bool txAddressBias
+	);
+
+	virtual void SetPerspectiveMatrix(
+		const Camera &camera,
+		const int viewport[4]
+	);
+
+	virtual void SetPerspectiveMatrix(const Mat4 &m);
+
+	virtual void SetScreenLocalMatrix();
+
+	virtual void SetOrthoMatrix(
+		float left,
+		float right,
+		float top,
+		float bottom,
+		float near,
+		float far
+	);
+
+	virtual void RotateForCamera(const Camera &camera);
+	virtual void RotateForCameraBasis();
+	virtual void PushMatrix(const Vec3 &pos, const Vec3 &scale, const Vec3 &angles);
+	virtual void PopMatrix();
+	virtual void ReleaseArrayStates();
+
+	virtual void BindLitMaterialStates(
+		r::Material &mat,
+		bool lightStencil
+	);
+
+	virtual void BindMaterialStates(r::Material &mat);
+	virtual void BindMaterialTextures(r::Material &mat, asset::MaterialLoader *loader);
+	virtual void BeginMaterialPass(r::Material &mat, r::Shader::Pass pass);
+	virtual void EndMaterialPass(r::Material &mat);
+
+	virtual void BindMaterialUniforms(
+		r::Material &mat,
+		const r::Shader::Uniforms &uniforms
+	);
+
+	virtual void DrawBatch(
+		MBatchDraw &draw,
+		r::Material &mat,
+		const r::Shader::Uniforms &uniforms,
+		bool sampleMaterialColor
+	);
+
+	virtual void BeginFog();
+	virtual void BeginFogDepthWrite(r::Material &fog, bool front);
+	virtual void BeginFogDraw(r::Material &fog);
+	virtual void EndFog();
+
+	virtual void RenderLightStencil(
+		const ViewDef &view,
+		const Vec4 **rects,
+		int numRects
+	);
+
+	virtual void BeginUnifiedShadows();
+	virtual void EndUnifiedShadows();
+
+	virtual bool BindUnifiedShadowRenderTarget(r::Material &shadowMaterial);
+	virtual bool BindUnifiedShadowTexture(r::Material &projectedMaterial);
+
+	virtual Vec2 BindPostFXTargets(
+		bool chain,
+		const r::Material &mat,
+		const Vec2 &srcScale,
+		const Vec2 &dstScale
+	);
+
+	virtual void BindPostFXQuad(const r::Material &mat);
+	virtual void DrawPostFXQuad();
+
+	virtual void BindOverlay(const r::Material &mat);
+	virtual void DrawOverlay();
+	virtual void CommitStates();
+	virtual void Finish();
+
+	virtual bool Project(const Vec3 &p, Vec3 &out);
+	virtual Vec3 Unproject(const Vec3 &p);
+
+	virtual Mat4 GetModelViewMatrix();
+	virtual Mat4 GetModelViewProjectionMatrix(bool txAddressBias);
+
+#if defined(WORLD_DEBUG_DRAW)
+	virtual void BeginDebugDraw();
+	virtual void EndDebugDraw();
+
+	virtual void DebugUploadVerts(
+		const Vec3 *verts,
+		int numVerts
+	);
+
+	virtual void DebugUploadIndices(
+		const U16 *indices,
+		int numIndices
+	);
+
+	virtual int DebugTesselateVerts(int numVerts);
+	virtual void DebugDrawLineLoop(int numVerts);
+	virtual void DebugDrawLineStrip(int numVerts);
+	virtual void DebugDrawIndexedTris(int numIndices);
+	virtual void DebugDrawIndexedLineLoop(int numIndices);
+	virtual void DebugDrawIndexedLineStrip(int numIndices);
+	virtual void DebugDrawTris(int num);
+	virtual void DebugDrawPoly(int num);
+#endif
+
+protected:
+
+	virtual RAD_DECLARE_GET(numTris, int) {
+		return m_numTris;
+	}
+
+	virtual RAD_DECLARE_SET(numTris, int) {
+		m_numTris = value;
+	}
+
+#if defined(WORLD_DEBUG_DRAW)
+	virtual RAD_DECLARE_GET(wireframe, bool) {
+		return m_wireframe;
+	}
+
+	virtual RAD_DECLARE_SET(wireframe, bool) {
+		m_wireframe = value;
+	}
+#endif
+
+private:
+
+	typedef zone_vector<Mat4, ZWorldT>::type MatrixStack;
+
+	RAD_DECLARE_GET(counters, const Counters*) {
+		return &m_counters;
+	}
+
+	void BindMaterial(const r::Material &mat);
+	void Rotate(float degrees, const Vec3 &axis);
+
+	Counters m_counters;
+	MatrixStack m_mv;
+	Mat4 m_prj;
+	const r::Material *m_material;
+	const r::Material *m_passMaterial;
+	int m_pass;
+	int m_numTris;
+	bool m_flipMatrix;
+	bool m_wireframe;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+// The world camera of each frame drawn during a capture, see World::BeginCameraCapture().
+// Paths are saved as text, one camera per line, so they can be replayed on another
+// machine with World::DrawBenchmark().
+class RADENG_CLASS CameraPath {
+public:
+	typedef zone_vector<Camera, ZWorldT>::type CameraVec;
+
+	CameraVec cameras;
+
+	void Write(std::ostream &out) const;
+	bool Read(std::istream &in);
+};
+
+} // world
+
+#include <Runtime/PopPack.h>
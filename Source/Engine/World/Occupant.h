@@ -70,8 +70,9 @@ private:
 	friend class World;
 	friend class WorldDraw;
 
-	IntSet m_areas;
+	IntVec m_areas;
 	dBSPLeaf::PtrVec m_bspLeafs;
+	MBatchOccupantLinkList::LinkVec m_links; // leaf and area membership.
 	World *m_world;
 	dBSPLeaf *m_leaf;
 	int m_markFrame;
@@ -15,10 +15,18 @@
 #include "../Engine.h"
 #include "../Sound/Sound.h"
 #include "../MathUtils.h"
+#include <Runtime/Thread.h>
+#include <Runtime/Time.h>
 #include <algorithm>
 
 namespace world {
 
+namespace {
+enum {
+	kModelTickGrain = 4 // DrawModel trees ticked per job.
+};
+}
+
 World::Ref World::New(Game &game, int slot, const SoundContext::Ref &sound, pkg::Zone zone) {
 	World::Ref w(new (ZEngine) World(game, slot, sound, zone));
 	w->m_zone.reset(new (ZEngine) Zone(w));
@@ -29,6 +37,7 @@ World::World(Game &game, int slot, const SoundContext::Ref &sound, pkg::Zone zon
 m_game(&game), 
 m_spawnState(SS_None), 
 m_spawnOfs(0),
+m_areaportalSerial(0),
 m_nextEntId(0), 
 m_nextTempEntId(0),
 m_time(0.f),
@@ -51,6 +60,10 @@ m_unloadSlotReq(false),
 m_switchLoad(false),
 m_switchLoadScreen(false),
 m_generateSave(false),
+m_queueModelTicks(false),
+#if defined(RAD_OPT_TOOLS)
+m_captureCamera(false),
+#endif
 m_gestures(0),
 m_flyCam(0) {
 	m_draw.reset(new (ZWorld) WorldDraw(this));
@@ -127,8 +140,159 @@ void World::Tick(float dt) {
 	}
 }
 
-void World::Draw() {
+struct World::ModelTickJob {
+	ModelTick *ticks;
+	ska::NotifyQueue *events;
+
+	void operator () (int first, int count) {
+		// queues are per range so events keep the order the models were queued in.
+		ska::NotifyQueue &q = events[first / kModelTickGrain];
+		q.Bind();
+		for (int i = first; i < first+count; ++i)
+			RunModelTick(ticks[i]);
+		q.Unbind();
+	}
+};
+
+bool World::QueueModelTick(const DrawModel::Ref &model, float time, float dt) {
+	if (!m_queueModelTicks)
+		return false;
+
+	ModelTick t;
+	t.model = model;
+	t.time = time;
+	t.dt = dt;
+	model->m_tickIndex = (int)m_modelTicks.size();
+	m_modelTicks.push_back(t);
+	return true;
+}
+
+void World::RunModelTick(const ModelTick &t) {
+	if (t.model->m_tickIndex < 0)
+		return; // already ticked by SyncModelTick().
+	t.model->m_tickIndex = -1;
+	t.model->Tick(t.time, t.dt);
+}
+
+void World::SyncModelTick(DrawModel &model) {
+	RAD_ASSERT(model.m_tickIndex >= 0);
+	const ModelTick &t = m_modelTicks[model.m_tickIndex];
+	RAD_ASSERT(t.model.get() == &model);
+	model.m_tickIndex = -1;
+	// on the main thread with no queue bound, events are dispatched immediately as they
+	// were when models ticked in place.
+	model.Tick(t.time, t.dt);
+}
+
+void World::TickModels(thread::JobScheduler &jobs) {
+	m_queueModelTicks = false;
+
+	const int kNumModels = (int)m_modelTicks.size();
+	if (kNumModels < 1)
+		return;
+
+	m_modelTickEvents.resize((kNumModels + kModelTickGrain - 1) / kModelTickGrain);
+
+	// models that were synced while entities ticked are skipped.
+	ModelTickJob job;
+	job.ticks = &m_modelTicks[0];
+	job.events = &m_modelTickEvents[0];
+	jobs.ParallelFor(kNumModels, kModelTickGrain, job);
+
+	for (NotifyQueueVec::iterator it = m_modelTickEvents.begin(); it != m_modelTickEvents.end(); ++it)
+		it->Dispatch();
+
+	// event handlers may free models, queued Ska tags point into them so the
+	// ticked models are held until every queue is dispatched.
+	m_modelTicks.clear();
+}
+
+#if defined(RAD_OPT_TOOLS)
+void World::BeginCameraCapture() {
+	m_cameraCapture.cameras.clear();
+	m_captureCamera = true;
+}
 
+void World::EndCameraCapture(CameraPath &path) {
+	m_captureCamera = false;
+	path.cameras.swap(m_cameraCapture.cameras);
+	m_cameraCapture.cameras.clear();
+}
+
+void World::DrawBenchmark(std::ostream &out, const CameraPath &path) {
+	const int kNumFrames = (int)path.cameras.size();
+
+	out << "******** World::DrawBenchmark ********" << std::endl;
+	out << "map: " << m_mapPath.c_str.get() << ", " << kNumFrames << " frames" << std::endl;
+
+	if (kNumFrames < 1)
+		return;
+
+	NullWorldDraw::Ref null(new (ZWorld) NullWorldDraw(this));
+	RB_WorldDraw::Ref rb = m_draw->m_rb;
+	m_draw->m_rb = null;
+
+	const Camera kCamera(m_cam);
+	const int kSimulatedParticles = m_draw->m_counters.simulatedParticles;
+	double totalMs = 0.0;
+	double minMs = 0.0;
+	double maxMs = 0.0;
+	int maxFrame = 0;
+
+	out << "frame ms areas portals models lights lightPasses batches tris materialBinds materialChanges shaderChanges commits" << std::endl;
+
+	for (int i = 0; i < kNumFrames; ++i) {
+		m_cam = path.cameras[i];
+
+		ClearDrawVisibility();
+		m_draw->m_counters.Clear();
+		null->ClearCounters();
+
+		xtime::MicroTimer timer;
+		timer.Start();
+
+		// the world view and overlays, the UI is not part of the draw pipeline.
+		null->BeginFrame();
+		null->FlipMatrixHack(true);
+		m_draw->DrawView();
+		null->SetScreenLocalMatrix();
+		m_draw->DrawOverlays();
+		null->FlipMatrixHack(false);
+		null->EndFrame();
+
+		timer.Stop();
+
+		const double kMs = timer.Elapsed() / 1000.0;
+		totalMs += kMs;
+		if ((i == 0) || (kMs < minMs))
+			minMs = kMs;
+		if ((i == 0) || (kMs > maxMs)) {
+			maxMs = kMs;
+			maxFrame = i;
+		}
+
+		const WorldDraw::Counters &c = m_draw->m_counters;
+		const NullWorldDraw::Counters &n = *null->counters.get();
+
+		out << i << " " << kMs << " " <<
+			c.drawnAreas << " " << c.drawnPortals << " " <<
+			(c.drawnWorldModels + c.drawnEntityModels + c.drawnActorModels) << " " <<
+			c.drawnLights << " " << c.numLightPasses << " " <<
+			n.batches << " " << n.numTris << " " <<
+			n.materialBinds << " " << n.materialChanges << " " << n.shaderChanges << " " <<
+			n.stateCommits << std::endl;
+	}
+
+	m_draw->m_rb = rb;
+	m_draw->m_counters.Clear();
+	m_draw->m_counters.simulatedParticles = kSimulatedParticles;
+	m_cam = kCamera;
+
+	out << "avg: " << (totalMs / kNumFrames) << " ms, min: " << minMs << " ms, max: " << maxMs << " ms (frame " << maxFrame << ")" << std::endl;
+}
+#endif
+
+void World::ClearDrawVisibility() {
 	for (Entity::IdMap::const_iterator it = m_ents.begin(); it != m_ents.end(); ++it) {
 		const Entity::Ref &e = it->second;
 		e->m_ps.visible = false; // clear for draw.
@@ -137,6 +301,16 @@ void World::Draw() {
 			m->m_inView = false; // clear for draw.
 		}
 	}
+}
+
+void World::Draw() {
+
+	ClearDrawVisibility();
+
+#if defined(RAD_OPT_TOOLS)
+	if (m_captureCamera)
+		m_cameraCapture.cameras.push_back(m_cam);
+#endif
 
 	// HACK
 	int simulatedParticles = m_draw->counters->simulatedParticles;
@@ -252,6 +426,8 @@ void World::TickState(float dt, float unmod_dt) {
 
 		DispatchEvents();
 
+		m_queueModelTicks = true;
+
 		for (Entity::IdMap::const_iterator it = m_ents.begin(); it != m_ents.end(); ++it) {
 			const Entity::Ref &entity = it->second;
 			if (entity.get() != m_viewController.get()) {
@@ -264,6 +440,9 @@ void World::TickState(float dt, float unmod_dt) {
 		if (m_viewController)
 			m_viewController->PrivateTick(frame, dt, xtime::TimeSlice::Infinite);
 
+		// joins before any animation events reach script.
+		TickModels(*App::Get()->engine->sys->jobs);
+
 		gc = true;
 	} else { 
 		// game is paused, must tick world!
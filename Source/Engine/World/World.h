@@ -13,6 +13,7 @@
 #include "Event.h"
 #include "../Camera.h"
 #include "WorldDraw.h"
+#include "NullWorldDraw.h"
 #include "WorldLua.h"
 #include "WorldCinematics.h"
 #include "Floors.h"
@@ -77,6 +78,18 @@ public:
 	void SetGameSpeed(float speed, float duration);
 
 	void Tick(float dt);
+
+#if defined(RAD_OPT_TOOLS)
+	// Records the camera of every drawn frame until EndCameraCapture(), the r_capturecamera
+	// and r_drawbenchmark console commands drive these from a running game.
+	void BeginCameraCapture();
+	void EndCameraCapture(CameraPath &path);
+
+	// Draws the view from each camera in the path through a NullWorldDraw backend and
+	// reports the CPU time and draw counters of every frame.
+	void DrawBenchmark(std::ostream &out, const CameraPath &path);
+#endif
+
 	void Draw();
 
 	void NotifyBackground();
@@ -134,6 +147,8 @@ public:
 	Entity::Vec FindEntityClass(const char *classname) const;
 	Entity::Vec FindEntityTargets(const char *targetname) const;
 	Entity::Vec BBoxTouching(const BBox &bbox, int classbits) const;
+	//! Batched BBoxTouching(), out[i] receives the entities touching boxes[i].
+	void BBoxTouching(const BBox *boxes, int numBoxes, int classbits, Entity::Vec *out) const;
 	Entity::Ref FirstBBoxTouching(const BBox &bbox, int classbits) const;
 	bool IsBBoxInsideBrushHull(const BBox &bbox, int brushNum) const;
 
@@ -159,6 +174,11 @@ public:
 	//! returns true if trace.start->trace.end was blocked, false otherwise.
 	bool LineTrace(Trace &trace);
 
+	//! Batched LineTrace(), the traces are walked through the world BSP together.
+	//! returns the number of traces that were blocked, blocked[i] is set to 1 if
+	//! LineTrace() would return true for traces[i].
+	int LineTraces(Trace *traces, int numTraces, U8 *blocked = 0);
+
 	Entity::Vec EntitiesTouchingBrush(int classbits, int brushNum, const Vec3 &xform = Vec3::Zero) const;
 	Entity::Ref FirstEntityTouchingBrush(int classbits, int brushNum, const Vec3 &xform = Vec3::Zero) const;
 	bool EntityTouchesBrush(const Entity &entity, int brushNum, const Vec3 &xform = Vec3::Zero) const;
@@ -195,12 +215,26 @@ private:
 	friend class WorldDraw;
 	friend class WorldLua;
 	friend class Entity;
+	friend class DrawModel;
 	friend class MBatchOccupant;
 	friend class Light;
 	typedef zone_list<Event::Ref, ZWorldT>::type EventList;
 	typedef zone_map<int, ZoneTagRef, ZWorldT>::type ZoneIdMap;
 	typedef boost::array<AreaBits, kMaxAreas> AreaVisMask;
 
+	// DrawModel ticks are queued while entities tick and run together as jobs. Reading
+	// the bones of a queued model ticks it at once (see SyncModelTick()), so attachments,
+	// kTickFlag_PostPhysics tasks and scripts see the same bone positions they would if
+	// models were ticked in place.
+	struct ModelTick {
+		DrawModel::Ref model;
+		float time;
+		float dt;
+	};
+	typedef zone_vector<ModelTick, ZWorldT>::type ModelTickVec;
+	typedef zone_vector<ska::NotifyQueue, ZWorldT>::type NotifyQueueVec;
+	struct ModelTickJob;
+
 	World(Game &game, int slot, const SoundContextRef &sound, pkg::Zone zone);
 
 	enum {
@@ -293,6 +327,10 @@ private:
 	int CreateEntity(const Keys &keys);
 	Keys LoadEntityKeys(const bsp_file::BSPFile &bsp, U32 entityNum);
 	void TickState(float dt, float unmod_dt);
+	bool QueueModelTick(const DrawModel::Ref &model, float time, float dt);
+	void TickModels(thread::JobScheduler &jobs);
+	void SyncModelTick(DrawModel &model);
+	static void RunModelTick(const ModelTick &t);
 	void DispatchEvents();
 	void FlushEvents();
 	int PostSpawn(const xtime::TimeSlice &time, int flags);
@@ -300,6 +338,7 @@ private:
 	void LoadBSP(const bsp_file::BSPFile &bsp);
 	void LinkEntity(Entity &entity, const BBox &bounds);
 	void UnlinkEntity(Entity &entity);
+	void ClearDrawVisibility();
 	void InternalUnlinkEntity(Entity &entity);
 	void LinkOccupant(MBatchOccupant &occupant, const BBox &bounds);
 	void UnlinkOccupant(MBatchOccupant &occupant);
@@ -407,6 +446,42 @@ private:
 	);
 
 	bool LineTrace(Trace &trace, const Vec3 &a, const Vec3 &b, int node);
+	bool LineTraceLeaf(Trace &trace, const Vec3 &a, const Vec3 &b, int leafNum);
+	bool LineTraceStart(Trace &trace);
+
+	//! Work-list for batched queries, segments (or box mins/maxs) are stored
+	//! as arrays of x/y/z so a node plane can be tested against all of them at once.
+	struct TraceBatch {
+		typedef zone_vector<float, ZWorldT>::type FloatVec;
+		typedef zone_vector<int, ZWorldT>::type IntVec;
+		typedef zone_vector<U8, ZWorldT>::type ByteVec;
+
+		void Reserve(int size);
+		void Push(const Vec3 &a, const Vec3 &b, int i);
+		void Resize(int size);
+
+		int size() const {
+			return (int)index.size();
+		}
+
+		FloatVec pts[6]; // a x y z, b x y z
+		IntVec index;
+		FloatVec dist[2];
+		ByteVec sides;
+		ByteVec done;
+	};
+
+	void LineTraces(Trace *traces, TraceBatch &batch, int nodeNum, int first, int count);
+
+	void BBoxTouching(
+		TraceBatch &batch,
+		int classbits,
+		int nodeNum,
+		int first,
+		int count,
+		Entity::Vec *out,
+		EntityBits *checked
+	) const;
 
 	dBSPLeaf *LeafForPoint(const Vec3 &pos);
 	dBSPLeaf *LeafForPoint(const Vec3 &pos, int nodeNum);
@@ -582,6 +657,8 @@ private:
 	ui::RootRef m_uiRoot;
 	SoundContextRef m_sound;
 	WorldDraw::Counters m_drawCounters;
+	ModelTickVec m_modelTicks;
+	NotifyQueueVec m_modelTickEvents;
 	dBSPNode::Vec m_nodes;
 	dBSPLeaf::Vec m_leafs;
 	dBSPArea::Vec m_areas;
@@ -589,6 +666,7 @@ private:
 	dAreaportal::Vec m_areaportals;
 	PlaneVec m_planes;
 	U32 m_spawnOfs;
+	int m_areaportalSerial; // changes with the state of any areaportal.
 	int m_frame;
 	int m_spawnState;
 	int m_nextEntId;
@@ -613,6 +691,11 @@ private:
 	bool m_switchLoad;
 	bool m_switchLoadScreen;
 	bool m_generateSave;
+	bool m_queueModelTicks;
+#if defined(RAD_OPT_TOOLS)
+	CameraPath m_cameraCapture;
+	bool m_captureCamera;
+#endif
 	float m_gameSpeed[3];
 	float m_gameSpeedTime[2];
 	int m_gestures;
@@ -8,13 +8,37 @@
 #include "Occupant.h"
 #include "Light.h"
 #include "../MathUtils.h"
+#include <Runtime/Base/SIMD.h>
 #include <algorithm>
 
 namespace world {
 
+namespace {
+
+// how a segment in a batched trace is routed through a node.
+enum {
+	kTraceSide_Front,
+	kTraceSide_Back,
+	kTraceSide_CrossFront, // a is in front, b is behind.
+	kTraceSide_CrossBack,  // a is behind, b is in front.
+	kTraceSide_Done
+};
+
+inline Plane::SideType DistanceSide(float d) {
+	if (d > math::Epsilon<float>())
+		return Plane::Front;
+	if (d < -math::Epsilon<float>())
+		return Plane::Back;
+	return Plane::On;
+}
+
+}
+
 void World::SetAreaportalState(int areaportalNum, bool open, bool relinkOccupants) {
 	RAD_ASSERT(areaportalNum < (int)m_bsp->numAreaportals.get());
 	dAreaportal &areaportal = m_areaportals[areaportalNum];
+	if (areaportal.open != open)
+		++m_areaportalSerial;
 	areaportal.open = open;
 
 	if (!relinkOccupants)
@@ -29,7 +53,7 @@ void World::SetAreaportalState(int areaportalNum, bool open, bool relinkOccupant
 	for (dBSPLeaf::Vec::const_iterator it = m_leafs.begin(); it != m_leafs.end(); ++it) {
 		const dBSPLeaf &leaf = *it;
 
-		for (EntityPtrSet::iterator it = leaf.entities.begin(); it != leaf.entities.end(); ++it) {
+		for (EntityLinkList::const_iterator it = leaf.entities.begin(); it != leaf.entities.end(); ++it) {
 			Entity *entity = *it;
 			RAD_ASSERT(entity);
 
@@ -37,13 +61,13 @@ void World::SetAreaportalState(int areaportalNum, bool open, bool relinkOccupant
 				ents.insert(entity);
 		}
 
-		for (MBatchOccupantPtrSet::iterator it = leaf.occupants.begin(); it != leaf.occupants.end(); ++it) {
+		for (MBatchOccupantLinkList::const_iterator it = leaf.occupants.begin(); it != leaf.occupants.end(); ++it) {
 			MBatchOccupant *occupant = *it;
 			if (leaf.area != occupant->m_leaf->area)
 				occupants.insert(occupant);
 		}
 
-		for (LightPtrSet::iterator it = leaf.lights.begin(); it != leaf.lights.end(); ++it) {
+		for (LightLinkList::const_iterator it = leaf.lights.begin(); it != leaf.lights.end(); ++it) {
 			Light *light = *it;
 			if (leaf.area != light->m_leaf->area)
 				lights.insert(light);
@@ -126,7 +150,7 @@ void World::BBoxTouching(
 		RAD_ASSERT(nodeNum < (int)m_leafs.size());
 		const dBSPLeaf &leaf = m_leafs[nodeNum];
 
-		for (EntityPtrSet::const_iterator it = leaf.entities.begin(); it != leaf.entities.end(); ++it) {
+		for (EntityLinkList::const_iterator it = leaf.entities.begin(); it != leaf.entities.end(); ++it) {
 			Entity *entity = *it;
 			if (checked[entity->m_id])
 				continue;
@@ -185,7 +209,7 @@ Entity::Ref World::FirstBBoxTouching(
 		RAD_ASSERT(nodeNum < (int)m_leafs.size());
 		const dBSPLeaf &leaf = m_leafs[nodeNum];
 
-		for (EntityPtrSet::const_iterator it = leaf.entities.begin(); it != leaf.entities.end(); ++it) {
+		for (EntityLinkList::const_iterator it = leaf.entities.begin(); it != leaf.entities.end(); ++it) {
 			Entity *entity = *it;
 			if (bits[entity->m_id])
 				continue;
@@ -237,9 +261,9 @@ void World::LinkEntity(Entity &entity, const BBox &bounds) {
 		return;
 
 	if (entity.ps->otype == kOccupantType_Sky) {
-		entity.m_areas.insert(kSkyArea);
+		entity.m_areas.push_back(kSkyArea);
 		dBSPArea &area = m_areas[kSkyArea];
-		area.entities.insert(&entity);
+		area.entities.Add(&entity, entity.m_links);
 		return;
 	}
 
@@ -275,15 +299,7 @@ void World::UnlinkEntity(Entity &entity) {
 
 void World::InternalUnlinkEntity(Entity &entity) {
 	
-	for (dBSPLeaf::PtrVec::const_iterator it = entity.m_bspLeafs.begin(); it != entity.m_bspLeafs.end(); ++it) {
-		dBSPLeaf *leaf = *it;
-		leaf->entities.erase(&entity);
-	}
-
-	for (IntSet::const_iterator it = entity.m_areas.begin(); it != entity.m_areas.end(); ++it) {
-		dBSPArea &area = m_areas[*it];
-		area.entities.erase(&entity);
-	}
+	EntityLinkList::RemoveAll(entity.m_links);
 
 	entity.m_bspLeafs.clear();
 	entity.m_areas.clear();
@@ -297,11 +313,14 @@ void World::LinkEntity(const LinkEntityParms &constArgs, int nodeNum) {
 		dBSPLeaf &leaf = m_leafs[nodeNum];
 
 		if ((leaf.area > -1) && constArgs.visible.test(leaf.area)) {
-			leaf.entities.insert(&constArgs.entity);
-			constArgs.entity.m_bspLeafs.push_back(&leaf);
-			constArgs.entity.m_areas.insert(leaf.area);
+			Entity &entity = constArgs.entity;
+			leaf.entities.Add(&entity, entity.m_links);
+			entity.m_bspLeafs.push_back(&leaf);
 			dBSPArea &area = m_areas[leaf.area];
-			area.entities.insert(&constArgs.entity);
+			if (std::find(entity.m_areas.begin(), entity.m_areas.end(), leaf.area) == entity.m_areas.end()) {
+				entity.m_areas.push_back(leaf.area);
+				area.entities.Add(&entity, entity.m_links);
+			}
 			m_draw->LinkEntity(
 				constArgs.entity, 
 				constArgs.bounds, 
@@ -336,9 +355,9 @@ void World::LinkOccupant(MBatchOccupant &occupant, const BBox &bounds) {
 		return;
 
 	if (occupant.sky) {
-		occupant.m_areas.insert(kSkyArea);
+		occupant.m_areas.push_back(kSkyArea);
 		dBSPArea &area = m_areas[kSkyArea];
-		area.occupants.insert(&occupant);
+		area.occupants.Add(&occupant, occupant.m_links);
 		return;
 	}
 
@@ -366,15 +385,7 @@ void World::UnlinkOccupant(MBatchOccupant &occupant) {
 
 void World::InternalUnlinkOccupant(MBatchOccupant &occupant) {
 	
-	for (dBSPLeaf::PtrVec::const_iterator it = occupant.m_bspLeafs.begin(); it != occupant.m_bspLeafs.end(); ++it) {
-		dBSPLeaf *leaf = *it;
-		leaf->occupants.erase(&occupant);
-	}
-
-	for (IntSet::const_iterator it = occupant.m_areas.begin(); it != occupant.m_areas.end(); ++it) {
-		dBSPArea &area = m_areas[*it];
-		area.occupants.erase(&occupant);
-	}
+	MBatchOccupantLinkList::RemoveAll(occupant.m_links);
 
 	occupant.m_bspLeafs.clear();
 	occupant.m_areas.clear();
@@ -388,11 +399,14 @@ void World::LinkOccupant(const LinkOccupantParms &constArgs, int nodeNum) {
 		dBSPLeaf &leaf = m_leafs[nodeNum];
 
 		if ((leaf.area > -1) && constArgs.visible.test(leaf.area)) {
-			leaf.occupants.insert(&constArgs.occupant);
-			constArgs.occupant.m_bspLeafs.push_back(&leaf);
-			constArgs.occupant.m_areas.insert(leaf.area);
+			MBatchOccupant &occupant = constArgs.occupant;
+			leaf.occupants.Add(&occupant, occupant.m_links);
+			occupant.m_bspLeafs.push_back(&leaf);
 			dBSPArea &area = m_areas[leaf.area];
-			area.occupants.insert(&constArgs.occupant);
+			if (std::find(occupant.m_areas.begin(), occupant.m_areas.end(), leaf.area) == occupant.m_areas.end()) {
+				occupant.m_areas.push_back(leaf.area);
+				area.occupants.Add(&occupant, occupant.m_links);
+			}
 			m_draw->LinkOccupant(
 				constArgs.occupant, 
 				constArgs.bounds, 
@@ -455,15 +469,7 @@ void World::UnlinkLight(Light &light) {
 
 void World::InternalUnlinkLight(Light &light) {
 	
-	for (dBSPLeaf::PtrVec::const_iterator it = light.m_bspLeafs.begin(); it != light.m_bspLeafs.end(); ++it) {
-		dBSPLeaf *leaf = *it;
-		leaf->lights.erase(&light);
-	}
-
-	for (IntSet::const_iterator it = light.m_areas.begin(); it != light.m_areas.end(); ++it) {
-		dBSPArea &area = m_areas[*it];
-		area.lights.erase(&light);
-	}
+	LightLinkList::RemoveAll(light.m_links);
 
 	light.m_bspLeafs.clear();
 	light.m_areas.clear();
@@ -477,11 +483,14 @@ void World::LinkLight(const LinkLightParms &constArgs, int nodeNum) {
 		dBSPLeaf &leaf = m_leafs[nodeNum];
 
 		if ((leaf.area > -1) && constArgs.visible.test(leaf.area)) {
-			leaf.lights.insert(&constArgs.light);
-			constArgs.light.m_bspLeafs.push_back(&leaf);
-			constArgs.light.m_areas.insert(leaf.area);
+			Light &light = constArgs.light;
+			leaf.lights.Add(&light, light.m_links);
+			light.m_bspLeafs.push_back(&leaf);
 			dBSPArea &area = m_areas[leaf.area];
-			area.lights.insert(&constArgs.light);
+			if (std::find(light.m_areas.begin(), light.m_areas.end(), leaf.area) == light.m_areas.end()) {
+				light.m_areas.push_back(leaf.area);
+				area.lights.Add(&light, light.m_links);
+			}
 			m_draw->LinkLight(
 				constArgs.light, 
 				constArgs.bounds, 
@@ -890,6 +899,26 @@ void World::MakeBoundingPlanes(const Vec3 &pos, const StackWinding &portal, Plan
 
 bool World::LineTrace(Trace &trace) {
 
+	if (LineTraceStart(trace))
+		return true;
+
+	bool r;
+	if (m_nodes.empty()) {
+		r = LineTrace(trace, trace.start, trace.end, -1);
+	} else {
+		r = LineTrace(trace, trace.start, trace.end, 0);
+	}
+
+	if (r) {
+		float l = (trace.end - trace.start).MagnitudeSquared();
+		float d = (trace.traceEnd - trace.start).MagnitudeSquared();
+		trace.frac = (l != 0.f) ? (d / l) : 1.f;
+	}
+
+	return r;
+}
+
+bool World::LineTraceStart(Trace &trace) {
 	const dBSPLeaf *leaf = LeafForPoint(trace.start);
 	if (!leaf) {
 		trace.startSolid = true;
@@ -912,62 +941,50 @@ bool World::LineTrace(Trace &trace) {
 	trace.startSolid = false;
 	trace.traceEnd = trace.start;
 	trace.frac = 1.f;
+	return false;
+}
 
-	bool r;
-	if (m_nodes.empty()) {
-		r = LineTrace(trace, trace.start, trace.end, -1);
-	} else {
-		r = LineTrace(trace, trace.start, trace.end, 0);
-	}
+bool World::LineTraceLeaf(Trace &trace, const Vec3 &a, const Vec3 &b, int leafNum) {
+	const dBSPLeaf &leaf = m_leafs[leafNum];
 
-	if (r) {
-		float l = (trace.end - trace.start).MagnitudeSquared();
-		float d = (trace.traceEnd - trace.start).MagnitudeSquared();
-		trace.frac = (l != 0.f) ? (d / l) : 1.f;
-	}
+	// it's not gonna hit this leaf.
+	if (!(leaf.contents&trace.contents))
+		return false;
 
-	return r;
-}
+	if (trace.contents&bsp_file::kContentsFlag_Clip) {
+		if (leaf.numClipModels < 1)
+			return false;
 
-bool World::LineTrace(Trace &trace, const Vec3 &a, const Vec3 &b, int nodeNum) {
-	if (nodeNum < 0) {
-		int leafNum = -(nodeNum + 1);
-		const dBSPLeaf &leaf = m_leafs[leafNum];
+		float bestDistance = std::numeric_limits<float>::max();
+		const bsp_file::BSPClipSurface *surface = 0;
+		Vec3 intersection;
+
+		for (int i = 0; i < leaf.numClipModels; ++i) {
+			RayIntersectsClipModel(
+				i+leaf.firstClipModel,
+				a,
+				b,
+				bestDistance,
+				intersection,
+				surface
+			);
+		}
 
-		// it's not gonna hit this leaf.
-		if (!(leaf.contents&trace.contents))
+		if (!surface)
 			return false;
-		
-		if (trace.contents&bsp_file::kContentsFlag_Clip) {
-			if (leaf.numClipModels < 1)
-				return false;
-
-			float bestDistance = std::numeric_limits<float>::max();
-			const bsp_file::BSPClipSurface *surface = 0;
-			Vec3 intersection;
-
-			for (int i = 0; i < leaf.numClipModels; ++i) {
-				RayIntersectsClipModel(
-					i+leaf.firstClipModel,
-					a,
-					b,
-					bestDistance,
-					intersection,
-					surface
-				);
-			}
 
-			if (!surface)
-				return false;
+		trace.contents = surface->contents;
+		trace.normal = m_planes[surface->planenum].Normal();
+		trace.traceEnd = intersection;
+		return true;
+	}
 
-			trace.contents = surface->contents;
-			trace.normal = m_planes[surface->planenum].Normal();
-			trace.traceEnd = intersection;
-			return true;
-		}
+	return false;
+}
 
-		return false;
-	}
+bool World::LineTrace(Trace &trace, const Vec3 &a, const Vec3 &b, int nodeNum) {
+	if (nodeNum < 0)
+		return LineTraceLeaf(trace, a, b, -(nodeNum + 1));
 
 	// trace from result->end
 	const dBSPNode &node = m_nodes[nodeNum];
@@ -1002,6 +1019,309 @@ bool World::LineTrace(Trace &trace, const Vec3 &a, const Vec3 &b, int nodeNum) {
 	return false;
 }
 
+void World::TraceBatch::Reserve(int size) {
+	if (size <= (int)index.capacity())
+		return;
+	size = std::max(size, (int)index.capacity()*2);
+	for (int i = 0; i < 6; ++i)
+		pts[i].reserve(size);
+	index.reserve(size);
+}
+
+void World::TraceBatch::Push(const Vec3 &a, const Vec3 &b, int i) {
+	for (int k = 0; k < 3; ++k) {
+		pts[k].push_back(a[k]);
+		pts[k+3].push_back(b[k]);
+	}
+	index.push_back(i);
+}
+
+void World::TraceBatch::Resize(int size) {
+	for (int i = 0; i < 6; ++i)
+		pts[i].resize(size);
+	index.resize(size);
+}
+
+int World::LineTraces(Trace *traces, int numTraces, U8 *blocked) {
+	TraceBatch batch;
+	batch.Reserve(numTraces*4);
+	batch.done.resize(numTraces, 0);
+
+	for (int i = 0; i < numTraces; ++i) {
+		Trace &trace = traces[i];
+		if (LineTraceStart(trace)) {
+			batch.done[i] = 1;
+		} else {
+			batch.Push(trace.start, trace.end, i);
+		}
+	}
+
+	if (batch.size() > 0)
+		LineTraces(traces, batch, m_nodes.empty() ? -1 : 0, 0, batch.size());
+
+	int numBlocked = 0;
+	for (int i = 0; i < numTraces; ++i) {
+		if (blocked)
+			blocked[i] = batch.done[i];
+		if (!batch.done[i])
+			continue;
+		++numBlocked;
+
+		Trace &trace = traces[i];
+		if (!trace.startSolid) {
+			float l = (trace.end - trace.start).MagnitudeSquared();
+			float d = (trace.traceEnd - trace.start).MagnitudeSquared();
+			trace.frac = (l != 0.f) ? (d / l) : 1.f;
+		}
+	}
+
+	return numBlocked;
+}
+
+void World::LineTraces(Trace *traces, TraceBatch &batch, int nodeNum, int first, int count) {
+	if (nodeNum < 0) {
+		const int kLeafNum = -(nodeNum + 1);
+		for (int i = first; i < first+count; ++i) {
+			const int kIndex = batch.index[i];
+			if (batch.done[kIndex])
+				continue;
+			const Vec3 kA(batch.pts[0][i], batch.pts[1][i], batch.pts[2][i]);
+			const Vec3 kB(batch.pts[3][i], batch.pts[4][i], batch.pts[5][i]);
+			if (LineTraceLeaf(traces[kIndex], kA, kB, kLeafNum))
+				batch.done[kIndex] = 1;
+		}
+		return;
+	}
+
+	const dBSPNode &node = m_nodes[nodeNum];
+	const Plane &plane = m_planes[node.planenum];
+	const float kPlane[4] = { plane.Normal()[0], plane.Normal()[1], plane.Normal()[2], plane.D() };
+
+	if ((int)batch.sides.size() < count) {
+		batch.dist[0].resize(count);
+		batch.dist[1].resize(count);
+		batch.sides.resize(count);
+	}
+
+	const float *kA[3] = { &batch.pts[0][first], &batch.pts[1][first], &batch.pts[2][first] };
+	const float *kB[3] = { &batch.pts[3][first], &batch.pts[4][first], &batch.pts[5][first] };
+	float *d0 = &batch.dist[0][0];
+	float *d1 = &batch.dist[1][0];
+	U8 *sides = &batch.sides[0];
+
+	SIMD->PlaneDistances(d0, kA, count, kPlane);
+	SIMD->PlaneDistances(d1, kB, count, kPlane);
+
+	// same side rules as LineTrace()
+	for (int i = 0; i < count; ++i) {
+		if (batch.done[batch.index[first+i]]) {
+			sides[i] = kTraceSide_Done;
+			continue;
+		}
+
+		Plane::SideType s0 = DistanceSide(d0[i]);
+		Plane::SideType s1 = DistanceSide(d1[i]);
+
+		if (s0 == Plane::On)
+			s0 = s1;
+		if (s1 == Plane::On)
+			s1 = s0;
+
+		if (s0 == s1) {
+			sides[i] = (s0 == Plane::Back) ? kTraceSide_Back : kTraceSide_Front;
+		} else {
+			sides[i] = (s0 == Plane::Back) ? kTraceSide_CrossBack : kTraceSide_CrossFront;
+		}
+	}
+
+	// Split into 4 work-lists: segments starting in front, segments starting behind,
+	// then the far halves of crossing segments, so each trace still walks front to back
+	// and stops at its first hit.
+	const int kListStart = batch.size();
+	batch.Reserve(kListStart + count*2);
+
+	const int kChildren[4] = { node.children[0], node.children[1], node.children[1], node.children[0] };
+	int listFirst[4];
+	int listCount[4];
+
+	for (int list = 0; list < 4; ++list) {
+		listFirst[list] = batch.size();
+
+		for (int i = 0; i < count; ++i) {
+			const int kSide = sides[i];
+			if (kSide == kTraceSide_Done)
+				continue;
+
+			const bool kWhole = (list < 2) && (kSide == list);
+			const bool kNear = (list < 2) && (kSide == list+2);
+			const bool kFar = (list >= 2) && (kSide == list);
+
+			if (!(kWhole || kNear || kFar))
+				continue;
+
+			const int j = first + i;
+			const Vec3 a(batch.pts[0][j], batch.pts[1][j], batch.pts[2][j]);
+			const Vec3 b(batch.pts[3][j], batch.pts[4][j], batch.pts[5][j]);
+
+			if (kWhole) {
+				batch.Push(a, b, batch.index[j]);
+			} else {
+				const Vec3 kMid = Plane::IntersectLineSegment(a, d0[i], b, d1[i]);
+				if (kNear) {
+					batch.Push(a, kMid, batch.index[j]);
+				} else {
+					batch.Push(kMid, b, batch.index[j]);
+				}
+			}
+		}
+
+		listCount[list] = batch.size() - listFirst[list];
+	}
+
+	for (int list = 0; list < 4; ++list) {
+		if (listCount[list] > 0)
+			LineTraces(traces, batch, kChildren[list], listFirst[list], listCount[list]);
+	}
+
+	batch.Resize(kListStart);
+}
+
+void World::BBoxTouching(const BBox *boxes, int numBoxes, int classbits, Entity::Vec *out) const {
+	if (numBoxes < 1)
+		return;
+
+	TraceBatch batch;
+	batch.Reserve(numBoxes*4);
+
+	for (int i = 0; i < numBoxes; ++i)
+		batch.Push(boxes[i].Mins(), boxes[i].Maxs(), i);
+
+	zone_vector<EntityBits, ZWorldT>::type checked(numBoxes);
+
+	BBoxTouching(batch, classbits, m_nodes.empty() ? -1 : 0, 0, numBoxes, out, &checked[0]);
+}
+
+void World::BBoxTouching(
+	TraceBatch &batch,
+	int classbits,
+	int nodeNum,
+	int first,
+	int count,
+	Entity::Vec *out,
+	EntityBits *checked
+) const {
+	if (nodeNum < 0) {
+		nodeNum = -(nodeNum + 1);
+		RAD_ASSERT(nodeNum < (int)m_leafs.size());
+		const dBSPLeaf &leaf = m_leafs[nodeNum];
+
+		for (EntityLinkList::const_iterator it = leaf.entities.begin(); it != leaf.entities.end(); ++it) {
+			Entity *entity = *it;
+			if (!entity->classbits)
+				continue;
+			if ((classbits != kEntityClassBits_Any) && !(classbits&entity->classbits))
+				continue;
+
+			BBox b(entity->ps->bbox);
+			b.Translate(entity->ps->worldPos);
+
+			for (int i = first; i < first+count; ++i) {
+				const int kIndex = batch.index[i];
+				if (checked[kIndex][entity->m_id])
+					continue;
+				checked[kIndex].set(entity->m_id);
+
+				const BBox kBox(
+					Vec3(batch.pts[0][i], batch.pts[1][i], batch.pts[2][i]),
+					Vec3(batch.pts[3][i], batch.pts[4][i], batch.pts[5][i])
+				);
+
+				if (kBox.Touches(b))
+					out[kIndex].push_back(entity->shared_from_this());
+			}
+		}
+
+		return;
+	}
+
+	const dBSPNode &node = m_nodes[nodeNum];
+	const Plane &plane = m_planes[node.planenum];
+	const Vec3 &normal = plane.Normal();
+	const float kPlane[4] = { normal[0], normal[1], normal[2], plane.D() };
+
+	if ((int)batch.sides.size() < count) {
+		batch.dist[0].resize(count);
+		batch.dist[1].resize(count);
+		batch.sides.resize(count);
+	}
+
+	// box corners nearest and furthest along the plane normal, see Plane::Side(BBox).
+	const float *kMins[3];
+	const float *kMaxs[3];
+	for (int k = 0; k < 3; ++k) {
+		const int kMinArray = (normal[k] >= 0.f) ? k : k+3;
+		kMins[k] = &batch.pts[kMinArray][first];
+		kMaxs[k] = &batch.pts[(kMinArray+3)%6][first];
+	}
+
+	float *d0 = &batch.dist[0][0];
+	float *d1 = &batch.dist[1][0];
+	U8 *sides = &batch.sides[0];
+
+	SIMD->PlaneDistances(d0, kMins, count, kPlane);
+	SIMD->PlaneDistances(d1, kMaxs, count, kPlane);
+
+	for (int i = 0; i < count; ++i) {
+		const Plane::SideType kS0 = DistanceSide(d0[i]);
+		const Plane::SideType kS1 = DistanceSide(d1[i]);
+		Plane::SideType s;
+
+		if (kS0 == kS1) {
+			s = kS0;
+		} else if (kS0 == Plane::On) {
+			s = kS1;
+		} else if (kS1 == Plane::On) {
+			s = kS0;
+		} else {
+			s = Plane::Cross;
+		}
+
+		sides[i] = (U8)s;
+	}
+
+	// boxes are not split at the node, see the PERFORMANCE NOTE in BBoxTouching()
+	const int kListStart = batch.size();
+	batch.Reserve(kListStart + count*2);
+
+	int listFirst[2];
+	int listCount[2];
+
+	for (int list = 0; list < 2; ++list) {
+		const Plane::SideType kSide = list ? Plane::Back : Plane::Front;
+		listFirst[list] = batch.size();
+
+		for (int i = 0; i < count; ++i) {
+			if ((sides[i] != kSide) && (sides[i] != Plane::Cross))
+				continue;
+			const int j = first + i;
+			batch.Push(
+				Vec3(batch.pts[0][j], batch.pts[1][j], batch.pts[2][j]),
+				Vec3(batch.pts[3][j], batch.pts[4][j], batch.pts[5][j]),
+				batch.index[j]
+			);
+		}
+
+		listCount[list] = batch.size() - listFirst[list];
+	}
+
+	for (int list = 0; list < 2; ++list) {
+		if (listCount[list] > 0)
+			BBoxTouching(batch, classbits, node.children[list], listFirst[list], listCount[list], out, checked);
+	}
+
+	batch.Resize(kListStart);
+}
+
 Entity::Ref World::FirstEntityTouchingBrush(int classbits, int brushNum, const Vec3 &xform) const {
 	RAD_ASSERT(brushNum >= 0 && brushNum < (int)m_bsp->numBrushes);
 	const bsp_file::BSPBrush *brush = m_bsp->Brushes() + brushNum;
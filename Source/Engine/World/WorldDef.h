@@ -77,6 +77,84 @@ typedef boost::weak_ptr<Zone> ZoneWRef;
 typedef boost::shared_ptr<ZoneTag> ZoneTagRef;
 typedef boost::weak_ptr<ZoneTag> ZoneTagWRef;
 
+//! The objects linked into a leaf or area.
+/*! Objects are stored in a dense array in no particular order. Each object keeps a
+	Link to its slot in every list it is in, and removing an object moves the last one
+	into its slot, so unlinking is constant time and relinking allocates nothing once
+	the arrays have grown. An object may only be in a list once. */
+template <typename T>
+class LinkList {
+public:
+	struct Link {
+		LinkList<T> *list;
+		int index;
+	};
+
+	typedef typename zone_vector<Link, ZWorldT>::type LinkVec;
+	typedef typename zone_vector<T*, ZWorldT>::type ObjectVec;
+	typedef typename ObjectVec::const_iterator const_iterator;
+
+	void Add(T *object, LinkVec &links) {
+		Link link = { this, (int)m_objects.size() };
+		Member member = { &links, (int)links.size() };
+		links.push_back(link);
+		m_objects.push_back(object);
+		m_members.push_back(member);
+	}
+
+	//! Removes an object from all the lists it was added to.
+	static void RemoveAll(LinkVec &links) {
+		for (typename LinkVec::const_iterator it = links.begin(); it != links.end(); ++it)
+			it->list->Remove(it->index);
+		links.clear();
+	}
+
+	const_iterator begin() const {
+		return m_objects.begin();
+	}
+
+	const_iterator end() const {
+		return m_objects.end();
+	}
+
+	int size() const {
+		return (int)m_objects.size();
+	}
+
+	bool empty() const {
+		return m_objects.empty();
+	}
+
+private:
+
+	struct Member {
+		LinkVec *links;
+		int link;
+	};
+
+	typedef typename zone_vector<Member, ZWorldT>::type MemberVec;
+
+	void Remove(int index) {
+		RAD_ASSERT(index < (int)m_objects.size());
+		const int kLast = (int)m_objects.size() - 1;
+		if (index != kLast) {
+			m_objects[index] = m_objects[kLast];
+			m_members[index] = m_members[kLast];
+			const Member &member = m_members[index];
+			(*member.links)[member.link].index = index;
+		}
+		m_objects.pop_back();
+		m_members.pop_back();
+	}
+
+	ObjectVec m_objects;
+	MemberVec m_members;
+};
+
+typedef LinkList<Entity> EntityLinkList;
+typedef LinkList<MBatchOccupant> MBatchOccupantLinkList;
+typedef LinkList<Light> LightLinkList;
+
 struct ClippedAreaVolume {
 
 	ClippedAreaVolume(int _area, const StackWindingStackVec &_volume, const BBox &_bounds) :
@@ -110,9 +188,9 @@ struct dBSPLeaf {
 	int firstFog;
 	int numFogs;
 
-	EntityPtrSet entities;
-	MBatchOccupantPtrSet occupants;
-	LightPtrSet lights;
+	EntityLinkList entities;
+	MBatchOccupantLinkList occupants;
+	LightLinkList lights;
 };
 
 struct dBSPArea {
@@ -126,9 +204,9 @@ struct dBSPArea {
 	int numModels;
 	bool sky;
 
-	EntityPtrSet entities;
-	MBatchOccupantPtrSet occupants;
-	LightPtrSet lights;
+	EntityLinkList entities;
+	MBatchOccupantLinkList occupants;
+	LightLinkList lights;
 };
 
 struct dAreaportal {
@@ -16,6 +16,7 @@
 #include "World.h"
 #include "Occupant.h"
 #include "ScreenOverlay.h"
+#include <Runtime/Base/SIMD.h>
 #include <Runtime/Container/ZoneList.h>
 
 using namespace r;
@@ -88,6 +89,19 @@ int RB_WorldDraw::LoadMaterial(const char *name, asset::MaterialBundle &mat) {
 	return details::LoadMaterial(name, mat);
 }
 
+void RB_WorldDraw::SubmitBatch(
+	MBatchDraw &draw,
+	r::Shader &shader,
+	const r::Shader::Uniforms &uniforms,
+	bool sampleMaterialColor
+) {
+	draw.Bind(&shader);
+	shader.BindStates(uniforms, sampleMaterialColor);
+	CommitStates();
+	draw.CompileArrayStates(shader);
+	draw.Draw();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 MBatchDraw::MBatchDraw(WorldDraw &draw, int matId, const void *uid) : 
@@ -732,19 +746,47 @@ void WorldDraw::VisMarkAreas(ViewDef &view) {
 	if (view.area < 0)
 		return; // no area set.
 
-	World::MakeVolume(&view.frustum[0], (int)view.frustum->size(), view.frustumVolume, view.frustumBounds);
-
-	ClippedAreaVolumeStackVec frustumAreas;
-	m_world->ClipOccupantVolume(
-		&view.camera.pos.get(),
-		&view.frustumVolume,
-		view.frustumBounds,
-		&frustumAreas,
-		view.area,
-		-1,
-		view.areas,
-		&m_counters
-	);
+	// A camera that hasn't moved (cinematics, menus, a paused game) sees the same
+	// areas through the same portals, only the flow of a changed view is run.
+	if (VisCacheValid(view)) {
+		view.frustumVolume = m_visCache.frustumVolume;
+		view.frustumBounds = m_visCache.frustumBounds;
+		view.areas = m_visCache.areas;
+	} else {
+		World::MakeVolume(&view.frustum[0], (int)view.frustum->size(), view.frustumVolume, view.frustumBounds);
+
+		m_visCache.frustumAreas->clear();
+		m_world->ClipOccupantVolume(
+			&view.camera.pos.get(),
+			&view.frustumVolume,
+			view.frustumBounds,
+			&m_visCache.frustumAreas,
+			view.area,
+			-1,
+			view.areas,
+			&m_counters
+		);
+
+		m_visCache.frustum = view.frustum;
+		m_visCache.frustumVolume = view.frustumVolume;
+		m_visCache.frustumBounds = view.frustumBounds;
+		m_visCache.areas = view.areas;
+		m_visCache.pos = view.camera.pos;
+		m_visCache.area = view.area;
+		m_visCache.areaportalSerial = m_world->m_areaportalSerial;
+		m_visCache.valid = true;
+	}
+
+	const ClippedAreaVolumeStackVec &frustumAreas = m_visCache.frustumAreas;
+
+	view.frustumCullPlanes.clear();
+	for (StackWindingStackVec::const_iterator it = view.frustumVolume->begin(); it != view.frustumVolume->end(); ++it) {
+		const Plane &plane = (*it).Plane();
+		view.frustumCullPlanes.push_back(plane.Normal()[0]);
+		view.frustumCullPlanes.push_back(plane.Normal()[1]);
+		view.frustumCullPlanes.push_back(plane.Normal()[2]);
+		view.frustumCullPlanes.push_back(plane.D());
+	}
 
 	++m_markFrame;
 
@@ -767,6 +809,32 @@ void WorldDraw::VisMarkAreas(ViewDef &view) {
 #endif
 }
 
+bool WorldDraw::VisCacheValid(const ViewDef &view) {
+	if (!m_visCache.valid || !m_world->cvars->r_viscache.value)
+		return false;
+
+	if ((view.area != m_visCache.area) || (m_world->m_areaportalSerial != m_visCache.areaportalSerial))
+		return false;
+
+	// poses closer than this reuse the portal flow, about a hundredth of a unit at the
+	// frustum planes.
+	const float kPosEpsilon = 0.01f;
+	const float kNormalEpsilon = 0.00001f;
+
+	if (!view.camera.pos.get().NearlyEquals(m_visCache.pos, kPosEpsilon))
+		return false;
+
+	if (view.frustum->size() != m_visCache.frustum->size())
+		return false;
+
+	for (size_t i = 0; i < view.frustum->size(); ++i) {
+		if (!view.frustum[i].NearlyEquals(m_visCache.frustum[i], kNormalEpsilon, kPosEpsilon))
+			return false;
+	}
+
+	return true;
+}
+
 void WorldDraw::VisMarkArea(
 	ViewDef &view,
 	int areaNum
@@ -780,10 +848,20 @@ void WorldDraw::VisMarkArea(
 
 	++m_counters.drawnAreas;
 
+	// Members are gathered with their bounds and frustum culled 4 at a time before
+	// anything more expensive is done with them.
+
 	// mark lights
-	for (LightPtrSet::const_iterator it = area.lights.begin(); it != area.lights.end(); ++it) {
+	m_visCullLights.Clear();
+
+	for (LightLinkList::const_iterator it = area.lights.begin(); it != area.lights.end(); ++it) {
 		Light &light = **it;
 
+		if (light.m_markFrame != m_markFrame) {
+			light.m_markFrame = m_markFrame;
+			++m_counters.testedLights;
+		}
+
 		if (light.m_exactlyCulledFrame == m_markFrame)
 			continue;
 
@@ -794,42 +872,49 @@ void WorldDraw::VisMarkArea(
 			
 			BBox bounds(light.m_bounds);
 			bounds.Translate(light.m_pos);
-							
-			if (!m_world->cvars->r_frustumcull.value || ClipBounds(view.frustumVolume, view.frustumBounds, bounds)) {
-				
-				if (ExactlyCullBox(view, bounds, &light.m_scissor)) {
-					light.m_exactlyCulledFrame = m_markFrame;
-					continue;
-				}
+			m_visCullLights.Add(&light, bounds);
+		}
+	}
 
-				if (light.intensity >= 0.01f)
-					++m_counters.visLights;
+	VisCull(view, m_visCullLights);
 
-				light.m_visFrame = m_markFrame;
-				view.visLights.push_back(&light);
-#if defined(WORLD_DEBUG_DRAW)
-				if (m_world->cvars->r_showlightscissor.value) {
-					if ((light.m_scissor[2] > 0.f) && (light.m_scissor[3] > 0.f)) {
-						m_dbgVars.lightScissors.push_back(light.m_scissor);
-					}
-				}
-#endif
-			}
+	for (int i = 0; i < m_visCullLights.Size(); ++i) {
+		if (!m_visCullLights.visible[i])
+			continue;
+
+		Light &light = *m_visCullLights.objects[i];
+
+		BBox bounds(light.m_bounds);
+		bounds.Translate(light.m_pos);
+
+		if (ExactlyCullBox(view, bounds, &light.m_scissor)) {
+			light.m_exactlyCulledFrame = m_markFrame;
+			continue;
 		}
 
-		if (light.m_markFrame != m_markFrame) {
-			light.m_markFrame = m_markFrame;
-			++m_counters.testedLights;
+		if (light.intensity >= 0.01f)
+			++m_counters.visLights;
+
+		light.m_visFrame = m_markFrame;
+		view.visLights.push_back(&light);
+#if defined(WORLD_DEBUG_DRAW)
+		if (m_world->cvars->r_showlightscissor.value) {
+			if ((light.m_scissor[2] > 0.f) && (light.m_scissor[3] > 0.f)) {
+				m_dbgVars.lightScissors.push_back(light.m_scissor);
+			}
 		}
+#endif
 	}
 
 	// mark world models.
 	if (m_world->cvars->r_drawworld.value) {
+		m_visCullWorldModels.Clear();
+
 		for (int i = 0; i < area.numModels; ++i) {
 			U16 modelNum = *(m_world->m_bsp->ModelIndices() + i + area.firstModel);
 			RAD_ASSERT(modelNum < (U16)m_worldModels.size());
 
-			const MStaticWorldMeshBatch::Ref &m = m_worldModels[modelNum];
+			MStaticWorldMeshBatch *m = m_worldModels[modelNum].get();
 			if (!m->visible)
 				continue;
 
@@ -843,20 +928,33 @@ void WorldDraw::VisMarkArea(
 				if (m_world->cvars->r_showworldbboxes.value)
 					m_dbgVars.worldBBoxes.push_back(m->TransformedBounds());
 #endif
-				if (!m_world->cvars->r_frustumcull.value || ClipBounds(view.frustumVolume, view.frustumBounds, m->TransformedBounds())) {
-					m->m_visibleFrame = m_markFrame;
-					++m_counters.drawnWorldModels;
-					details::MBatch *batch = AddViewBatch(view, m->m_matRef, m->m_matId);
-					if (batch)
-						batch->AddDraw(*m);
-				}
+				m_visCullWorldModels.Add(m, m->TransformedBounds());
 			}
 		}
+
+		VisCull(view, m_visCullWorldModels);
+
+		for (int i = 0; i < m_visCullWorldModels.Size(); ++i) {
+			if (!m_visCullWorldModels.visible[i])
+				continue;
+
+			MStaticWorldMeshBatch *m = m_visCullWorldModels.objects[i];
+			if (m->m_visibleFrame == m_markFrame)
+				continue; // listed more than once.
+
+			m->m_visibleFrame = m_markFrame;
+			++m_counters.drawnWorldModels;
+			details::MBatch *batch = AddViewBatch(view, m->m_matRef, m->m_matId);
+			if (batch)
+				batch->AddDraw(*m);
+		}
 	}
 
 	// add entities.
 	if (m_world->cvars->r_drawentities.value) {
-		for (EntityPtrSet::const_iterator it = area.entities.begin(); it != area.entities.end(); ++it) {
+		m_visCullEntityModels.Clear();
+
+		for (EntityLinkList::const_iterator it = area.entities.begin(); it != area.entities.end(); ++it) {
 			Entity *e = *it;
 
 			for (DrawModel::Map::const_iterator it = e->models->begin(); it != e->models->end(); ++it) {
@@ -869,39 +967,47 @@ void WorldDraw::VisMarkArea(
 					++m_counters.testedEntityModels;
 				}
 
-				if (m->m_visibleFrame != m_markFrame) {
+				if (m->m_visibleFrame != m_markFrame)
+					m_visCullEntityModels.Add(m.get(), m->TransformedBounds());
+			}
+		}
+
+		VisCull(view, m_visCullEntityModels);
+
+		for (int i = 0; i < m_visCullEntityModels.Size(); ++i) {
+			if (!m_visCullEntityModels.visible[i])
+				continue;
+
+			DrawModel *m = m_visCullEntityModels.objects[i];
+			Entity *e = m->entity.get();
 
-					if (!m_world->cvars->r_frustumcull.value || ClipBounds(view.frustumVolume, view.frustumBounds, m->TransformedBounds())) {
-						m->m_visibleFrame = m_markFrame;
-						m->m_inView = true;
-						++m_counters.drawnEntityModels;
+			m->m_visibleFrame = m_markFrame;
+			m->m_inView = true;
+			++m_counters.drawnEntityModels;
 
-						if (e->m_markFrame != m_markFrame) {
-							e->m_markFrame = m_markFrame;
-							e->m_ps.visible = true;
-							++m_counters.drawnEntities;
+			if (e->m_markFrame != m_markFrame) {
+				e->m_markFrame = m_markFrame;
+				e->m_ps.visible = true;
+				++m_counters.drawnEntities;
 
 #if defined(WORLD_DEBUG_DRAW)
-							if (m_world->cvars->r_showentitybboxes.value) {
-								BBox bounds(e->ps->bbox);
-								bounds.Translate(e->ps->worldPos);
-								m_dbgVars.entityBBoxes.push_back(bounds);
-							}
+				if (m_world->cvars->r_showentitybboxes.value) {
+					BBox bounds(e->ps->bbox);
+					bounds.Translate(e->ps->worldPos);
+					m_dbgVars.entityBBoxes.push_back(bounds);
+				}
 #endif
-						}			
-
-						for (MBatchDraw::Vec::const_iterator it = m->m_batches.begin(); it != m->m_batches.end(); ++it) {
-							const MBatchDraw::Ref &draw = *it;
-						
-							if ((draw->m_markFrame != m_markFrame) && draw->visible) {
-								draw->m_markFrame = m_markFrame;
-								draw->m_visibleFrame = m_markFrame;
-								details::MBatch *batch = AddViewBatch(view, draw->m_matRef, draw->m_matId);
-								if (batch)
-									batch->AddDraw(*draw);
-							}
-						}
-					}
+			}
+
+			for (MBatchDraw::Vec::const_iterator it = m->m_batches.begin(); it != m->m_batches.end(); ++it) {
+				const MBatchDraw::Ref &draw = *it;
+
+				if ((draw->m_markFrame != m_markFrame) && draw->visible) {
+					draw->m_markFrame = m_markFrame;
+					draw->m_visibleFrame = m_markFrame;
+					details::MBatch *batch = AddViewBatch(view, draw->m_matRef, draw->m_matId);
+					if (batch)
+						batch->AddDraw(*draw);
 				}
 			}
 		}
@@ -910,7 +1016,9 @@ void WorldDraw::VisMarkArea(
 	// add batch occupants.
 	
 	if (m_world->cvars->r_drawoccupants.value) {
-		for (MBatchOccupantPtrSet::const_iterator it = area.occupants.begin(); it != area.occupants.end(); ++it) {
+		m_visCullOccupants.Clear();
+
+		for (MBatchOccupantLinkList::const_iterator it = area.occupants.begin(); it != area.occupants.end(); ++it) {
 			MBatchOccupant *o = *it;
 			if (!o->visible)
 				continue;
@@ -925,31 +1033,73 @@ void WorldDraw::VisMarkArea(
 					++m_counters.testedActorModels;
 				}
 
-				if (m->m_visibleFrame != m_markFrame) {
-				
-					if (!m_world->cvars->r_frustumcull.value || ClipBounds(view.frustumVolume, view.frustumBounds, m->TransformedBounds())) {
-						m->m_visibleFrame = m_markFrame;
-						++m_counters.drawnActorModels;
+				if (m->m_visibleFrame != m_markFrame)
+					m_visCullOccupants.Add(OccupantDraw(o, m.get()), m->TransformedBounds());
+			}
+		}
+
+		VisCull(view, m_visCullOccupants);
+
+		for (int i = 0; i < m_visCullOccupants.Size(); ++i) {
+			if (!m_visCullOccupants.visible[i])
+				continue;
 
-						if (o->m_markFrame != m_markFrame) {
-							o->m_markFrame = m_markFrame;
-							++m_counters.drawnActors;
+			MBatchOccupant *o = m_visCullOccupants.objects[i].first;
+			MBatchDraw *m = m_visCullOccupants.objects[i].second;
+
+			if (m->m_visibleFrame == m_markFrame)
+				continue; // listed more than once.
+
+			m->m_visibleFrame = m_markFrame;
+			++m_counters.drawnActorModels;
+
+			if (o->m_markFrame != m_markFrame) {
+				o->m_markFrame = m_markFrame;
+				++m_counters.drawnActors;
 #if defined(WORLD_DEBUG_DRAW)
-							if (m_world->cvars->r_showactorbboxes.value)
-								m_dbgVars.actorBBoxes.push_back(o->bounds);
+				if (m_world->cvars->r_showactorbboxes.value)
+					m_dbgVars.actorBBoxes.push_back(o->bounds);
 #endif
-						}
-
-						details::MBatch *batch = AddViewBatch(view, m->m_matRef, m->m_matId);
-						if (batch)
-							batch->AddDraw(*m);	
-					}
-				}
 			}
+
+			details::MBatch *batch = AddViewBatch(view, m->m_matRef, m->m_matId);
+			if (batch)
+				batch->AddDraw(*m);
 		}
 	}
 }
 
+void WorldDraw::VisCull(const ViewDef &view, VisCullBoxes &boxes) {
+	const int kNumBoxes = boxes.Size();
+	boxes.visible.resize(kNumBoxes);
+
+	if (kNumBoxes < 1)
+		return;
+
+	if (!m_world->cvars->r_frustumcull.value) {
+		std::fill(boxes.visible.begin(), boxes.visible.end(), (U8)1);
+		return;
+	}
+
+	const float kVolumeBounds[6] = {
+		view.frustumBounds.Mins()[0], view.frustumBounds.Mins()[1], view.frustumBounds.Mins()[2],
+		view.frustumBounds.Maxs()[0], view.frustumBounds.Maxs()[1], view.frustumBounds.Maxs()[2]
+	};
+
+	const float *bounds[6];
+	for (int i = 0; i < 6; ++i)
+		bounds[i] = &boxes.bounds[i][0];
+
+	SIMD->CullBoxes(
+		&boxes.visible[0],
+		bounds,
+		kNumBoxes,
+		view.frustumCullPlanes.empty() ? 0 : &view.frustumCullPlanes[0],
+		(int)view.frustumCullPlanes.size() / 4,
+		kVolumeBounds
+	);
+}
+
 bool WorldDraw::ClipBounds(const StackWindingStackVec &volume, const BBox &volumeBounds, const BBox &bounds) {
 	
 	// volume is convex.
@@ -1312,17 +1462,17 @@ void WorldDraw::DrawUnlitBatch(
 	r::Material *mat = batch.matRef->mat;
 #endif
 
-	mat->BindStates();
+	m_rb->BindMaterialStates(*mat);
 	if (!wireframe)
-		mat->BindTextures(batch.matRef->loader);
+		m_rb->BindMaterialTextures(*mat, batch.matRef->loader);
 
 #if !defined(RAD_TARGET_GOLDEN)
 	if (mat->maxLights > 0) {
-		mat->shader->Begin(r::Shader::kPass_Preview, *mat);
+		m_rb->BeginMaterialPass(*mat, r::Shader::kPass_Preview);
 	} else 
 #endif
 	{
-		mat->shader->Begin(r::Shader::kPass_Default, *mat);
+		m_rb->BeginMaterialPass(*mat, r::Shader::kPass_Default);
 	}
 
 	for (details::MBatchDrawLink *link = batch.head; link; link = link->next) {
@@ -1337,7 +1487,6 @@ void WorldDraw::DrawUnlitBatch(
 		if (!wireframe)
 			++m_counters.numBatches;
 
-		draw->Bind(mat->shader.get().get());
 		r::Shader::Uniforms u(draw->rgba.get());
 
 		if (tx) {
@@ -1346,16 +1495,13 @@ void WorldDraw::DrawUnlitBatch(
 			u.eyePos = view.camera.pos;
 		}
 
-		mat->shader->BindStates(u);
-		m_rb->CommitStates();
-		draw->CompileArrayStates(*mat->shader.get());
-		draw->Draw();
+		m_rb->DrawBatch(*draw, *mat, u);
 
 		if (tx)
 			m_rb->PopMatrix();
 	}
 
-	mat->shader->End();
+	m_rb->EndMaterialPass(*mat);
 }
 
 void WorldDraw::DrawOverlay(ScreenOverlay &overlay) {
@@ -1363,15 +1509,15 @@ void WorldDraw::DrawOverlay(ScreenOverlay &overlay) {
 		return;
 
 	const details::MatRef *matRef = overlay.m_mat;
-	matRef->mat->BindStates();
-	matRef->mat->BindTextures(matRef->loader);
-	matRef->mat->shader->Begin(r::Shader::kPass_Default, *matRef->mat);
+	m_rb->BindMaterialStates(*matRef->mat);
+	m_rb->BindMaterialTextures(*matRef->mat, matRef->loader);
+	m_rb->BeginMaterialPass(*matRef->mat, r::Shader::kPass_Default);
 	m_rb->BindOverlay(*matRef->mat);
 	Shader::Uniforms u(Vec4(1, 1, 1, overlay.alpha));
-	matRef->mat->shader->BindStates(u);
+	m_rb->BindMaterialUniforms(*matRef->mat, u);
 	m_rb->CommitStates();
 	m_rb->DrawOverlay();
-	matRef->mat->shader->End();
+	m_rb->EndMaterialPass(*matRef->mat);
 }
 
 void WorldDraw::AddScreenOverlay(ScreenOverlay &overlay) {
@@ -1407,15 +1553,15 @@ void WorldDraw::PostProcess() {
 		Shader::Uniforms u(fx->color.get());
 
 		r::Material *m = fx->material;
-		m->BindTextures(fx->loader);
+		m_rb->BindMaterialTextures(*m, fx->loader);
 		u.pfxVars = m_rb->BindPostFXTargets(--num > 0, *m, fx->srcScale, dstScale);
-		m->BindStates();
-		m->shader->Begin(r::Shader::kPass_Default, *m);
+		m_rb->BindMaterialStates(*m);
+		m_rb->BeginMaterialPass(*m, r::Shader::kPass_Default);
 		m_rb->BindPostFXQuad(*m);
-		m->shader->BindStates(u);
+		m_rb->BindMaterialUniforms(*m, u);
 		m_rb->CommitStates();
 		m_rb->DrawPostFXQuad();
-		m->shader->End();
+		m_rb->EndMaterialPass(*m);
 	}
 }
 
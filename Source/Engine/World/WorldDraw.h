@@ -22,6 +22,7 @@
 #include <Runtime/Container/ZoneMap.h>
 #include <Runtime/Container/ZoneVector.h>
 #include <Runtime/Base/ObjectPool.h>
+#include <Runtime/Thread/Interlocked.h>
 #include <bitset>
 #include <Runtime/PushPack.h>
 
@@ -54,6 +55,7 @@ public:
 	PlaneStackVec frustum;
 	StackWindingStackVec frustumVolume;
 	BBox frustumBounds;
+	zone_vector<float, ZWorldT>::type frustumCullPlanes; // frustumVolume planes for SIMDDriver::CullBoxes()
 	
 	AreaBits areas;
 	LightVec visLights;
@@ -135,6 +137,28 @@ public:
 		bool lightStencil
 	) = 0;
 
+	// Material and geometry submission. WorldDraw issues every material, shader
+	// and batch bind through these so a backend can record them instead.
+
+	virtual void BindMaterialStates(r::Material &mat) = 0;
+	virtual void BindMaterialTextures(r::Material &mat, asset::MaterialLoader *loader) = 0;
+	virtual void BeginMaterialPass(r::Material &mat, r::Shader::Pass pass) = 0;
+	virtual void EndMaterialPass(r::Material &mat) = 0;
+
+	virtual void BindMaterialUniforms(
+		r::Material &mat,
+		const r::Shader::Uniforms &uniforms
+	) = 0;
+
+	// Binds and draws the batch with the shader of mat, which must be between
+	// BeginMaterialPass() and EndMaterialPass().
+	virtual void DrawBatch(
+		MBatchDraw &draw,
+		r::Material &mat,
+		const r::Shader::Uniforms &uniforms,
+		bool sampleMaterialColor = true
+	) = 0;
+
 	virtual void BindRenderTarget() = 0;
 
 	// Fog
@@ -207,6 +231,14 @@ public:
 
 protected:
 
+	// Runs the bind/commit/draw sequence for DrawBatch() on the device.
+	void SubmitBatch(
+		MBatchDraw &draw,
+		r::Shader &shader,
+		const r::Shader::Uniforms &uniforms,
+		bool sampleMaterialColor
+	);
+
 	virtual RAD_DECLARE_GET(numTris, int) = 0; 
 	virtual RAD_DECLARE_SET(numTris, int) = 0;
 
@@ -255,7 +287,7 @@ public:
 		int drawnLights;
 		int drawnFogs;
 		int drawnParticles;
-		int simulatedParticles;
+		thread::Interlocked<int> simulatedParticles; // emitters tick on job threads.
 		int numLightPasses;
 		int numLightPassLights;
 		int numStencilLightPasses;
@@ -345,6 +377,10 @@ private:
 			return s_scale; 
 		}
 
+		virtual RAD_DECLARE_GET(numTris, int) {
+			return m_m->NumTris();
+		}
+
 	private:
 		r::Mesh::Ref m_m;
 		BBox m_bounds;
@@ -353,6 +389,65 @@ private:
 		static Vec3 s_scale;
 	};
 
+	//! Bounds of the members of an area, as SIMDDriver::CullBoxes() takes them.
+	struct VisCullBoxes {
+		typedef zone_vector<float, ZWorldT>::type FloatVec;
+		typedef zone_vector<U8, ZWorldT>::type ByteVec;
+
+		void Clear() {
+			for (int i = 0; i < 6; ++i)
+				bounds[i].clear();
+		}
+
+		void Add(const BBox &box) {
+			for (int i = 0; i < 3; ++i) {
+				bounds[i].push_back(box.Mins()[i]);
+				bounds[i+3].push_back(box.Maxs()[i]);
+			}
+		}
+
+		int Size() const {
+			return (int)bounds[0].size();
+		}
+
+		FloatVec bounds[6];
+		ByteVec visible;
+	};
+
+	template <typename T>
+	struct VisCullSet : public VisCullBoxes {
+		typedef typename zone_vector<T, ZWorldT>::type Vec;
+
+		void Clear() {
+			VisCullBoxes::Clear();
+			objects.clear();
+		}
+
+		void Add(const T &object, const BBox &box) {
+			VisCullBoxes::Add(box);
+			objects.push_back(object);
+		}
+
+		Vec objects;
+	};
+
+	typedef std::pair<MBatchOccupant*, MBatchDraw*> OccupantDraw;
+
+	//! Portal flow of the last view, see VisMarkAreas().
+	struct VisCache {
+		VisCache() : area(-1), areaportalSerial(0), valid(false) {}
+
+		PlaneStackVec frustum;
+		StackWindingStackVec frustumVolume;
+		BBox frustumBounds;
+		ClippedAreaVolumeStackVec frustumAreas;
+		AreaBits areas;
+		Vec3 pos;
+		int area;
+		int areaportalSerial;
+		bool valid;
+	};
+
 	RAD_DECLARE_GET(rb, const RB_WorldDraw::Ref&) { 
 		return m_rb; 
 	}
@@ -427,11 +522,17 @@ private:
 	);
 
 	void VisMarkAreas(ViewDef &view);
+	bool VisCacheValid(const ViewDef &view);
 
 	void VisMarkArea(
 		ViewDef &view, 
 		int area
 	);
+
+	void VisCull(
+		const ViewDef &view,
+		VisCullBoxes &boxes
+	);
 		
 	void UpdateLightInteractions(ViewDef &view);
 	void VisMarkShadowCasters(ViewDef &view);
@@ -678,6 +779,11 @@ private:
 	details::MatRefMap m_refMats;
 	World *m_world;
 	Light *m_lights[2];
+	VisCullSet<Light*> m_visCullLights;
+	VisCullSet<MStaticWorldMeshBatch*> m_visCullWorldModels;
+	VisCullSet<DrawModel*> m_visCullEntityModels;
+	VisCullSet<OccupantDraw> m_visCullOccupants;
+	VisCache m_visCache;
 	int m_frame;
 	int m_markFrame;
 	bool m_uiOnly;
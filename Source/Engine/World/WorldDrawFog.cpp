@@ -121,40 +121,28 @@ void WorldDraw::DrawFogNum(ViewDef &view, int num) {
 	u.tcGen = m_rb->GetModelViewProjectionMatrix(true);
 	
 	// render fog backfaces into z
-	m_fogZ_M.material->BindTextures(m_fogZ_M.loader);
+	m_rb->BindMaterialTextures(*m_fogZ_M.material, m_fogZ_M.loader);
 	m_rb->BeginFogDepthWrite(*m_fogZ_M.material, false);
 
-	m_fogZ_M.material->shader->Begin(r::Shader::kPass_Default, *m_fogZ_M.material);
-	draw->Bind(m_fogZ_M.material->shader.get().get());
-	m_fogZ_M.material->shader->BindStates(u);
-	m_rb->CommitStates();
-	draw->CompileArrayStates(*m_fogZ_M.material->shader.get());
-	draw->Draw();
-	m_fogZ_M.material->shader->End();
+	m_rb->BeginMaterialPass(*m_fogZ_M.material, r::Shader::kPass_Default);
+	m_rb->DrawBatch(*draw, *m_fogZ_M.material, u);
+	m_rb->EndMaterialPass(*m_fogZ_M.material);
 
 	// render fog opacity based on front face z
-	matRef->mat->BindTextures(matRef->loader);
+	m_rb->BindMaterialTextures(*matRef->mat, matRef->loader);
 	m_rb->BeginFogDraw(*matRef->mat);
-	matRef->mat->shader->Begin(r::Shader::kPass_Default, *matRef->mat);
-	draw->Bind(matRef->mat->shader.get().get());
-	matRef->mat->shader->BindStates(u);
-	m_rb->CommitStates();
-	draw->CompileArrayStates(*matRef->mat->shader.get());
-	draw->Draw();
-	matRef->mat->shader->End();
+	m_rb->BeginMaterialPass(*matRef->mat, r::Shader::kPass_Default);
+	m_rb->DrawBatch(*draw, *matRef->mat, u);
+	m_rb->EndMaterialPass(*matRef->mat);
 
 	// render fog front faces into z (for next fog)
 	if (--view.numFogs > 0) { // skip this, if we are the last drawn fog we don't care.
-		m_fogZ_M.material->BindTextures(m_fogZ_M.loader);
+		m_rb->BindMaterialTextures(*m_fogZ_M.material, m_fogZ_M.loader);
 		m_rb->BeginFogDepthWrite(*m_fogZ_M.material, true);
 
-		m_fogZ_M.material->shader->Begin(r::Shader::kPass_Default, *m_fogZ_M.material);
-		draw->Bind(m_fogZ_M.material->shader.get().get());
-		m_fogZ_M.material->shader->BindStates(u);
-		m_rb->CommitStates();
-		draw->CompileArrayStates(*m_fogZ_M.material->shader.get());
-		draw->Draw();
-		m_fogZ_M.material->shader->End();
+		m_rb->BeginMaterialPass(*m_fogZ_M.material, r::Shader::kPass_Default);
+		m_rb->DrawBatch(*draw, *m_fogZ_M.material, u);
+		m_rb->EndMaterialPass(*m_fogZ_M.material);
 	}
 }
 
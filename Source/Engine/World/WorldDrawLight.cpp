@@ -31,11 +31,11 @@ void WorldDraw::DrawUnshadowedLitBatch(
 
 	bool first = true;
 
-	mat->BindStates();
-	mat->BindTextures(batch.matRef->loader);
+	m_rb->BindMaterialStates(*mat);
+	m_rb->BindMaterialTextures(*mat, batch.matRef->loader);
 
 	RAD_ASSERT(mat->shader->HasPass(r::Shader::kPass_Default));
-	mat->shader->Begin(r::Shader::kPass_Default, *mat);
+	m_rb->BeginMaterialPass(*mat, r::Shader::kPass_Default);
 
 	// draw base pass
 	for (details::MBatchDrawLink *link = batch.head; link; link = link->next) {
@@ -49,7 +49,7 @@ void WorldDraw::DrawUnshadowedLitBatch(
 		DrawBatch(view, *draw, *mat);
 	}
 
-	mat->shader->End();
+	m_rb->EndMaterialPass(*mat);
 
 	for (details::MBatchDrawLink *link = batch.head; link; link = link->next) {
 		MBatchDraw *draw = link->draw;
@@ -72,7 +72,6 @@ void WorldDraw::DrawBatch(
 		invTx = Mat4::Translation(-pos) * (Mat4::Rotation(QuatFromAngles(angles)).Transpose());
 	}
 
-	draw.Bind(mat.shader.get().get());
 	r::Shader::Uniforms u(draw.rgba.get());
 
 	if (tx) {
@@ -81,10 +80,7 @@ void WorldDraw::DrawBatch(
 		u.eyePos = view.camera.pos;
 	}
 
-	mat.shader->BindStates(u);
-	m_rb->CommitStates();
-	draw.CompileArrayStates(*mat.shader.get());
-	draw.Draw();
+	m_rb->DrawBatch(draw, mat, u);
 
 	if (tx)
 		m_rb->PopMatrix();
@@ -209,16 +205,11 @@ void WorldDraw::DrawUnshadowedLitBatchLights(
 				RAD_ASSERT(mat.shader->HasPass((r::Shader::Pass)pass));
 
 				m_rb->BindLitMaterialStates(mat, !fullscreenLight);
-				mat.BindTextures(batch.matRef->loader);
+				m_rb->BindMaterialTextures(mat, batch.matRef->loader);
 
-				mat.shader->Begin((r::Shader::Pass)pass, mat);
-				draw.Bind(mat.shader.get().get());
-				
-				mat.shader->BindStates(u);
-				m_rb->CommitStates();
-				draw.CompileArrayStates(*mat.shader.get());
-				draw.Draw();
-				mat.shader->End();
+				m_rb->BeginMaterialPass(mat, (r::Shader::Pass)pass);
+				m_rb->DrawBatch(draw, mat, u);
+				m_rb->EndMaterialPass(mat);
 
 				++m_counters.numLightPasses;
 				++m_counters.numBatches;
@@ -295,8 +286,8 @@ bool WorldDraw::GenerateUnifiedEntityShadow(const ViewDef &view, const Entity &e
 	if (!m_rb->BindUnifiedShadowRenderTarget(*m_shadow_M.material))
 		return false;
 
-	m_shadow_M.material->BindTextures(m_shadow_M.loader);
-	m_shadow_M.material->shader->Begin(r::Shader::kPass_Default, *m_shadow_M.material);
+	m_rb->BindMaterialTextures(*m_shadow_M.material, m_shadow_M.loader);
+	m_rb->BeginMaterialPass(*m_shadow_M.material, r::Shader::kPass_Default);
 
 	DrawUnifiedShadowTexture(
 		view,
@@ -305,7 +296,7 @@ bool WorldDraw::GenerateUnifiedEntityShadow(const ViewDef &view, const Entity &e
 		projector.unifiedRadius
 	);
 
-	m_shadow_M.material->shader->End();
+	m_rb->EndMaterialPass(*m_shadow_M.material);
 
 	SetupPerspectiveFrustumPlanes(
 		projector.frustum,
@@ -354,8 +345,8 @@ bool WorldDraw::GenerateUnifiedOccupantShadow(const ViewDef &view, const MBatchO
 	if (!m_rb->BindUnifiedShadowRenderTarget(*m_shadow_M.material))
 		return false;
 
-	m_shadow_M.material->BindTextures(m_shadow_M.loader);
-	m_shadow_M.material->shader->Begin(r::Shader::kPass_Default, *m_shadow_M.material);
+	m_rb->BindMaterialTextures(*m_shadow_M.material, m_shadow_M.loader);
+	m_rb->BeginMaterialPass(*m_shadow_M.material, r::Shader::kPass_Default);
 
 	DrawUnifiedShadowTexture(
 		view,
@@ -364,7 +355,7 @@ bool WorldDraw::GenerateUnifiedOccupantShadow(const ViewDef &view, const MBatchO
 		projector.unifiedRadius
 	);
 
-	m_shadow_M.material->shader->End();
+	m_rb->EndMaterialPass(*m_shadow_M.material);
 
 	SetupPerspectiveFrustumPlanes(
 		projector.frustum,
@@ -483,11 +474,7 @@ void WorldDraw::DrawUnifiedShadowTexture(
 					m_rb->PushMatrix(pos, draw->scale, angles);
 				}
 
-				draw->Bind(m_shadow_M.material->shader.get().get());
-				m_shadow_M.material->shader->BindStates(u);
-				m_rb->CommitStates();
-				draw->CompileArrayStates(*m_shadow_M.material->shader.get());
-				draw->Draw();
+				m_rb->DrawBatch(*draw, *m_shadow_M.material, u);
 
 				if (tx)
 					m_rb->PopMatrix();
@@ -549,11 +536,11 @@ void WorldDraw::DrawViewWithUnifiedShadow(
 	u.lights.lights[0].radius = shadow.unifiedRadius;
 	u.tcGen = shadow.mv * MakePerspectiveMatrix(shadow.viewplanes, shadow.zplanes, true);
 
-	m_projected_M.material->BindTextures(m_projected_M.loader);
+	m_rb->BindMaterialTextures(*m_projected_M.material, m_projected_M.loader);
 	bool r = m_rb->BindUnifiedShadowTexture(*m_projected_M.material); // does mat->BindStates()
 	RAD_ASSERT_MSG(r, "BindUnifiedShadowTexture() failed!");
 	
-	m_projected_M.material->shader->Begin(r::Shader::kPass_Default, *m_projected_M.material);
+	m_rb->BeginMaterialPass(*m_projected_M.material, r::Shader::kPass_Default);
 
 	Vec3 pos, angles;
 
@@ -577,18 +564,14 @@ void WorldDraw::DrawViewWithUnifiedShadow(
 			if (tx)
 				m_rb->PushMatrix(pos, draw->scale, angles);
 
-			draw->Bind(m_projected_M.material->shader.get().get());
-			m_projected_M.material->shader->BindStates(u, false);
-			m_rb->CommitStates();
-			draw->CompileArrayStates(*m_projected_M.material->shader.get());
-			draw->Draw();
+			m_rb->DrawBatch(*draw, *m_projected_M.material, u, false);
 
 			if (tx)
 				m_rb->PopMatrix();
 		}
 	}
 
-	m_projected_M.material->shader->End();
+	m_rb->EndMaterialPass(*m_projected_M.material);
 }
 
 void WorldDraw::CalcUnifiedLightPosAndSize(
@@ -713,7 +696,7 @@ void WorldDraw::LinkEntity(
 		return;
 	
 	// link potential light interactions
-	for (LightPtrSet::const_iterator it = leaf.lights.begin(); it != leaf.lights.end(); ++it) {
+	for (LightLinkList::const_iterator it = leaf.lights.begin(); it != leaf.lights.end(); ++it) {
 		Light &light = **it;
 
 		if (!(light.interactionFlags & entity.lightInteractionFlags))
@@ -779,7 +762,7 @@ void WorldDraw::LinkOccupant(
 		return;
 
 	// link potential light interactions
-	for (LightPtrSet::const_iterator it = leaf.lights.begin(); it != leaf.lights.end(); ++it) {
+	for (LightLinkList::const_iterator it = leaf.lights.begin(); it != leaf.lights.end(); ++it) {
 		Light &light = **it;
 
 		if (!(light.interactionFlags & occupant.lightInteractionFlags))
@@ -836,7 +819,7 @@ void WorldDraw::LinkLight(Light &light, const BBox &bounds) {
 		return; // not a world light
 
 	// NOTE: models can span areas, this may check them multiple times.
-	for (IntSet::const_iterator it = light.m_areas.begin(); it != light.m_areas.end(); ++it) {
+	for (IntVec::const_iterator it = light.m_areas.begin(); it != light.m_areas.end(); ++it) {
 		const dBSPArea &area = m_world->m_areas[*it];
 
 		for (int i = 0; i < area.numModels; ++i) {
@@ -861,7 +844,7 @@ void WorldDraw::LinkLight(
 	dBSPLeaf &leaf,
 	dBSPArea &area
 ) {
-	for (EntityPtrSet::const_iterator it = leaf.entities.begin(); it != leaf.entities.end(); it++) {
+	for (EntityLinkList::const_iterator it = leaf.entities.begin(); it != leaf.entities.end(); it++) {
 		Entity &entity = **it;
 
 		if (!(light.interactionFlags & entity.lightInteractionFlags))
@@ -892,7 +875,7 @@ void WorldDraw::LinkLight(
 		}
 	}
 
-	for (MBatchOccupantPtrSet::const_iterator it = leaf.occupants.begin(); it != leaf.occupants.end(); ++it) {
+	for (MBatchOccupantLinkList::const_iterator it = leaf.occupants.begin(); it != leaf.occupants.end(); ++it) {
 		MBatchOccupant &occupant = **it;
 
 		if (!(light.interactionFlags & occupant.lightInteractionFlags))
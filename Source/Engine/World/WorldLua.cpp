@@ -401,7 +401,7 @@ void WorldLua::PostSpawn() {
 #if !defined(LUA_JIT)
 	lua_gc(m_L->L, LUA_GCSTOP, 0);
 #endif
-	lua::State::CompactPools();
+	m_L->CompactPools();
 }
 
 void WorldLua::DeleteEntId(Entity &ent) {
@@ -495,11 +495,11 @@ OggState Encoder::WriteOgg(AddrSize *bytesWritten)
 					return OS_Error;
 				}
 
-				if (ogg_page_eos(m_vv.og))
-					return OS_Error;
-
 				if (bytesWritten)
 					*bytesWritten += m_vv.og->header_len + m_vv.og->body_len;
+
+				if (ogg_page_eos(m_vv.og))
+					return OS_Done;
 			}
 		}
 
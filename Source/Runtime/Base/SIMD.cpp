@@ -10,6 +10,8 @@
 #if defined(RAD_OPT_TOOLS)
 #include "../Time.h"
 #include "../Math.h"
+#include "../Math/Vector.h"
+#include <algorithm>
 #endif
 
 RADRT_API const SIMDDriver *SIMD = 0;
@@ -19,7 +21,7 @@ const SIMDDriver *SIMD_sse2_bind();
 const SIMDDriver *SIMD_neon_bind();
 
 void SIMDDriver::Select() {
-#if defined(RAD_OPT_WINX) && !defined(_WIN64)
+#if (defined(RAD_OPT_WINX) && !defined(_WIN64)) || defined(RAD_OPT_SSE2)
 	SIMD = SIMD_sse2_bind();
 #elif defined(__ARM_NEON__)
 	SIMD = SIMD_neon_bind();
@@ -84,11 +86,13 @@ struct SkinTestData {
 			m[15] = 1.f;
 		}
 		
-		for (int i = 0; i < numVerts; ++i) {
+		for (int i = 0; i < numVerts*bonesPerVert; ++i)
 			boneIndices[i] = (U16)(rand() % numBones);
+
+		for (int i = 0; i < numVerts; ++i) {
 			for (int kk = 0; kk < 2; ++kk) {
 				float *v = vertices[kk] + (kFloatsPerVert*bonesPerVert*i);
-				for (int k = 0; k < kFloatsPerVert; ++k) {
+				for (int k = 0; k < kFloatsPerVert; k += 4) {
 					for (int j = 0; j < bonesPerVert; ++j) {
 						v[0] = (rand() / (float)RAND_MAX) * 5000.f;
 						v[1] = (rand() / (float)RAND_MAX) * 5000.f;
@@ -120,6 +124,90 @@ struct SkinTestData {
 	}
 };
 
+struct BoneTestData {
+
+	BoneTestData() {
+		out = 0;
+		bones[0] = bones[1] = 0;
+		indices[0] = indices[1] = 0;
+		rTable = 0;
+		stTable = 0;
+	}
+
+	~BoneTestData() {
+		Free();
+	}
+
+	enum {
+		kTableSize = 4096
+	};
+
+	float *out;
+	float *bones[2];
+	int *indices[2];
+	S16 *rTable;
+	S16 *stTable;
+	float decodeMags[3];
+
+	void Create(int numBones) {
+		Free();
+		const AddrSize kBoneSize = sizeof(float)*SIMDDriver::kNumBoneTMFloats*numBones;
+		out = (float*)safe_zone_malloc(ZRuntime, kBoneSize);
+		rTable = (S16*)safe_zone_malloc(ZRuntime, sizeof(S16)*4*kTableSize);
+		stTable = (S16*)safe_zone_malloc(ZRuntime, sizeof(S16)*3*kTableSize);
+
+		decodeMags[0] = 1.f / 32767.f;
+		decodeMags[1] = 1.f / 256.f;
+		decodeMags[2] = 1.f / 64.f;
+
+		for (int i = 0; i < kTableSize; ++i) {
+			// random unit quaternions
+			float q[4];
+			float len = 0.f;
+			for (int k = 0; k < 4; ++k) {
+				q[k] = (rand() / (float)RAND_MAX) * 2.f - 1.f;
+				len += q[k]*q[k];
+			}
+			len = 1.f / math::SquareRoot(len);
+			for (int k = 0; k < 4; ++k)
+				rTable[i*4+k] = (S16)(q[k]*len*32767.f);
+			for (int k = 0; k < 3; ++k)
+				stTable[i*3+k] = (S16)((rand() % 65535) - 32767);
+		}
+
+		for (int i = 0; i < 2; ++i) {
+			bones[i] = (float*)safe_zone_malloc(ZRuntime, kBoneSize);
+			indices[i] = (int*)safe_zone_malloc(ZRuntime, sizeof(int)*3*numBones);
+			for (int k = 0; k < numBones*3; ++k)
+				indices[i][k] = rand() % kTableSize;
+		}
+
+		SIMD_ref_bind()->DecodeBones(bones[0], rTable, stTable, stTable, decodeMags, indices[0], 0, 0.f, numBones);
+		SIMD_ref_bind()->DecodeBones(bones[1], rTable, stTable, stTable, decodeMags, indices[1], 0, 0.f, numBones);
+	}
+
+	void Free() {
+		if (out)
+			zone_free(out);
+		for (int i = 0; i < 2; ++i) {
+			if (bones[i])
+				zone_free(bones[i]);
+			if (indices[i])
+				zone_free(indices[i]);
+		}
+		if (rTable)
+			zone_free(rTable);
+		if (stTable)
+			zone_free(stTable);
+
+		out = 0;
+		bones[0] = bones[1] = 0;
+		indices[0] = indices[1] = 0;
+		rTable = 0;
+		stTable = 0;
+	}
+};
+
 inline int VertsPerSecond(xtime::MicroTimer &timer, int numVerts) {
 	float s = xtime::Constants<float>::MicrosToSecond(timer.Elapsed());
 	return (int)math::Floor<float>((((float)numVerts) / s) + 0.5f);
@@ -129,7 +217,8 @@ void SIMDSkinTest(std::ostream &out) {
 	enum {
 		kNumVerts = 27*kKilo, // doing an odd number
 		kNumBones = 256,
-		kMultiplier = (2*kMeg) / kNumVerts
+		kMultiplier = (2*kMeg) / kNumVerts,
+		kBoneMultiplier = (2*kMeg) / kNumBones
 	};
 	xtime::MicroTimer refTime, simdTime;
 	SkinTestData skinData;
@@ -235,6 +324,157 @@ void SIMDSkinTest(std::ostream &out) {
 	
 	out << ref->name << ": " << vps[0] << " (vps), " << SIMD->name << ": " << vps[1] << " (vps). " << pct << "%" << std::endl;
 	
+	out << "******** SIMDBoneBlendTest ********" << std::endl;
+
+	BoneTestData boneData;
+	boneData.Create(kNumBones);
+
+	refTime.Start();
+	for (int i = 0; i < kBoneMultiplier; ++i) {
+		ref->BlendBones(boneData.out, boneData.bones[0], boneData.bones[1], 0.343234f, kNumBones);
+	}
+	refTime.Stop();
+	simdTime.Start();
+	for (int i = 0; i < kBoneMultiplier; ++i) {
+		SIMD->BlendBones(boneData.out, boneData.bones[0], boneData.bones[1], 0.343234f, kNumBones);
+	}
+	simdTime.Stop();
+
+	vps[0] = VertsPerSecond(refTime, kNumBones*kBoneMultiplier);
+	vps[1] = VertsPerSecond(simdTime, kNumBones*kBoneMultiplier);
+	pct = ((vps[1] / (float)vps[0]) - 1.f) * 100.f;
+
+	out << "(Blend) " << ref->name << ": " << vps[0] << " (bps), " << SIMD->name << ": " << vps[1] << " (bps). " << pct << "%" << std::endl;
+
+	refTime.Start();
+	for (int i = 0; i < kBoneMultiplier; ++i) {
+		ref->DecodeBones(boneData.out, boneData.rTable, boneData.stTable, boneData.stTable, boneData.decodeMags, boneData.indices[0], boneData.indices[1], 0.343234f, kNumBones);
+	}
+	refTime.Stop();
+	simdTime.Start();
+	for (int i = 0; i < kBoneMultiplier; ++i) {
+		SIMD->DecodeBones(boneData.out, boneData.rTable, boneData.stTable, boneData.stTable, boneData.decodeMags, boneData.indices[0], boneData.indices[1], 0.343234f, kNumBones);
+	}
+	simdTime.Stop();
+
+	vps[0] = VertsPerSecond(refTime, kNumBones*kBoneMultiplier);
+	vps[1] = VertsPerSecond(simdTime, kNumBones*kBoneMultiplier);
+	pct = ((vps[1] / (float)vps[0]) - 1.f) * 100.f;
+
+	out << "(Decode) " << ref->name << ": " << vps[0] << " (bps), " << SIMD->name << ": " << vps[1] << " (bps). " << pct << "%" << std::endl;
+
+	// compare against the reference implementation
+	float maxError = 0.f;
+	ref->DecodeBones(boneData.bones[0], boneData.rTable, boneData.stTable, boneData.stTable, boneData.decodeMags, boneData.indices[0], boneData.indices[1], 0.343234f, kNumBones);
+	SIMD->DecodeBones(boneData.out, boneData.rTable, boneData.stTable, boneData.stTable, boneData.decodeMags, boneData.indices[0], boneData.indices[1], 0.343234f, kNumBones);
+	for (int i = 0; i < kNumBones*SIMDDriver::kNumBoneTMFloats; ++i) {
+		maxError = std::max(maxError, math::Abs(boneData.out[i] - boneData.bones[0][i]));
+	}
+
+	out << "Max error: " << maxError << std::endl;
+
+	out << "******** SIMDCullTest ********" << std::endl;
+
+	enum {
+		kNumBoxes = 4*kKilo+3, // odd number of boxes
+		kNumPlanes = 6,
+		kBoxMultiplier = (2*kMeg) / kNumBoxes
+	};
+
+	float *boxes = (float*)safe_zone_malloc(ZRuntime, kNumBoxes*6*sizeof(float));
+	U8 *visible[2];
+	visible[0] = (U8*)safe_zone_malloc(ZRuntime, kNumBoxes);
+	visible[1] = (U8*)safe_zone_malloc(ZRuntime, kNumBoxes);
+	const float *boxArrays[6];
+
+	for (int i = 0; i < 6; ++i)
+		boxArrays[i] = boxes + i*kNumBoxes;
+
+	for (int i = 0; i < kNumBoxes; ++i) {
+		for (int k = 0; k < 3; ++k) {
+			boxes[k*kNumBoxes+i] = ((rand() / (float)RAND_MAX) * 2.f - 1.f) * 5000.f;
+			boxes[(k+3)*kNumBoxes+i] = boxes[k*kNumBoxes+i] + (rand() / (float)RAND_MAX) * 500.f;
+		}
+	}
+
+	// a box shaped volume, with every other plane tilted.
+	float planes[kNumPlanes*4];
+	for (int i = 0; i < kNumPlanes; ++i) {
+		math::Vector3<float> n(0.f, 0.f, 0.f);
+		n[i/2] = (i&1) ? -1.f : 1.f;
+		if (i&1)
+			n[(i/2+1)%3] = 0.5f;
+		n.Normalize();
+		planes[i*4+0] = n[0];
+		planes[i*4+1] = n[1];
+		planes[i*4+2] = n[2];
+		planes[i*4+3] = -2500.f;
+	}
+
+	const float kVolumeBounds[6] = { -2500.f, -2500.f, -2500.f, 2500.f, 2500.f, 2500.f };
+
+	refTime.Start();
+	for (int i = 0; i < kBoxMultiplier; ++i) {
+		ref->CullBoxes(visible[0], boxArrays, kNumBoxes, planes, kNumPlanes, kVolumeBounds);
+	}
+	refTime.Stop();
+	simdTime.Start();
+	for (int i = 0; i < kBoxMultiplier; ++i) {
+		SIMD->CullBoxes(visible[1], boxArrays, kNumBoxes, planes, kNumPlanes, kVolumeBounds);
+	}
+	simdTime.Stop();
+
+	vps[0] = VertsPerSecond(refTime, kNumBoxes*kBoxMultiplier);
+	vps[1] = VertsPerSecond(simdTime, kNumBoxes*kBoxMultiplier);
+	pct = ((vps[1] / (float)vps[0]) - 1.f) * 100.f;
+
+	out << "(Cull) " << ref->name << ": " << vps[0] << " (boxes/s), " << SIMD->name << ": " << vps[1] << " (boxes/s). " << pct << "%" << std::endl;
+
+	int numVisible = 0;
+	int numMismatched = 0;
+	for (int i = 0; i < kNumBoxes; ++i) {
+		numVisible += visible[0][i];
+		if (visible[0][i] != visible[1][i])
+			++numMismatched;
+	}
+
+	out << "Visible: " << numVisible << " of " << kNumBoxes << ", mismatched: " << numMismatched << std::endl;
+
+	// box mins as points, against the first plane.
+	float *distances[2];
+	distances[0] = (float*)safe_zone_malloc(ZRuntime, kNumBoxes*sizeof(float));
+	distances[1] = (float*)safe_zone_malloc(ZRuntime, kNumBoxes*sizeof(float));
+
+	refTime.Start();
+	for (int i = 0; i < kBoxMultiplier; ++i) {
+		ref->PlaneDistances(distances[0], boxArrays, kNumBoxes, planes);
+	}
+	refTime.Stop();
+	simdTime.Start();
+	for (int i = 0; i < kBoxMultiplier; ++i) {
+		SIMD->PlaneDistances(distances[1], boxArrays, kNumBoxes, planes);
+	}
+	simdTime.Stop();
+
+	vps[0] = VertsPerSecond(refTime, kNumBoxes*kBoxMultiplier);
+	vps[1] = VertsPerSecond(simdTime, kNumBoxes*kBoxMultiplier);
+	pct = ((vps[1] / (float)vps[0]) - 1.f) * 100.f;
+
+	out << "(PlaneDistances) " << ref->name << ": " << vps[0] << " (pps), " << SIMD->name << ": " << vps[1] << " (pps). " << pct << "%" << std::endl;
+
+	maxError = 0.f;
+	for (int i = 0; i < kNumBoxes; ++i) {
+		maxError = std::max(maxError, math::Abs(distances[0][i] - distances[1][i]));
+	}
+
+	out << "Max error: " << maxError << std::endl;
+
+	zone_free(distances[0]);
+	zone_free(distances[1]);
+	zone_free(boxes);
+	zone_free(visible[0]);
+	zone_free(visible[1]);
+	
 	out << "******************************" << std::endl;
 }
 
@@ -10,11 +10,19 @@
 #include "Base.h"
 #include <iostream>
 
+// Instruction sets available to intrinsic based code paths.
+#if defined(RAD_OPT_INTEL) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+	#define RAD_OPT_SSE2
+#elif defined(__ARM_NEON__)
+	#define RAD_OPT_NEON
+#endif
+
 //! Implements single instruction multiple data optimized routines
 struct SIMDDriver {
 	enum { 
 		kAlignment = 16,
-		kNumBoneFloats = 16
+		kNumBoneFloats = 16,
+		kNumBoneTMFloats = 10
 	};
 
 	SIMDDriver() {
@@ -51,6 +59,104 @@ struct SIMDDriver {
 
 	FBlendVerts BlendVerts;
 
+	//! Blends N bone transforms.
+	/*! Each bone transform is kNumBoneTMFloats floats: rotation quaternion (x y z w), 
+		scale (x y z), translation (x y z). Rotations are slerped (with a normalized lerp
+		when they are nearly equal), scale and translation are lerped. No alignment is
+		required and outBones may be the same as srcBones or dstBones.
+		\param frac 0 = srcBones, 1 = dstBones
+	*/
+	typedef void (*FBlendBones) (
+		float *outBones,
+		const float *srcBones,
+		const float *dstBones,
+		float frac,
+		int numBones
+	);
+
+	FBlendBones BlendBones;
+
+	//! Decodes N bone transforms from quantized keyframe tables, blending between two keyframes.
+	/*! \param outBones kNumBoneTMFloats floats per bone, see FBlendBones.
+		\param rTable rotation table, 4 shorts per entry
+		\param sTable scale table, 3 shorts per entry
+		\param tTable translation table, 3 shorts per entry
+		\param decodeMags rotation, scale and translation dequantization scales
+		\param srcIndices numBones rotation table indices, followed by numBones scale
+						  and numBones translation indices.
+		\param dstIndices same as srcIndices, not read when frac is 0.
+	*/
+	typedef void (*FDecodeBones) (
+		float *outBones,
+		const S16 *rTable,
+		const S16 *sTable,
+		const S16 *tTable,
+		const float *decodeMags,
+		const int *srcIndices,
+		const int *dstIndices,
+		float frac,
+		int numBones
+	);
+
+	FDecodeBones DecodeBones;
+
+	//! Culls N axis aligned boxes against a convex volume.
+	/*! A box is culled if it doesn't touch volumeBounds or is entirely behind any
+		plane. Boxes within math::Epsilon<float>() of a plane are kept, so a box culled 
+		here is always culled by math::Plane::Side(), but not the other way around.
+		No alignment is required.
+		\param outVisible 1 for each box that may be visible, 0 for each culled box.
+		\param boxes numBoxes floats each of mins x, y, z and maxs x, y, z.
+		\param planes 4 floats per plane: normal x y z, distance (see math::Plane).
+		\param volumeBounds mins x y z, maxs x y z.
+	*/
+	typedef void (*FCullBoxes) (
+		U8 *outVisible,
+		const float * const *boxes,
+		int numBoxes,
+		const float *planes,
+		int numPlanes,
+		const float *volumeBounds
+	);
+
+	FCullBoxes CullBoxes;
+
+	//! Signed distances of N points to a plane (see math::Plane::Distance()).
+	/*! No alignment is required.
+		\param points 3 arrays of numPoints floats: x, y, z.
+		\param plane normal x y z, distance.
+	*/
+	typedef void (*FPlaneDistances) (
+		float *outDistances,
+		const float * const *points,
+		int numPoints,
+		const float *plane
+	);
+
+	FPlaneDistances PlaneDistances;
+
+	//! Resamples 16 bit PCM with linear interpolation and adds it into a stereo mix.
+	/*! No alignment is required.
+		\param out numFrames interleaved left/right floats, the result is added to them.
+		\param src srcChannels (1 or 2) samples per frame. Frames are read up to and
+				   including ((pos + (numFrames-1)*step) >> 16) + 1.
+		\param pos first source frame, 16.16 fixed point.
+		\param step source frames advanced per output frame, 16.16 fixed point.
+		\param gains left and right gain, applied to full scale samples (32767 -> gain).
+				     A mono source is mixed into both sides.
+	*/
+	typedef void (*FResampleMix) (
+		float *out,
+		int numFrames,
+		const S16 *src,
+		int srcChannels,
+		U32 pos,
+		U32 step,
+		const float *gains
+	);
+
+	FResampleMix ResampleMix;
+
 	// accelerated writes for multiples of 16 bytes.
 	// NOTE: src, dst, and len must be 16 byte aligned!
 	typedef void (*FMemCopy16) (
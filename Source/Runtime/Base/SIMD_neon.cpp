@@ -9,7 +9,10 @@
 
 #include "SIMD.h"
 #include "../StringBase.h"
+#include "../Math/Math.h"
 #include <iostream>
+#include <algorithm>
+#include <arm_neon.h>
 
 const SIMDDriver *SIMD_ref_bind();
 
@@ -5352,6 +5355,401 @@ void MemRep16(
 		bytes += len;
 	}
 }
+
+///////////////////////////////////////////////////////////////////////////////
+// Bone blending, 4 bones at a time.
+// Rotations are transposed into x, y, z, w registers and slerped together.
+///////////////////////////////////////////////////////////////////////////////
+
+enum {
+	kBoneStride = SIMDDriver::kNumBoneTMFloats
+};
+
+inline void Transpose4(float32x4_t *r) {
+	const float32x4x2_t kT0 = vtrnq_f32(r[0], r[1]);
+	const float32x4x2_t kT1 = vtrnq_f32(r[2], r[3]);
+	r[0] = vcombine_f32(vget_low_f32(kT0.val[0]), vget_low_f32(kT1.val[0]));
+	r[1] = vcombine_f32(vget_low_f32(kT0.val[1]), vget_low_f32(kT1.val[1]));
+	r[2] = vcombine_f32(vget_high_f32(kT0.val[0]), vget_high_f32(kT1.val[0]));
+	r[3] = vcombine_f32(vget_high_f32(kT0.val[1]), vget_high_f32(kT1.val[1]));
+}
+
+inline float32x4_t Reciprocal(float32x4_t x) {
+	float32x4_t e = vrecpeq_f32(x);
+	e = vmulq_f32(e, vrecpsq_f32(x, e));
+	return vmulq_f32(e, vrecpsq_f32(x, e));
+}
+
+inline float32x4_t RSqrt(float32x4_t x) {
+	float32x4_t e = vrsqrteq_f32(x);
+	e = vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(x, e), e));
+	return vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(x, e), e));
+}
+
+//! acos(x) for x in [0, 1], Abramowitz & Stegun 4.4.46 (|error| <= 2e-8)
+inline float32x4_t ACos(float32x4_t x) {
+	float32x4_t p = vdupq_n_f32(-0.0012624911f);
+	p = vmlaq_f32(vdupq_n_f32(0.0066700901f), p, x);
+	p = vmlaq_f32(vdupq_n_f32(-0.0170881256f), p, x);
+	p = vmlaq_f32(vdupq_n_f32(0.0308918810f), p, x);
+	p = vmlaq_f32(vdupq_n_f32(-0.0501743046f), p, x);
+	p = vmlaq_f32(vdupq_n_f32(0.0889789874f), p, x);
+	p = vmlaq_f32(vdupq_n_f32(-0.2145988016f), p, x);
+	p = vmlaq_f32(vdupq_n_f32(1.5707963050f), p, x);
+	// sqrt(y) = y * rsqrt(y), clamped so y == 0 doesn't produce 0 * inf.
+	const float32x4_t kY = vsubq_f32(vdupq_n_f32(1.f), x);
+	const float32x4_t kSqrt = vmulq_f32(kY, RSqrt(vmaxq_f32(kY, vdupq_n_f32(1e-20f))));
+	return vmulq_f32(p, kSqrt);
+}
+
+//! sin(x) for x in [0, PI/2]
+inline float32x4_t Sin(float32x4_t x) {
+	const float32x4_t kX2 = vmulq_f32(x, x);
+	float32x4_t p = vdupq_n_f32(-2.5052108e-8f);
+	p = vmlaq_f32(vdupq_n_f32(2.7557319e-6f), p, kX2);
+	p = vmlaq_f32(vdupq_n_f32(-1.9841270e-4f), p, kX2);
+	p = vmlaq_f32(vdupq_n_f32(8.3333333e-3f), p, kX2);
+	p = vmlaq_f32(vdupq_n_f32(-1.6666667e-1f), p, kX2);
+	p = vmlaq_f32(vdupq_n_f32(1.f), p, kX2);
+	return vmulq_f32(p, x);
+}
+
+//! Slerps 4 quaternions, q0 is replaced with the result.
+inline void Slerp4(float32x4_t *q0, float32x4_t *q1, float32x4_t t) {
+	const float32x4_t kOne = vdupq_n_f32(1.f);
+
+	float32x4_t cosom = vmulq_f32(q0[0], q1[0]);
+	cosom = vmlaq_f32(cosom, q0[1], q1[1]);
+	cosom = vmlaq_f32(cosom, q0[2], q1[2]);
+	cosom = vmlaq_f32(cosom, q0[3], q1[3]);
+
+	// take the shortest path
+	const uint32x4_t kSign = vandq_u32(vreinterpretq_u32_f32(cosom), vdupq_n_u32(0x80000000));
+	cosom = vminq_f32(vabsq_f32(cosom), kOne);
+
+	const float32x4_t kOmega = ACos(cosom);
+	const float32x4_t kInvSinom = Reciprocal(vmaxq_f32(Sin(kOmega), vdupq_n_f32(1e-20f)));
+	const float32x4_t kT0 = vsubq_f32(kOne, t);
+
+	float32x4_t s0 = vmulq_f32(Sin(vmulq_f32(kT0, kOmega)), kInvSinom);
+	float32x4_t s1 = vmulq_f32(Sin(vmulq_f32(t, kOmega)), kInvSinom);
+
+	// nearly equal rotations are lerped (same threshold as math::Slerp).
+	const uint32x4_t kLerp = vcleq_f32(vsubq_f32(kOne, cosom), vdupq_n_f32(0.0006f));
+	s0 = vbslq_f32(kLerp, kT0, s0);
+	s1 = vbslq_f32(kLerp, t, s1);
+	s1 = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(s1), kSign));
+
+	float32x4_t lenSq = vdupq_n_f32(0.f);
+	for (int i = 0; i < 4; ++i) {
+		q0[i] = vmlaq_f32(vmulq_f32(q0[i], s0), q1[i], s1);
+		lenSq = vmlaq_f32(lenSq, q0[i], q0[i]);
+	}
+
+	// renormalize, lerped and quantized keys are not unit length.
+	const float32x4_t kInvLen = RSqrt(vmaxq_f32(lenSq, vdupq_n_f32(1e-20f)));
+	for (int i = 0; i < 4; ++i)
+		q0[i] = vmulq_f32(q0[i], kInvLen);
+}
+
+inline void LoadRotations(float32x4_t *q, const float *bones) {
+	q[0] = vld1q_f32(bones);
+	q[1] = vld1q_f32(bones+kBoneStride);
+	q[2] = vld1q_f32(bones+kBoneStride*2);
+	q[3] = vld1q_f32(bones+kBoneStride*3);
+	Transpose4(q);
+}
+
+//! Blends 4 bones, out may be src or dst.
+inline void BlendBones4(float *out, const float *src, const float *dst, float32x4_t t) {
+	float32x4_t q0[4];
+	float32x4_t q1[4];
+	float32x4_t st[4][2];
+
+	LoadRotations(q0, src);
+	LoadRotations(q1, dst);
+
+	// scale and translation are 6 floats, lerped as 2 overlapping vectors
+	for (int i = 0; i < 4; ++i) {
+		const int kOfs = i*kBoneStride;
+		for (int k = 0; k < 2; ++k) {
+			const float32x4_t a = vld1q_f32(src+kOfs+4+k*2);
+			const float32x4_t b = vld1q_f32(dst+kOfs+4+k*2);
+			st[i][k] = vmlaq_f32(a, vsubq_f32(b, a), t);
+		}
+	}
+
+	Slerp4(q0, q1, t);
+	Transpose4(q0);
+
+	for (int i = 0; i < 4; ++i) {
+		const int kOfs = i*kBoneStride;
+		vst1q_f32(out+kOfs, q0[i]);
+		vst1q_f32(out+kOfs+4, st[i][0]);
+		vst1q_f32(out+kOfs+6, st[i][1]);
+	}
+}
+
+void BlendBones(
+	float *outBones,
+	const float *srcBones,
+	const float *dstBones,
+	float frac,
+	int numBones
+) {
+	const float32x4_t kT = vdupq_n_f32(frac);
+
+	int i;
+	for (i = 0; i+4 <= numBones; i += 4) {
+		const int kOfs = i*kBoneStride;
+		BlendBones4(outBones+kOfs, srcBones+kOfs, dstBones+kOfs, kT);
+	}
+
+	if (i < numBones) {
+		// blend the remainder through zero padded copies.
+		float temp[3][kBoneStride*4];
+		const int kNumFloats = (numBones-i)*kBoneStride;
+		const int kOfs = i*kBoneStride;
+
+		memset(temp, 0, sizeof(temp));
+		memcpy(temp[0], srcBones+kOfs, kNumFloats*sizeof(float));
+		memcpy(temp[1], dstBones+kOfs, kNumFloats*sizeof(float));
+		BlendBones4(temp[2], temp[0], temp[1], kT);
+		memcpy(outBones+kOfs, temp[2], kNumFloats*sizeof(float));
+	}
+}
+
+inline void DecodeBone(
+	float *out,
+	const S16 *rTable,
+	const S16 *sTable,
+	const S16 *tTable,
+	const float *decodeMags,
+	int r,
+	int s,
+	int t
+) {
+	const int32x4_t kQ = vmovl_s16(vld1_s16(rTable+r*4));
+	vst1q_f32(out, vmulq_n_f32(vcvtq_f32_s32(kQ), decodeMags[0]));
+
+	sTable += s*3;
+	tTable += t*3;
+
+	out[4] = sTable[0] * decodeMags[1];
+	out[5] = sTable[1] * decodeMags[1];
+	out[6] = sTable[2] * decodeMags[1];
+	out[7] = tTable[0] * decodeMags[2];
+	out[8] = tTable[1] * decodeMags[2];
+	out[9] = tTable[2] * decodeMags[2];
+}
+
+inline void DecodeKeys(
+	float *out,
+	const S16 *rTable,
+	const S16 *sTable,
+	const S16 *tTable,
+	const float *decodeMags,
+	const int *indices,
+	int stride,
+	int numBones
+) {
+	for (int i = 0; i < numBones; ++i) {
+		DecodeBone(
+			out+i*kBoneStride,
+			rTable,
+			sTable,
+			tTable,
+			decodeMags,
+			indices[i],
+			indices[i+stride],
+			indices[i+stride*2]
+		);
+	}
+}
+
+void DecodeBones(
+	float *outBones,
+	const S16 *rTable,
+	const S16 *sTable,
+	const S16 *tTable,
+	const float *decodeMags,
+	const int *srcIndices,
+	const int *dstIndices,
+	float frac,
+	int numBones
+) {
+	if (frac == 0.f) {
+		DecodeKeys(outBones, rTable, sTable, tTable, decodeMags, srcIndices, numBones, numBones);
+		return;
+	}
+
+	const float32x4_t kT = vdupq_n_f32(frac);
+	float temp[2][kBoneStride*4];
+
+	for (int i = 0; i < numBones; i += 4) {
+		const int kNumBones = std::min(4, numBones-i);
+
+		if (kNumBones < 4)
+			memset(temp, 0, sizeof(temp));
+
+		DecodeKeys(temp[0], rTable, sTable, tTable, decodeMags, srcIndices+i, numBones, kNumBones);
+		DecodeKeys(temp[1], rTable, sTable, tTable, decodeMags, dstIndices+i, numBones, kNumBones);
+
+		if (kNumBones == 4) {
+			BlendBones4(outBones+i*kBoneStride, temp[0], temp[1], kT);
+		} else {
+			BlendBones4(temp[0], temp[0], temp[1], kT);
+			memcpy(outBones+i*kBoneStride, temp[0], kNumBones*kBoneStride*sizeof(float));
+		}
+	}
+}
+
+}
+
+namespace {
+
+void CullBoxes(
+	U8 *outVisible,
+	const float * const *boxes,
+	int numBoxes,
+	const float *planes,
+	int numPlanes,
+	const float *volumeBounds
+) {
+	const float32x4_t kEpsilon = vdupq_n_f32(-math::Epsilon<float>());
+	const float32x4_t kVolume[6] = {
+		vdupq_n_f32(volumeBounds[0]), vdupq_n_f32(volumeBounds[1]), vdupq_n_f32(volumeBounds[2]),
+		vdupq_n_f32(volumeBounds[3]), vdupq_n_f32(volumeBounds[4]), vdupq_n_f32(volumeBounds[5])
+	};
+
+	float temp[6][4];
+	U32 mask[4];
+
+	for (int i = 0; i < numBoxes; i += 4) {
+		const int kNumBoxes = std::min(4, numBoxes-i);
+		float32x4_t box[6];
+
+		if (kNumBoxes == 4) {
+			for (int k = 0; k < 6; ++k)
+				box[k] = vld1q_f32(boxes[k]+i);
+		} else {
+			// pad with empty boxes at the volume mins, their results are not written.
+			for (int k = 0; k < 6; ++k) {
+				for (int j = 0; j < 4; ++j)
+					temp[k][j] = (j < kNumBoxes) ? boxes[k][i+j] : volumeBounds[k%3];
+				box[k] = vld1q_f32(temp[k]);
+			}
+		}
+
+		uint32x4_t visible = vandq_u32(
+			vandq_u32(
+				vandq_u32(vcgeq_f32(box[3], kVolume[0]), vcleq_f32(box[0], kVolume[3])),
+				vandq_u32(vcgeq_f32(box[4], kVolume[1]), vcleq_f32(box[1], kVolume[4]))
+			),
+			vandq_u32(vcgeq_f32(box[5], kVolume[2]), vcleq_f32(box[2], kVolume[5]))
+		);
+
+		for (int k = 0; k < numPlanes; ++k) {
+			const float *plane = planes + k*4;
+			// corner furthest in front of the plane, the plane is the same for all 4 boxes.
+			float32x4_t d = vmulq_n_f32((plane[0] >= 0.f) ? box[3] : box[0], plane[0]);
+			d = vmlaq_n_f32(d, (plane[1] >= 0.f) ? box[4] : box[1], plane[1]);
+			d = vmlaq_n_f32(d, (plane[2] >= 0.f) ? box[5] : box[2], plane[2]);
+			d = vsubq_f32(d, vdupq_n_f32(plane[3]));
+			visible = vandq_u32(visible, vcgeq_f32(d, kEpsilon));
+		}
+
+		vst1q_u32(mask, visible);
+		for (int j = 0; j < kNumBoxes; ++j)
+			outVisible[i+j] = mask[j] ? 1 : 0;
+	}
+}
+
+void PlaneDistances(
+	float *outDistances,
+	const float * const *points,
+	int numPoints,
+	const float *plane
+) {
+	const float32x4_t kDist = vdupq_n_f32(plane[3]);
+
+	int i = 0;
+	for (; i+4 <= numPoints; i += 4) {
+		float32x4_t d = vmulq_n_f32(vld1q_f32(points[0]+i), plane[0]);
+		d = vmlaq_n_f32(d, vld1q_f32(points[1]+i), plane[1]);
+		d = vmlaq_n_f32(d, vld1q_f32(points[2]+i), plane[2]);
+		vst1q_f32(outDistances+i, vsubq_f32(d, kDist));
+	}
+
+	for (; i < numPoints; ++i) {
+		outDistances[i] =
+			plane[0] * points[0][i] +
+			plane[1] * points[1][i] +
+			plane[2] * points[2][i] -
+			plane[3];
+	}
+}
+
+void ResampleMix(
+	float *out,
+	int numFrames,
+	const S16 *src,
+	int srcChannels,
+	U32 pos,
+	U32 step,
+	const float *gains
+) {
+	const float kGains[2] = { gains[0] * (1.f / 32768.f), gains[1] * (1.f / 32768.f) };
+
+	// samples on either side of 4 output frames are gathered, then interpolated together.
+	float a[2][4];
+	float b[2][4];
+	float frac[4];
+
+	int i = 0;
+	for (; i+4 <= numFrames; i += 4) {
+		if (srcChannels == 1) {
+			for (int k = 0; k < 4; ++k, pos += step) {
+				const S16 *x = src + (pos>>16);
+				a[0][k] = x[0];
+				b[0][k] = x[1];
+				frac[k] = (float)(pos&0xffff);
+			}
+		} else {
+			for (int k = 0; k < 4; ++k, pos += step) {
+				const S16 *x = src + (pos>>16)*2;
+				a[0][k] = x[0];
+				b[0][k] = x[2];
+				a[1][k] = x[1];
+				b[1][k] = x[3];
+				frac[k] = (float)(pos&0xffff);
+			}
+		}
+
+		const float32x4_t kFrac = vmulq_n_f32(vld1q_f32(frac), 1.f / 65536.f);
+		const float32x4_t kA = vld1q_f32(a[0]);
+		const float32x4_t kLeft = vmlaq_f32(kA, vsubq_f32(vld1q_f32(b[0]), kA), kFrac);
+		float32x4_t right = kLeft;
+
+		if (srcChannels != 1) {
+			const float32x4_t kB = vld1q_f32(a[1]);
+			right = vmlaq_f32(kB, vsubq_f32(vld1q_f32(b[1]), kB), kFrac);
+		}
+
+		float32x4x2_t lr;
+		lr.val[0] = vmulq_n_f32(kLeft, kGains[0]);
+		lr.val[1] = vmulq_n_f32(right, kGains[1]);
+
+		float32x4x2_t mix = vld2q_f32(out + i*2);
+		mix.val[0] = vaddq_f32(mix.val[0], lr.val[0]);
+		mix.val[1] = vaddq_f32(mix.val[1], lr.val[1]);
+		vst2q_f32(out + i*2, mix);
+	}
+
+	if (i < numFrames)
+		SIMD_ref_bind()->ResampleMix(out+i*2, numFrames-i, src, srcChannels, pos, step, gains);
+}
+
 }
 
 const SIMDDriver *SIMD_neon_bind() {
@@ -5367,6 +5765,11 @@ const SIMDDriver *SIMD_neon_bind() {
 	d.BlendVerts   = &BlendVerts;
 	d.MemCopy16    = &MemCopy16;
 	d.MemRep16     = &MemRep16;
+	d.BlendBones   = &BlendBones;
+	d.DecodeBones  = &DecodeBones;
+	d.CullBoxes    = &CullBoxes;
+	d.PlaneDistances = &PlaneDistances;
+	d.ResampleMix = &ResampleMix;
 	
 	string::cpy(d.name, "SIMD_neon");
 	return &d;
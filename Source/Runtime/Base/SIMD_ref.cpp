@@ -7,6 +7,7 @@
 #include RADPCH
 #include "SIMD.h"
 #include "../StringBase.h"
+#include "../Math/Quaternion.h"
 
 namespace {
 
@@ -210,6 +211,183 @@ void BlendVerts(
 	}
 }
 
+inline void BlendBone(float *out, const float *src, const float *dst, float frac) {
+	const math::QuaternionF r = math::Slerp(
+		math::QuaternionF(src[0], src[1], src[2], src[3]),
+		math::QuaternionF(dst[0], dst[1], dst[2], dst[3]),
+		frac
+	);
+
+	for (int i = 4; i < SIMDDriver::kNumBoneTMFloats; ++i)
+		out[i] = math::Lerp(src[i], dst[i], frac);
+
+	out[0] = r.X();
+	out[1] = r.Y();
+	out[2] = r.Z();
+	out[3] = r.W();
+}
+
+void BlendBones(
+	float *outBones,
+	const float *srcBones,
+	const float *dstBones,
+	float frac,
+	int numBones
+) {
+	for (int i = 0; i < numBones; ++i) {
+		BlendBone(outBones, srcBones, dstBones, frac);
+		outBones += SIMDDriver::kNumBoneTMFloats;
+		srcBones += SIMDDriver::kNumBoneTMFloats;
+		dstBones += SIMDDriver::kNumBoneTMFloats;
+	}
+}
+
+inline void DecodeBone(
+	float *out,
+	const S16 *rTable,
+	const S16 *sTable,
+	const S16 *tTable,
+	const float *decodeMags,
+	int r,
+	int s,
+	int t
+) {
+	rTable += r*4;
+	sTable += s*3;
+	tTable += t*3;
+
+	out[0] = rTable[0] * decodeMags[0];
+	out[1] = rTable[1] * decodeMags[0];
+	out[2] = rTable[2] * decodeMags[0];
+	out[3] = rTable[3] * decodeMags[0];
+	out[4] = sTable[0] * decodeMags[1];
+	out[5] = sTable[1] * decodeMags[1];
+	out[6] = sTable[2] * decodeMags[1];
+	out[7] = tTable[0] * decodeMags[2];
+	out[8] = tTable[1] * decodeMags[2];
+	out[9] = tTable[2] * decodeMags[2];
+}
+
+void DecodeBones(
+	float *outBones,
+	const S16 *rTable,
+	const S16 *sTable,
+	const S16 *tTable,
+	const float *decodeMags,
+	const int *srcIndices,
+	const int *dstIndices,
+	float frac,
+	int numBones
+) {
+	if (frac == 0.f) {
+		for (int i = 0; i < numBones; ++i) {
+			DecodeBone(
+				outBones, 
+				rTable, 
+				sTable, 
+				tTable, 
+				decodeMags, 
+				srcIndices[i], 
+				srcIndices[i+numBones], 
+				srcIndices[i+numBones*2]
+			);
+			outBones += SIMDDriver::kNumBoneTMFloats;
+		}
+		return;
+	}
+
+	float x[SIMDDriver::kNumBoneTMFloats];
+	float y[SIMDDriver::kNumBoneTMFloats];
+
+	for (int i = 0; i < numBones; ++i) {
+		DecodeBone(x, rTable, sTable, tTable, decodeMags, srcIndices[i], srcIndices[i+numBones], srcIndices[i+numBones*2]);
+		DecodeBone(y, rTable, sTable, tTable, decodeMags, dstIndices[i], dstIndices[i+numBones], dstIndices[i+numBones*2]);
+		BlendBone(outBones, x, y, frac);
+		outBones += SIMDDriver::kNumBoneTMFloats;
+	}
+}
+
+void CullBoxes(
+	U8 *outVisible,
+	const float * const *boxes,
+	int numBoxes,
+	const float *planes,
+	int numPlanes,
+	const float *volumeBounds
+) {
+	const float kEpsilon = -math::Epsilon<float>();
+
+	for (int i = 0; i < numBoxes; ++i) {
+		const float kBox[2][3] = {
+			{boxes[0][i], boxes[1][i], boxes[2][i]},
+			{boxes[3][i], boxes[4][i], boxes[5][i]}
+		};
+
+		bool visible = 
+			(kBox[1][0] >= volumeBounds[0]) && (kBox[0][0] <= volumeBounds[3]) &&
+			(kBox[1][1] >= volumeBounds[1]) && (kBox[0][1] <= volumeBounds[4]) &&
+			(kBox[1][2] >= volumeBounds[2]) && (kBox[0][2] <= volumeBounds[5]);
+
+		for (int k = 0; visible && (k < numPlanes); ++k) {
+			const float *plane = planes + k*4;
+			// corner furthest in front of the plane.
+			const float d = 
+				plane[0] * kBox[plane[0] >= 0.f][0] +
+				plane[1] * kBox[plane[1] >= 0.f][1] +
+				plane[2] * kBox[plane[2] >= 0.f][2] -
+				plane[3];
+			visible = d >= kEpsilon;
+		}
+
+		outVisible[i] = visible ? 1 : 0;
+	}
+}
+
+void PlaneDistances(
+	float *outDistances,
+	const float * const *points,
+	int numPoints,
+	const float *plane
+) {
+	for (int i = 0; i < numPoints; ++i) {
+		outDistances[i] =
+			plane[0] * points[0][i] +
+			plane[1] * points[1][i] +
+			plane[2] * points[2][i] -
+			plane[3];
+	}
+}
+
+void ResampleMix(
+	float *out,
+	int numFrames,
+	const S16 *src,
+	int srcChannels,
+	U32 pos,
+	U32 step,
+	const float *gains
+) {
+	const float kFracScale = 1.f / 65536.f;
+	const float kGains[2] = { gains[0] * (1.f / 32768.f), gains[1] * (1.f / 32768.f) };
+
+	if (srcChannels == 1) {
+		for (int i = 0; i < numFrames; ++i, pos += step) {
+			const S16 *x = src + (pos>>16);
+			const float kFrac = (pos&0xffff) * kFracScale;
+			const float kSample = x[0] + (x[1]-x[0]) * kFrac;
+			out[i*2+0] += kSample * kGains[0];
+			out[i*2+1] += kSample * kGains[1];
+		}
+	} else {
+		for (int i = 0; i < numFrames; ++i, pos += step) {
+			const S16 *x = src + (pos>>16)*2;
+			const float kFrac = (pos&0xffff) * kFracScale;
+			out[i*2+0] += (x[0] + (x[2]-x[0]) * kFrac) * kGains[0];
+			out[i*2+1] += (x[1] + (x[3]-x[1]) * kFrac) * kGains[1];
+		}
+	}
+}
+
 void MemCopy16(void *dst, const void *src, int len) {
 	RAD_ASSERT(IsAligned(dst, 16));
 	RAD_ASSERT(IsAligned(src, 16));
@@ -242,6 +420,11 @@ const SIMDDriver *SIMD_ref_bind() {
 	d.SkinVerts[2] = &SkinVerts3B;
 	d.SkinVerts[3] = &SkinVerts4B;
 	d.BlendVerts = &BlendVerts;
+	d.BlendBones = &BlendBones;
+	d.DecodeBones = &DecodeBones;
+	d.CullBoxes = &CullBoxes;
+	d.PlaneDistances = &PlaneDistances;
+	d.ResampleMix = &ResampleMix;
 	d.MemCopy16 = &MemCopy16;
 	d.MemRep16 = &MemRep16;
 
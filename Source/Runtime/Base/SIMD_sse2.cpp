@@ -12,12 +12,22 @@
 
 const SIMDDriver *SIMD_ref_bind();
 
-#if defined(RAD_OPT_WINX)
+// skinning is MSVC x86 inline assembly, bone blending uses intrinsics.
+#if defined(RAD_OPT_WINX) && !defined(_WIN64)
+#define SIMD_SSE2_ASM
+#endif
+
+#if defined(SIMD_SSE2_ASM) || defined(RAD_OPT_SSE2)
 
 #include "../StringBase.h"
+#include "../Math/Math.h"
+#include <algorithm>
+#include <emmintrin.h>
 
 namespace {
 
+#if defined(SIMD_SSE2_ASM)
+
 void SkinVerts1B(
 	float *outVerts, 
 	const float *bones, 
@@ -502,6 +512,388 @@ void SkinVerts3B(
 	}
 }
 
+#endif // SIMD_SSE2_ASM
+
+///////////////////////////////////////////////////////////////////////////////
+// Bone blending, 4 bones at a time.
+// Rotations are transposed into x, y, z, w registers and slerped together.
+///////////////////////////////////////////////////////////////////////////////
+
+enum {
+	kBoneStride = SIMDDriver::kNumBoneTMFloats
+};
+
+inline __m128 Select(__m128 mask, __m128 a, __m128 b) {
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+//! acos(x) for x in [0, 1], Abramowitz & Stegun 4.4.46 (|error| <= 2e-8)
+inline __m128 ACos(__m128 x) {
+	__m128 p = _mm_set1_ps(-0.0012624911f);
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(0.0066700901f));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(-0.0170881256f));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(0.0308918810f));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(-0.0501743046f));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(0.0889789874f));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(-0.2145988016f));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(1.5707963050f));
+	return _mm_mul_ps(p, _mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.f), x)));
+}
+
+//! sin(x) for x in [0, PI/2]
+inline __m128 Sin(__m128 x) {
+	const __m128 x2 = _mm_mul_ps(x, x);
+	__m128 p = _mm_set1_ps(-2.5052108e-8f);
+	p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(2.7557319e-6f));
+	p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.9841270e-4f));
+	p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(8.3333333e-3f));
+	p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.6666667e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(1.f));
+	return _mm_mul_ps(p, x);
+}
+
+//! Slerps 4 quaternions, q0 is replaced with the result.
+inline void Slerp4(__m128 *q0, __m128 *q1, __m128 t) {
+	const __m128 kOne = _mm_set1_ps(1.f);
+	const __m128 kSignMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+
+	__m128 cosom = _mm_add_ps(
+		_mm_add_ps(_mm_mul_ps(q0[0], q1[0]), _mm_mul_ps(q0[1], q1[1])),
+		_mm_add_ps(_mm_mul_ps(q0[2], q1[2]), _mm_mul_ps(q0[3], q1[3]))
+	);
+
+	// take the shortest path
+	const __m128 kSign = _mm_and_ps(cosom, kSignMask);
+	cosom = _mm_min_ps(_mm_xor_ps(cosom, kSign), kOne);
+
+	const __m128 kOmega = ACos(cosom);
+	const __m128 kInvSinom = _mm_div_ps(kOne, Sin(kOmega));
+	const __m128 kT0 = _mm_sub_ps(kOne, t);
+
+	__m128 s0 = _mm_mul_ps(Sin(_mm_mul_ps(kT0, kOmega)), kInvSinom);
+	__m128 s1 = _mm_mul_ps(Sin(_mm_mul_ps(t, kOmega)), kInvSinom);
+
+	// nearly equal rotations are lerped (same threshold as math::Slerp).
+	const __m128 kLerp = _mm_cmple_ps(_mm_sub_ps(kOne, cosom), _mm_set1_ps(0.0006f));
+	s0 = Select(kLerp, kT0, s0);
+	s1 = _mm_xor_ps(Select(kLerp, t, s1), kSign);
+
+	__m128 lenSq = _mm_setzero_ps();
+	for (int i = 0; i < 4; ++i) {
+		q0[i] = _mm_add_ps(_mm_mul_ps(q0[i], s0), _mm_mul_ps(q1[i], s1));
+		lenSq = _mm_add_ps(lenSq, _mm_mul_ps(q0[i], q0[i]));
+	}
+
+	// renormalize, lerped and quantized keys are not unit length.
+	const __m128 kInvLen = _mm_div_ps(kOne, _mm_sqrt_ps(_mm_max_ps(lenSq, _mm_set1_ps(1e-20f))));
+	for (int i = 0; i < 4; ++i)
+		q0[i] = _mm_mul_ps(q0[i], kInvLen);
+}
+
+inline void LoadRotations(__m128 *q, const float *bones) {
+	q[0] = _mm_loadu_ps(bones);
+	q[1] = _mm_loadu_ps(bones+kBoneStride);
+	q[2] = _mm_loadu_ps(bones+kBoneStride*2);
+	q[3] = _mm_loadu_ps(bones+kBoneStride*3);
+	_MM_TRANSPOSE4_PS(q[0], q[1], q[2], q[3]);
+}
+
+//! Blends 4 bones, out may be src or dst.
+inline void BlendBones4(float *out, const float *src, const float *dst, __m128 t) {
+	__m128 q0[4];
+	__m128 q1[4];
+	__m128 st[4][2];
+
+	LoadRotations(q0, src);
+	LoadRotations(q1, dst);
+
+	// scale and translation are 6 floats, lerped as 2 overlapping vectors
+	for (int i = 0; i < 4; ++i) {
+		const int kOfs = i*kBoneStride;
+		for (int k = 0; k < 2; ++k) {
+			const __m128 a = _mm_loadu_ps(src+kOfs+4+k*2);
+			const __m128 b = _mm_loadu_ps(dst+kOfs+4+k*2);
+			st[i][k] = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+		}
+	}
+
+	Slerp4(q0, q1, t);
+	_MM_TRANSPOSE4_PS(q0[0], q0[1], q0[2], q0[3]);
+
+	for (int i = 0; i < 4; ++i) {
+		const int kOfs = i*kBoneStride;
+		_mm_storeu_ps(out+kOfs, q0[i]);
+		_mm_storeu_ps(out+kOfs+4, st[i][0]);
+		_mm_storeu_ps(out+kOfs+6, st[i][1]);
+	}
+}
+
+void BlendBones(
+	float *outBones,
+	const float *srcBones,
+	const float *dstBones,
+	float frac,
+	int numBones
+) {
+	const __m128 kT = _mm_set1_ps(frac);
+
+	int i;
+	for (i = 0; i+4 <= numBones; i += 4) {
+		const int kOfs = i*kBoneStride;
+		BlendBones4(outBones+kOfs, srcBones+kOfs, dstBones+kOfs, kT);
+	}
+
+	if (i < numBones) {
+		// blend the remainder through zero padded copies.
+		float temp[3][kBoneStride*4];
+		const int kNumFloats = (numBones-i)*kBoneStride;
+		const int kOfs = i*kBoneStride;
+
+		memset(temp, 0, sizeof(temp));
+		memcpy(temp[0], srcBones+kOfs, kNumFloats*sizeof(float));
+		memcpy(temp[1], dstBones+kOfs, kNumFloats*sizeof(float));
+		BlendBones4(temp[2], temp[0], temp[1], kT);
+		memcpy(outBones+kOfs, temp[2], kNumFloats*sizeof(float));
+	}
+}
+
+inline void DecodeBone(
+	float *out,
+	const S16 *rTable,
+	const S16 *sTable,
+	const S16 *tTable,
+	const float *decodeMags,
+	__m128 rMag,
+	int r,
+	int s,
+	int t
+) {
+	__m128i q = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(rTable+r*4));
+	q = _mm_srai_epi32(_mm_unpacklo_epi16(q, q), 16);
+	_mm_storeu_ps(out, _mm_mul_ps(_mm_cvtepi32_ps(q), rMag));
+
+	sTable += s*3;
+	tTable += t*3;
+
+	out[4] = sTable[0] * decodeMags[1];
+	out[5] = sTable[1] * decodeMags[1];
+	out[6] = sTable[2] * decodeMags[1];
+	out[7] = tTable[0] * decodeMags[2];
+	out[8] = tTable[1] * decodeMags[2];
+	out[9] = tTable[2] * decodeMags[2];
+}
+
+inline void DecodeKeys(
+	float *out,
+	const S16 *rTable,
+	const S16 *sTable,
+	const S16 *tTable,
+	const float *decodeMags,
+	const int *indices,
+	int stride,
+	int numBones
+) {
+	const __m128 kRMag = _mm_set1_ps(decodeMags[0]);
+	for (int i = 0; i < numBones; ++i) {
+		DecodeBone(
+			out+i*kBoneStride,
+			rTable,
+			sTable,
+			tTable,
+			decodeMags,
+			kRMag,
+			indices[i],
+			indices[i+stride],
+			indices[i+stride*2]
+		);
+	}
+}
+
+void DecodeBones(
+	float *outBones,
+	const S16 *rTable,
+	const S16 *sTable,
+	const S16 *tTable,
+	const float *decodeMags,
+	const int *srcIndices,
+	const int *dstIndices,
+	float frac,
+	int numBones
+) {
+	if (frac == 0.f) {
+		DecodeKeys(outBones, rTable, sTable, tTable, decodeMags, srcIndices, numBones, numBones);
+		return;
+	}
+
+	const __m128 kT = _mm_set1_ps(frac);
+	float temp[2][kBoneStride*4];
+
+	for (int i = 0; i < numBones; i += 4) {
+		const int kNumBones = std::min(4, numBones-i);
+
+		if (kNumBones < 4)
+			memset(temp, 0, sizeof(temp));
+
+		DecodeKeys(temp[0], rTable, sTable, tTable, decodeMags, srcIndices+i, numBones, kNumBones);
+		DecodeKeys(temp[1], rTable, sTable, tTable, decodeMags, dstIndices+i, numBones, kNumBones);
+
+		if (kNumBones == 4) {
+			BlendBones4(outBones+i*kBoneStride, temp[0], temp[1], kT);
+		} else {
+			BlendBones4(temp[0], temp[0], temp[1], kT);
+			memcpy(outBones+i*kBoneStride, temp[0], kNumBones*kBoneStride*sizeof(float));
+		}
+	}
+}
+
+}
+
+namespace {
+
+void CullBoxes(
+	U8 *outVisible,
+	const float * const *boxes,
+	int numBoxes,
+	const float *planes,
+	int numPlanes,
+	const float *volumeBounds
+) {
+	const __m128 kEpsilon = _mm_set1_ps(-math::Epsilon<float>());
+	const __m128 kVolume[6] = {
+		_mm_set1_ps(volumeBounds[0]), _mm_set1_ps(volumeBounds[1]), _mm_set1_ps(volumeBounds[2]),
+		_mm_set1_ps(volumeBounds[3]), _mm_set1_ps(volumeBounds[4]), _mm_set1_ps(volumeBounds[5])
+	};
+
+	float temp[6][4];
+
+	for (int i = 0; i < numBoxes; i += 4) {
+		const int kNumBoxes = std::min(4, numBoxes-i);
+		__m128 box[6];
+
+		if (kNumBoxes == 4) {
+			for (int k = 0; k < 6; ++k)
+				box[k] = _mm_loadu_ps(boxes[k]+i);
+		} else {
+			// pad with empty boxes at the volume mins, their results are not written.
+			for (int k = 0; k < 6; ++k) {
+				for (int j = 0; j < 4; ++j)
+					temp[k][j] = (j < kNumBoxes) ? boxes[k][i+j] : volumeBounds[k%3];
+				box[k] = _mm_loadu_ps(temp[k]);
+			}
+		}
+
+		__m128 visible = _mm_and_ps(
+			_mm_and_ps(
+				_mm_and_ps(_mm_cmpge_ps(box[3], kVolume[0]), _mm_cmple_ps(box[0], kVolume[3])),
+				_mm_and_ps(_mm_cmpge_ps(box[4], kVolume[1]), _mm_cmple_ps(box[1], kVolume[4]))
+			),
+			_mm_and_ps(_mm_cmpge_ps(box[5], kVolume[2]), _mm_cmple_ps(box[2], kVolume[5]))
+		);
+
+		for (int k = 0; (k < numPlanes) && _mm_movemask_ps(visible); ++k) {
+			const float *plane = planes + k*4;
+			// corner furthest in front of the plane, the plane is the same for all 4 boxes.
+			__m128 d = _mm_mul_ps(_mm_set1_ps(plane[0]), (plane[0] >= 0.f) ? box[3] : box[0]);
+			d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(plane[1]), (plane[1] >= 0.f) ? box[4] : box[1]));
+			d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(plane[2]), (plane[2] >= 0.f) ? box[5] : box[2]));
+			d = _mm_sub_ps(d, _mm_set1_ps(plane[3]));
+			visible = _mm_and_ps(visible, _mm_cmpge_ps(d, kEpsilon));
+		}
+
+		const int kMask = _mm_movemask_ps(visible);
+		for (int j = 0; j < kNumBoxes; ++j)
+			outVisible[i+j] = (U8)((kMask >> j) & 1);
+	}
+}
+
+void PlaneDistances(
+	float *outDistances,
+	const float * const *points,
+	int numPoints,
+	const float *plane
+) {
+	const __m128 kPlane[4] = {
+		_mm_set1_ps(plane[0]), _mm_set1_ps(plane[1]), _mm_set1_ps(plane[2]), _mm_set1_ps(plane[3])
+	};
+
+	int i = 0;
+	for (; i+4 <= numPoints; i += 4) {
+		__m128 d = _mm_mul_ps(kPlane[0], _mm_loadu_ps(points[0]+i));
+		d = _mm_add_ps(d, _mm_mul_ps(kPlane[1], _mm_loadu_ps(points[1]+i)));
+		d = _mm_add_ps(d, _mm_mul_ps(kPlane[2], _mm_loadu_ps(points[2]+i)));
+		_mm_storeu_ps(outDistances+i, _mm_sub_ps(d, kPlane[3]));
+	}
+
+	for (; i < numPoints; ++i) {
+		outDistances[i] =
+			plane[0] * points[0][i] +
+			plane[1] * points[1][i] +
+			plane[2] * points[2][i] -
+			plane[3];
+	}
+}
+
+void ResampleMix(
+	float *out,
+	int numFrames,
+	const S16 *src,
+	int srcChannels,
+	U32 pos,
+	U32 step,
+	const float *gains
+) {
+	const __m128 kFracScale = _mm_set1_ps(1.f / 65536.f);
+	const __m128 kGains[2] = {
+		_mm_set1_ps(gains[0] * (1.f / 32768.f)), _mm_set1_ps(gains[1] * (1.f / 32768.f))
+	};
+
+	// samples on either side of 4 output frames are gathered, then interpolated together.
+	float a[2][4];
+	float b[2][4];
+	float frac[4];
+
+	int i = 0;
+	for (; i+4 <= numFrames; i += 4) {
+		if (srcChannels == 1) {
+			for (int k = 0; k < 4; ++k, pos += step) {
+				const S16 *x = src + (pos>>16);
+				a[0][k] = x[0];
+				b[0][k] = x[1];
+				frac[k] = (float)(pos&0xffff);
+			}
+		} else {
+			for (int k = 0; k < 4; ++k, pos += step) {
+				const S16 *x = src + (pos>>16)*2;
+				a[0][k] = x[0];
+				b[0][k] = x[2];
+				a[1][k] = x[1];
+				b[1][k] = x[3];
+				frac[k] = (float)(pos&0xffff);
+			}
+		}
+
+		const __m128 kFrac = _mm_mul_ps(_mm_loadu_ps(frac), kFracScale);
+		const __m128 kA = _mm_loadu_ps(a[0]);
+		const __m128 kLeft = _mm_add_ps(kA, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b[0]), kA), kFrac));
+		__m128 right = kLeft;
+
+		if (srcChannels != 1) {
+			const __m128 kB = _mm_loadu_ps(a[1]);
+			right = _mm_add_ps(kB, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b[1]), kB), kFrac));
+		}
+
+		const __m128 kL = _mm_mul_ps(kLeft, kGains[0]);
+		const __m128 kR = _mm_mul_ps(right, kGains[1]);
+
+		float *dst = out + i*2;
+		_mm_storeu_ps(dst, _mm_add_ps(_mm_loadu_ps(dst), _mm_unpacklo_ps(kL, kR)));
+		_mm_storeu_ps(dst+4, _mm_add_ps(_mm_loadu_ps(dst+4), _mm_unpackhi_ps(kL, kR)));
+	}
+
+	if (i < numFrames)
+		SIMD_ref_bind()->ResampleMix(out+i*2, numFrames-i, src, srcChannels, pos, step, gains);
+}
+
 }
 
 const SIMDDriver *SIMD_sse2_bind()
@@ -512,11 +904,18 @@ const SIMDDriver *SIMD_sse2_bind()
 		return &d;
 
 	d = *SIMD_ref_bind();
+#if defined(SIMD_SSE2_ASM)
 	d.SkinVerts[0] = &SkinVerts1B;
 	d.SkinVerts[1] = &SkinVerts2B;
 	d.SkinVerts[2] = &SkinVerts3B;
 
 	// TODO: 4 bones
+#endif
+	d.BlendBones = &BlendBones;
+	d.DecodeBones = &DecodeBones;
+	d.CullBoxes = &CullBoxes;
+	d.PlaneDistances = &PlaneDistances;
+	d.ResampleMix = &ResampleMix;
 
 	string::cpy(d.name, "SIMD_sse2");
 	return &d;
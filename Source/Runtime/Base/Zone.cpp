@@ -10,6 +10,7 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/recursive_mutex.hpp>
 #include <boost/thread/locks.hpp>
+#include <boost/thread/tss.hpp>
 
 #if defined(RAD_OVERLOAD_STD_NEW)
 void * RAD_ANSICALL operator new(size_t s, const std::nothrow_t&) throw() {
@@ -178,6 +179,239 @@ Mutex &GetMutex() {
 } // namespace
 #endif
 
+// Allocation statistics are kept per-thread so Realloc/Delete never take a lock.
+// Each thread owns a ThreadState holding counters for every zone and a cache
+// of small blocks. ThreadStates are never freed: when a thread exits its state
+// is released and adopted by the next new thread, its counters are deltas so
+// summing every state ever created always gives the zone totals.
+
+namespace {
+
+enum {
+	kMaxTrackedZones = 128, // zones past this use the locked counters in Zone.
+	kHighWaterFoldBytes = 64*kKilo,
+	kSmallBlockGranularity = 16,
+	kNumSmallBlockClasses = 32,
+	kMaxSmallBlockSize = kSmallBlockGranularity*kNumSmallBlockClasses,
+	kSmallBlockChunkSize = 64*kKilo,
+	kMaxCachedSmallBlocks = 256,
+	kSmallBlockBatchSize = 64
+};
+
+// Only the owning thread writes its counters. Readers sum them without a lock,
+// each field is a single word so a read sees an old or a new value, never a torn
+// one, but the sum across threads is only a snapshot.
+struct ZoneCounters {
+	volatile SAddrSize numBytes;
+	volatile SAddrSize overhead;
+	volatile SAddrSize numAllocs;
+	SAddrSize foldMark;
+	volatile AddrSize small;
+	volatile AddrSize large;
+};
+
+struct SmallBlock {
+	SmallBlock *next;
+};
+
+struct SmallBlockList {
+	SmallBlock *head;
+	int count;
+
+	void Push(SmallBlock *b) {
+		b->next = head;
+		head = b;
+		++count;
+	}
+
+	SmallBlock *Pop() {
+		SmallBlock *b = head;
+		head = b->next;
+		--count;
+		return b;
+	}
+
+	//! Moves up to n blocks into list.
+	void Move(SmallBlockList &list, int n) {
+		while (head && n-- > 0)
+			list.Push(Pop());
+	}
+};
+
+typedef boost::mutex DepotMutex;
+typedef boost::lock_guard<DepotMutex> DepotLock;
+
+DepotMutex &GetDepotMutex() {
+	static aligned_block<sizeof(DepotMutex), RAD_ALIGNOF(DepotMutex)> s_data;
+	static DepotMutex *m = new (s_data.data) DepotMutex();
+	return *m;
+}
+
+// Small blocks shared between threads, only touched in batches.
+SmallBlockList s_depot[kNumSmallBlockClasses];
+
+void CarveSmallBlocks(int sizeClass, SmallBlockList &list) {
+	const AddrSize kBlockSize = (AddrSize)(sizeClass+1)*kSmallBlockGranularity;
+	// small block memory is pooled for the life of the process.
+	U8 *chunk = (U8*)malloc(kSmallBlockChunkSize+kSmallBlockGranularity-1);
+	RAD_OUT_OF_MEM(chunk);
+	chunk = Align(chunk, kSmallBlockGranularity);
+
+	for (AddrSize ofs = 0; ofs+kBlockSize <= kSmallBlockChunkSize; ofs += kBlockSize)
+		list.Push(reinterpret_cast<SmallBlock*>(chunk+ofs));
+}
+
+struct SmallBlockCache {
+	SmallBlockList lists[kNumSmallBlockClasses];
+
+	void *Alloc(int sizeClass) {
+		SmallBlockList &list = lists[sizeClass];
+		if (!list.head) {
+			{
+				DepotLock L(GetDepotMutex());
+				s_depot[sizeClass].Move(list, kSmallBlockBatchSize);
+			}
+			if (!list.head)
+				CarveSmallBlocks(sizeClass, list);
+		}
+		return list.Pop();
+	}
+
+	void Free(int sizeClass, void *p) {
+		SmallBlockList &list = lists[sizeClass];
+		list.Push(reinterpret_cast<SmallBlock*>(p));
+		if (list.count > kMaxCachedSmallBlocks) {
+			DepotLock L(GetDepotMutex());
+			list.Move(s_depot[sizeClass], kSmallBlockBatchSize);
+		}
+	}
+
+	void Flush() {
+		DepotLock L(GetDepotMutex());
+		for (int i = 0; i < kNumSmallBlockClasses; ++i)
+			lists[i].Move(s_depot[i], lists[i].count);
+	}
+};
+
+struct ThreadState {
+	ZoneCounters zones[kMaxTrackedZones];
+	SmallBlockCache cache;
+	ThreadState *next;
+	volatile bool inUse;
+};
+
+ThreadState *s_threadStates = 0; // guarded by GetMutex()
+int s_numZones = 0; // guarded by GetMutex()
+
+RAD_THREAD_VAR ThreadState *t_threadState = 0;
+RAD_THREAD_VAR bool t_threadExited = false;
+
+void ReleaseThreadState(ThreadState *state) {
+	state->cache.Flush();
+	t_threadState = 0;
+	t_threadExited = true; // any allocations made by later thread exit handlers use the locked path.
+	state->inUse = false;
+}
+
+typedef boost::thread_specific_ptr<ThreadState> ThreadExitHook;
+
+ThreadExitHook &GetThreadExitHook() {
+	// never destructed, threads may exit during static destruction.
+	static aligned_block<sizeof(ThreadExitHook), RAD_ALIGNOF(ThreadExitHook)> s_data;
+	static ThreadExitHook *hook = new (s_data.data) ThreadExitHook(&ReleaseThreadState);
+	return *hook;
+}
+
+ThreadState *LocalThreadState() {
+	ThreadState *state = t_threadState;
+	if (state || t_threadExited)
+		return state;
+
+	{
+#if defined(NEED_LOCKS)
+		Lock L(GetMutex());
+#endif
+		for (state = s_threadStates; state; state = state->next) {
+			if (!state->inUse)
+				break;
+		}
+
+		if (!state) {
+			state = (ThreadState*)malloc(sizeof(ThreadState));
+			RAD_OUT_OF_MEM(state);
+			memset(state, 0, sizeof(ThreadState));
+			for (int i = 0; i < kMaxTrackedZones; ++i)
+				state->zones[i].small = std::numeric_limits<AddrSize>::max();
+			state->next = s_threadStates;
+			s_threadStates = state;
+		}
+
+		state->inUse = true;
+	}
+
+	// set first: registering the exit hook may allocate.
+	t_threadState = state;
+	GetThreadExitHook().reset(state);
+	return state;
+}
+
+inline U8 *BlockBase(U8 *p) {
+	return p - p[-2];
+}
+
+inline int BlockSizeClass(U8 *p) {
+	return (int)p[-1];
+}
+
+//! Returns the offset of the zone header in a small block so the user pointer is aligned, or -1 if it doesn't fit.
+inline int SmallBlockOffset(AddrSize size, AddrSize headerSize, AddrSize alignment) {
+	if ((alignment > kSmallBlockGranularity) || (size > kMaxSmallBlockSize))
+		return -1;
+	// 2 bytes in front of the zone header hold the block offset and size class.
+	return (int)(Align(headerSize+2, kSmallBlockGranularity) - headerSize);
+}
+
+inline int SmallBlockSizeClass(AddrSize size, AddrSize headerSize, int offset) {
+	const AddrSize kTotal = size + headerSize + offset;
+	if (kTotal > kMaxSmallBlockSize)
+		return -1;
+	return (int)((kTotal + kSmallBlockGranularity - 1) / kSmallBlockGranularity) - 1;
+}
+
+void *SmallBlockAlloc(int sizeClass, int offset) {
+	ThreadState *state = LocalThreadState();
+	U8 *block;
+
+	if (state) {
+		block = (U8*)state->cache.Alloc(sizeClass);
+	} else {
+		SmallBlockCache cache;
+		memset(&cache, 0, sizeof(cache));
+		block = (U8*)cache.Alloc(sizeClass);
+		cache.Flush();
+	}
+
+	U8 *p = block + offset;
+	p[-2] = (U8)offset;
+	p[-1] = (U8)sizeClass;
+	return p;
+}
+
+void SmallBlockFree(U8 *p) {
+	const int kSizeClass = BlockSizeClass(p);
+	U8 *block = BlockBase(p);
+	ThreadState *state = LocalThreadState();
+
+	if (state) {
+		state->cache.Free(kSizeClass, block);
+	} else {
+		DepotLock L(GetDepotMutex());
+		s_depot[kSizeClass].Push(reinterpret_cast<SmallBlock*>(block));
+	}
+}
+
+} // namespace
+
 RAD_ZONE_DEF(RADRT_API, ZUnknown, "Unknown", 0);
 RAD_ZONE_DEF(RADRT_API, ZRuntime, "Runtime", 0);
 
@@ -189,38 +423,97 @@ void Zone::Init() {
 	m_backGuard[1]=RAD_MEM_GUARD;
 #endif
 
-	if (m_parent) {
 #if defined(NEED_LOCKS)
-		Lock L(GetMutex());
+	Lock L(GetMutex());
 #endif
+
+	if (s_numZones < kMaxTrackedZones)
+		m_index = s_numZones++;
+
+	if (m_parent) {
 		m_next = m_parent->m_head;
 		m_parent->m_head = this;
 	}
 }
 
-void Zone::Inc(AddrSize size, AddrSize overhead) {
+void Zone::Account(SAddrSize numBytes, SAddrSize overhead, SAddrSize numAllocs, AddrSize allocSize) {
+	ThreadState *state = (m_index >= 0) ? LocalThreadState() : 0;
+
+	if (!state) {
 #if defined(NEED_LOCKS)
-	Lock L(GetMutex());
+		Lock L(GetMutex());
 #endif
-	m_numBytes += size;
-	m_overhead += overhead;
-	m_high = std::max<volatile AddrSize>(m_numBytes, m_high);
-	m_small = std::min<volatile AddrSize>(m_small, size);
-	m_large = std::max<volatile AddrSize>(m_large, size);
+		m_numBytes += numBytes;
+		m_overhead += overhead;
+		m_numAllocs += numAllocs;
+		if (allocSize) {
+			m_small = std::min<AddrSize>((AddrSize)m_small, allocSize);
+			m_large = std::max<AddrSize>((AddrSize)m_large, allocSize);
+		}
+		m_high = std::max<AddrSize>(SumBytes(), (AddrSize)m_high);
+		return;
+	}
+
+	ZoneCounters &c = state->zones[m_index];
+	c.numBytes += numBytes;
+	c.overhead += overhead;
+	c.numAllocs += numAllocs;
+
+	if (allocSize) {
+		c.small = std::min<AddrSize>((AddrSize)c.small, allocSize);
+		c.large = std::max<AddrSize>((AddrSize)c.large, allocSize);
+	}
+
+	// the high water mark needs the sum across all threads, only update it after
+	// this thread has grown the zone by a reasonable amount.
+	if (c.numBytes < c.foldMark) {
+		c.foldMark = c.numBytes;
+	} else if ((c.numBytes - c.foldMark) > kHighWaterFoldBytes) {
+		c.foldMark = c.numBytes;
+		FoldHigh();
+	}
 }
 
-void Zone::Dec(AddrSize size, AddrSize overhead) {
+void Zone::FoldHigh() {
 #if defined(NEED_LOCKS)
 	Lock L(GetMutex());
 #endif
-	RAD_ASSERT(m_numBytes >= size);
-	RAD_ASSERT(m_overhead >= overhead);
-	m_numBytes -= size;
-	m_overhead -= overhead;
+	m_high = std::max<AddrSize>(SumBytes(), (AddrSize)m_high);
+}
+
+AddrSize Zone::SumBytes() const {
+	SAddrSize total = (SAddrSize)m_numBytes;
+	if (m_index >= 0) {
+		for (ThreadState *s = s_threadStates; s; s = s->next)
+			total += s->zones[m_index].numBytes;
+	}
+	return (AddrSize)std::max<SAddrSize>(total, 0);
+}
+
+void Zone::Inc(AddrSize size, AddrSize overhead) {
+	Account((SAddrSize)size, (SAddrSize)overhead, 0, size);
+}
+
+void Zone::Dec(AddrSize size, AddrSize overhead) {
+	Account(-(SAddrSize)size, -(SAddrSize)overhead, 0, 0);
+}
+
+void Zone::_Delete(U8 *p) {
+	const U16 kHeaderField = *reinterpret_cast<U16*>(p);
+	const AddrSize kOverhead = EHeaderSize + (kHeaderField & ~ESmallBlockFlag);
+	const AddrSize kSize = *reinterpret_cast<AddrSize*>(p+sizeof(Zone*)+2);
+
+	Account(-(SAddrSize)(kSize+kOverhead), -(SAddrSize)kOverhead, -1, 0);
+
+	if (kHeaderField & ESmallBlockFlag) {
+		SmallBlockFree(p);
+	} else {
+		aligned_free(p);
+	}
 }
 
 void *Zone::Realloc(void *ptr, size_t size, AddrSize headerSize, AddrSize alignment) {
-	RAD_ASSERT(headerSize <= std::numeric_limits<U16>::max());
+	RAD_ASSERT(headerSize < ESmallBlockFlag);
 #if defined(RAD_OPT_ZONE_MEMGUARD)
 	if (ptr) {
 		RAD_VERIFY(FromPtr(ptr) == this);
@@ -231,29 +524,66 @@ void *Zone::Realloc(void *ptr, size_t size, AddrSize headerSize, AddrSize alignm
 	AddrSize oldHeaderSize = ptr ? HeaderSize(ptr) : headerSize;
 	RAD_ASSERT(headerSize == oldHeaderSize); // you can't change this with Realloc.
 
-	U8 *pptr = (U8*)ptr - EHeaderSize;
-	U8 *p = (U8*)aligned_realloc(ptr ? pptr : 0, size, EHeaderSize+headerSize, alignment);
+	const AddrSize kOverhead = EHeaderSize + headerSize;
+	U8 *pptr = ptr ? ((U8*)ptr - EHeaderSize) : 0;
+	const bool kWasSmall = pptr && ((*reinterpret_cast<U16*>(pptr) & ESmallBlockFlag) != 0);
 
-	if (ptr && (p||!size)) {
-		if (!p)
-			--m_numAllocs;
+	const int kSmallOffset = size ? SmallBlockOffset(size, kOverhead, alignment) : -1;
+	const int kSizeClass = (kSmallOffset >= 0) ? SmallBlockSizeClass(size, kOverhead, kSmallOffset) : -1;
+
+	U8 *p = 0;
+
+	if (!size) {
+		if (pptr) {
+			if (kWasSmall) {
+				SmallBlockFree(pptr);
+			} else {
+				aligned_free(pptr);
+			}
+		}
+	} else if (kWasSmall && (kSizeClass == BlockSizeClass(pptr)) && (kSmallOffset == (int)pptr[-2])) {
+		p = pptr; // still fits.
+	} else if (kWasSmall || (kSizeClass >= 0)) {
+		if (kSizeClass >= 0) {
+			p = (U8*)SmallBlockAlloc(kSizeClass, kSmallOffset);
+		} else {
+			p = (U8*)aligned_realloc(0, size, kOverhead, alignment);
+		}
+
+		if (p && pptr) {
+			memcpy(p, pptr, kOverhead + std::min<AddrSize>(oldSize, size));
+			if (kWasSmall) {
+				SmallBlockFree(pptr);
+			} else {
+				aligned_free(pptr);
+			}
+		}
+	} else {
+		p = (U8*)aligned_realloc(pptr, size, kOverhead, alignment);
+	}
 
-		RAD_ASSERT(m_numBytes >= oldSize);
-		RAD_ASSERT(m_overhead >= (oldHeaderSize+EHeaderSize));
+	SAddrSize numBytes = 0;
+	SAddrSize overhead = 0;
+	SAddrSize numAllocs = 0;
 
-		m_numBytes -= oldSize;
-		m_overhead -= oldHeaderSize+EHeaderSize;
+	if (ptr && (p||!size)) {
+		if (!p)
+			--numAllocs;
+		numBytes -= (SAddrSize)(oldSize + kOverhead);
+		overhead -= (SAddrSize)kOverhead;
 	}
 
 	if (p) {
-		AddrSize actualSize = size + EHeaderSize + headerSize; // count this as well.
+		AddrSize actualSize = size + kOverhead; // count this as well.
 
 		if (!ptr) // make another alloc.
-			++m_numAllocs;
+			++numAllocs;
 
-		Inc(actualSize, EHeaderSize + headerSize);
-		
-		*reinterpret_cast<U16*>(p) = (U16)headerSize;
+		numBytes += (SAddrSize)actualSize;
+		overhead += (SAddrSize)kOverhead;
+		Account(numBytes, overhead, numAllocs, actualSize);
+
+		*reinterpret_cast<U16*>(p) = (U16)(headerSize | ((kSizeClass >= 0) ? ESmallBlockFlag : 0));
 		p += sizeof(U16);
 		*reinterpret_cast<Zone**>(p) = this;
 		p += sizeof(Zone*);
@@ -262,6 +592,8 @@ void *Zone::Realloc(void *ptr, size_t size, AddrSize headerSize, AddrSize alignm
 #if defined(RAD_OPT_ZONE_MEMGUARD)
 		p = (U8*)WriteMemGuards(p);
 #endif
+	} else if (numAllocs || numBytes) {
+		Account(numBytes, overhead, numAllocs, 0);
 	}
 
 	RAD_ASSERT((((AddrSize)p) & (alignment-1)) == 0);
@@ -269,11 +601,73 @@ void *Zone::Realloc(void *ptr, size_t size, AddrSize headerSize, AddrSize alignm
 	return p;
 }
 
+AddrSize Zone::RAD_IMPLEMENT_GET(numBytes) {
+#if defined(NEED_LOCKS)
+	Lock L(GetMutex());
+#endif
+	return SumBytes();
+}
+
+AddrSize Zone::RAD_IMPLEMENT_GET(overhead) {
+#if defined(NEED_LOCKS)
+	Lock L(GetMutex());
+#endif
+	SAddrSize total = (SAddrSize)m_overhead;
+	if (m_index >= 0) {
+		for (ThreadState *s = s_threadStates; s; s = s->next)
+			total += s->zones[m_index].overhead;
+	}
+	return (AddrSize)std::max<SAddrSize>(total, 0);
+}
+
+AddrSize Zone::RAD_IMPLEMENT_GET(count) {
+#if defined(NEED_LOCKS)
+	Lock L(GetMutex());
+#endif
+	SAddrSize total = (SAddrSize)m_numAllocs;
+	if (m_index >= 0) {
+		for (ThreadState *s = s_threadStates; s; s = s->next)
+			total += s->zones[m_index].numAllocs;
+	}
+	return (AddrSize)std::max<SAddrSize>(total, 0);
+}
+
+AddrSize Zone::RAD_IMPLEMENT_GET(small) {
+#if defined(NEED_LOCKS)
+	Lock L(GetMutex());
+#endif
+	AddrSize x = m_small;
+	if (m_index >= 0) {
+		for (ThreadState *s = s_threadStates; s; s = s->next)
+			x = std::min<AddrSize>(x, (AddrSize)s->zones[m_index].small);
+	}
+	return x;
+}
+
+AddrSize Zone::RAD_IMPLEMENT_GET(large) {
+#if defined(NEED_LOCKS)
+	Lock L(GetMutex());
+#endif
+	AddrSize x = m_large;
+	if (m_index >= 0) {
+		for (ThreadState *s = s_threadStates; s; s = s->next)
+			x = std::max<AddrSize>(x, (AddrSize)s->zones[m_index].large);
+	}
+	return x;
+}
+
+AddrSize Zone::RAD_IMPLEMENT_GET(high) {
+#if defined(NEED_LOCKS)
+	Lock L(GetMutex());
+#endif
+	return std::max<AddrSize>(SumBytes(), (AddrSize)m_high);
+}
+
 AddrSize Zone::RAD_IMPLEMENT_GET(totalBytes) {
 #if defined(NEED_LOCKS)
 	Lock L(GetMutex());
 #endif
-	AddrSize total = m_numBytes;
+	AddrSize total = numBytes;
 	for (Zone *z = m_head; z; z = z->next) {
 		total += z->totalBytes;
 	}
@@ -284,9 +678,9 @@ AddrSize Zone::RAD_IMPLEMENT_GET(totalOverhead) {
 #if defined(NEED_LOCKS)
 	Lock L(GetMutex());
 #endif
-	AddrSize total = m_overhead;
+	AddrSize total = overhead;
 	for (Zone *z = m_head; z; z = z->next) {
-		total += z->m_overhead;
+		total += z->totalOverhead;
 	}
 	return total;
 }
@@ -295,7 +689,7 @@ AddrSize Zone::RAD_IMPLEMENT_GET(totalCount) {
 #if defined(NEED_LOCKS)
 	Lock L(GetMutex());
 #endif
-	AddrSize total = m_numAllocs;
+	AddrSize total = count;
 	for (Zone *z = m_head; z; z = z->next) {
 		total += z->totalCount;
 	}
@@ -306,7 +700,7 @@ AddrSize Zone::RAD_IMPLEMENT_GET(totalSmall) {
 #if defined(NEED_LOCKS)
 	Lock L(GetMutex());
 #endif
-	AddrSize total = m_small;
+	AddrSize total = small;
 	for (Zone *z = m_head; z; z = z->next) {
 		total = std::min<AddrSize>(z->totalSmall, total);
 	}
@@ -317,7 +711,7 @@ AddrSize Zone::RAD_IMPLEMENT_GET(totalLarge) {
 #if defined(NEED_LOCKS)
 	Lock L(GetMutex());
 #endif
-	AddrSize total = m_large;
+	AddrSize total = large;
 	for (Zone *z = m_head; z; z = z->next) {
 		total = std::max<AddrSize>(z->totalLarge, total);
 	}
@@ -328,7 +722,7 @@ AddrSize Zone::RAD_IMPLEMENT_GET(totalHigh) {
 #if defined(NEED_LOCKS)
 	Lock L(GetMutex());
 #endif
-	AddrSize total = m_high;
+	AddrSize total = high;
 	for (Zone *z = m_head; z; z = z->next) {
 		total = std::max<AddrSize>(z->totalHigh, total);
 	}
@@ -37,7 +37,8 @@ public:
 		 m_numAllocs(0),
 		 m_small(std::numeric_limits<AddrSize>::max()),
 		 m_large(0),
-		 m_high(0)
+		 m_high(0),
+		 m_index(-1)
 	 {
 		 Init();
 	 }
@@ -52,7 +53,8 @@ public:
 		 m_numAllocs(0),
 		 m_small(std::numeric_limits<AddrSize>::max()),
 		 m_large(0),
-		 m_high(0)
+		 m_high(0),
+		 m_index(-1)
 	 {
 		 Init();
 	 }
@@ -62,6 +64,9 @@ public:
 	RAD_DECLARE_READONLY_PROPERTY(Zone, head, Zone*);
 	RAD_DECLARE_READONLY_PROPERTY(Zone, name, const char *);
 
+	// Counters are kept per-thread and summed without stopping the threads that own
+	// them, values read while other threads allocate are approximate. Use them for
+	// reporting, not for accounting.
 	RAD_DECLARE_READONLY_PROPERTY(Zone, numBytes, AddrSize);
 	RAD_DECLARE_READONLY_PROPERTY(Zone, overhead, AddrSize);
 	RAD_DECLARE_READONLY_PROPERTY(Zone, count, AddrSize);
@@ -107,7 +112,7 @@ public:
 		U8 *pp = (U8*)p;
 		pp -= EHeaderSize;
 		RAD_ASSERT(FromPtr(p)); // check guards
-		return (AddrSize)*reinterpret_cast<U16*>(pp);
+		return (AddrSize)(*reinterpret_cast<U16*>(pp) & ~ESmallBlockFlag);
 	}
 
 	static Zone *FromPtr(void *p) {
@@ -141,12 +146,13 @@ private:
 	RAD_DECLARE_GET(next, Zone*) { return m_next; }
 	RAD_DECLARE_GET(head, Zone*) { return m_head; }
 	RAD_DECLARE_GET(name, const char*) { return m_name; }
-	RAD_DECLARE_GET(numBytes, AddrSize) { return m_numBytes; }
-	RAD_DECLARE_GET(overhead, AddrSize) { return m_overhead; }
-	RAD_DECLARE_GET(count, AddrSize) { return m_numAllocs; }
-	RAD_DECLARE_GET(small, AddrSize) { return m_small; }
-	RAD_DECLARE_GET(large, AddrSize) { return m_large; }
-	RAD_DECLARE_GET(high, AddrSize) { return m_high; }
+	// counters are kept per-thread and summed here.
+	RAD_DECLARE_GET(numBytes, AddrSize);
+	RAD_DECLARE_GET(overhead, AddrSize);
+	RAD_DECLARE_GET(count, AddrSize);
+	RAD_DECLARE_GET(small, AddrSize);
+	RAD_DECLARE_GET(large, AddrSize);
+	RAD_DECLARE_GET(high, AddrSize);
 	RAD_DECLARE_GET(totalBytes, AddrSize);
 	RAD_DECLARE_GET(totalOverhead, AddrSize);
 	RAD_DECLARE_GET(totalCount, AddrSize);
@@ -156,17 +162,17 @@ private:
 
 	enum {
 #if defined (RAD_OPT_ZONE_MEMGUARD)
-		EHeaderSize = sizeof(U16) + sizeof(Zone*) + sizeof(AddrSize) + sizeof(void*)
+		EHeaderSize = sizeof(U16) + sizeof(Zone*) + sizeof(AddrSize) + sizeof(void*),
 #else
-		EHeaderSize = sizeof(U16) + sizeof(Zone*) + sizeof(AddrSize)
+		EHeaderSize = sizeof(U16) + sizeof(Zone*) + sizeof(AddrSize),
 #endif
+		ESmallBlockFlag = 0x8000 // set in the header size field of blocks from the small block cache.
 	};
 
-	void _Delete(U8 *p) {
-		--m_numAllocs;
-		Dec(*reinterpret_cast<AddrSize*>(p+sizeof(Zone*)+2), EHeaderSize + *reinterpret_cast<U16*>(p));
-		aligned_free(p);
-	}
+	void _Delete(U8 *p);
+	void Account(SAddrSize numBytes, SAddrSize overhead, SAddrSize numAllocs, AddrSize allocSize);
+	void FoldHigh();
+	AddrSize SumBytes() const;
 
 #if defined (RAD_OPT_ZONE_MEMGUARD)
 	static void *WriteMemGuards(void *ptr);
@@ -181,6 +187,7 @@ private:
 	volatile AddrSize m_small;
 	volatile AddrSize m_large;
 	volatile AddrSize m_high;
+	int m_index;
 	const char *m_name;
 	Zone *m_parent;
 	Zone *m_next;
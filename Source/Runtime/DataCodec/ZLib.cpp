@@ -518,8 +518,8 @@ RADRT_API bool RADRT_CALL Decode(const void* data, AddrSize dataSize, void* out,
 	RAD_ASSERT(data&&dataSize);
 	RAD_ASSERT(out&&outSize);
 
-	uInt dummySize = (uInt)outSize;
-	int zerr = uncompress((Bytef*)out, (uLongf*)&dummySize, (const Bytef*)data, (uInt)dataSize, heap_allocate, heap_free, 0);
+	uLongf dummySize = (uLongf)outSize;
+	int zerr = uncompress((Bytef*)out, &dummySize, (const Bytef*)data, (uInt)dataSize, heap_allocate, heap_free, 0);
 
 	return zerr == Z_OK;
 }
@@ -5,6 +5,7 @@
 
 #include RADPCH
 #include "File.h"
+#include "../DataCodec/ZLib.h"
 #include "../PushSystemMacros.h"
 
 using namespace data_codec::lmp;
@@ -195,6 +196,7 @@ void FileSystem::AddDirectory(
 	m.dir = path;
 	m.mask = mask;
 	m_paths.push_back(m);
+	RebuildPakIndex();
 }
 
 PakFile::Ref FileSystem::OpenPakFile(
@@ -220,6 +222,7 @@ void FileSystem::AddPakFile(
 	m.pak = pakFile;
 	m.mask = mask;
 	m_paths.push_back(m);
+	RebuildPakIndex();
 }
 
 void FileSystem::RemovePakFile(const PakFileRef &pakFile) {
@@ -232,6 +235,8 @@ void FileSystem::RemovePakFile(const PakFileRef &pakFile) {
 			++it;
 		}
 	}
+
+	RebuildPakIndex();
 }
 
 void FileSystem::RemovePakFiles() {
@@ -243,6 +248,8 @@ void FileSystem::RemovePakFiles() {
 			++it;
 		}
 	}
+
+	RebuildPakIndex();
 }
 
 FILE *FileSystem::fopen(
@@ -311,19 +318,22 @@ MMFile::Ref FileSystem::OpenFile(
 	if (resolved)
 		*resolved = 0;
 
-	for (PathMapping::Vec::const_iterator it = m_paths.begin(); it != m_paths.end(); ++it) {
-		const PathMapping &m = *it;
+	const U32 kHash = HashPath(path);
+	int pakEntry = FindPakEntry(path, kHash, -1);
+
+	for (int i = 0; i < (int)m_paths.size(); ++i) {
+		const PathMapping &m = m_paths[i];
 
 		if (m.mask&exclude)
 			continue;
 		if (m.mask&mask) {
 
 			if (m.pak) {
-				MMFileRef r = m.pak->OpenFile(kPath.c_str);
-				if (r) {
+				pakEntry = SkipPakEntries(path, kHash, pakEntry, i);
+				if ((pakEntry != -1) && (m_pakIndex.entries[pakEntry].mapping == i)) {
 					if (resolved)
 						*resolved = m.mask;
-					return r;
+					return m.pak->OpenLump(*m_pakIndex.entries[pakEntry].lump);
 				}
 			} else {
 				String spath;
@@ -483,15 +493,19 @@ bool FileSystem::FileExists(
 	if (resolved)
 		*resolved = 0;
 
-	for (PathMapping::Vec::const_iterator it = m_paths.begin(); it != m_paths.end(); ++it) {
-		const PathMapping &m = *it;
+	const U32 kHash = HashPath(path);
+	int pakEntry = FindPakEntry(path, kHash, -1);
+
+	for (int i = 0; i < (int)m_paths.size(); ++i) {
+		const PathMapping &m = m_paths[i];
 
 		if (m.mask&exclude)
 			continue;
 		if (m.mask&mask) {
 
 			if (m.pak) {
-				if (m.pak->FileExists(kPath.c_str)) {
+				pakEntry = SkipPakEntries(path, kHash, pakEntry, i);
+				if ((pakEntry != -1) && (m_pakIndex.entries[pakEntry].mapping == i)) {
 					if (resolved)
 						*resolved = m.mask;
 					return true;
@@ -512,6 +526,101 @@ bool FileSystem::FileExists(
 	return false;
 }
 
+U32 FileSystem::HashPath(const char *path) {
+	RAD_ASSERT(path);
+	// FNV-1a
+	U32 hash = 2166136261U;
+	for (const U8 *z = reinterpret_cast<const U8*>(path); *z; ++z) {
+		hash ^= (U32)*z;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+void FileSystem::RebuildPakIndex() {
+	m_pakIndex.entries.clear();
+	m_pakIndex.buckets.clear();
+
+	int numLumps = 0;
+	for (PathMapping::Vec::const_iterator it = m_paths.begin(); it != m_paths.end(); ++it) {
+		if ((*it).pak)
+			numLumps += (*it).pak->numLumps;
+	}
+
+	if (numLumps < 1)
+		return;
+
+	// at most 1 entry per bucket on average.
+	int numBuckets = 16;
+	while (numBuckets < numLumps)
+		numBuckets <<= 1;
+
+	m_pakIndex.entries.reserve(numLumps);
+	m_pakIndex.buckets.resize(numBuckets, -1);
+
+	for (int i = 0; i < (int)m_paths.size(); ++i) {
+		const PathMapping &m = m_paths[i];
+		if (!m.pak)
+			continue;
+
+		const int kNumLumps = m.pak->numLumps;
+		for (int k = 0; k < kNumLumps; ++k) {
+			PakIndex::Entry e;
+			e.lump = m.pak->LumpForIndex(k);
+			if (!e.lump)
+				break;
+			e.hash = HashPath(e.lump->Name());
+			e.mapping = i;
+			e.next = -1;
+			m_pakIndex.entries.push_back(e);
+		}
+	}
+
+	// link in reverse so each chain is in mount order.
+	const U32 kMask = (U32)(numBuckets-1);
+	for (int i = (int)m_pakIndex.entries.size()-1; i >= 0; --i) {
+		PakIndex::Entry &e = m_pakIndex.entries[i];
+		int &bucket = m_pakIndex.buckets[e.hash&kMask];
+		e.next = bucket;
+		bucket = i;
+	}
+}
+
+int FileSystem::FindPakEntry(
+	const char *path, 
+	U32 hash, 
+	int prev
+) const {
+	if (m_pakIndex.buckets.empty())
+		return -1;
+
+	int i;
+	if (prev == -1) {
+		i = m_pakIndex.buckets[hash&(U32)(m_pakIndex.buckets.size()-1)];
+	} else {
+		i = m_pakIndex.entries[prev].next;
+	}
+
+	for (; i != -1; i = m_pakIndex.entries[i].next) {
+		const PakIndex::Entry &e = m_pakIndex.entries[i];
+		if ((e.hash == hash) && !string::cmp(e.lump->Name(), path))
+			break;
+	}
+
+	return i;
+}
+
+int FileSystem::SkipPakEntries(
+	const char *path,
+	U32 hash,
+	int entry,
+	int mapping
+) const {
+	while ((entry != -1) && (m_pakIndex.entries[entry].mapping < mapping))
+		entry = FindPakEntry(path, hash, entry);
+	return entry;
+}
+
 FileSearch::Ref FileSystem::OpenSearch(
 	const char *path,
 	SearchOptions searchOptions,
@@ -558,12 +667,21 @@ PakFile::PakFile(const MMFile::Ref &file) : m_file(file) {
 }
 
 MMFile::Ref PakFile::OpenFile(const char *path) {
-	MMFile::Ref r;
-
 	const StreamReader::Lump *l = m_pak.GetByName(path);
 	if (l)
-		r.reset(new (ZFile) MMPakEntry(shared_from_this(), *l));
-	return r;
+		return OpenLump(*l);
+	return MMFile::Ref();
+}
+
+MMFile::Ref PakFile::OpenLump(const StreamReader::Lump &lump) {
+	if (lump.TagSize() > 0) {
+		MMBlockPakEntry *entry = new (ZFile) MMBlockPakEntry(shared_from_this(), lump);
+		MMFile::Ref r(entry);
+		if (!entry->Init())
+			r.reset();
+		return r;
+	}
+	return MMFile::Ref(new (ZFile) MMPakEntry(shared_from_this(), lump));
 }
 
 FileSearch::Ref PakFile::OpenSearch(
@@ -623,6 +741,110 @@ AddrSize PakFile::MMPakEntry::RAD_IMPLEMENT_GET(size) {
 	return (AddrSize)m_lump.Size();
 }
 
+PakFile::MMBlockPakEntry::Blocks::~Blocks() {
+	if (data)
+		zone_free(data);
+}
+
+PakFile::MMBlockPakEntry::MMBlockPakEntry(
+	const PakFileRef &pakFile,
+	const data_codec::lmp::StreamReader::Lump &lump
+) : m_pakFile(pakFile), m_lump(lump), m_size(0), m_blockSize(0) {
+}
+
+bool PakFile::MMBlockPakEntry::Init() {
+	if (m_lump.TagSize() == sizeof(data_codec::lmp::LOfs)) {
+		// older paks zip the whole lump, which reads as a single block.
+		m_size = (AddrSize)*reinterpret_cast<const data_codec::lmp::LOfs*>(m_lump.TagData());
+		m_blockSize = m_size;
+		m_offsets.push_back(0);
+		m_offsets.push_back((U32)m_lump.Size());
+		return m_size > 0;
+	}
+
+	if (m_lump.TagSize() != sizeof(PakBlockTag))
+		return false;
+
+	const PakBlockTag *tag = reinterpret_cast<const PakBlockTag*>(m_lump.TagData());
+	m_size = (AddrSize)tag->size;
+	m_blockSize = (AddrSize)tag->blockSize;
+
+	if (!m_size || !m_blockSize)
+		return false;
+
+	const AddrSize kNumOffsets = ((m_size + m_blockSize - 1) / m_blockSize) + 1;
+	const AddrSize kTableSize = kNumOffsets * sizeof(U32);
+
+	if (kTableSize > (AddrSize)m_lump.Size())
+		return false;
+
+	MMapping::Ref mm = m_pakFile->m_file->MMap((AddrSize)m_lump.Ofs(), kTableSize, ZFile);
+	if (!mm)
+		return false;
+
+	const U32 *offsets = reinterpret_cast<const U32*>(mm->data.get());
+	m_offsets.assign(offsets, offsets + kNumOffsets);
+
+	return (m_offsets[0] == (U32)kTableSize) && (m_offsets.back() == (U32)m_lump.Size());
+}
+
+MMapping::Ref PakFile::MMBlockPakEntry::MMap(AddrSize ofs, AddrSize size, ::Zone &zone) {
+	if (size == 0)
+		size = m_size - ofs;
+	RAD_ASSERT(ofs+size <= m_size);
+
+	// mappings of the same region (stream buffers refilling, parsers seeking around a file)
+	// share the blocks decoded for the last one.
+	Blocks::Ref blocks = m_cache.lock();
+	if (!blocks || (ofs < blocks->ofs) || (ofs+size > blocks->ofs+blocks->size)) {
+		blocks = Decompress(ofs, size, zone);
+		if (!blocks)
+			return MMapping::Ref();
+		m_cache = blocks;
+	}
+
+	return MMapping::Ref(new (ZFile) MMappedBlocks(blocks, ofs, size));
+}
+
+PakFile::MMBlockPakEntry::Blocks::Ref PakFile::MMBlockPakEntry::Decompress(AddrSize ofs, AddrSize size, ::Zone &zone) {
+	const AddrSize kFirst = ofs / m_blockSize;
+	const AddrSize kLast = (ofs + std::max<AddrSize>(size, 1) - 1) / m_blockSize;
+	const AddrSize kZipOfs = (AddrSize)m_offsets[kFirst];
+	const AddrSize kZipSize = (AddrSize)m_offsets[kLast+1] - kZipOfs;
+
+	MMapping::Ref mm = m_pakFile->m_file->MMap((AddrSize)m_lump.Ofs() + kZipOfs, kZipSize, ZFile);
+	if (!mm)
+		return Blocks::Ref();
+
+	Blocks::Ref blocks(new (ZFile) Blocks());
+	blocks->ofs = kFirst * m_blockSize;
+	blocks->size = std::min(m_size, (kLast+1) * m_blockSize) - blocks->ofs;
+	blocks->data = safe_zone_malloc(zone, blocks->size);
+
+	const U8 *src = reinterpret_cast<const U8*>(mm->data.get());
+	U8 *dst = reinterpret_cast<U8*>(blocks->data);
+
+	for (AddrSize i = kFirst; i <= kLast; ++i) {
+		const AddrSize kSrcSize = (AddrSize)(m_offsets[i+1] - m_offsets[i]);
+		const AddrSize kDstSize = std::min(m_blockSize, m_size - (i * m_blockSize));
+
+		if (kSrcSize == kDstSize) {
+			memcpy(dst, src, kDstSize);
+		} else if (!data_codec::zlib::Decode(src, kSrcSize, dst, kDstSize)) {
+			return Blocks::Ref();
+		}
+
+		src += kSrcSize;
+		dst += kDstSize;
+	}
+
+	return blocks;
+}
+
+AddrSize PakFile::MMBlockPakEntry::RAD_IMPLEMENT_GET(size) {
+	return m_size;
+}
+
 PakFile::PakSearch::PakSearch(const char *_path, SearchOptions searchOptions, const PakFile::Ref &pak)
 	: m_searchOptions(searchOptions), m_pak(pak), m_idx(0) {
 
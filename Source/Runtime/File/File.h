@@ -10,6 +10,7 @@
 #include "../TimeDef.h"
 #include "../Container/ZoneVector.h"
 #include "../DataCodec/LmpReader.h"
+#include <boost/weak_ptr.hpp>
 #include <stdio.h>
 
 #if defined(RAD_OPT_WINX)
@@ -288,8 +289,48 @@ private:
 		String dir;
 		int mask;
 	};
+
+	// Every lump of the mounted pak files hashed by path, so resolving a relative path
+	// is a single lookup instead of a search of each pak file. Entries with the same
+	// path are chained in mount order. Rebuilt whenever the mount points change.
+	struct PakIndex {
+		struct Entry {
+			const data_codec::lmp::StreamReader::Lump *lump;
+			U32 hash;
+			int mapping; // index in m_paths.
+			int next;
+		};
+
+		typedef zone_vector<Entry, ZFileT>::type EntryVec;
+		typedef zone_vector<int, ZFileT>::type BucketVec;
+
+		EntryVec entries;
+		BucketVec buckets; // power of 2 size.
+	};
+
+	static U32 HashPath(const char *path);
+
+	void RebuildPakIndex();
+
+	//! Returns the entry after prev with the specified path, or -1.
+	/*! A prev of -1 returns the first entry. */
+	int FindPakEntry(
+		const char *path, 
+		U32 hash, 
+		int prev
+	) const;
+
+	//! Returns the first entry from entry on with the specified path that is in the
+	//! pak file at mount point mapping or a later one, or -1.
+	int SkipPakEntries(
+		const char *path,
+		U32 hash,
+		int entry,
+		int mapping
+	) const;
 	
 	PathMapping::Vec m_paths;
+	PakIndex m_pakIndex;
 	boost::array<String, kAliasMax> m_aliasTable;
 	int m_globalMask;
 };
@@ -417,6 +458,7 @@ private:
 
 	friend class FileSystem;
 	friend class MMPakEntry;
+	friend class MMBlockPakEntry;
 	friend class details::DetailsSearch;
 
 	class MMPakEntry : public MMFile {
@@ -462,6 +504,80 @@ private:
 		MMapping::Ref m_mm;
 	};
 
+	//! A compressed lump, see PakBlockTag.
+	/*! Mappings decompress only the blocks they cover. The blocks of the last mapping are
+		kept while any mapping of them is alive and are reused by mappings inside them. */
+	class MMBlockPakEntry : public MMFile {
+	public:
+
+		MMBlockPakEntry(
+			const PakFileRef &pakFile,
+			const data_codec::lmp::StreamReader::Lump &lump
+		);
+
+		bool Init();
+
+		virtual MMappingRef MMap(
+			AddrSize ofs, 
+			AddrSize size,
+			::Zone &zone
+		);
+
+	protected:
+
+		virtual RAD_DECLARE_GET(size, AddrSize);
+
+	private:
+
+		struct Blocks {
+			typedef boost::shared_ptr<Blocks> Ref;
+			typedef boost::weak_ptr<Blocks> WRef;
+
+			Blocks() : data(0), ofs(0), size(0) {}
+			~Blocks();
+
+			void *data;
+			AddrSize ofs;
+			AddrSize size;
+		};
+
+		class MMappedBlocks : public MMapping {
+		public:
+			MMappedBlocks(
+				const Blocks::Ref &blocks,
+				AddrSize offset,
+				AddrSize size
+			) : MMapping(
+				reinterpret_cast<const U8*>(blocks->data) + (offset - blocks->ofs), 
+				size, 
+				offset, 
+				0, 
+				ZFile
+			), m_blocks(blocks) {}
+
+			virtual void Prefetch(
+				AddrSize offset,
+				AddrSize size
+			) {
+			}
+
+		private:
+
+			Blocks::Ref m_blocks;
+		};
+
+		typedef zone_vector<U32, ZFileT>::type OffsetVec;
+
+		Blocks::Ref Decompress(AddrSize ofs, AddrSize size, ::Zone &zone);
+
+		PakFileRef m_pakFile;
+		const data_codec::lmp::StreamReader::Lump &m_lump;
+		OffsetVec m_offsets;
+		Blocks::WRef m_cache;
+		AddrSize m_size;
+		AddrSize m_blockSize;
+	};
+
 	class PakSearch : public FileSearch {
 	public:
 		PakSearch(
@@ -490,6 +606,8 @@ private:
 	static Ref Open(const MMFileRef &file);
 
 	PakFile(const MMFileRef &file);
+
+	MMFileRef OpenLump(const data_codec::lmp::StreamReader::Lump &lump);
 	
 	FileSearchRef OpenSearch(
 		const char *path,
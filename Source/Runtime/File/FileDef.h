@@ -52,7 +52,18 @@ enum {
 
 enum { // pak files
 	kDPakSig = RAD_FOURCC('D', 'P', 'A', 'K'),
-	kDPakMagic = 0xA3054028
+	kDPakMagic = 0xA3054028,
+	kPakBlockSize = 64*kKilo // uncompressed size of the blocks of a compressed lump.
+};
+
+//! Tag data of a compressed pak file lump.
+/*! Compressed lumps start with a table of numBlocks+1 U32 offsets from the start of
+	the lump, one for each block and one for the end of the last block, followed by the
+	blocks. Each block is zlib compressed unless its size in the lump is its uncompressed
+	size, so any block can be read without the ones before it. */
+struct PakBlockTag {
+	U32 size; // uncompressed size.
+	U32 blockSize;
 };
 
 RAD_BEGIN_FLAGS
@@ -6,6 +6,7 @@
 
 #include RADPCH
 #include "ImageCodec.h"
+#include "PixelConvert.h"
 #include <algorithm>
 
 namespace image_codec {
@@ -82,7 +83,7 @@ RADRT_API void RADRT_CALL ConvertPixel(const void* voidsrcPix, void* voiddstPix,
 		{
 			U16 p;
 			
-			if (srcFormat == Format_RGB555)
+			if (srcFormat != Format_PAL8_RGB555)
 			{
 				p = ((U16*)srcPix)[0];
 			}
@@ -181,14 +182,14 @@ RADRT_API void RADRT_CALL ConvertPixel(const void* voidsrcPix, void* voiddstPix,
 		{
 			U16 p;
 			
-			if (srcFormat == Format_RGB565)
+			if (srcFormat != Format_PAL8_RGB565)
 			{
 				p = ((U16*)srcPix)[0];
 			}
 			else
 			{
 				RAD_ASSERT(pal);
-				p = ((U16*)pal)[((U16*)srcPix)[0]];
+				p = ((U16*)pal)[((U8*)srcPix)[0]];
 			}
 
 			U16 r, g, b;
@@ -757,6 +758,13 @@ RADRT_API bool RADRT_CALL ConvertPixelData(const void* src, AddrSize srcByteCoun
 
 	AddrSize pixCount = srcByteCount / srcBPP;
 
+	details::FConvertPixels convert = details::FindPixelConverter(srcFormat, dstFormat);
+	if (convert)
+	{
+		convert(srcB, dstB, pal, pixCount, srcFormat, dstFormat);
+		return true;
+	}
+
 	while (pixCount-- > 0)
 	{
 		ConvertPixel(srcB, dstB, pal, srcFormat, dstFormat);
@@ -0,0 +1,534 @@
+/*! \file PixelConvert.cpp
+	\copyright Copyright (c) 2013 Sunside Inc., All Rights Reserved.
+	\copyright See Radiance/LICENSE for licensing terms.
+	\author Joe Riedel
+	\ingroup runtime
+*/
+
+/* Bulk pixel conversion kernels used by ConvertPixelData().
+
+   ConvertPixel() switches on both formats for every pixel. The kernels here are
+   specialized per format pair and bound into a table indexed by format type when
+   the runtime is loaded, the same way SIMDDriver binds its reference routines and
+   then overrides them with SSE2/NEON versions.
+
+   - 8 bit per channel formats are swizzled/expanded/packed directly.
+   - 1 byte formats (A8, paletted) expand through a 256 entry lookup table.
+   - 2 byte formats expand through a 64K entry lookup table for large images.
+
+   Lookup tables are built with ConvertPixel() so output is bit identical to the
+   per-pixel path.
+*/
+
+#include RADPCH
+#include "PixelConvert.h"
+#include "../Base/SIMD.h"
+
+#if defined(RAD_OPT_SSE2)
+#include <emmintrin.h>
+#elif defined(RAD_OPT_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace image_codec {
+namespace details {
+
+namespace {
+
+enum {
+	kNumFormatTypes = _Format_BGR888 + 1,
+	kMinLookup16Pixels = 64*kKilo // below this building the table costs more than it saves.
+};
+
+enum {
+	kPack_555,
+	kPack_565,
+	kPack_4444,
+	kPack_5551
+};
+
+inline bool IsBGR(int format) {
+	switch (format) {
+	case Format_BGR555:
+	case Format_BGR565:
+	case Format_BGRA4444:
+	case Format_BGRA5551:
+	case Format_BGR888:
+	case Format_BGRA8888:
+		return true;
+	}
+	return false;
+}
+
+int PackForFormat(int format) {
+	switch (format) {
+	case Format_RGB555:
+	case Format_BGR555:
+		return kPack_555;
+	case Format_RGB565:
+	case Format_BGR565:
+		return kPack_565;
+	case Format_RGBA4444:
+	case Format_BGRA4444:
+		return kPack_4444;
+	}
+	return kPack_5551;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Reference kernels
+///////////////////////////////////////////////////////////////////////////////
+
+void Copy(const U8 *src, U8 *dst, const void *pal, AddrSize numPixels, int srcFormat, int dstFormat) {
+	memcpy(dst, src, (size_t)(numPixels * FormatBPP(srcFormat)));
+}
+
+//! RGB888/BGR888/RGBA8888/BGRA8888 to each other.
+template <int kSrcBPP, int kDstBPP, bool kSwap>
+void Shuffle8(const U8 *src, U8 *dst, const void *pal, AddrSize numPixels, int srcFormat, int dstFormat) {
+	for (; numPixels > 0; --numPixels, src += kSrcBPP, dst += kDstBPP) {
+		const U8 c0 = src[kSwap ? 2 : 0];
+		const U8 c1 = src[1];
+		const U8 c2 = src[kSwap ? 0 : 2];
+		dst[0] = c0;
+		dst[1] = c1;
+		dst[2] = c2;
+		if (kDstBPP == 4)
+			dst[3] = (kSrcBPP == 4) ? src[3] : 0xFF;
+	}
+}
+
+//! 8 bit per channel formats to A8.
+template <int kSrcBPP>
+void Alpha8(const U8 *src, U8 *dst, const void *pal, AddrSize numPixels, int srcFormat, int dstFormat) {
+	for (; numPixels > 0; --numPixels, src += kSrcBPP, ++dst) {
+		if (kSrcBPP == 4) {
+			*dst = src[3];
+		} else {
+			*dst = (U8)(((U16)src[0] + (U16)src[1] + (U16)src[2]) / 3);
+		}
+	}
+}
+
+template <int kSrcBPP, bool kSwap, int kPack>
+inline U16 PackPixel16(const U8 *src) {
+	const U16 lo = src[kSwap ? 2 : 0];
+	const U16 g  = src[1];
+	const U16 hi = src[kSwap ? 0 : 2];
+
+	switch (kPack) {
+	case kPack_555:
+		return (lo>>3) | ((g>>3)<<5) | ((hi>>3)<<10);
+	case kPack_565:
+		return (lo>>3) | ((g>>2)<<5) | ((hi>>3)<<11);
+	case kPack_4444:
+		return (lo>>4) | ((g>>4)<<4) | ((hi>>4)<<8) | ((kSrcBPP == 4) ? ((src[3]>>4)<<12) : 0xF000);
+	default:
+		return (lo>>3) | ((g>>3)<<5) | ((hi>>3)<<10) | ((kSrcBPP == 4) ? ((src[3] >= 128) ? 0x8000 : 0x0) : 0x8000);
+	}
+}
+
+//! 8 bit per channel formats to 16 bit packed formats.
+template <int kSrcBPP, bool kSwap, int kPack>
+void Pack16(const U8 *src, U8 *dst, const void *pal, AddrSize numPixels, int srcFormat, int dstFormat) {
+	U16 *dst16 = reinterpret_cast<U16*>(dst);
+	for (; numPixels > 0; --numPixels, src += kSrcBPP, ++dst16)
+		*dst16 = PackPixel16<kSrcBPP, kSwap, kPack>(src);
+}
+
+template <int kDstBPP>
+inline void WriteEntry(U8 *dst, const U8 *entry) {
+	memcpy(dst, entry, kDstBPP); // constant size, compiles to a single move.
+}
+
+//! A8 and paletted formats, every possible output pixel is precomputed.
+template <int kDstBPP>
+void Lookup8(const U8 *src, U8 *dst, const void *pal, AddrSize numPixels, int srcFormat, int dstFormat) {
+	U8 table[256*kDstBPP];
+
+	for (int i = 0; i < 256; ++i) {
+		const U8 index = (U8)i;
+		ConvertPixel(&index, &table[i*kDstBPP], pal, srcFormat, dstFormat);
+	}
+
+	for (; numPixels > 0; --numPixels, ++src, dst += kDstBPP)
+		WriteEntry<kDstBPP>(dst, &table[(*src)*kDstBPP]);
+}
+
+//! 16 bit formats, every possible output pixel is precomputed.
+template <int kDstBPP>
+void Lookup16(const U8 *src, U8 *dst, const void *pal, AddrSize numPixels, int srcFormat, int dstFormat) {
+	if (numPixels < kMinLookup16Pixels) {
+		for (; numPixels > 0; --numPixels, src += 2, dst += kDstBPP)
+			ConvertPixel(src, dst, pal, srcFormat, dstFormat);
+		return;
+	}
+
+	U8 *table = (U8*)safe_zone_malloc(ZImageCodec, 65536*kDstBPP);
+
+	for (int i = 0; i < 65536; ++i) {
+		const U16 value = (U16)i;
+		ConvertPixel(&value, &table[i*kDstBPP], pal, srcFormat, dstFormat);
+	}
+
+	const U16 *src16 = reinterpret_cast<const U16*>(src);
+	for (; numPixels > 0; --numPixels, ++src16, dst += kDstBPP)
+		WriteEntry<kDstBPP>(dst, &table[(*src16)*kDstBPP]);
+
+	zone_free(table);
+}
+
+FConvertPixels SelectShuffle8(int srcBPP, int dstBPP, bool swap) {
+	if (srcBPP == 3) {
+		if (dstBPP == 3)
+			return swap ? &Shuffle8<3, 3, true> : &Shuffle8<3, 3, false>;
+		return swap ? &Shuffle8<3, 4, true> : &Shuffle8<3, 4, false>;
+	}
+
+	if (dstBPP == 3)
+		return swap ? &Shuffle8<4, 3, true> : &Shuffle8<4, 3, false>;
+	return swap ? &Shuffle8<4, 4, true> : &Shuffle8<4, 4, false>;
+}
+
+template <int kSrcBPP, bool kSwap>
+FConvertPixels SelectPack16(int pack) {
+	switch (pack) {
+	case kPack_555:
+		return &Pack16<kSrcBPP, kSwap, kPack_555>;
+	case kPack_565:
+		return &Pack16<kSrcBPP, kSwap, kPack_565>;
+	case kPack_4444:
+		return &Pack16<kSrcBPP, kSwap, kPack_4444>;
+	}
+	return &Pack16<kSrcBPP, kSwap, kPack_5551>;
+}
+
+FConvertPixels SelectPack16(int srcBPP, bool swap, int pack) {
+	if (srcBPP == 3)
+		return swap ? SelectPack16<3, true>(pack) : SelectPack16<3, false>(pack);
+	return swap ? SelectPack16<4, true>(pack) : SelectPack16<4, false>(pack);
+}
+
+FConvertPixels SelectLookup(int srcBPP, int dstBPP) {
+	switch (dstBPP) {
+	case 1:
+		return (srcBPP == 1) ? &Lookup8<1> : &Lookup16<1>;
+	case 2:
+		return (srcBPP == 1) ? &Lookup8<2> : &Lookup16<2>;
+	case 3:
+		return (srcBPP == 1) ? &Lookup8<3> : &Lookup16<3>;
+	}
+	return (srcBPP == 1) ? &Lookup8<4> : &Lookup16<4>;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SSE2 kernels
+///////////////////////////////////////////////////////////////////////////////
+
+#if defined(RAD_OPT_SSE2)
+
+void SwapRB32_sse2(const U8 *src, U8 *dst, const void *pal, AddrSize numPixels, int srcFormat, int dstFormat) {
+	const __m128i kAGMask = _mm_set1_epi32(0xFF00FF00);
+	const __m128i kRBMask = _mm_set1_epi32(0x00FF00FF);
+
+	for (; numPixels >= 4; numPixels -= 4, src += 16, dst += 16) {
+		__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+		__m128i ag = _mm_and_si128(p, kAGMask);
+		__m128i rb = _mm_and_si128(p, kRBMask);
+		rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_or_si128(ag, rb));
+	}
+
+	Shuffle8<4, 4, true>(src, dst, pal, numPixels, srcFormat, dstFormat);
+}
+
+//! Extracts the top kBits of channel kChannel and moves them to bit kDstShift.
+template <int kChannel, int kBits, int kDstShift>
+inline __m128i Field(__m128i p) {
+	return _mm_slli_epi32(
+		_mm_and_si128(
+			_mm_srli_epi32(p, (kChannel*8) + 8 - kBits),
+			_mm_set1_epi32((1<<kBits)-1)
+		),
+		kDstShift
+	);
+}
+
+template <bool kSwap, int kPack>
+inline __m128i PackPixels16(__m128i p) {
+	const int kLo = kSwap ? 2 : 0;
+	const int kHi = kSwap ? 0 : 2;
+
+	switch (kPack) {
+	case kPack_555:
+		return _mm_or_si128(_mm_or_si128(Field<kLo, 5, 0>(p), Field<1, 5, 5>(p)), Field<kHi, 5, 10>(p));
+	case kPack_565:
+		return _mm_or_si128(_mm_or_si128(Field<kLo, 5, 0>(p), Field<1, 6, 5>(p)), Field<kHi, 5, 11>(p));
+	case kPack_4444:
+		return _mm_or_si128(
+			_mm_or_si128(Field<kLo, 4, 0>(p), Field<1, 4, 4>(p)),
+			_mm_or_si128(Field<kHi, 4, 8>(p), Field<3, 4, 12>(p))
+		);
+	default:
+		return _mm_or_si128(
+			_mm_or_si128(Field<kLo, 5, 0>(p), Field<1, 5, 5>(p)),
+			_mm_or_si128(Field<kHi, 5, 10>(p), Field<3, 1, 15>(p))
+		);
+	}
+}
+
+//! Packs 8 32 bit values (each < 65536) into 8 16 bit values.
+inline __m128i PackU32toU16(__m128i a, __m128i b) {
+	// packs_epi32 saturates signed, bias into signed range and back.
+	const __m128i kBias32 = _mm_set1_epi32(0x8000);
+	const __m128i kBias16 = _mm_set1_epi16((short)0x8000);
+	a = _mm_sub_epi32(a, kBias32);
+	b = _mm_sub_epi32(b, kBias32);
+	return _mm_add_epi16(_mm_packs_epi32(a, b), kBias16);
+}
+
+template <bool kSwap, int kPack>
+void Pack16_sse2(const U8 *src, U8 *dst, const void *pal, AddrSize numPixels, int srcFormat, int dstFormat) {
+	for (; numPixels >= 8; numPixels -= 8, src += 32, dst += 16) {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src+16));
+		a = PackPixels16<kSwap, kPack>(a);
+		b = PackPixels16<kSwap, kPack>(b);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), PackU32toU16(a, b));
+	}
+
+	Pack16<4, kSwap, kPack>(src, dst, pal, numPixels, srcFormat, dstFormat);
+}
+
+template <bool kSwap>
+FConvertPixels SelectPack16_sse2(int pack) {
+	switch (pack) {
+	case kPack_555:
+		return &Pack16_sse2<kSwap, kPack_555>;
+	case kPack_565:
+		return &Pack16_sse2<kSwap, kPack_565>;
+	case kPack_4444:
+		return &Pack16_sse2<kSwap, kPack_4444>;
+	}
+	return &Pack16_sse2<kSwap, kPack_5551>;
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// NEON kernels
+///////////////////////////////////////////////////////////////////////////////
+
+#if defined(RAD_OPT_NEON)
+
+template <int kSrcBPP, int kDstBPP, bool kSwap>
+void Shuffle8_neon(const U8 *src, U8 *dst, const void *pal, AddrSize numPixels, int srcFormat, int dstFormat) {
+	for (; numPixels >= 16; numPixels -= 16, src += 16*kSrcBPP, dst += 16*kDstBPP) {
+		uint8x16x4_t p;
+
+		if (kSrcBPP == 4) {
+			p = vld4q_u8(src);
+		} else {
+			uint8x16x3_t t = vld3q_u8(src);
+			p.val[0] = t.val[0];
+			p.val[1] = t.val[1];
+			p.val[2] = t.val[2];
+			p.val[3] = vdupq_n_u8(0xFF);
+		}
+
+		if (kSwap) {
+			uint8x16_t t = p.val[0];
+			p.val[0] = p.val[2];
+			p.val[2] = t;
+		}
+
+		if (kDstBPP == 4) {
+			vst4q_u8(dst, p);
+		} else {
+			uint8x16x3_t t;
+			t.val[0] = p.val[0];
+			t.val[1] = p.val[1];
+			t.val[2] = p.val[2];
+			vst3q_u8(dst, t);
+		}
+	}
+
+	Shuffle8<kSrcBPP, kDstBPP, kSwap>(src, dst, pal, numPixels, srcFormat, dstFormat);
+}
+
+FConvertPixels SelectShuffle8_neon(int srcBPP, int dstBPP, bool swap) {
+	if (srcBPP == 3) {
+		if (dstBPP == 3)
+			return swap ? &Shuffle8_neon<3, 3, true> : &Shuffle8_neon<3, 3, false>;
+		return swap ? &Shuffle8_neon<3, 4, true> : &Shuffle8_neon<3, 4, false>;
+	}
+
+	if (dstBPP == 3)
+		return swap ? &Shuffle8_neon<4, 3, true> : &Shuffle8_neon<4, 3, false>;
+	return swap ? &Shuffle8_neon<4, 4, true> : &Shuffle8_neon<4, 4, false>;
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+const int kLookupSrcFormats[] = {
+	Format_A8,
+	Format_PAL8_RGB555,
+	Format_PAL8_RGB565,
+	Format_PAL8_RGB888,
+	Format_PAL8_RGBA8888,
+	Format_RGB555,
+	Format_BGR555,
+	Format_RGB565,
+	Format_BGR565,
+	Format_RGBA4444,
+	Format_BGRA4444,
+	Format_RGBA5551,
+	Format_BGRA5551
+};
+
+const int kChannel8Formats[] = {
+	Format_RGB888,
+	Format_BGR888,
+	Format_RGBA8888,
+	Format_BGRA8888
+};
+
+const int kPacked16Formats[] = {
+	Format_RGB555,
+	Format_BGR555,
+	Format_RGB565,
+	Format_BGR565,
+	Format_RGBA4444,
+	Format_BGRA4444,
+	Format_RGBA5551,
+	Format_BGRA5551
+};
+
+const int kDstFormats[] = {
+	Format_A8,
+	Format_RGB555,
+	Format_BGR555,
+	Format_RGB565,
+	Format_BGR565,
+	Format_RGBA4444,
+	Format_BGRA4444,
+	Format_RGBA5551,
+	Format_BGRA5551,
+	Format_RGBA8888,
+	Format_BGRA8888,
+	Format_RGB888,
+	Format_BGR888
+};
+
+//! Converter table indexed by [srcType][dstType].
+struct PixelConverters {
+
+	PixelConverters() {
+		memset(fn, 0, sizeof(fn));
+		BindRef();
+#if defined(RAD_OPT_SSE2)
+		BindSSE2();
+#elif defined(RAD_OPT_NEON)
+		BindNEON();
+#endif
+	}
+
+	void Bind(int srcFormat, int dstFormat, FConvertPixels f) {
+		fn[RAD_IMAGECODEC_TYPE(srcFormat)][RAD_IMAGECODEC_TYPE(dstFormat)] = f;
+	}
+
+	void BindRef() {
+		for (size_t i = 0; i < (sizeof(kLookupSrcFormats)/sizeof(kLookupSrcFormats[0])); ++i) {
+			const int kSrc = kLookupSrcFormats[i];
+			for (size_t k = 0; k < (sizeof(kDstFormats)/sizeof(kDstFormats[0])); ++k) {
+				const int kDst = kDstFormats[k];
+				if (kSrc == kDst) {
+					Bind(kSrc, kDst, &Copy);
+				} else {
+					Bind(kSrc, kDst, SelectLookup(FormatBPP(kSrc), FormatBPP(kDst)));
+				}
+			}
+		}
+
+		for (size_t i = 0; i < (sizeof(kChannel8Formats)/sizeof(kChannel8Formats[0])); ++i) {
+			const int kSrc = kChannel8Formats[i];
+			const int kSrcBPP = FormatBPP(kSrc);
+
+			for (size_t k = 0; k < (sizeof(kChannel8Formats)/sizeof(kChannel8Formats[0])); ++k) {
+				const int kDst = kChannel8Formats[k];
+				if (kSrc == kDst) {
+					Bind(kSrc, kDst, &Copy);
+				} else {
+					Bind(kSrc, kDst, SelectShuffle8(kSrcBPP, FormatBPP(kDst), IsBGR(kSrc) != IsBGR(kDst)));
+				}
+			}
+
+			for (size_t k = 0; k < (sizeof(kPacked16Formats)/sizeof(kPacked16Formats[0])); ++k) {
+				const int kDst = kPacked16Formats[k];
+				Bind(kSrc, kDst, SelectPack16(kSrcBPP, IsBGR(kSrc) != IsBGR(kDst), PackForFormat(kDst)));
+			}
+
+			Bind(kSrc, Format_A8, (kSrcBPP == 4) ? &Alpha8<4> : &Alpha8<3>);
+		}
+	}
+
+#if defined(RAD_OPT_SSE2)
+	void BindSSE2() {
+		Bind(Format_RGBA8888, Format_BGRA8888, &SwapRB32_sse2);
+		Bind(Format_BGRA8888, Format_RGBA8888, &SwapRB32_sse2);
+
+		const int kSrcs[] = { Format_RGBA8888, Format_BGRA8888 };
+		for (size_t i = 0; i < (sizeof(kSrcs)/sizeof(kSrcs[0])); ++i) {
+			for (size_t k = 0; k < (sizeof(kPacked16Formats)/sizeof(kPacked16Formats[0])); ++k) {
+				const int kDst = kPacked16Formats[k];
+				const int kPack = PackForFormat(kDst);
+				Bind(
+					kSrcs[i],
+					kDst,
+					(IsBGR(kSrcs[i]) != IsBGR(kDst)) ? SelectPack16_sse2<true>(kPack) : SelectPack16_sse2<false>(kPack)
+				);
+			}
+		}
+	}
+#endif
+
+#if defined(RAD_OPT_NEON)
+	void BindNEON() {
+		for (size_t i = 0; i < (sizeof(kChannel8Formats)/sizeof(kChannel8Formats[0])); ++i) {
+			const int kSrc = kChannel8Formats[i];
+			for (size_t k = 0; k < (sizeof(kChannel8Formats)/sizeof(kChannel8Formats[0])); ++k) {
+				const int kDst = kChannel8Formats[k];
+				if (kSrc != kDst)
+					Bind(kSrc, kDst, SelectShuffle8_neon(FormatBPP(kSrc), FormatBPP(kDst), IsBGR(kSrc) != IsBGR(kDst)));
+			}
+		}
+	}
+#endif
+
+	FConvertPixels fn[kNumFormatTypes][kNumFormatTypes];
+};
+
+PixelConverters s_converters;
+
+} // namespace
+
+FConvertPixels FindPixelConverter(int srcFormat, int dstFormat) {
+	if ((RAD_IMAGECODEC_FAMILY(srcFormat) != SharedFamily) ||
+		(RAD_IMAGECODEC_FAMILY(dstFormat) != SharedFamily)) {
+		return 0;
+	}
+
+	const int kSrcType = RAD_IMAGECODEC_TYPE(srcFormat);
+	const int kDstType = RAD_IMAGECODEC_TYPE(dstFormat);
+
+	if (kSrcType >= kNumFormatTypes || kDstType >= kNumFormatTypes)
+		return 0;
+
+	return s_converters.fn[kSrcType][kDstType];
+}
+
+} // details
+
+} // image_codec
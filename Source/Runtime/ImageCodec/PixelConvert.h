@@ -0,0 +1,33 @@
+/*! \file PixelConvert.h
+	\copyright Copyright (c) 2013 Sunside Inc., All Rights Reserved.
+	\copyright See Radiance/LICENSE for licensing terms.
+	\author Joe Riedel
+	\ingroup runtime
+*/
+
+#pragma once
+
+#include "ImageCodec.h"
+#include "../PushPack.h"
+
+namespace image_codec {
+namespace details {
+
+//! Converts numPixels tightly packed pixels from srcFormat to dstFormat.
+/*! Results are identical to calling ConvertPixel() on each pixel. */
+typedef void (*FConvertPixels) (
+	const U8 *src,
+	U8 *dst,
+	const void *pal,
+	AddrSize numPixels,
+	int srcFormat,
+	int dstFormat
+);
+
+//! Returns the specialized bulk converter for a format pair, or NULL if ConvertPixel() must be used.
+FConvertPixels FindPixelConverter(int srcFormat, int dstFormat);
+
+} // details
+} // image_codec
+
+#include "../PopPack.h"
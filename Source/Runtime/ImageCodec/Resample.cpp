@@ -0,0 +1,675 @@
+/*! \file Resample.cpp
+	\copyright Copyright (c) 2013 Sunside Inc., All Rights Reserved.
+	\copyright See Radiance/LICENSE for licensing terms.
+	\author Joe Riedel
+	\ingroup runtime
+*/
+
+/* Separable polyphase resampler used by the texture cooker.
+
+   Pixels are expanded to 4 floats, filtered horizontally into a temporary
+   image then vertically into the destination. Each destination pixel (or row)
+   is a weighted sum of source pixels (or rows) which maps directly onto 4-wide
+   SIMD multiply-adds. No GL context is required so any number of cook threads
+   can run this concurrently.
+*/
+
+#include RADPCH
+#include "Resample.h"
+#include "../Base/SIMD.h"
+#include "../Container/ZoneVector.h"
+#include "../Thread.h"
+#include "../StringBase.h"
+#include <algorithm>
+#include <math.h>
+
+#if defined(RAD_OPT_SSE2)
+#include <emmintrin.h>
+#elif defined(RAD_OPT_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace image_codec {
+namespace resample {
+
+namespace {
+
+enum {
+	kFloatsPerPixel = 4,
+	kLinearTableSize = 4096,
+	kMaxThreads = 16,
+	kMinRowsPerBand = 32,
+	kMinThreadedPixels = 256*256
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+struct GammaTables {
+	GammaTables() {
+		for (int i = 0; i < 256; ++i) {
+			float c = i / 255.f;
+			toLinear[i] = (c <= 0.04045f) ? (c / 12.92f) : (float)pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+
+		for (int i = 0; i < kLinearTableSize; ++i) {
+			float c = i / (float)(kLinearTableSize-1);
+			c = (c <= 0.0031308f) ? (c * 12.92f) : (1.055f * (float)pow(c, 1.f/2.4f) - 0.055f);
+			toSRGB[i] = (U8)std::min(255, std::max(0, (int)(c * 255.f + 0.5f)));
+		}
+	}
+
+	float toLinear[256];
+	U8 toSRGB[kLinearTableSize];
+};
+
+GammaTables s_gamma;
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline float Sinc(float x) {
+	if (fabs(x) < 1e-4f)
+		return 1.f;
+	x *= 3.1415926535897932384626433832795f;
+	return (float)sin(x) / x;
+}
+
+inline float Bessel0(float x) {
+	const float kEpsilon = 1e-6f;
+	float xh = x * 0.5f;
+	float sum = 1.f;
+	float pow = 1.f;
+	float ds = 1.f;
+	float k = 0.f;
+
+	while (ds > sum * kEpsilon) {
+		k += 1.f;
+		pow *= xh / k;
+		ds = pow * pow;
+		sum += ds;
+	}
+
+	return sum;
+}
+
+float EvalBox(float x) {
+	return (x >= -0.5f && x < 0.5f) ? 1.f : 0.f;
+}
+
+// Same parameters the DXT path hands to nvtt (width 3, alpha 4, stretch 1).
+const float kKaiserWidth = 3.f;
+const float kKaiserAlpha = 4.f;
+// Computed during static initialization, before any cook thread can run a filter.
+const float kKaiserInvBesselAlpha = 1.f / Bessel0(kKaiserAlpha);
+
+float EvalKaiser(float x) {
+	float t = x / kKaiserWidth;
+	float t2 = 1.f - t*t;
+	if (t2 <= 0.f)
+		return 0.f;
+	return Sinc(x) * Bessel0(kKaiserAlpha * (float)sqrt(t2)) * kKaiserInvBesselAlpha;
+}
+
+float EvalLanczos(float x) {
+	if (fabs(x) >= 3.f)
+		return 0.f;
+	return Sinc(x) * Sinc(x / 3.f);
+}
+
+struct FilterDesc {
+	float support;
+	float (*eval) (float);
+};
+
+const FilterDesc &DescForFilter(Filter filter) {
+	static const FilterDesc kFilters[] = {
+		{ 0.5f, &EvalBox },
+		{ 3.f, &EvalKaiser },
+		{ 3.f, &EvalLanczos }
+	};
+	RAD_ASSERT(filter >= kFilter_Box && filter <= kFilter_Lanczos);
+	return kFilters[filter];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+//! Per destination pixel list of source taps along one axis.
+class WeightTable {
+public:
+
+	struct Span {
+		int first;
+		int count;
+	};
+
+	typedef zone_vector<Span, ZImageCodecT>::type SpanVec;
+	typedef zone_vector<int, ZImageCodecT>::type IntVec;
+	typedef zone_vector<float, ZImageCodecT>::type FloatVec;
+
+	void Build(int srcSize, int dstSize, Filter filter) {
+		const FilterDesc &desc = DescForFilter(filter);
+		const float kScale = srcSize / (float)dstSize;
+		const float kFilterScale = std::max(kScale, 1.f); // widen filter when minifying.
+		const float kSupport = desc.support * kFilterScale;
+
+		spans.resize(dstSize);
+		indices.clear();
+		weights.clear();
+		indices.reserve(dstSize * ((int)ceil(kSupport*2.f) + 2));
+		weights.reserve(indices.capacity());
+
+		for (int i = 0; i < dstSize; ++i) {
+			const float kCenter = (i + 0.5f) * kScale;
+			const int kFirst = (int)floor(kCenter - kSupport);
+			const int kLast = (int)ceil(kCenter + kSupport);
+
+			Span &span = spans[i];
+			span.first = (int)indices.size();
+
+			float sum = 0.f;
+			for (int j = kFirst; j <= kLast; ++j) {
+				float w = desc.eval((j + 0.5f - kCenter) / kFilterScale);
+				if (w == 0.f)
+					continue;
+				indices.push_back(std::min(std::max(j, 0), srcSize-1));
+				weights.push_back(w);
+				sum += w;
+			}
+
+			span.count = (int)indices.size() - span.first;
+
+			if ((span.count < 1) || (fabs(sum) < 1e-6f)) {
+				indices.resize(span.first);
+				weights.resize(span.first);
+				indices.push_back(std::min(std::max((int)kCenter, 0), srcSize-1));
+				weights.push_back(1.f);
+				span.count = 1;
+			} else {
+				const float kInvSum = 1.f / sum;
+				for (int j = 0; j < span.count; ++j)
+					weights[span.first+j] *= kInvSum;
+			}
+		}
+	}
+
+	SpanVec spans;
+	IntVec indices;
+	FloatVec weights;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+//! 4 floats per pixel, 16 byte aligned.
+class FloatImage {
+public:
+	FloatImage() : data(0), width(0), height(0) {
+	}
+
+	~FloatImage() {
+		Free();
+	}
+
+	void Allocate(int w, int h) {
+		Free();
+		width = w;
+		height = h;
+		data = (float*)safe_zone_malloc(
+			ZImageCodec,
+			sizeof(float)*kFloatsPerPixel*w*h,
+			0,
+			SIMDDriver::kAlignment
+		);
+	}
+
+	void Free() {
+		if (data)
+			zone_free(data);
+		data = 0;
+	}
+
+	void Swap(FloatImage &img) {
+		std::swap(data, img.data);
+		std::swap(width, img.width);
+		std::swap(height, img.height);
+	}
+
+	float *Row(int y) const {
+		return data + (y*width*kFloatsPerPixel);
+	}
+
+	float *data;
+	int width;
+	int height;
+
+private:
+
+	FloatImage(const FloatImage&);
+	FloatImage &operator = (const FloatImage&);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Pixel layouts the float conversion understands natively, everything else
+// goes through ConvertPixel to/from RGBA8888.
+enum Layout {
+	kLayout_A8,
+	kLayout_RGB8,
+	kLayout_RGBA8,
+	kLayout_Packed
+};
+
+Layout LayoutForFormat(int format) {
+	switch (format) {
+	case Format_A8:
+		return kLayout_A8;
+	case Format_RGB888:
+	case Format_BGR888:
+		return kLayout_RGB8;
+	case Format_RGBA8888:
+	case Format_BGRA8888:
+		return kLayout_RGBA8;
+	}
+	return kLayout_Packed;
+}
+
+inline float UnpackColor(U8 c, bool gamma) {
+	return gamma ? s_gamma.toLinear[c] : (c * (1.f/255.f));
+}
+
+inline U8 PackColor(float f, bool gamma) {
+	f = std::min(std::max(f, 0.f), 1.f);
+	if (gamma)
+		return s_gamma.toSRGB[(int)(f * (kLinearTableSize-1) + 0.5f)];
+	return (U8)(f * 255.f + 0.5f);
+}
+
+inline float UnpackAlpha(U8 c) {
+	return c * (1.f/255.f);
+}
+
+inline U8 PackAlpha(float f) {
+	f = std::min(std::max(f, 0.f), 1.f);
+	return (U8)(f * 255.f + 0.5f);
+}
+
+void Unpack(const Mipmap &src, int format, int flags, FloatImage &dst) {
+	const bool kGamma = (flags&kFlag_Gamma) ? true : false;
+	const Layout kLayout = LayoutForFormat(format);
+	const int kBPP = FormatBPP(format);
+
+	dst.Allocate(src.width, src.height);
+
+	for (int y = 0; y < src.height; ++y) {
+		const U8 *s = reinterpret_cast<const U8*>(src.data) + y*src.stride;
+		float *d = dst.Row(y);
+
+		for (int x = 0; x < src.width; ++x, s += kBPP, d += kFloatsPerPixel) {
+			switch (kLayout) {
+			case kLayout_A8:
+				d[0] = UnpackAlpha(s[0]);
+				d[1] = d[2] = d[3] = 0.f;
+				break;
+			case kLayout_RGB8:
+				d[0] = UnpackColor(s[0], kGamma);
+				d[1] = UnpackColor(s[1], kGamma);
+				d[2] = UnpackColor(s[2], kGamma);
+				d[3] = 1.f;
+				break;
+			case kLayout_RGBA8:
+				d[0] = UnpackColor(s[0], kGamma);
+				d[1] = UnpackColor(s[1], kGamma);
+				d[2] = UnpackColor(s[2], kGamma);
+				d[3] = UnpackAlpha(s[3]);
+				break;
+			case kLayout_Packed: {
+				U8 rgba[4];
+				ConvertPixel(s, rgba, 0, format, Format_RGBA8888);
+				d[0] = UnpackColor(rgba[0], kGamma);
+				d[1] = UnpackColor(rgba[1], kGamma);
+				d[2] = UnpackColor(rgba[2], kGamma);
+				d[3] = UnpackAlpha(rgba[3]);
+			} break;
+			}
+		}
+	}
+}
+
+void Pack(const FloatImage &src, int format, int flags, Mipmap &dst) {
+	const bool kGamma = (flags&kFlag_Gamma) ? true : false;
+	const Layout kLayout = LayoutForFormat(format);
+	const int kBPP = FormatBPP(format);
+
+	RAD_ASSERT(src.width == dst.width);
+	RAD_ASSERT(src.height == dst.height);
+
+	for (int y = 0; y < dst.height; ++y) {
+		const float *s = src.Row(y);
+		U8 *d = reinterpret_cast<U8*>(dst.data) + y*dst.stride;
+
+		for (int x = 0; x < dst.width; ++x, s += kFloatsPerPixel, d += kBPP) {
+			switch (kLayout) {
+			case kLayout_A8:
+				d[0] = PackAlpha(s[0]);
+				break;
+			case kLayout_RGB8:
+				d[0] = PackColor(s[0], kGamma);
+				d[1] = PackColor(s[1], kGamma);
+				d[2] = PackColor(s[2], kGamma);
+				break;
+			case kLayout_RGBA8:
+				d[0] = PackColor(s[0], kGamma);
+				d[1] = PackColor(s[1], kGamma);
+				d[2] = PackColor(s[2], kGamma);
+				d[3] = PackAlpha(s[3]);
+				break;
+			case kLayout_Packed: {
+				U8 rgba[4];
+				rgba[0] = PackColor(s[0], kGamma);
+				rgba[1] = PackColor(s[1], kGamma);
+				rgba[2] = PackColor(s[2], kGamma);
+				rgba[3] = PackAlpha(s[3]);
+				ConvertPixel(rgba, d, 0, Format_RGBA8888, format);
+			} break;
+			}
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Kernels
+///////////////////////////////////////////////////////////////////////////////
+
+//! Filters one row horizontally: each output pixel is a weighted sum of input pixels.
+void FilterRow(
+	float *dst,
+	const float *src,
+	const WeightTable &table,
+	int dstWidth
+) {
+	const WeightTable::Span *span = &table.spans[0];
+	const int *indices = &table.indices[0];
+	const float *weights = &table.weights[0];
+
+	for (int x = 0; x < dstWidth; ++x, ++span, dst += kFloatsPerPixel) {
+		const int *idx = indices + span->first;
+		const float *w = weights + span->first;
+#if defined(RAD_OPT_SSE2)
+		__m128 acc = _mm_setzero_ps();
+		for (int k = 0; k < span->count; ++k) {
+			__m128 p = _mm_load_ps(src + idx[k]*kFloatsPerPixel);
+			acc = _mm_add_ps(acc, _mm_mul_ps(p, _mm_set1_ps(w[k])));
+		}
+		_mm_store_ps(dst, acc);
+#elif defined(RAD_OPT_NEON)
+		float32x4_t acc = vdupq_n_f32(0.f);
+		for (int k = 0; k < span->count; ++k) {
+			float32x4_t p = vld1q_f32(src + idx[k]*kFloatsPerPixel);
+			acc = vmlaq_n_f32(acc, p, w[k]);
+		}
+		vst1q_f32(dst, acc);
+#else
+		float acc[4] = {0.f, 0.f, 0.f, 0.f};
+		for (int k = 0; k < span->count; ++k) {
+			const float *p = src + idx[k]*kFloatsPerPixel;
+			acc[0] += p[0] * w[k];
+			acc[1] += p[1] * w[k];
+			acc[2] += p[2] * w[k];
+			acc[3] += p[3] * w[k];
+		}
+		dst[0] = acc[0];
+		dst[1] = acc[1];
+		dst[2] = acc[2];
+		dst[3] = acc[3];
+#endif
+	}
+}
+
+//! dst = src * w (numFloats must be a multiple of 4)
+void ScaleRow(float *dst, const float *src, float w, int numFloats) {
+#if defined(RAD_OPT_SSE2)
+	const __m128 kW = _mm_set1_ps(w);
+	for (int i = 0; i < numFloats; i += 4)
+		_mm_store_ps(dst+i, _mm_mul_ps(_mm_load_ps(src+i), kW));
+#elif defined(RAD_OPT_NEON)
+	for (int i = 0; i < numFloats; i += 4)
+		vst1q_f32(dst+i, vmulq_n_f32(vld1q_f32(src+i), w));
+#else
+	for (int i = 0; i < numFloats; ++i)
+		dst[i] = src[i] * w;
+#endif
+}
+
+//! dst += src * w (numFloats must be a multiple of 4)
+void MulAddRow(float *dst, const float *src, float w, int numFloats) {
+#if defined(RAD_OPT_SSE2)
+	const __m128 kW = _mm_set1_ps(w);
+	for (int i = 0; i < numFloats; i += 4)
+		_mm_store_ps(dst+i, _mm_add_ps(_mm_load_ps(dst+i), _mm_mul_ps(_mm_load_ps(src+i), kW)));
+#elif defined(RAD_OPT_NEON)
+	for (int i = 0; i < numFloats; i += 4)
+		vst1q_f32(dst+i, vmlaq_n_f32(vld1q_f32(dst+i), vld1q_f32(src+i), w));
+#else
+	for (int i = 0; i < numFloats; ++i)
+		dst[i] += src[i] * w;
+#endif
+}
+
+//! Clamps to [0, 1] so ringing from negative lobes doesn't accumulate down the mip chain.
+void SaturateRow(float *dst, int numFloats) {
+#if defined(RAD_OPT_SSE2)
+	const __m128 kZero = _mm_setzero_ps();
+	const __m128 kOne = _mm_set1_ps(1.f);
+	for (int i = 0; i < numFloats; i += 4)
+		_mm_store_ps(dst+i, _mm_min_ps(_mm_max_ps(_mm_load_ps(dst+i), kZero), kOne));
+#elif defined(RAD_OPT_NEON)
+	const float32x4_t kZero = vdupq_n_f32(0.f);
+	const float32x4_t kOne = vdupq_n_f32(1.f);
+	for (int i = 0; i < numFloats; i += 4)
+		vst1q_f32(dst+i, vminq_f32(vmaxq_f32(vld1q_f32(dst+i), kZero), kOne));
+#else
+	for (int i = 0; i < numFloats; ++i)
+		dst[i] = std::min(std::max(dst[i], 0.f), 1.f);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Threading
+///////////////////////////////////////////////////////////////////////////////
+
+class RowJob {
+public:
+	virtual ~RowJob() {}
+	virtual void Run(int firstRow, int lastRow) = 0;
+};
+
+class BandThread : public thread::Thread {
+public:
+
+	BandThread() : m_job(0), m_first(0), m_last(0) {
+	}
+
+	void Start(RowJob &job, int first, int last) {
+		m_job = &job;
+		m_first = first;
+		m_last = last;
+		Run();
+	}
+
+protected:
+
+	virtual int ThreadProc() {
+		m_job->Run(m_first, m_last);
+		return 0;
+	}
+
+private:
+
+	RowJob *m_job;
+	int m_first;
+	int m_last;
+};
+
+int NumThreadsForImage(int numThreads, int width, int height) {
+	if (numThreads == 0)
+		numThreads = (int)thread::NumContexts();
+	if ((width*height) < kMinThreadedPixels)
+		return 1;
+	return std::max(1, std::min(std::min(numThreads, (int)kMaxThreads), height / kMinRowsPerBand));
+}
+
+void RunRows(RowJob &job, int numRows, int numThreads) {
+	if (numThreads < 2) {
+		job.Run(0, numRows);
+		return;
+	}
+
+	const int kRowsPerBand = (numRows + numThreads - 1) / numThreads;
+	BandThread threads[kMaxThreads];
+
+	int numStarted = 0;
+	for (int i = 1; i < numThreads; ++i) {
+		int first = i*kRowsPerBand;
+		if (first >= numRows)
+			break;
+		threads[numStarted++].Start(job, first, std::min(numRows, first+kRowsPerBand));
+	}
+
+	job.Run(0, std::min(numRows, kRowsPerBand));
+
+	for (int i = 0; i < numStarted; ++i)
+		threads[i].Join();
+}
+
+class HorizontalJob : public RowJob {
+public:
+	HorizontalJob(const FloatImage &src, FloatImage &dst, const WeightTable &table)
+		: m_src(src), m_dst(dst), m_table(table) {
+	}
+
+	virtual void Run(int firstRow, int lastRow) {
+		for (int y = firstRow; y < lastRow; ++y)
+			FilterRow(m_dst.Row(y), m_src.Row(y), m_table, m_dst.width);
+	}
+
+private:
+	const FloatImage &m_src;
+	FloatImage &m_dst;
+	const WeightTable &m_table;
+};
+
+class VerticalJob : public RowJob {
+public:
+	VerticalJob(const FloatImage &src, FloatImage &dst, const WeightTable &table)
+		: m_src(src), m_dst(dst), m_table(table) {
+	}
+
+	virtual void Run(int firstRow, int lastRow) {
+		const int kNumFloats = m_dst.width*kFloatsPerPixel;
+
+		for (int y = firstRow; y < lastRow; ++y) {
+			const WeightTable::Span &span = m_table.spans[y];
+			const int *idx = &m_table.indices[span.first];
+			const float *w = &m_table.weights[span.first];
+			float *row = m_dst.Row(y);
+
+			ScaleRow(row, m_src.Row(idx[0]), w[0], kNumFloats);
+			for (int k = 1; k < span.count; ++k)
+				MulAddRow(row, m_src.Row(idx[k]), w[k], kNumFloats);
+			SaturateRow(row, kNumFloats);
+		}
+	}
+
+private:
+	const FloatImage &m_src;
+	FloatImage &m_dst;
+	const WeightTable &m_table;
+};
+
+void ResampleFloat(
+	const FloatImage &src,
+	FloatImage &dst,
+	int dstWidth,
+	int dstHeight,
+	Filter filter,
+	int numThreads
+) {
+	WeightTable horz, vert;
+	horz.Build(src.width, dstWidth, filter);
+	vert.Build(src.height, dstHeight, filter);
+
+	FloatImage temp;
+	temp.Allocate(dstWidth, src.height);
+
+	HorizontalJob hjob(src, temp, horz);
+	RunRows(hjob, src.height, NumThreadsForImage(numThreads, src.width, src.height));
+
+	dst.Allocate(dstWidth, dstHeight);
+
+	VerticalJob vjob(temp, dst, vert);
+	RunRows(vjob, dstHeight, NumThreadsForImage(numThreads, dstWidth, dstHeight));
+}
+
+bool ValidFormat(int format) {
+	return (RAD_IMAGECODEC_FAMILY(format) == SharedFamily) &&
+		!IsPalettedFormat(format) &&
+		(FormatBPP(format) > 0);
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+RADRT_API Filter RADRT_CALL FilterForName(const char *name) {
+	if (name) {
+		if (!string::icmp(name, "Box"))
+			return kFilter_Box;
+		if (!string::icmp(name, "Lanczos"))
+			return kFilter_Lanczos;
+	}
+	return kFilter_Kaiser;
+}
+
+RADRT_API bool RADRT_CALL Resize(
+	const Mipmap &src,
+	Mipmap &dst,
+	int format,
+	Filter filter,
+	int flags,
+	int numThreads
+) {
+	RAD_ASSERT(src.data && dst.data);
+	if (!ValidFormat(format) || src.width < 1 || src.height < 1 || dst.width < 1 || dst.height < 1)
+		return false;
+
+	FloatImage in, out;
+	Unpack(src, format, flags, in);
+	ResampleFloat(in, out, dst.width, dst.height, filter, numThreads);
+	Pack(out, format, flags, dst);
+	return true;
+}
+
+RADRT_API bool RADRT_CALL GenerateMipmaps(
+	Frame &frame,
+	int format,
+	Filter filter,
+	int flags,
+	int numThreads
+) {
+	if (!ValidFormat(format) || frame.mipCount < 1)
+		return false;
+
+	FloatImage level, next;
+	Unpack(frame.mipmaps[0], format, flags, level);
+
+	for (int i = 1; i < frame.mipCount; ++i) {
+		Mipmap &mip = frame.mipmaps[i];
+		RAD_ASSERT(mip.data);
+		ResampleFloat(level, next, mip.width, mip.height, filter, numThreads);
+		Pack(next, format, flags, mip);
+		level.Swap(next);
+	}
+
+	return true;
+}
+
+} // resample
+} // image_codec
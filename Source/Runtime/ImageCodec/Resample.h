@@ -0,0 +1,59 @@
+/*! \file Resample.h
+	\copyright Copyright (c) 2013 Sunside Inc., All Rights Reserved.
+	\copyright See Radiance/LICENSE for licensing terms.
+	\author Joe Riedel
+	\ingroup runtime
+*/
+
+#pragma once
+
+#include "ImageCodec.h"
+#include "../PushPack.h"
+
+namespace image_codec {
+namespace resample {
+
+//! Reconstruction filters used when resizing or building mipmaps.
+enum Filter {
+	kFilter_Box,
+	kFilter_Kaiser,
+	kFilter_Lanczos
+};
+
+enum {
+	RAD_FLAG(kFlag_Gamma) //!< Color channels are sRGB encoded and are averaged in linear space.
+};
+
+//! Returns the filter matching a texture key value ("Box", "Kaiser", "Lanczos").
+/*! Unrecognized names return kFilter_Kaiser. */
+RADRT_API Filter RADRT_CALL FilterForName(const char *name);
+
+//! Resamples src into dst.
+/*! dst must be allocated by the caller, its width, height and stride define the output.
+	Any non-paletted shared format is supported. Work is split into row bands across
+	numThreads threads (0 uses thread::NumContexts()), small images are always done
+	on the calling thread. */
+RADRT_API bool RADRT_CALL Resize(
+	const Mipmap &src,
+	Mipmap &dst,
+	int format,
+	Filter filter,
+	int flags,
+	int numThreads = 1
+);
+
+//! Fills in mipmaps 1 through mipCount-1 of a frame from mipmap 0.
+/*! All mipmaps must already be allocated. Each level is filtered from the previous
+	level, which is kept in floating point to avoid quantizing the chain. */
+RADRT_API bool RADRT_CALL GenerateMipmaps(
+	Frame &frame,
+	int format,
+	Filter filter,
+	int flags,
+	int numThreads = 1
+);
+
+} // resample
+} // image_codec
+
+#include "../PopPack.h"
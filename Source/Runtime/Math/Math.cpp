@@ -44,6 +44,16 @@ float FastFloatRand(float min, float max){
 	return min + FastFloatRand()*(max-min);
 }
 
+float FastFloatRand(int &index) {
+	int x = index&(kNumRandFloats-1);
+	index = (x+1)&(kNumRandFloats-1);
+	return kRandFloats[x];
+}
+
+float FastFloatRand(int &index, float min, float max) {
+	return min + FastFloatRand(index)*(max-min);
+}
+
 float FastSin(const float &angle) {
 	int low, high;
 	float frac;
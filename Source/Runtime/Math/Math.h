@@ -143,6 +143,10 @@ T Mid(const T &a, const T &b);
 // Float Rand
 float FastFloatRand(float min, float max);
 float FastFloatRand(); // [0, 1]
+// Same sequence, walked with a caller owned index instead of the shared one
+// so separate generators can be used from different threads.
+float FastFloatRand(int &index, float min, float max);
+float FastFloatRand(int &index); // [0, 1]
 
 // (a>0) ? 1 : (a<0) ? -1 : 0
 
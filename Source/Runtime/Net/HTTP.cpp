@@ -7,128 +7,871 @@
 
 #include RADPCH
 #include "HTTP.h"
+#include "../Time.h"
+#include <algorithm>
 #if !defined(RAD_OPT_WINX)
 #include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <netinet/tcp.h>
 #endif
 
 namespace net {
 
-HTTPResponse::HTTPResponse(Zone &zone)
-: m_zone(&zone), m_body(0), m_size(0), m_responseCode(-1) {
+namespace {
+
+#if defined(RAD_OPT_WINX)
+
+typedef WSAPOLLFD PollFd;
+
+inline int Poll(PollFd *fds, int num, int timeout) {
+	return WSAPoll(fds, (ULONG)num, timeout);
 }
 
-HTTPResponse::~HTTPResponse() {
-	if (m_body)
-		zone_free(m_body);
+inline bool WouldBlock() {
+	const int kErr = WSAGetLastError();
+	return (kErr == WSAEWOULDBLOCK) || (kErr == WSAEINPROGRESS);
+}
+
+inline void SetNonBlocking(int sd) {
+	u_long argp = 1;
+	ioctlsocket(sd, FIONBIO, &argp);
 }
 
-int HTTPResponse::ReadLine(Socket &sd, String &line) {
-	line.Clear();
+#else
 
-	int n = 0;
-	char c;
+typedef pollfd PollFd;
 
-	do {
-		int r = recv(sd, &c, 1, 0);
-		if (r == 0)
-			return n; // no more data.
-		if (r < 0)
-			return r;
+inline int Poll(PollFd *fds, int num, int timeout) {
+	return poll(fds, (nfds_t)num, timeout);
+}
 
-		++n;
-		line += c;
-	} while (c != '\n');
+inline bool WouldBlock() {
+	return (errno == EWOULDBLOCK) || (errno == EAGAIN) || (errno == EINPROGRESS) || (errno == EINTR);
+}
 
-	return n;
+inline void SetNonBlocking(int sd) {
+	fcntl(sd, F_SETFL, fcntl(sd, F_GETFL, 0) | O_NONBLOCK);
 }
 
-HTTP_OpStatus HTTPResponse::Read(Socket &sd) {
-	
-	if (m_body)
+#endif
+
+#if defined(MSG_NOSIGNAL)
+const int kSendFlags = MSG_NOSIGNAL;
+#else
+const int kSendFlags = 0;
+#endif
+
+void SetStreamOptions(int sd) {
+	int opt = 1;
+	// requests are small and sent in one piece, don't let them sit in the Nagle buffer.
+	setsockopt(sd, IPPROTO_TCP, TCP_NODELAY, (const char*)&opt, sizeof(opt));
+#if defined(SO_NOSIGPIPE)
+	setsockopt(sd, SOL_SOCKET, SO_NOSIGPIPE, (const char*)&opt, sizeof(opt));
+#endif
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+class HTTPResponse::Parser {
+public:
+
+	enum Result {
+		kMore,
+		kDone,
+		kError
+	};
+
+	explicit Parser(HTTPResponse &response);
+
+	//! Parses data, used is set to the number of bytes that belong to this response.
+	Result Feed(const char *data, AddrSize size, AddrSize &used);
+	//! The connection was closed.
+	Result Finish();
+
+	HTTP_OpStatus status;
+	bool keepAlive;
+
+private:
+
+	enum State {
+		kState_Status,
+		kState_Header,
+		kState_Body,
+		kState_ChunkSize,
+		kState_ChunkData,
+		kState_ChunkEnd,
+		kState_Trailer,
+		kState_UntilClose,
+		kState_Done
+	};
+
+	enum {
+		kMaxLine = 8*kKilo
+	};
+
+	Result Line();
+	Result Header(const char *name, int nameLen, const char *value);
+	Result EndOfHeader();
+	Result Body(const char *data, AddrSize size);
+
+	Result Error(HTTP_OpStatus error) {
+		status = error;
+		m_state = kState_Done;
+		return kError;
+	}
+
+	HTTPResponse &m_r;
+	AddrSize m_length;
+	State m_state;
+	int m_lineLen;
+	bool m_http10;
+	bool m_chunked;
+	bool m_gotLength;
+	bool m_close;
+	bool m_keepAlive;
+	char m_line[kMaxLine];
+};
+
+HTTPResponse::Parser::Parser(HTTPResponse &response) :
+status(kHTTP_OpStatus_Success),
+keepAlive(false),
+m_r(response),
+m_length(0),
+m_state(kState_Status),
+m_lineLen(0),
+m_http10(false),
+m_chunked(false),
+m_gotLength(false),
+m_close(false),
+m_keepAlive(false) {
+}
+
+HTTPResponse::Parser::Result HTTPResponse::Parser::Feed(const char *data, AddrSize size, AddrSize &used) {
+	used = 0;
+
+	while (used < size) {
+		switch (m_state) {
+		case kState_Body:
+		case kState_ChunkData: {
+			const AddrSize kNum = std::min(size-used, m_length);
+			if (Body(data+used, kNum) == kError)
+				return kError;
+			used += kNum;
+			m_length -= kNum;
+			if (m_length == 0) {
+				if (m_state == kState_Body) {
+					m_state = kState_Done;
+					return kDone;
+				}
+				m_state = kState_ChunkEnd;
+			}
+		} break;
+		case kState_UntilClose:
+			if (Body(data+used, size-used) == kError)
+				return kError;
+			used = size;
+			break;
+		case kState_Done:
+			return kDone;
+		default: {
+			const char *nl = (const char*)memchr(data+used, '\n', size-used);
+			const AddrSize kNum = nl ? (AddrSize)(nl-(data+used)+1) : (size-used);
+			if (m_lineLen + kNum >= kMaxLine)
+				return Error(kHTTP_OpStatus_ResponseError);
+
+			memcpy(m_line+m_lineLen, data+used, kNum);
+			m_lineLen += (int)kNum;
+			used += kNum;
+
+			if (nl) {
+				m_line[m_lineLen] = 0;
+				Result r = Line();
+				m_lineLen = 0;
+				if (r != kMore)
+					return r;
+			}
+		} break;
+		}
+	}
+
+	return (m_state == kState_Done) ? kDone : kMore;
+}
+
+HTTPResponse::Parser::Result HTTPResponse::Parser::Finish() {
+	if (m_state == kState_UntilClose)
+		m_state = kState_Done;
+	keepAlive = false;
+	if (m_state != kState_Done)
+		return Error(kHTTP_OpStatus_SocketError); // truncated.
+	return (status == kHTTP_OpStatus_Success) ? kDone : kError;
+}
+
+HTTPResponse::Parser::Result HTTPResponse::Parser::Line() {
+	int len = m_lineLen;
+	while ((len > 0) && ((m_line[len-1] == '\n') || (m_line[len-1] == '\r')))
+		--len;
+	m_line[len] = 0;
+
+	switch (m_state) {
+	case kState_Status:
+		m_r.m_header += m_line;
+		m_r.m_header += "\r\n";
+		if (strncmp(m_line, "HTTP/1.", 7))
+			return Error(kHTTP_OpStatus_ResponseError);
+		m_http10 = m_line[7] == '0';
+		if (sscanf(m_line, "HTTP/1.%*d %d", &m_r.m_responseCode) != 1)
+			return Error(kHTTP_OpStatus_ResponseError);
+		m_state = kState_Header;
+		break;
+	case kState_Header: {
+		m_r.m_header += m_line;
+		m_r.m_header += "\r\n";
+		if (len == 0)
+			return EndOfHeader();
+
+		const char *colon = strchr(m_line, ':');
+		if (!colon)
+			break; // ignore malformed fields.
+
+		const char *value = colon + 1;
+		while ((*value == ' ') || (*value == '\t'))
+			++value;
+
+		return Header(m_line, (int)(colon-m_line), value);
+	}
+	case kState_ChunkSize: {
+		char *end;
+		m_length = (AddrSize)strtoul(m_line, &end, 16);
+		if (end == m_line)
+			return Error(kHTTP_OpStatus_ResponseError);
+		m_state = (m_length > 0) ? kState_ChunkData : kState_Trailer;
+	} break;
+	case kState_ChunkEnd:
+		if (len != 0)
+			return Error(kHTTP_OpStatus_ResponseError);
+		m_state = kState_ChunkSize;
+		break;
+	case kState_Trailer:
+		if (len == 0) {
+			m_state = kState_Done;
+			return kDone;
+		}
+		break;
+	default:
+		RAD_FAIL("invalid parser state");
+		break;
+	}
+
+	return kMore;
+}
+
+HTTPResponse::Parser::Result HTTPResponse::Parser::Header(const char *name, int nameLen, const char *value) {
+	if ((nameLen == 12) && !string::nicmp(name, "Content-Type", 12)) {
+		// only the media type, like the original sscanf("%s").
+		int len = 0;
+		while (value[len] && (value[len] != ' ') && (value[len] != '\t'))
+			++len;
+		m_r.m_contentType = String(value, len, string::CopyTag);
+	} else if ((nameLen == 14) && !string::nicmp(name, "Content-Length", 14)) {
+		char *end;
+		m_length = (AddrSize)strtoul(value, &end, 10);
+		if (end == value)
+			return Error(kHTTP_OpStatus_ResponseError);
+		m_gotLength = true;
+	} else if ((nameLen == 17) && !string::nicmp(name, "Transfer-Encoding", 17)) {
+		for (const char *z = value; *z; ++z) {
+			if (!string::nicmp(z, "chunked", 7)) {
+				m_chunked = true;
+				break;
+			}
+		}
+	} else if ((nameLen == 10) && !string::nicmp(name, "Connection", 10)) {
+		if (!string::nicmp(value, "close", 5)) {
+			m_close = true;
+		} else if (!string::nicmp(value, "keep-alive", 10)) {
+			m_keepAlive = true;
+		}
+	}
+
+	return kMore;
+}
+
+HTTPResponse::Parser::Result HTTPResponse::Parser::EndOfHeader() {
+	if (m_r.m_responseCode == -1)
+		return Error(kHTTP_OpStatus_ResponseError);
+
+	if ((m_r.m_responseCode >= 100) && (m_r.m_responseCode < 200)) {
+		// informational, the real response follows.
+		m_r.m_header.Clear();
+		m_r.m_contentType.Clear();
+		m_r.m_responseCode = -1;
+		m_chunked = m_gotLength = m_close = m_keepAlive = false;
+		m_state = kState_Status;
+		return kMore;
+	}
+
+	keepAlive = m_http10 ? m_keepAlive : !m_close;
+
+	const bool kNoBody = (m_r.m_responseCode == 204) ||
+		(m_r.m_responseCode == 304) ||
+		(!m_chunked && m_gotLength && (m_length == 0));
+
+	if (kNoBody) {
+		m_state = kState_Done;
+		return kDone;
+	}
+
+	if (m_r.m_contentType.empty)
+		return Error(kHTTP_OpStatus_ResponseError);
+
+	if (m_chunked) {
+		m_state = kState_ChunkSize;
+	} else if (m_gotLength) {
+		m_state = kState_Body;
+		if (m_r.Reserve(m_length) != kHTTP_OpStatus_Success)
+			return Error(kHTTP_OpStatus_BufferError);
+	} else {
+		m_state = kState_UntilClose;
+		keepAlive = false;
+	}
+
+	return kMore;
+}
+
+HTTPResponse::Parser::Result HTTPResponse::Parser::Body(const char *data, AddrSize size) {
+	const HTTP_OpStatus kStatus = m_r.Append(data, size);
+	if (kStatus != kHTTP_OpStatus_Success)
+		return Error(kStatus);
+	return kMore;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+HTTPResponse::HTTPResponse(Zone &zone)
+: m_zone(&zone), m_body(0), m_size(0), m_capacity(0), m_responseCode(-1), m_ownsBody(true) {
+}
+
+HTTPResponse::~HTTPResponse() {
+	if (m_ownsBody && m_body)
+		zone_free(m_body);
+}
+
+void HTTPResponse::Reset(void *data, AddrSize size) {
+	if (m_ownsBody && m_body)
 		zone_free(m_body);
 
 	m_header.Clear();
-	m_size = 0;
 	m_contentType.Clear();
 	m_responseCode = -1;
+	m_size = 0;
+	m_body = data;
+	m_capacity = data ? size : 0;
+	m_ownsBody = data == 0;
+}
+
+HTTP_OpStatus HTTPResponse::Reserve(AddrSize size) {
+	if (size <= m_capacity)
+		return kHTTP_OpStatus_Success;
+	if (!m_ownsBody)
+		return kHTTP_OpStatus_BufferError;
 
-	String line;
-	bool eoh = false;
-	bool first = true;
-	bool gotSize = false;
+	m_body = safe_zone_realloc(*m_zone, m_body, size);
+	m_capacity = size;
+	return kHTTP_OpStatus_Success;
+}
+
+HTTP_OpStatus HTTPResponse::Append(const void *data, AddrSize size) {
+	const AddrSize kSize = m_size + size;
+
+	if (kSize > m_capacity) {
+		// chunked and close delimited bodies grow geometrically.
+		HTTP_OpStatus r = Reserve(std::max(kSize, std::max(m_capacity*2, (AddrSize)(4*kKilo))));
+		if (r != kHTTP_OpStatus_Success)
+			return r;
+	}
+
+	memcpy(((U8*)m_body)+m_size, data, size);
+	m_size = kSize;
+	return kHTTP_OpStatus_Success;
+}
+
+HTTP_OpStatus HTTPResponse::Read(Socket &sd) {
+	Reset(0, 0);
+
+	Parser parser(*this);
+	char buf[4*kKilo];
 
 	for (;;) {
-		int r = ReadLine(sd, line);
+		int r = recv(sd, buf, sizeof(buf), 0);
 		if (r < 0)
 			return kHTTP_OpStatus_SocketError;
-		if (r == 0)
-			break;
 
-		RAD_ASSERT(!line.empty);
-		m_header += line;
+		AddrSize used;
+		Parser::Result result = (r == 0) ? parser.Finish() : parser.Feed(buf, (AddrSize)r, used);
+		if (result != Parser::kMore)
+			return parser.status;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
 
-		if (line == "\r\n") {
-			eoh = true;
-			break;
+struct HTTPClient::Connection {
+	Connection() :
+	get(0),
+	parser(0),
+	sent(0),
+	time(0),
+	numRequests(0),
+	sd(-1),
+	connected(false),
+	gotData(false),
+	keepAlive(false),
+	dead(false) {
+	}
+
+	String host;
+	HTTPGet *get;
+	HTTPResponse::Parser *parser;
+	int sent;
+	xtime::TimeVal time; // last activity, milliseconds.
+	int numRequests;
+	int sd;
+	bool connected;
+	bool gotData;
+	bool keepAlive;
+	bool dead; // closed at the end of the I/O loop.
+};
+
+namespace {
+boost::mutex s_defaultM;
+HTTPClient::Ref s_default;
+}
+
+HTTPClient::HTTPClient(int maxConnectionsPerHost, int idleTimeout) :
+m_wakeSd(-1),
+m_maxConnectionsPerHost(maxConnectionsPerHost),
+m_idleTimeout(idleTimeout),
+m_quit(false) {
+	memset(&m_counters, 0, sizeof(m_counters));
+	memset(&m_wakeAddr, 0, sizeof(m_wakeAddr));
+
+	// Submit() wakes the I/O thread out of poll() with a datagram sent to itself.
+	m_wakeSd = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (m_wakeSd != -1) {
+		m_wakeAddr.sin_family = AF_INET;
+		m_wakeAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		m_wakeAddr.sin_port = 0;
+
+		socklen_t len = sizeof(m_wakeAddr);
+		if ((bind(m_wakeSd, (const sockaddr*)&m_wakeAddr, sizeof(m_wakeAddr)) != 0) ||
+			(getsockname(m_wakeSd, (sockaddr*)&m_wakeAddr, &len) != 0)) {
+			closesocket(m_wakeSd);
+			m_wakeSd = -1;
+		} else {
+			SetNonBlocking(m_wakeSd);
+		}
+	}
+
+	Run();
+}
+
+HTTPClient::~HTTPClient() {
+	m_quit = true;
+	Wake();
+	Join();
+
+	RAD_ASSERT(m_pending.empty());
+
+	for (ConnectionVec::iterator it = m_conns.begin(); it != m_conns.end(); ++it)
+		Close(*it);
+
+	if (m_wakeSd != -1)
+		closesocket(m_wakeSd);
+}
+
+const HTTPClient::Ref &HTTPClient::Default() {
+	boost::lock_guard<boost::mutex> L(s_defaultM);
+	if (!s_default)
+		s_default.reset(new (ZRuntime) HTTPClient());
+	return s_default;
+}
+
+void HTTPClient::Submit(HTTPGet &get) {
+	{
+		Lock L(m_m);
+		get.m_retry = false;
+		m_pending.push_back(&get);
+	}
+	Wake();
+}
+
+void HTTPClient::Cancel(HTTPGet &get) {
+	Lock L(m_m);
+
+	m_pending.remove(&get);
+
+	for (ConnectionVec::iterator it = m_conns.begin(); it != m_conns.end(); ++it) {
+		Connection *c = *it;
+		if (c->get == &get) {
+			// the rest of the response is still in flight, the connection can't be reused.
+			delete c->parser;
+			c->parser = 0;
+			c->get = 0;
+			c->dead = true;
 		}
+	}
+}
 
-		if (first) {
-			r = line.StrStr("HTTP/1.1");
-			if (r != 0) {
-				return kHTTP_OpStatus_ResponseError;
+void HTTPClient::Wake() {
+	if (m_wakeSd != -1) {
+		char c = 0;
+		sendto(m_wakeSd, &c, 1, 0, (const sockaddr*)&m_wakeAddr, sizeof(m_wakeAddr));
+	}
+}
+
+int HTTPClient::ThreadProc() {
+	typedef zone_vector<PollFd, ZRuntimeT>::type PollFdVec;
+
+	PollFdVec fds;
+	ConnectionVec polled;
+	const int kFirst = (m_wakeSd != -1) ? 1 : 0;
+	// without a wake socket new requests are picked up by polling.
+	const int kTimeout = kFirst ? 1000 : 10;
+
+	while (!m_quit) {
+		fds.clear();
+		polled.clear();
+
+		{
+			Lock L(m_m);
+
+			if (kFirst) {
+				PollFd fd;
+				fd.fd = m_wakeSd;
+				fd.events = POLLIN;
+				fd.revents = 0;
+				fds.push_back(fd);
 			}
 
-			sscanf(line.c_str, "HTTP/1.1 %d ", &m_responseCode);
-			first = false;
+			for (ConnectionVec::iterator it = m_conns.begin(); it != m_conns.end(); ++it) {
+				Connection *c = *it;
+				const bool kSending = !c->connected || (c->get && (c->sent < c->get->m_request.numBytes.get()));
+
+				PollFd fd;
+				fd.fd = c->sd;
+				fd.events = kSending ? POLLOUT : POLLIN;
+				fd.revents = 0;
+				fds.push_back(fd);
+				polled.push_back(c);
+			}
+		}
 
+		if (fds.empty()) {
+			thread::Sleep(kTimeout);
 		} else {
-			// parse fields we are interested in.
-
-			if (m_contentType.empty) {
-				r = line.StrStr("Content-Type:");
-				if (r == 0) {
-					char sz[kKilo];
-					sscanf(line.c_str, "Content-Type: %s\r\n", sz);
-					m_contentType = sz;
-				}
+			Poll(&fds[0], (int)fds.size(), kTimeout);
+		}
+
+		Lock L(m_m);
+		const xtime::TimeVal kNow = xtime::ReadMilliseconds();
+
+		if (kFirst && fds[0].revents) {
+			char buf[64];
+			while (recv(m_wakeSd, buf, sizeof(buf), 0) > 0) {}
+		}
+
+		for (size_t i = 0; i < polled.size(); ++i) {
+			Connection &c = *polled[i];
+			const int kEvents = fds[kFirst+i].revents;
+
+			if (!kEvents || c.dead)
+				continue;
+
+			if (fds[kFirst+i].events & POLLOUT)
+				OnWritable(c, kNow);
+			if (!c.dead && c.connected && (kEvents & (POLLIN|POLLERR|POLLHUP)))
+				OnReadable(c, kNow);
+		}
+
+		for (ConnectionVec::iterator it = m_conns.begin(); it != m_conns.end(); ++it) {
+			Connection &c = **it;
+			if (c.dead)
+				continue;
+
+			const xtime::TimeVal kElapsed = kNow - c.time;
+
+			if (c.get) {
+				if (kElapsed > (xtime::TimeVal)(c.connected ? kReadTimeout : kConnectTimeout))
+					Fail(c, kHTTP_OpStatus_SocketError);
+			} else if (kElapsed > (xtime::TimeVal)m_idleTimeout) {
+				c.dead = true;
 			}
+		}
 
-			if (m_size == 0) {
-				r = line.StrStr("Content-Length:");
-				if (r == 0) {
-					int size;
-					sscanf(line.c_str, "Content-Length: %d\r\n", &size);
-					m_size = (AddrSize)size;
-					gotSize = true;
-				}
+		for (size_t i = 0; i < m_conns.size();) {
+			if (m_conns[i]->dead) {
+				Close(m_conns[i]);
+				m_conns[i] = m_conns.back();
+				m_conns.pop_back();
+			} else {
+				++i;
 			}
 		}
+
+		Schedule(kNow);
 	}
 
-	if ((m_responseCode == -1) ||
-		(m_contentType.empty) || 
-		(!gotSize)) {
-			return kHTTP_OpStatus_ResponseError;
+	return 0;
+}
+
+void HTTPClient::Schedule(xtime::TimeVal now) {
+	for (RequestList::iterator it = m_pending.begin(); it != m_pending.end();) {
+		HTTPGet &get = **it;
+
+		Connection *idle = 0;
+		int num = 0;
+
+		for (ConnectionVec::iterator c = m_conns.begin(); c != m_conns.end(); ++c) {
+			if ((*c)->dead || !((*c)->host == get.m_host))
+				continue;
+			++num;
+			if (!idle && !(*c)->get && (*c)->connected)
+				idle = *c;
+		}
+
+		if (!idle) {
+			if (num >= m_maxConnectionsPerHost) {
+				++it; // wait for a connection to this host to finish.
+				continue;
+			}
+
+			it = m_pending.erase(it);
+			Connection *c = Open(get, now);
+			if (c)
+				Start(*c, get, now);
+			continue;
+		}
+
+		it = m_pending.erase(it);
+		Start(*idle, get, now);
 	}
+}
 
-	if (m_size > 0) {
-		m_body = safe_zone_malloc(*m_zone, m_size);
-		if ((int)m_size != recv(sd, (char*)m_body, (int)m_size, 0)) {
-			return kHTTP_OpStatus_SocketError;
+HTTPClient::Connection *HTTPClient::Open(HTTPGet &get, xtime::TimeVal now) {
+	int sd = (int)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (sd == -1) {
+		Complete(get, kHTTP_OpStatus_SocketError);
+		return 0;
+	}
+
+	SetNonBlocking(sd);
+	SetStreamOptions(sd);
+
+	const int kResult = connect(sd, (const sockaddr*)&get.m_hostAddr, sizeof(get.m_hostAddr));
+	if ((kResult != 0) && !WouldBlock()) {
+		closesocket(sd);
+		Complete(get, kHTTP_OpStatus_SocketError);
+		return 0;
+	}
+
+	Connection *c = new (ZRuntime) Connection();
+	c->host = get.m_host;
+	c->sd = sd;
+	c->connected = kResult == 0;
+	c->time = now;
+	m_conns.push_back(c);
+
+	++m_counters.numConnects;
+	++m_counters.numOpen;
+	return c;
+}
+
+void HTTPClient::Close(Connection *c) {
+	if (c->get)
+		Complete(*c->get, kHTTP_OpStatus_SocketError);
+	delete c->parser;
+	closesocket(c->sd);
+	delete c;
+	--m_counters.numOpen;
+}
+
+void HTTPClient::Start(Connection &c, HTTPGet &get, xtime::TimeVal now) {
+	RAD_ASSERT(!c.get);
+
+	get.m_response->Reset(get.m_bodyData, get.m_bodySize);
+
+	c.get = &get;
+	c.parser = new (ZRuntime) HTTPResponse::Parser(*get.m_response);
+	c.sent = 0;
+	c.time = now;
+	c.gotData = false;
+	c.keepAlive = false;
+
+	if (c.numRequests > 0)
+		++m_counters.numReused;
+	++c.numRequests;
+
+	if (c.connected)
+		OnWritable(c, now); // don't wait for poll() to send on an idle connection.
+}
+
+void HTTPClient::Finish(Connection &c, HTTP_OpStatus status) {
+	HTTPGet *get = c.get;
+	RAD_ASSERT(get);
+
+	delete c.parser;
+	c.parser = 0;
+	c.get = 0;
+
+	if ((status != kHTTP_OpStatus_Success) || !c.keepAlive)
+		c.dead = true;
+
+	Complete(*get, status);
+}
+
+void HTTPClient::Fail(Connection &c, HTTP_OpStatus status) {
+	c.dead = true;
+
+	if (!c.get)
+		return;
+
+	// a server may close a kept-alive connection as we send on it.
+	if ((status == kHTTP_OpStatus_SocketError) && !c.gotData && (c.numRequests > 1) && !c.get->m_retry) {
+		c.get->m_retry = true;
+		m_pending.push_front(c.get);
+		delete c.parser;
+		c.parser = 0;
+		c.get = 0;
+		++m_counters.numRetries;
+		return;
+	}
+
+	Finish(c, status);
+}
+
+void HTTPClient::Complete(HTTPGet &get, HTTP_OpStatus status) {
+	++m_counters.numRequests;
+	if (status != kHTTP_OpStatus_Success)
+		++m_counters.numFailed;
+
+	get.m_status = status;
+	get.m_done.Open();
+}
+
+void HTTPClient::OnWritable(Connection &c, xtime::TimeVal now) {
+	if (!c.connected) {
+		int err = 0;
+		socklen_t errSize = sizeof(err);
+
+		if ((getsockopt(c.sd, SOL_SOCKET, SO_ERROR, (char*)&err, &errSize) != 0) || (err != 0)) {
+			Fail(c, kHTTP_OpStatus_SocketError);
+			return;
 		}
+
+		c.connected = true;
+		c.time = now;
 	}
 
-	return kHTTP_OpStatus_Success;
+	if (!c.get)
+		return;
+
+	const String &req = c.get->m_request;
+	const int kSize = req.numBytes;
+
+	while (c.sent < kSize) {
+		const int kSent = (int)send(c.sd, req.c_str.get() + c.sent, kSize - c.sent, kSendFlags);
+		if (kSent < 0) {
+			if (!WouldBlock())
+				Fail(c, kHTTP_OpStatus_SocketError);
+			return;
+		}
+
+		c.sent += kSent;
+		c.time = now;
+	}
+}
+
+void HTTPClient::OnReadable(Connection &c, xtime::TimeVal now) {
+	char buf[16*kKilo];
+
+	for (;;) {
+		const int kRead = (int)recv(c.sd, buf, sizeof(buf), 0);
+
+		if (kRead < 0) {
+			if (!WouldBlock())
+				Fail(c, kHTTP_OpStatus_SocketError);
+			return;
+		}
+
+		if (!c.get) {
+			// closed while idle, or data we didn't ask for.
+			c.dead = true;
+			return;
+		}
+
+		if (kRead == 0) {
+			if (!c.gotData) {
+				Fail(c, kHTTP_OpStatus_SocketError);
+			} else {
+				c.parser->Finish();
+				Finish(c, c.parser->status);
+			}
+			return;
+		}
+
+		c.gotData = true;
+		c.time = now;
+		m_counters.numBytesRead += (U64)kRead;
+
+		AddrSize used;
+		const HTTPResponse::Parser::Result kResult = c.parser->Feed(buf, (AddrSize)kRead, used);
+
+		if (kResult == HTTPResponse::Parser::kDone) {
+			// anything after the response is unsolicited, don't reuse the connection.
+			c.keepAlive = c.parser->keepAlive && (used == (AddrSize)kRead);
+			Finish(c, kHTTP_OpStatus_Success);
+			return;
+		} else if (kResult == HTTPResponse::Parser::kError) {
+			Finish(c, c.parser->status);
+			return;
+		}
+	}
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-HTTPGet::HTTPGet(Zone &zone) 
-: m_zone(&zone), m_status(kHTTP_OpStatus_None) {
+HTTPGet::HTTPGet(Zone &zone) :
+m_client(HTTPClient::Default()),
+m_done(true),
+m_zone(&zone),
+m_bodyData(0),
+m_bodySize(0),
+m_status(kHTTP_OpStatus_None),
+m_retry(false) {
+}
+
+HTTPGet::HTTPGet(const HTTPClient::Ref &client, Zone &zone) :
+m_client(client),
+m_done(true),
+m_zone(&zone),
+m_bodyData(0),
+m_bodySize(0),
+m_status(kHTTP_OpStatus_None),
+m_retry(false) {
 }
 
 HTTPGet::~HTTPGet() {
-	Join();
+	// also waits for the I/O thread to be done with us.
+	m_client->Cancel(*this);
+}
+
+void HTTPGet::SetBodyBuffer(void *data, AddrSize size) {
+	RAD_ASSERT(m_status != kHTTP_OpStatus_Pending);
+	m_bodyData = data;
+	m_bodySize = data ? size : 0;
 }
 
 HTTP_OpStatus HTTPGet::SendRequest(const char *host, const char *resource, const char *accept) {
@@ -142,115 +885,51 @@ HTTP_OpStatus HTTPGet::SendRequest(const char *host, const char *resource, const
 	m_response.reset(new (*m_zone) HTTPResponse(*m_zone));
 
 	m_host = host;
-	m_resource = resource;
 
-	if (accept) {
-		m_accept = accept;
-	} else {
-		m_accept.Clear();
+	String name(host);
+	int port = 80;
+
+	const char *colon = strchr(host, ':');
+	if (colon) {
+		name = String(host, (int)(colon-host), string::CopyTag);
+		port = atoi(colon+1);
 	}
 
-	struct hostent *z = gethostbyname(host);
+	struct hostent *z = gethostbyname(name.c_str);
 	if (!z || (z->h_addrtype != AF_INET)) {
 		m_status = kHTTP_OpStatus_UnknownHostError;
 		return m_status;
 	}
 
+	memset(&m_hostAddr, 0, sizeof(m_hostAddr));
 	m_hostAddr.sin_family = AF_INET;
-	m_hostAddr.sin_port = htons(80);
+	m_hostAddr.sin_port = htons((u_short)port);
 	m_hostAddr.sin_addr.s_addr = *((unsigned int*)z->h_addr_list[0]);
 
+	m_request = "GET ";
+	m_request += resource;
+	m_request += " HTTP/1.1\r\n";
+	m_request += "Host: ";
+	m_request += m_host + "\r\n";
+	if (accept) {
+		m_request += "Accept: ";
+		m_request += accept;
+		m_request += "\r\n";
+	}
+	m_request += "Connection: keep-alive\r\n";
+	m_request += "\r\n";
+
 	m_status = kHTTP_OpStatus_Pending;
-	Run();
+	m_done.Close();
+	m_client->Submit(*this);
 
 	return kHTTP_OpStatus_Pending;
 }
 
 HTTP_OpStatus HTTPGet::WaitForCompletion() {
-	Join();
+	// always go through the gate, it orders our reads of the response after the I/O thread's writes.
+	m_done.Wait();
 	return m_status;
 }
 
-int HTTPGet::ThreadProc() {
-
-	Socket sd = (int)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-
-	if (sd == -1) {
-		m_status = kHTTP_OpStatus_SocketError;
-		return 0;
-	}
-
-	int opt = 1;
-
-#if defined(RAD_OPT_WINX)
-	u_long argp = 1;
-	ioctlsocket(sd, FIONBIO, &argp);
-#else
-    fcntl(sd, F_SETFL, O_NONBLOCK);
-#endif
-
-	if (connect(sd, (const sockaddr*)&m_hostAddr, sizeof(m_hostAddr)) != -1) {
-		m_status = kHTTP_OpStatus_SocketError;
-		return 0;
-	}
-	
-	struct timeval  timeout;
-    timeout.tv_sec = 10;
-    timeout.tv_usec = 0;
-
-	fd_set set;
-	FD_ZERO(&set);
-	FD_SET((int)sd, &set);
-
-	int z = select(sd + 1, 0, &set, 0, &timeout);
-	if (z < 1) {
-		m_status = kHTTP_OpStatus_SocketError;
-		return 0;
-	}
-
-	U32 err;
-#if defined(RAD_OPT_WINX)
-	int errSize = sizeof(err);
-#else
-	socklen_t errSize = sizeof(err);
-#endif
-
-	if (getsockopt(sd, SOL_SOCKET, SO_ERROR, (char*)&err, &errSize) != 0) {
-		m_status = kHTTP_OpStatus_SocketError;
-		return 0;
-	}
-
-	if (err != 0) {
-		m_status = kHTTP_OpStatus_SocketError;
-		return 0;
-	}
-
-#if defined(RAD_OPT_WINX)
-	argp = 0;
-	ioctlsocket(sd, FIONBIO, &argp);
-#else
-    fcntl(sd, F_SETFL, fcntl(sd, F_GETFL, 0) & ~O_NONBLOCK);
-#endif
-
-	String req("GET ");
-	req += m_resource;
-	req += " HTTP/1.1\r\n";
-	req += "Host: ";
-	req += m_host + "\r\n";
-	if (!m_accept.empty) {
-		req += "Accept: ";
-		req += m_accept;
-		req += "\r\n";
-	}
-	req += "\r\n";
-
-	if (!sd.send(req.c_str.get(), req.numBytes, 0)) {
-		m_status = kHTTP_OpStatus_SocketError;
-		return 0;
-	}
-
-	m_status = m_response->Read(sd);
-	return 0;
-}
-
 }
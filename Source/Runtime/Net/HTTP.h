@@ -9,6 +9,10 @@
 
 #include "Socket.h"
 #include "../Thread/Thread.h"
+#include "../Thread/Locks.h"
+#include "../Container/ZoneVector.h"
+#include "../Container/ZoneList.h"
+#include "../String.h"
 #include <Runtime/PushPack.h>
 
 namespace net {
@@ -20,9 +24,12 @@ enum HTTP_OpStatus {
 	kHTTP_OpStatus_SocketError = -1,
 	kHTTP_OpStatus_ResponseError = -2,
 	kHTTP_OpStatus_UnknownHostError = -3,
-	kHTTP_OpStatus_BusyError = -4 // already an outstanding request
+	kHTTP_OpStatus_BusyError = -4, // already an outstanding request
+	kHTTP_OpStatus_BufferError = -5 // body did not fit in the supplied buffer
 };
 
+class HTTPGet;
+
 class RADRT_CLASS HTTPResponse {
 public:
 
@@ -31,6 +38,7 @@ public:
 	HTTPResponse(Zone &zone = ZRuntime);
 	~HTTPResponse();
 
+	//! Reads a complete response from a blocking socket.
 	HTTP_OpStatus Read(Socket &sd);
 
 	RAD_DECLARE_READONLY_PROPERTY(HTTPResponse, responseCode, int);
@@ -41,7 +49,15 @@ public:
 
 private:
 
-	int ReadLine(Socket &sd, String &line);
+	friend class HTTPClient;
+
+	//! Incremental response parser, handles Content-Length, chunked and close delimited bodies.
+	class Parser;
+
+	//! Clears the response, the body is written to data if it is not null.
+	void Reset(void *data, AddrSize size);
+	HTTP_OpStatus Reserve(AddrSize size);
+	HTTP_OpStatus Append(const void *data, AddrSize size);
 
 	RAD_DECLARE_GET(responseCode, int) {
 		return m_responseCode;
@@ -68,27 +84,116 @@ private:
 	Zone *m_zone;
 	void *m_body;
 	AddrSize m_size;
+	AddrSize m_capacity;
 	int m_responseCode;
+	bool m_ownsBody;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
 
-class RADRT_CLASS HTTPGet : private thread::Thread {
+//! Runs HTTP requests on a single I/O thread.
+/*! Every outstanding request is multiplexed with poll() on one thread. Connections are
+	HTTP/1.1 keep-alive and pooled per host, a finished connection is reused by the next
+	request for the same host.
+*/
+class RADRT_CLASS HTTPClient : private thread::Thread {
+public:
+	typedef boost::shared_ptr<HTTPClient> Ref;
+
+	//! Client counters, written by the I/O thread without locking.
+	struct Counters {
+		int numRequests; //!< Requests finished, successfully or not.
+		int numFailed; //!< Requests that finished with an error.
+		int numConnects; //!< Connections opened.
+		int numReused; //!< Requests sent on a kept-alive connection.
+		int numRetries; //!< Requests resent after a kept-alive connection was closed by the server.
+		int numOpen; //!< Connections currently open.
+		U64 numBytesRead;
+	};
+
+	enum {
+		kDefaultMaxConnectionsPerHost = 4,
+		kDefaultIdleTimeout = 30000, // milliseconds
+		kConnectTimeout = 10000,
+		kReadTimeout = 30000
+	};
+
+	HTTPClient(int maxConnectionsPerHost = kDefaultMaxConnectionsPerHost, int idleTimeout = kDefaultIdleTimeout);
+	~HTTPClient();
+
+	//! The client used by HTTPGet objects that are not given one.
+	static const Ref &Default();
+
+	RAD_DECLARE_READONLY_PROPERTY(HTTPClient, counters, const Counters*);
+
+private:
+
+	friend class HTTPGet;
+
+	struct Connection;
+	typedef zone_vector<Connection*, ZRuntimeT>::type ConnectionVec;
+	typedef zone_list<HTTPGet*, ZRuntimeT>::type RequestList;
+	typedef boost::mutex Mutex;
+	typedef boost::lock_guard<Mutex> Lock;
+
+	void Submit(HTTPGet &get);
+	void Cancel(HTTPGet &get);
+	void Wake();
+
+	virtual int ThreadProc();
+
+	void Schedule(xtime::TimeVal now);
+	Connection *Open(HTTPGet &get, xtime::TimeVal now);
+	void Close(Connection *c);
+	void Start(Connection &c, HTTPGet &get, xtime::TimeVal now);
+	void Finish(Connection &c, HTTP_OpStatus status);
+	//! Finishes the request with an error, or resends it if a kept-alive connection was closed on it.
+	void Fail(Connection &c, HTTP_OpStatus status);
+	void Complete(HTTPGet &get, HTTP_OpStatus status);
+	void OnWritable(Connection &c, xtime::TimeVal now);
+	void OnReadable(Connection &c, xtime::TimeVal now);
+
+	RAD_DECLARE_GET(counters, const Counters*) {
+		return &m_counters;
+	}
+
+	Mutex m_m;
+	ConnectionVec m_conns;
+	RequestList m_pending;
+	Counters m_counters;
+	sockaddr_in m_wakeAddr;
+	int m_wakeSd;
+	int m_maxConnectionsPerHost;
+	int m_idleTimeout;
+	volatile bool m_quit;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+//! An HTTP GET request run by an HTTPClient.
+class RADRT_CLASS HTTPGet {
 public:
 	typedef boost::shared_ptr<HTTPGet> Ref;
 
 	HTTPGet(Zone &zone = ZRuntime);
+	HTTPGet(const HTTPClient::Ref &client, Zone &zone = ZRuntime);
 	~HTTPGet();
 
+	//! Starts a request, host may include a port ("localhost:8080").
 	HTTP_OpStatus SendRequest(const char *host, const char *resource, const char *accept);
 	HTTP_OpStatus WaitForCompletion();
 
+	//! Streams response bodies into data instead of allocating them.
+	/*! The request fails with kHTTP_OpStatus_BufferError if a body is larger than size.
+		Pass null to allocate bodies again. */
+	void SetBodyBuffer(void *data, AddrSize size);
+
 	RAD_DECLARE_READONLY_PROPERTY(HTTPGet, status, HTTP_OpStatus);
 	RAD_DECLARE_READONLY_PROPERTY(HTTPGet, response, HTTPResponse::Ref);
 
 private:
 
-	virtual int ThreadProc();
+	friend class HTTPClient;
 
 	RAD_DECLARE_GET(status, HTTP_OpStatus) {
 		return m_status;
@@ -98,13 +203,17 @@ private:
 		return m_response;
 	}
 
-	String m_host;
-	String m_resource;
-	String m_accept;
+	String m_host; // host[:port], also the connection pool key.
+	String m_request;
 	sockaddr_in m_hostAddr;
+	HTTPClient::Ref m_client;
 	HTTPResponse::Ref m_response;
+	thread::Gate m_done;
 	Zone *m_zone;
-	HTTP_OpStatus m_status;
+	void *m_bodyData;
+	AddrSize m_bodySize;
+	volatile HTTP_OpStatus m_status;
+	bool m_retry;
 };
 
 }
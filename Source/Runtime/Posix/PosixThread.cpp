@@ -415,6 +415,9 @@ bool Thread::Join(U32 maxWaitTime)
 	if (join)
 	{
 		join = pthread_join(m_thread, 0) == 0;
+		// subclasses often Join() in their destructor before ours does, a thread can only be joined once.
+		if (join)
+			m_valid = false;
 	}
 
 	return join;
@@ -6,3 +6,4 @@
 #pragma once
 #include "Thread/Locks.h"
 #include "Thread/Thread.h"
+#include "Thread/JobScheduler.h"
@@ -0,0 +1,222 @@
+/*! \file JobScheduler.cpp
+	\copyright Copyright (c) 2013 Sunside Inc., All Rights Reserved.
+	\copyright See Radiance/LICENSE for licensing terms.
+	\author Joe Riedel
+	\ingroup runtime
+*/
+
+#include RADPCH
+#include "JobScheduler.h"
+#include "Thread.h"
+#include "Locks.h"
+#include "../Container/ZoneDeque.h"
+
+namespace thread {
+namespace details {
+
+struct JobQueue {
+	typedef zone_deque<Job*, ZRuntimeT>::type Deque;
+	typedef boost::mutex Mutex;
+	typedef boost::lock_guard<Mutex> Lock;
+
+	Mutex m;
+	Deque jobs;
+};
+
+struct JobSleep {
+	typedef boost::mutex Mutex;
+	typedef boost::unique_lock<Mutex> Lock;
+
+	Mutex m;
+	boost::condition_variable c;
+};
+
+class JobWorker : public thread::Thread {
+public:
+
+	JobWorker(JobScheduler &scheduler, int queue) : m_scheduler(&scheduler), m_queue(queue) {
+	}
+
+protected:
+
+	virtual int ThreadProc() {
+		m_scheduler->WorkerLoop(m_queue);
+		return 0;
+	}
+
+private:
+
+	JobScheduler *m_scheduler;
+	int m_queue;
+};
+
+} // details
+
+namespace {
+RAD_THREAD_VAR JobScheduler *t_scheduler = 0;
+RAD_THREAD_VAR int t_queue = 0;
+}
+
+JobScheduler::JobScheduler(int numThreads) :
+m_numQueued(0),
+m_numThreads(numThreads),
+m_numSleeping(0),
+m_quit(false) {
+	if (m_numThreads < 1)
+		m_numThreads = (int)NumContexts();
+	if (m_numThreads < 1)
+		m_numThreads = 1;
+
+	// queue 0 belongs to threads outside the pool, workers own the rest.
+	m_queues = new (ZRuntime) details::JobQueue[m_numThreads];
+	m_sleep = new (ZRuntime) details::JobSleep();
+	m_workers = new (ZRuntime) details::JobWorker*[m_numThreads];
+	m_workers[0] = 0;
+
+	for (int i = 1; i < m_numThreads; ++i) {
+		m_workers[i] = new (ZRuntime) details::JobWorker(*this, i);
+		m_workers[i]->Run();
+	}
+}
+
+JobScheduler::~JobScheduler() {
+	{
+		details::JobSleep::Lock L(m_sleep->m);
+		m_quit = true;
+		m_sleep->c.notify_all();
+	}
+
+	for (int i = 1; i < m_numThreads; ++i) {
+		m_workers[i]->Join();
+		delete m_workers[i];
+	}
+
+	RAD_ASSERT(m_numQueued == 0);
+
+	delete [] m_workers;
+	delete m_sleep;
+	delete [] m_queues;
+}
+
+void JobScheduler::Submit(JobGroup &group, Job &job) {
+	Job *p = &job;
+	Submit(group, &p, 1);
+}
+
+void JobScheduler::Submit(JobGroup &group, Job **jobs, int numJobs) {
+	if (numJobs < 1)
+		return;
+	for (int i = 0; i < numJobs; ++i) {
+		RAD_ASSERT(jobs[i]->m_group == 0);
+		jobs[i]->m_group = &group;
+	}
+	group.m_pending += numJobs;
+	Push(QueueIndex(), jobs, numJobs);
+}
+
+void JobScheduler::Wait(JobGroup &group) {
+	const int kQueue = QueueIndex();
+	while (!group.done) {
+		Job *job = FindJob(kQueue);
+		if (job) {
+			Execute(*job);
+		} else {
+			// the last jobs of the group are running on other threads.
+			thread::Yield();
+		}
+	}
+}
+
+int JobScheduler::QueueIndex() const {
+	return (t_scheduler == this) ? t_queue : 0;
+}
+
+void JobScheduler::Push(int queue, Job **jobs, int numJobs) {
+	{
+		details::JobQueue &q = m_queues[queue];
+		details::JobQueue::Lock L(q.m);
+		for (int i = 0; i < numJobs; ++i)
+			q.jobs.push_back(jobs[i]);
+	}
+
+	// m_numQueued is raised before checking for sleepers, and workers check it
+	// under m_sleep->m before going to sleep, so a wakeup cannot be missed.
+	m_numQueued += numJobs;
+
+	details::JobSleep::Lock L(m_sleep->m);
+	if (m_numSleeping > 0) {
+		if (numJobs > 1) {
+			m_sleep->c.notify_all();
+		} else {
+			m_sleep->c.notify_one();
+		}
+	}
+}
+
+Job *JobScheduler::Pop(int queue) {
+	details::JobQueue &q = m_queues[queue];
+	details::JobQueue::Lock L(q.m);
+	if (q.jobs.empty())
+		return 0;
+	Job *job = q.jobs.back();
+	q.jobs.pop_back();
+	--m_numQueued;
+	return job;
+}
+
+Job *JobScheduler::Steal(int queue) {
+	details::JobQueue &q = m_queues[queue];
+	details::JobQueue::Lock L(q.m);
+	if (q.jobs.empty())
+		return 0;
+	Job *job = q.jobs.front();
+	q.jobs.pop_front();
+	--m_numQueued;
+	return job;
+}
+
+Job *JobScheduler::FindJob(int queue) {
+	if (m_numQueued == 0)
+		return 0;
+
+	Job *job = Pop(queue);
+	for (int i = 1; !job && (i < m_numThreads); ++i) {
+		job = Steal((queue+i) % m_numThreads);
+	}
+
+	return job;
+}
+
+void JobScheduler::Execute(Job &job) {
+	JobGroup *group = job.m_group;
+	job.m_group = 0;
+	job.Run();
+	// the group may be destroyed by its waiter once this reaches zero.
+	--group->m_pending;
+}
+
+void JobScheduler::WorkerLoop(int queue) {
+	t_scheduler = this;
+	t_queue = queue;
+
+	for (;;) {
+		Job *job = FindJob(queue);
+		if (job) {
+			Execute(*job);
+			continue;
+		}
+
+		details::JobSleep::Lock L(m_sleep->m);
+		if (m_quit)
+			break;
+		if (m_numQueued == 0) {
+			++m_numSleeping;
+			m_sleep->c.wait(L);
+			--m_numSleeping;
+		}
+	}
+
+	t_scheduler = 0;
+}
+
+} // thread
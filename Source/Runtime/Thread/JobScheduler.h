@@ -0,0 +1,184 @@
+/*! \file JobScheduler.h
+	\copyright Copyright (c) 2013 Sunside Inc., All Rights Reserved.
+	\copyright See Radiance/LICENSE for licensing terms.
+	\author Joe Riedel
+	\ingroup runtime
+*/
+
+#pragma once
+
+#include "../Base.h"
+#include "../Container/ZoneVector.h"
+#include "Interlocked.h"
+#include <boost/shared_ptr.hpp>
+#include <algorithm>
+#include "../PushPack.h"
+
+namespace thread {
+
+class JobGroup;
+class JobScheduler;
+
+namespace details {
+class JobWorker;
+struct JobQueue;
+struct JobSleep;
+} // details
+
+//! A unit of work run by a JobScheduler.
+/*! Jobs are owned by the submitter and must remain valid until the JobGroup they
+	were submitted with has been waited on. */
+class RADRT_CLASS Job {
+public:
+	Job() : m_group(0) {}
+	virtual ~Job() {}
+
+	virtual void Run() = 0;
+
+private:
+
+	friend class JobScheduler;
+
+	JobGroup *m_group;
+};
+
+//! Counts the outstanding jobs of a submission so it can be joined.
+class RADRT_CLASS JobGroup : private boost::noncopyable {
+public:
+
+	JobGroup() : m_pending(0) {}
+	~JobGroup() {
+		RAD_ASSERT(m_pending == 0);
+	}
+
+	RAD_DECLARE_READONLY_PROPERTY(JobGroup, done, bool);
+
+private:
+
+	friend class JobScheduler;
+
+	RAD_DECLARE_GET(done, bool) {
+		return m_pending == 0;
+	}
+
+	Interlocked<int> m_pending;
+};
+
+//! Runs jobs on a pool of worker threads.
+/*! Every thread has its own job queue. Jobs submitted from a worker are pushed on that
+	worker's queue and run last-in first-out, idle workers steal the oldest jobs from
+	the other queues. Jobs submitted from any other thread go on a shared queue.
+
+	Wait() does not block while there is work queued: the waiting thread runs jobs
+	until the group is done, so jobs may submit and wait on jobs of their own.
+
+	Jobs can complete in any order on any thread. Callers that need deterministic results
+	should have each job write only its own outputs and combine them after Wait(). */
+class RADRT_CLASS JobScheduler : private boost::noncopyable {
+public:
+	typedef boost::shared_ptr<JobScheduler> Ref;
+
+	//! Creates a scheduler.
+	/*! \param numThreads number of threads that run jobs, including the thread that
+		calls Wait(). 0 uses thread::NumContexts(), 1 runs all jobs in Wait(). */
+	explicit JobScheduler(int numThreads = 0);
+	~JobScheduler();
+
+	void Submit(JobGroup &group, Job &job);
+	void Submit(JobGroup &group, Job **jobs, int numJobs);
+
+	//! Runs jobs on the calling thread until all jobs in the group have completed.
+	void Wait(JobGroup &group);
+
+	//! Calls fn(first, count) over [0, count) split into ranges of grain items.
+	/*! The ranges depend only on count and grain, not on the number of threads.
+		Returns after all ranges have been run. */
+	template <typename Fn>
+	void ParallelFor(int count, int grain, Fn &fn);
+
+	RAD_DECLARE_READONLY_PROPERTY(JobScheduler, numThreads, int);
+
+private:
+
+	friend class details::JobWorker;
+
+	RAD_DECLARE_GET(numThreads, int) {
+		return m_numThreads;
+	}
+
+	int QueueIndex() const;
+	void Push(int queue, Job **jobs, int numJobs);
+	Job *Pop(int queue);
+	Job *Steal(int queue);
+	Job *FindJob(int queue);
+	void Execute(Job &job);
+	void WorkerLoop(int queue);
+
+	details::JobQueue *m_queues;
+	details::JobWorker **m_workers;
+	Interlocked<int> m_numQueued;
+	int m_numThreads;
+	int m_numSleeping;
+	bool m_quit;
+	details::JobSleep *m_sleep;
+};
+
+namespace details {
+
+template <typename Fn>
+class RangeJob : public Job {
+public:
+
+	RangeJob() : m_fn(0), m_first(0), m_count(0) {}
+
+	void Init(Fn &fn, int first, int count) {
+		m_fn = &fn;
+		m_first = first;
+		m_count = count;
+	}
+
+	virtual void Run() {
+		(*m_fn)(m_first, m_count);
+	}
+
+private:
+
+	Fn *m_fn;
+	int m_first;
+	int m_count;
+};
+
+} // details
+
+template <typename Fn>
+void JobScheduler::ParallelFor(int count, int grain, Fn &fn) {
+	if (count < 1)
+		return;
+	if (grain < 1)
+		grain = 1;
+
+	const int kNumJobs = (count + grain - 1) / grain;
+	if ((kNumJobs < 2) || (m_numThreads < 2)) {
+		for (int i = 0; i < count; i += grain)
+			fn(i, std::min(grain, count - i));
+		return;
+	}
+
+	typedef details::RangeJob<Fn> RangeJobType;
+	typename zone_vector<RangeJobType, ZRuntimeT>::type jobs(kNumJobs);
+	zone_vector<Job*, ZRuntimeT>::type ptrs(kNumJobs);
+
+	for (int i = 0; i < kNumJobs; ++i) {
+		int first = i*grain;
+		jobs[i].Init(fn, first, std::min(grain, count - first));
+		ptrs[i] = &jobs[i];
+	}
+
+	JobGroup group;
+	Submit(group, &ptrs[0], kNumJobs);
+	Wait(group);
+}
+
+} // thread
+
+#include "../PopPack.h"
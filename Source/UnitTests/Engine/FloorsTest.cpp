@@ -0,0 +1,190 @@
+// FloorsTest.cpp
+// Copyright (c) 2013 Sunside Inc., All Rights Reserved
+// Author: Joe Riedel
+// See Radiance/LICENSE for licensing terms.
+
+#include "../UTCommon.h"
+#include <Engine/World/BSPFile.h>
+#include <Engine/World/Floors.h>
+
+#if defined(RAD_OPT_TOOLS)
+
+using namespace world;
+
+namespace ut
+{
+namespace
+{
+	enum {
+		kGridSize = 4,
+		kNumFloors = kGridSize*kGridSize,
+		kWaypointsPerFloor = 6,
+		kRoomSize = 512,
+		kRoomBorder = 32,
+		kNumLadders = 6,
+		kDisabledFloor = 5
+	};
+
+	typedef zone_vector<bsp_file::BSPWaypoint, ZWorldT>::type WaypointVec;
+	typedef zone_vector<bsp_file::BSPWaypointConnection, ZWorldT>::type ConnectionVec;
+	typedef zone_vector<IntVec, ZWorldT>::type IntVecVec;
+
+	U32 s_seed = 0x6b43a9b5;
+
+	int Random(int max) {
+		s_seed = s_seed * 1664525 + 1013904223;
+		return (int)((s_seed >> 8) % (U32)max);
+	}
+
+	//! A grid of rooms, each a floor with a few waypoints, joined by doors (some one way)
+	//! and by ladders that leave the floors through waypoints of their own.
+	class Level {
+	public:
+
+		void Build(bsp_file::BSPFileBuilder &bsp) {
+			for (int i = 0; i < kNumFloors; ++i) {
+				for (int k = 0; k < kWaypointsPerFloor; ++k) {
+					const float kX = (float)((i % kGridSize) * kRoomSize + kRoomBorder + Random(kRoomSize - kRoomBorder*2));
+					const float kY = (float)((i / kGridSize) * kRoomSize + kRoomBorder + Random(kRoomSize - kRoomBorder*2));
+					AddWaypoint(kX, kY, 0.f, i);
+				}
+			}
+
+			for (int y = 0; y < kGridSize; ++y) {
+				for (int x = 0; x < kGridSize; ++x) {
+					const int kFloor = y*kGridSize + x;
+					if (x+1 < kGridSize)
+						AddDoor(kFloor, kFloor+1);
+					if (y+1 < kGridSize)
+						AddDoor(kFloor, kFloor+kGridSize);
+				}
+			}
+
+			for (int i = 0; i < kNumLadders; ++i) {
+				const int kBottom = RoomWaypoint(Random(kNumFloors));
+				const int kTop = RoomWaypoint(Random(kNumFloors));
+				if (kBottom == kTop)
+					continue;
+
+				const bsp_file::BSPWaypoint &bottom = m_waypoints[kBottom];
+				const int kLadder = AddWaypoint(bottom.pos[0], bottom.pos[1], 256.f, -1);
+				AddConnection(kBottom, kLadder, bsp_file::kWaypointConnectionFlag_AtoB|bsp_file::kWaypointConnectionFlag_BtoA);
+				AddConnection(kLadder, kTop, bsp_file::kWaypointConnectionFlag_AtoB|bsp_file::kWaypointConnectionFlag_BtoA);
+			}
+
+			for (ConnectionVec::const_iterator it = m_connections.begin(); it != m_connections.end(); ++it)
+				*bsp.AddWaypointConnection() = *it;
+
+			for (int i = 0; i < kNumFloors; ++i) {
+				bsp_file::BSPFloor *floor = bsp.AddFloor();
+				memset(floor, 0, sizeof(bsp_file::BSPFloor));
+				floor->name = bsp.numStrings;
+				floor->firstWaypoint = (S32)bsp.numWaypointIndices;
+				floor->numWaypoints = kWaypointsPerFloor;
+
+				char name[32];
+				sprintf(name, "floor%d", i);
+				*bsp.AddString() = name;
+
+				for (int k = 0; k < kWaypointsPerFloor; ++k)
+					*bsp.AddWaypointIndex() = (U16)(i*kWaypointsPerFloor + k);
+			}
+
+			for (int i = 0; i < (int)m_waypoints.size(); ++i) {
+				bsp_file::BSPWaypoint &waypoint = m_waypoints[i];
+				waypoint.firstConnection = bsp.numWaypointIndices;
+				waypoint.numConnections = (U32)m_waypointConnections[i].size();
+
+				for (IntVec::const_iterator it = m_waypointConnections[i].begin(); it != m_waypointConnections[i].end(); ++it)
+					*bsp.AddWaypointIndex() = (U16)*it;
+
+				*bsp.AddWaypoint() = waypoint;
+			}
+		}
+
+	private:
+
+		int RoomWaypoint(int floor) {
+			return floor*kWaypointsPerFloor + Random(kWaypointsPerFloor);
+		}
+
+		int AddWaypoint(float x, float y, float z, int floor) {
+			bsp_file::BSPWaypoint waypoint;
+			memset(&waypoint, 0, sizeof(waypoint));
+			waypoint.pos[0] = x;
+			waypoint.pos[1] = y;
+			waypoint.pos[2] = z;
+			waypoint.uid = (U32)m_waypoints.size() + 1;
+			waypoint.floorNum = floor;
+			waypoint.triNum = -1;
+			waypoint.targetName = -1;
+			waypoint.userId = -1;
+			waypoint.flags = Floors::kWaypointState_Enabled;
+
+			m_waypoints.push_back(waypoint);
+			m_waypointConnections.resize(m_waypoints.size());
+			return (int)m_waypoints.size() - 1;
+		}
+
+		//! Every fourth door only opens one way.
+		void AddDoor(int floorA, int floorB) {
+			int flags = bsp_file::kWaypointConnectionFlag_AtoB;
+			if (Random(4))
+				flags |= bsp_file::kWaypointConnectionFlag_BtoA;
+			AddConnection(RoomWaypoint(floorA), RoomWaypoint(floorB), flags);
+		}
+
+		void AddConnection(int a, int b, int flags) {
+			bsp_file::BSPWaypointConnection connection;
+			memset(&connection, 0, sizeof(connection));
+			connection.flags = flags;
+			for (int i = 0; i < 4; ++i)
+				connection.cmds[i] = -1;
+			connection.anims[0] = connection.anims[1] = -1;
+			connection.waypoints[0] = (U32)a;
+			connection.waypoints[1] = (U32)b;
+
+			m_waypointConnections[a].push_back((int)m_connections.size());
+			m_waypointConnections[b].push_back((int)m_connections.size());
+			m_connections.push_back(connection);
+		}
+
+		WaypointVec m_waypoints;
+		ConnectionVec m_connections;
+		IntVecVec m_waypointConnections;
+	};
+
+	//! Plans between every pair of waypoints with the A* planner and the flood planner it
+	//! replaced, A* must find every route the flood planner finds and never a longer one.
+	void PlanTest() {
+		bsp_file::BSPFileBuilder bsp;
+		Level level;
+		level.Build(bsp);
+
+		Floors floors;
+		if (!floors.Load(bsp)) {
+			FAIL(-1, "Floors::Load() failed.");
+		}
+
+		for (int i = 0; i < kNumFloors; ++i) {
+			if (i != kDisabledFloor)
+				floors.SetFloorState(i, Floors::kFloorState_Enabled);
+		}
+
+		// a disabled waypoint can't be crossed.
+		floors.SetWaypointState(floors.waypointIds.get()[Random((int)floors.waypointIds.get().size())], 0);
+
+		if (!floors.PlanBenchmark(std::cout)) {
+			FAIL(-1, "A* missed or lengthened a route found by the flood planner.");
+		}
+	}
+}
+
+	void FloorsTest()
+	{
+		Begin("FloorsTest");
+		DO(PlanTest());
+	}
+}
+
+#endif
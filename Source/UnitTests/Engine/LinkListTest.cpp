@@ -0,0 +1,191 @@
+// LinkListTest.cpp
+// Copyright (c) 2013 Sunside Inc., All Rights Reserved
+// Author: Joe Riedel
+// See Radiance/LICENSE for licensing terms.
+
+#include "../UTCommon.h"
+#include <Engine/World/WorldDef.h>
+#include <Runtime/Time.h>
+#include <algorithm>
+
+using namespace world;
+
+namespace ut
+{
+namespace
+{
+	enum {
+		kNumLists = 64,
+		kNumObjects = 256,
+		kMaxListsPerObject = 6,
+		kNumRelinks = 200,
+		kNumBenchmarkLists = 4096,
+		kNumBenchmarkObjects = 2048,
+		kNumBenchmarkFrames = 100
+	};
+
+	struct TestObject {
+		typedef LinkList<TestObject> List;
+		List::LinkVec links;
+		int lists[kMaxListsPerObject]; // lists the object should be in.
+		int numLists;
+	};
+
+	typedef TestObject::List List;
+
+	U32 s_seed = 0x2545f491;
+
+	int Random(int max) {
+		s_seed = s_seed * 1664525 + 1013904223;
+		return (int)((s_seed >> 8) % (U32)max);
+	}
+
+	//! Links obj into numLists distinct lists in [first, first+range).
+	void Link(TestObject &obj, List *lists, int first, int range, int numLists) {
+		obj.numLists = 0;
+		while (obj.numLists < numLists) {
+			const int kList = first + Random(range);
+			if (std::find(obj.lists, obj.lists + obj.numLists, kList) != obj.lists + obj.numLists)
+				continue; // an object may only be in a list once.
+			obj.lists[obj.numLists++] = kList;
+			lists[kList].Add(&obj, obj.links);
+		}
+	}
+
+	void Unlink(TestObject &obj) {
+		List::RemoveAll(obj.links);
+		obj.numLists = 0;
+	}
+
+	//! Checks the back-references both ways and that every list holds exactly the objects
+	//! that were linked into it.
+	bool Validate(const List *lists, int numLists, const TestObject *objects, int numObjects, const char *step) {
+		int numLinks = 0;
+
+		for (int i = 0; i < numObjects; ++i) {
+			const TestObject &obj = objects[i];
+			if ((int)obj.links.size() != obj.numLists) {
+				Fail(-1, "%s: object %d has %d link(s), expected %d.", step, i, (int)obj.links.size(), obj.numLists);
+				return false;
+			}
+
+			numLinks += obj.numLists;
+
+			for (int k = 0; k < obj.numLists; ++k) {
+				const List::Link &link = obj.links[k];
+				if (link.list != &lists[obj.lists[k]]) {
+					Fail(-1, "%s: object %d link %d points at the wrong list.", step, i, k);
+					return false;
+				}
+
+				if ((link.index < 0) || (link.index >= link.list->size()) || (*(link.list->begin() + link.index) != &obj)) {
+					Fail(-1, "%s: object %d link %d has a stale index %d.", step, i, k, link.index);
+					return false;
+				}
+			}
+		}
+
+		int numMembers = 0;
+		for (int i = 0; i < numLists; ++i)
+			numMembers += lists[i].size();
+
+		// with every link resolving to its own slot, equal counts mean no list holds anything else.
+		if (numMembers != numLinks) {
+			Fail(-1, "%s: lists hold %d object(s), objects have %d link(s).", step, numMembers, numLinks);
+			return false;
+		}
+
+		return true;
+	}
+
+	void MembershipTest() {
+		List lists[kNumLists];
+		TestObject *objects = new TestObject[kNumObjects];
+
+		for (int i = 0; i < kNumObjects; ++i)
+			Link(objects[i], lists, 0, kNumLists, 1 + Random(kMaxListsPerObject));
+
+		bool ok = Validate(lists, kNumLists, objects, kNumObjects, "link");
+
+		// relink random objects, each relink swap-removes from the middle of several lists.
+		for (int i = 0; ok && (i < kNumRelinks); ++i) {
+			TestObject &obj = objects[Random(kNumObjects)];
+			Unlink(obj);
+			Link(obj, lists, 0, kNumLists, 1 + Random(kMaxListsPerObject));
+			ok = Validate(lists, kNumLists, objects, kNumObjects, "relink");
+		}
+
+		// unlink in a shuffled order so the last slot and middle slots are both removed.
+		for (int i = 0; ok && (i < kNumObjects); ++i) {
+			const int kIndex = (i * 97) % kNumObjects;
+			Unlink(objects[kIndex]);
+			ok = Validate(lists, kNumLists, objects, kNumObjects, "unlink");
+		}
+
+		for (int i = 0; ok && (i < kNumLists); ++i) {
+			if (!lists[i].empty()) {
+				Fail(-1, "list %d still holds %d object(s) after every object was unlinked.", i, lists[i].size());
+				ok = false;
+			}
+		}
+
+		delete [] objects;
+	}
+
+	//! Moves thousands of objects through a large set of lists every frame, the way the
+	//! world relinks moving entities and lights into leafs and areas.
+	void RelinkBenchmarkTest() {
+		List *lists = new List[kNumBenchmarkLists];
+		TestObject *objects = new TestObject[kNumBenchmarkObjects];
+
+		xtime::MicroTimer timer;
+		double firstFrame = 0.0;
+		double steadyFrames = 0.0;
+
+		for (int frame = 0; frame < kNumBenchmarkFrames; ++frame) {
+			// objects move a short way, so they land in lists near the ones they left.
+			int starts[kNumBenchmarkObjects];
+			for (int i = 0; i < kNumBenchmarkObjects; ++i)
+				starts[i] = Random(kNumBenchmarkLists - 16);
+
+			timer.Start();
+			for (int i = 0; i < kNumBenchmarkObjects; ++i) {
+				Unlink(objects[i]);
+				Link(objects[i], lists, starts[i], 16, 1 + (i % kMaxListsPerObject));
+			}
+			timer.Stop();
+
+			// the first frame grows the arrays, later frames relink in place.
+			if (frame == 0) {
+				firstFrame = (double)timer.Elapsed();
+			} else {
+				steadyFrames += (double)timer.Elapsed();
+			}
+		}
+
+		const bool kValid = Validate(lists, kNumBenchmarkLists, objects, kNumBenchmarkObjects, "benchmark");
+
+		for (int i = 0; i < kNumBenchmarkObjects; ++i)
+			Unlink(objects[i]);
+
+		delete [] objects;
+		delete [] lists;
+
+		if (!kValid)
+			return;
+
+		const int kSteadyFrames = kNumBenchmarkFrames - 1;
+
+		std::cout << kNumBenchmarkObjects << " objects, first frame: " << (firstFrame / 1000.0) << " ms, steady: " <<
+			(steadyFrames / (1000.0 * kSteadyFrames)) << " ms/frame, " <<
+			(steadyFrames * 1000.0 / ((double)kSteadyFrames * kNumBenchmarkObjects)) << " ns/relink" << std::endl;
+	}
+}
+
+	void LinkListTest()
+	{
+		Begin("LinkListTest");
+		DO(MembershipTest());
+		DO(RelinkBenchmarkTest());
+	}
+}
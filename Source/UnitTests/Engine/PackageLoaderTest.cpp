@@ -0,0 +1,399 @@
+// PackageLoaderTest.cpp
+// Copyright (c) 2013 Sunside Inc., All Rights Reserved
+// Author: Joe Riedel
+// See Radiance/LICENSE for licensing terms.
+
+#include "../UTCommon.h"
+#include <Engine/Engine.h>
+#include <Engine/Packages/Packages.h>
+#include <Engine/Assets/AssetTypes.h>
+#include <Runtime/Thread.h>
+#include <Runtime/Thread/Locks.h>
+#include <Runtime/Time.h>
+#include <vector>
+
+#if defined(RAD_OPT_PC_TOOLS)
+
+using namespace pkg;
+
+namespace ut
+{
+namespace
+{
+	enum {
+		kTimeout = 5000, // milliseconds
+		kTestType = asset::AT_StringTable
+	};
+
+	typedef boost::mutex Mutex;
+	typedef boost::lock_guard<Mutex> Lock;
+
+	//! A sink that ran for an asset.
+	struct Event {
+		String name;
+		int stage;
+		bool mainThread;
+	};
+
+	typedef std::vector<Event> EventVec;
+
+	Mutex s_m;
+	EventVec s_events;
+	thread::Id s_mainThread;
+	// assets named hold* block their first sink on the loader thread until s_hold opens.
+	thread::Gate s_hold;
+	thread::Gate s_entered;
+
+	void Record(const Asset::Ref &asset, int stage) {
+		Event e;
+		e.name = asset->name.get();
+		e.stage = stage;
+		e.mainThread = thread::ThreadId() == s_mainThread;
+
+		Lock L(s_m);
+		s_events.push_back(e);
+	}
+
+	EventVec Events(int stage) {
+		EventVec events;
+		Lock L(s_m);
+		for (EventVec::const_iterator it = s_events.begin(); it != s_events.end(); ++it) {
+			if (it->stage == stage)
+				events.push_back(*it);
+		}
+		return events;
+	}
+
+	int NumEvents(const char *name) {
+		int num = 0;
+		Lock L(s_m);
+		for (EventVec::const_iterator it = s_events.begin(); it != s_events.end(); ++it) {
+			if (it->name == name)
+				++num;
+		}
+		return num;
+	}
+
+	//! First loader thread sink, holds the loader thread on hold* assets.
+	class ParseSink : public Sink<ParseSink> {
+	public:
+		enum {
+			SinkStage = SS_Parser,
+			AssetType = kTestType,
+			SinkAsync = 1
+		};
+
+	protected:
+		virtual int Process(const xtime::TimeSlice &time, Engine &engine, const Asset::Ref &asset, int flags) {
+			if (!(flags&P_Load))
+				return SR_Success;
+
+			Record(asset, SinkStage);
+
+			if (!strncmp(asset->name.get(), "hold", 4)) {
+				s_entered.Open();
+				s_hold.Wait();
+			}
+
+			return SR_Success;
+		}
+	};
+
+	//! Second loader thread sink, a cancelled load must not reach it.
+	class DecodeSink : public Sink<DecodeSink> {
+	public:
+		enum {
+			SinkStage = SS_Load,
+			AssetType = kTestType,
+			SinkAsync = 1
+		};
+
+	protected:
+		virtual int Process(const xtime::TimeSlice &time, Engine &engine, const Asset::Ref &asset, int flags) {
+			if (flags&P_Load)
+				Record(asset, SinkStage);
+			return SR_Success;
+		}
+	};
+
+	//! Main thread sink, runs from Wait() or TickAsyncLoads().
+	class UploadSink : public Sink<UploadSink> {
+	public:
+		enum {
+			SinkStage = SS_Process,
+			AssetType = kTestType
+		};
+
+	protected:
+		virtual int Process(const xtime::TimeSlice &time, Engine &engine, const Asset::Ref &asset, int flags) {
+			if (flags&P_Load)
+				Record(asset, SinkStage);
+			return SR_Success;
+		}
+	};
+
+	//! A bare engine with a file system and a package manager bound to the test sinks.
+	class Fixture {
+	public:
+
+		Fixture() : m_engine(Engine::New()) {
+			s_mainThread = thread::ThreadId();
+			s_events.clear();
+			s_hold.Close();
+			s_entered.Close();
+
+			// the engine is never initialized, the package manager only needs files.
+			Engine::ComTable &sys = const_cast<Engine::ComTable&>(*m_engine->sys.get());
+			sys.files = file::FileSystem::New();
+
+			m_pm = PackageMan::New(*m_engine, "@r:/Temp/PackageLoaderTest");
+			m_bindings.push_back(m_pm->Bind<ParseSink>());
+			m_bindings.push_back(m_pm->Bind<DecodeSink>());
+			m_bindings.push_back(m_pm->Bind<UploadSink>());
+			m_pkg = m_pm->CreatePackage("PackageLoaderTest");
+		}
+
+		~Fixture() {
+			s_hold.Open(); // never leave the loader thread blocked.
+			m_pm->StopAsyncLoads();
+			m_assets.clear();
+			m_pkg.reset();
+			m_bindings.clear();
+			m_pm.reset();
+
+			const file::FileSystem::Ref &files = m_engine->sys->files;
+			files->DeleteDirectory("@r:/Temp/Files/PackageLoaderTest");
+			files->DeleteDirectory("@r:/Temp/Tags/PackageLoaderTest");
+			files->DeleteDirectory("@r:/Temp/Globals/PackageLoaderTest");
+
+			delete m_engine;
+		}
+
+		AsyncLoad::Ref Load(const char *name, int priority) {
+			Package::Entry::Ref entry = m_pkg->CreateEntry(name, (asset::Type)kTestType);
+			Asset::Ref asset = m_pm->Asset(entry->id, Z_Engine);
+			m_assets.push_back(asset);
+			return m_pm->LoadAsync(asset, P_Load, priority);
+		}
+
+		//! Ticks the background loads until none of loads are pending.
+		bool Wait(const AsyncLoad::Ref *loads, int numLoads) {
+			const xtime::TimeVal kStart = xtime::ReadMilliseconds();
+
+			for (;;) {
+				int numPending = 0;
+				for (int i = 0; i < numLoads; ++i) {
+					if (loads[i]->result == SR_Pending)
+						++numPending;
+				}
+
+				if (!numPending)
+					return true;
+				if (xtime::ReadMilliseconds() - kStart > kTimeout)
+					return false;
+
+				m_pm->TickAsyncLoads(xtime::TimeSlice(10));
+				thread::Sleep(1);
+			}
+		}
+
+		RAD_DECLARE_READONLY_PROPERTY(Fixture, pm, PackageMan*);
+
+	private:
+
+		typedef std::vector<Binding::Ref> BindingVec;
+		typedef std::vector<Asset::Ref> AssetVec;
+
+		RAD_DECLARE_GET(pm, PackageMan*) {
+			return m_pm.get();
+		}
+
+		Engine *m_engine;
+		PackageMan::Ref m_pm;
+		Package::Ref m_pkg;
+		BindingVec m_bindings;
+		AssetVec m_assets;
+	};
+
+	void PriorityTest() {
+		Fixture f;
+
+		// hold the loader thread so the rest queue up behind it.
+		AsyncLoad::Ref loads[6];
+		loads[0] = f.Load("hold0", 0);
+		if (!s_entered.Wait(kTimeout)) {
+			FAIL(-1, "loader thread never started hold0.");
+		}
+
+		loads[1] = f.Load("a", 0);
+		loads[2] = f.Load("b", 5);
+		loads[3] = f.Load("c", 0);
+		loads[4] = f.Load("d", 10);
+		loads[5] = f.Load("e", 5);
+
+		loads[3]->Cancel();
+		if (loads[3]->result != SR_Cancelled) {
+			FAIL(-1, "cancelling a queued load returned %d.", loads[3]->result.get());
+		}
+
+		s_hold.Open();
+
+		if (!f.Wait(loads, 6)) {
+			FAIL(-1, "background loads didn't complete in %d ms.", (int)kTimeout);
+		}
+
+		// higher priorities first, the same priority in request order.
+		const char *kOrder[] = { "hold0", "d", "b", "e", "a" };
+		const int kNumOrder = (int)(sizeof(kOrder)/sizeof(kOrder[0]));
+
+		const EventVec kParsed = Events(ParseSink::SinkStage);
+		if ((int)kParsed.size() != kNumOrder) {
+			FAIL(-1, "%d assets were parsed, expected %d.", (int)kParsed.size(), kNumOrder);
+		}
+
+		for (int i = 0; i < kNumOrder; ++i) {
+			if (kParsed[i].name != kOrder[i]) {
+				FAIL(-1, "load %d was %s, expected %s.", i, kParsed[i].name.c_str.get(), kOrder[i]);
+			}
+		}
+
+		for (int i = 0; i < 6; ++i) {
+			const int kExpected = (i == 3) ? (int)SR_Cancelled : (int)SR_Success;
+			if (loads[i]->result != kExpected) {
+				FAIL(-1, "%s completed with %d, expected %d.", loads[i]->asset->name.get(), loads[i]->result.get(), kExpected);
+			}
+		}
+
+		if (NumEvents("c")) {
+			FAIL(-1, "a cancelled load ran %d sink(s).", NumEvents("c"));
+		}
+
+		// async sinks run on the loader thread, the rest on the main thread.
+		Lock L(s_m);
+		for (EventVec::const_iterator it = s_events.begin(); it != s_events.end(); ++it) {
+			if (it->mainThread != (it->stage == UploadSink::SinkStage)) {
+				FAIL(-1, "%s stage %d ran on the wrong thread.", it->name.c_str.get(), it->stage);
+			}
+		}
+	}
+
+	void CancelTest() {
+		Fixture f;
+
+		// cancelled while the loader thread is in its first sink.
+		AsyncLoad::Ref loads[2];
+		loads[0] = f.Load("hold1", 0);
+		if (!s_entered.Wait(kTimeout)) {
+			FAIL(-1, "loader thread never started hold1.");
+		}
+
+		loads[0]->Cancel();
+		if (loads[0]->result != SR_Pending) {
+			FAIL(-1, "cancelling a running load returned %d before the sink finished.", loads[0]->result.get());
+		}
+
+		s_hold.Open();
+
+		if (loads[0]->Wait() != SR_Cancelled) {
+			FAIL(-1, "a load cancelled in flight completed with %d.", loads[0]->result.get());
+		}
+
+		if (NumEvents("hold1") != 1) {
+			FAIL(-1, "a load cancelled in flight ran %d sinks, expected 1.", NumEvents("hold1"));
+		}
+
+		// cancelled with its main thread sinks left to run.
+		loads[1] = f.Load("f", 0);
+		const xtime::TimeVal kStart = xtime::ReadMilliseconds();
+		while (Events(DecodeSink::SinkStage).empty()) {
+			if (xtime::ReadMilliseconds() - kStart > kTimeout) {
+				FAIL(-1, "loader thread never decoded f.");
+			}
+			thread::Sleep(1);
+		}
+
+		// the loader thread may still be returning from the sink, Wait() finishes the cancel.
+		loads[1]->Cancel();
+		if (loads[1]->Wait() != SR_Cancelled) {
+			FAIL(-1, "a load cancelled before its main thread sinks completed with %d.", loads[1]->result.get());
+		}
+
+		if (Events(UploadSink::SinkStage).size()) {
+			FAIL(-1, "a cancelled load ran its main thread sinks.");
+		}
+
+		// cancelling a completed load changes nothing.
+		AsyncLoad::Ref done = f.Load("g", 0);
+		if (done->Wait() != SR_Success) {
+			FAIL(-1, "load after cancels completed with %d.", done->result.get());
+		}
+
+		done->Cancel();
+		if (done->result != SR_Success) {
+			FAIL(-1, "cancelling a completed load changed its result to %d.", done->result.get());
+		}
+	}
+
+	//! Opens s_hold after a delay, while the main thread is stopping the loader.
+	class ReleaseThread : public thread::Thread {
+	protected:
+		virtual int ThreadProc() {
+			thread::Sleep(50);
+			s_hold.Open();
+			return 0;
+		}
+	};
+
+	void StopTest() {
+		Fixture f;
+
+		AsyncLoad::Ref loads[3];
+		loads[0] = f.Load("hold2", 0);
+		if (!s_entered.Wait(kTimeout)) {
+			FAIL(-1, "loader thread never started hold2.");
+		}
+
+		loads[1] = f.Load("h", 0);
+		loads[2] = f.Load("i", 5);
+
+		// returns once the loader thread finishes hold2.
+		ReleaseThread release;
+		release.Run();
+		f.pm->StopAsyncLoads();
+		release.Join();
+
+		if ((loads[1]->result != SR_Cancelled) || (loads[2]->result != SR_Cancelled)) {
+			FAIL(-1, "queued loads completed with %d and %d when the loader stopped.", loads[1]->result.get(), loads[2]->result.get());
+		}
+
+		if (NumEvents("h") || NumEvents("i")) {
+			FAIL(-1, "queued loads ran sinks after the loader stopped.");
+		}
+
+		// the load in flight finishes normally.
+		if (loads[0]->Wait() != SR_Success) {
+			FAIL(-1, "the load in flight when the loader stopped completed with %d.", loads[0]->result.get());
+		}
+
+		if (NumEvents("hold2") != 3) {
+			FAIL(-1, "the load in flight when the loader stopped ran %d sinks, expected 3.", NumEvents("hold2"));
+		}
+
+		// and the loader starts again.
+		AsyncLoad::Ref next = f.Load("j", 0);
+		if (!f.Wait(&next, 1) || (next->result != SR_Success)) {
+			FAIL(-1, "a load after the loader stopped completed with %d.", next->result.get());
+		}
+	}
+}
+
+	void PackageLoaderTest()
+	{
+		Begin("PackageLoaderTest");
+		DO(PriorityTest());
+		DO(CancelTest());
+		DO(StopTest());
+	}
+}
+
+#endif
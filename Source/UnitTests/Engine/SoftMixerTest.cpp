@@ -0,0 +1,171 @@
+// SoftMixerTest.cpp
+// Copyright (c) 2013 Sunside Inc., All Rights Reserved
+// Author: Joe Riedel
+// See Radiance/LICENSE for licensing terms.
+
+#include "../UTCommon.h"
+#include <Engine/Sound/SoftMixer.h>
+#include <Runtime/Time.h>
+#include <math.h>
+
+namespace ut
+{
+namespace
+{
+	enum {
+		kRate = SoftMixer::kDefaultRate,
+		kBufferFrames = 1000,
+		kNumVoices = 128,
+		kMaxMixedVoices = 8,
+		kBenchmarkSeconds = 2
+	};
+
+	//! Keeps the mix for inspection.
+	class CaptureSink : public SoftMixer::Sink {
+	public:
+		CaptureSink(zone_vector<S16, ZSoundT>::type &frames) : m_frames(frames) {}
+
+		virtual void Write(const S16 *frames, int numFrames) {
+			m_frames.insert(m_frames.end(), frames, frames + numFrames*2);
+		}
+
+	private:
+		zone_vector<S16, ZSoundT>::type &m_frames;
+	};
+
+	ALint SourceState(SoftMixer &mixer, ALuint source) {
+		ALint state = 0;
+		mixer.GetSourcei(source, AL_SOURCE_STATE, &state);
+		return state;
+	}
+
+	//! A stereo buffer at the output rate is copied to the output as is.
+	void SoftMixerPlaybackTest() {
+		std::cout << "Playback..." << std::endl;
+
+		zone_vector<S16, ZSoundT>::type out;
+		SoftMixer mixer(new (ZSound) CaptureSink(out), kRate);
+
+		zone_vector<S16, ZSoundT>::type samples(kBufferFrames*2);
+		for (int i = 0; i < kBufferFrames; ++i) {
+			samples[i*2+0] = 8192;
+			samples[i*2+1] = -8192;
+		}
+
+		ALuint buffer;
+		mixer.GenBuffers(1, &buffer);
+		if (!mixer.BufferData(buffer, AL_FORMAT_STEREO16, &samples[0], kBufferFrames*2*sizeof(S16), kRate)) {
+			FAIL(-1, "SoftMixer::BufferData failed.");
+		}
+
+		ALuint sources[2];
+		mixer.GenSources(2, sources);
+		for (int i = 0; i < 2; ++i) {
+			mixer.Sourcei(sources[i], AL_BUFFER, (ALint)buffer);
+			mixer.Sourcef(sources[i], AL_GAIN, 0.5f);
+		}
+
+		mixer.Sourcei(sources[1], AL_LOOPING, AL_TRUE);
+		mixer.SourcePlay(sources[0]);
+		mixer.SourcePlay(sources[1]);
+		mixer.Mix(kBufferFrames*3);
+
+		if ((int)out.size() != kBufferFrames*3*2) {
+			FAIL(-1, "SoftMixer wrote %d frames, expected %d.", (int)out.size()/2, kBufferFrames*3);
+		}
+
+		if ((SourceState(mixer, sources[0]) != AL_STOPPED) ||
+			(SourceState(mixer, sources[1]) != AL_PLAYING)) {
+			FAIL(-1, "SoftMixer: a one shot voice should stop and a looping voice should keep playing.");
+		}
+
+		// both voices at half gain while the one shot plays, then the looping voice alone.
+		int numWrong = 0;
+		for (int i = 0; i < kBufferFrames*3; ++i) {
+			const int kExpected = (i < kBufferFrames) ? 8192 : 4096;
+			if ((abs(out[i*2+0] - kExpected) > 1) || (abs(out[i*2+1] + kExpected) > 1))
+				++numWrong;
+		}
+
+		if (numWrong) {
+			FAIL(-1, "SoftMixer: %d mixed frame(s) have the wrong value.", numWrong);
+		}
+	}
+
+	//! Voices beyond maxMixedVoices are virtualized and keep their place.
+	void SoftMixerVirtualizeTest() {
+		std::cout << "Virtualization..." << std::endl;
+
+		// one second of noise at half the output rate so every voice resamples.
+		const int kBufRate = kRate/2;
+		zone_vector<S16, ZSoundT>::type samples(kBufRate);
+		U32 seed = 0x12345;
+		for (size_t i = 0; i < samples.size(); ++i) {
+			seed = seed * 1664525u + 1013904223u;
+			samples[i] = (S16)(seed >> 16);
+		}
+
+		for (int pass = 0; pass < 2; ++pass) {
+			// pass 0 mixes every voice, pass 1 virtualizes all but the loudest.
+			const int kMaxMixed = (pass == 0) ? kNumVoices : kMaxMixedVoices;
+			SoftMixer mixer(new (ZSound) SoftMixer::NullSink(), kRate, kMaxMixed);
+			mixer.DistanceModel(AL_LINEAR_DISTANCE_CLAMPED);
+
+			ALuint buffer;
+			mixer.GenBuffers(1, &buffer);
+			mixer.BufferData(buffer, AL_FORMAT_MONO16, &samples[0], (ALsizei)(samples.size()*sizeof(S16)), kBufRate);
+
+			zone_vector<ALuint, ZSoundT>::type sources(kNumVoices);
+			mixer.GenSources(kNumVoices, &sources[0]);
+
+			for (int i = 0; i < kNumVoices; ++i) {
+				// spread voices out to twice the max distance, half of them are silent.
+				const float kAngle = i * 2.399963f;
+				const float kDist = 200.f * (i+1) / kNumVoices;
+				mixer.Sourcei(sources[i], AL_BUFFER, (ALint)buffer);
+				mixer.Sourcei(sources[i], AL_LOOPING, AL_TRUE);
+				mixer.Sourcef(sources[i], AL_MAX_DISTANCE, 100.f);
+				mixer.Source3f(sources[i], AL_POSITION, cosf(kAngle)*kDist, 0.f, sinf(kAngle)*kDist);
+				mixer.SourcePlay(sources[i]);
+			}
+
+			xtime::MicroTimer timer;
+			timer.Start();
+			mixer.Mix(kRate * kBenchmarkSeconds + kBufferFrames*2);
+			const double kUs = (double)timer.Elapsed();
+
+			const SoftMixer::Counters &c = *mixer.counters.get();
+			const double kNsPerVoiceFrame = c.numVoiceFrames ? ((kUs * 1000.0) / c.numVoiceFrames) : 0.0;
+
+			std::cout << "SoftMixer " << ((pass == 0) ? "(all voices)" : "(virtualized)") << ": " <<
+				kNumVoices << " voices, " << c.numMixed << " mixed, " << c.numVirtual << " virtual, " <<
+				kNsPerVoiceFrame << " ns per voice-frame, " << (kUs / 1000.0 / kBenchmarkSeconds) << 
+				" ms per second of audio." << std::endl;
+
+			// voices past the max distance are silent and never mixed.
+			if ((c.numPlaying != kNumVoices) || 
+				(c.numMixed > std::min<int>(kMaxMixed, kNumVoices/2)) ||
+				(c.numMixed < 1) ||
+				(c.numVirtual != kNumVoices - c.numMixed)) {
+				FAIL(-1, "SoftMixer: %d playing, %d mixed, %d virtual voices with at most %d mixed.", c.numPlaying, c.numMixed, c.numVirtual, kMaxMixed);
+			}
+
+			// every voice advanced the same, mixed or not.
+			const ALint kExpectedOffset = (ALint)(((kRate * kBenchmarkSeconds + kBufferFrames*2) / 2) % samples.size());
+			for (int i = 0; i < kNumVoices; ++i) {
+				ALint offset = -1;
+				mixer.GetSourcei(sources[i], AL_SAMPLE_OFFSET, &offset);
+				if (offset != kExpectedOffset) {
+					FAIL(-1, "SoftMixer: voice %d is at sample %d, expected %d.", i, offset, kExpectedOffset);
+				}
+			}
+		}
+	}
+}
+
+	void SoftMixerTest() {
+		Begin("SoftMixerTest");
+		DO(SoftMixerPlaybackTest());
+		DO(SoftMixerVirtualizeTest());
+	}
+}
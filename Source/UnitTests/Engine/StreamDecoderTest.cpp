@@ -0,0 +1,262 @@
+// StreamDecoderTest.cpp
+// Copyright (c) 2013 Sunside Inc., All Rights Reserved
+// Author: Joe Riedel
+// See Radiance/LICENSE for licensing terms.
+
+#include "../UTCommon.h"
+#include <Engine/Sound/SoftMixer.h>
+#include <Engine/Sound/StreamDecoder.h>
+#include <Runtime/AudioCodec/Vorbis.h>
+#include <Runtime/Stream.h>
+#include <Runtime/Stream/MemoryStream.h>
+#include <Runtime/Thread.h>
+#include <Runtime/Time.h>
+#include <algorithm>
+#include <math.h>
+
+using namespace audio_codec;
+
+namespace ut
+{
+namespace
+{
+	enum {
+		kRate = SoftMixer::kDefaultRate,
+		kChannels = 2,
+		kNumFrames = kRate*2,
+		kEncodeFrames = 4096,
+		kBlockSize = 16*1024, // bytes, same as a music streaming buffer.
+		kNumBuffers = 4, // AL buffers queued on the source.
+		kBlockFrames = kBlockSize / (kChannels*2),
+		kMaxVorbisFrames = 2048 // largest vorbis block, the most the codec may pad or trim.
+	};
+
+	typedef zone_vector<U8, ZSoundT>::type ByteVec;
+
+	//! Encodes two seconds of a stereo tone.
+	bool EncodeTone(ByteVec &ogg) {
+		stream::DynamicMemOutputBuffer ob(ZSound);
+		stream::OutputStream os(ob);
+
+		ogg_vorbis::Encoder encoder;
+		if (!encoder.Initialize(1, kChannels, kRate, 0.3f, os))
+			return false;
+
+		for (int frame = 0; frame < kNumFrames; frame += kEncodeFrames) {
+			const int kCount = std::min((int)kEncodeFrames, kNumFrames - frame);
+			float **pcm = encoder.BeginEncode(kCount);
+			if (!pcm)
+				return false;
+
+			for (int i = 0; i < kCount; ++i) {
+				const float kT = (float)(frame + i) / kRate;
+				pcm[0][i] = 0.5f * sinf(kT * 440.f * 6.2831853f);
+				pcm[1][i] = 0.5f * sinf(kT * 660.f * 6.2831853f);
+			}
+
+			if (!encoder.EndEncode(kCount))
+				return false;
+		}
+
+		const bool kBuilt = encoder.BuildOgg();
+		encoder.Finalize();
+
+		const U8 *data = (const U8*)ob.OutputBuffer().Ptr();
+		ogg.assign(data, data + (AddrSize)ob.OutPos());
+		return kBuilt && !ogg.empty();
+	}
+
+	struct PlayResult {
+		StreamDecoder::Counters counters;
+		int numDecodedFrames;
+		bool stopped;
+	};
+
+	//! Streams the Vorbis data through a StreamDecoder into a source, the way
+	//! Sound::TickStream() does on the ALDriver thread.
+	/*! If keepAhead is true a tick only mixes, a quarter of a block, once every buffer is
+		queued, otherwise each tick mixes more than the queue holds so playback runs dry
+		between ticks. */
+	bool Play(const ByteVec &ogg, bool keepAhead, PlayResult &result) {
+		stream::MemInputBuffer ib(&ogg[0], (stream::SPos)ogg.size());
+		stream::InputStream is(ib);
+
+		ogg_vorbis::Decoder vbd;
+		ogg_vorbis::BSI bsi;
+		if (!vbd.Initialize(is, false) || !vbd.BSInfo(bsi))
+			return false;
+
+		if ((bsi.channels != kChannels) || (bsi.rate != kRate))
+			return false;
+
+		SoftMixer mixer(new (ZSound) SoftMixer::NullSink(), kRate);
+
+		ALuint bufs[kNumBuffers];
+		int numFreeBufs = kNumBuffers;
+		mixer.GenBuffers(kNumBuffers, bufs);
+
+		ALuint source;
+		mixer.GenSources(1, &source);
+
+		result.numDecodedFrames = 0;
+		result.stopped = false;
+
+		{
+			StreamDecoder decoder(vbd, kBlockSize);
+
+			const int kMixFrames = keepAhead ? (kBlockFrames/4) : (kBlockFrames*(kNumBuffers+1));
+			bool eos = false;
+			bool started = false;
+
+			for (;;) {
+				ALint num;
+				mixer.GetSourcei(source, AL_BUFFERS_PROCESSED, &num);
+				if (num > 0) {
+					mixer.SourceUnqueueBuffers(source, num, bufs+numFreeBufs);
+					numFreeBufs += num;
+				}
+
+				while ((numFreeBufs > 0) && !eos) {
+					const StreamDecoder::Block *block = decoder.Front();
+					if (!block)
+						break;
+
+					if (block->size > 0) {
+						ALuint buf = bufs[--numFreeBufs];
+						mixer.BufferData(buf, AL_FORMAT_STEREO16, block->data, (ALsizei)block->size, kRate);
+						mixer.SourceQueueBuffers(source, 1, &buf);
+						result.numDecodedFrames += (int)(block->size / (kChannels*2));
+					}
+
+					eos = block->eos;
+					decoder.Pop();
+				}
+
+				mixer.GetSourcei(source, AL_BUFFERS_QUEUED, &num);
+				if (num < 1) {
+					if (eos) { // everything up to the end of the stream was played.
+						result.stopped = started;
+						break;
+					}
+					thread::Sleep(1); // waiting on the decoder.
+					continue;
+				}
+
+				if (keepAhead && !eos && (num < kNumBuffers)) {
+					thread::Sleep(1); // only mix with every buffer queued.
+					continue;
+				}
+
+				ALint state;
+				mixer.GetSourcei(source, AL_SOURCE_STATE, &state);
+				if (state != AL_PLAYING) {
+					if (started)
+						decoder.Underrun(); // the source played everything we queued.
+					mixer.SourcePlay(source);
+					started = true;
+				}
+
+				mixer.Mix(kMixFrames);
+			}
+
+			result.counters = *decoder.counters.get();
+		}
+
+		mixer.DeleteSources(1, &source);
+		mixer.DeleteBuffers(kNumBuffers, bufs);
+		return true;
+	}
+
+	void Print(const char *name, const PlayResult &r) {
+		const StreamDecoder::Counters &c = r.counters;
+		std::cout << name << ": " << c.numBlocks << " blocks, " << c.numUnderruns << " underrun(s), " <<
+			c.numStarved << " starved, decode avg " << c.avgDecodeMs << " ms max " << c.maxDecodeMs <<
+			" ms, latency avg " << c.avgLatencyMs << " ms max " << c.maxLatencyMs << " ms." << std::endl;
+	}
+
+	bool CheckDecoded(const char *name, const PlayResult &r) {
+		const StreamDecoder::Counters &c = r.counters;
+
+		if (abs(r.numDecodedFrames - kNumFrames) > kMaxVorbisFrames) {
+			Fail(-1, "%s: decoded %d frames, expected %d.", name, r.numDecodedFrames, kNumFrames);
+			return false;
+		}
+
+		// the last block may be partial or empty.
+		const int kMinBlocks = (r.numDecodedFrames + kBlockFrames - 1) / kBlockFrames;
+		if ((c.numBlocks < kMinBlocks) || (c.numBlocks > kMinBlocks+1)) {
+			Fail(-1, "%s: decoded %d blocks, expected %d.", name, c.numBlocks, kMinBlocks);
+			return false;
+		}
+
+		if ((c.avgDecodeMs < 0.f) || (c.avgDecodeMs > c.maxDecodeMs) ||
+			(c.avgLatencyMs < 0.f) || (c.avgLatencyMs > c.maxLatencyMs)) {
+			Fail(-1, "%s: decode or latency averages are outside [0, max].", name);
+			return false;
+		}
+
+		return true;
+	}
+
+	//! A consumer that never outruns the decoder plays the stream without an underrun, and
+	//! blocks wait in the ring while the queued buffers play.
+	void StreamDecoderAheadTest() {
+		ByteVec ogg;
+		if (!EncodeTone(ogg)) {
+			FAIL(-1, "unable to encode the test tone.");
+		}
+
+		PlayResult r;
+		if (!Play(ogg, true, r)) {
+			FAIL(-1, "unable to open the encoded test tone.");
+		}
+
+		Print("ahead", r);
+
+		if (!CheckDecoded("ahead", r))
+			return;
+
+		if (!r.stopped) {
+			FAIL(-1, "ahead: the source was not stopped at the end of the stream.");
+		}
+
+		if (r.counters.numUnderruns != 0) {
+			FAIL(-1, "ahead: %d underrun(s) with the decoder kept ahead.", r.counters.numUnderruns);
+		}
+
+		if (r.counters.maxLatencyMs <= 0.f) {
+			FAIL(-1, "ahead: blocks never waited in the ring.");
+		}
+	}
+
+	//! A consumer that mixes more than it queues runs dry every tick and reports it.
+	void StreamDecoderUnderrunTest() {
+		ByteVec ogg;
+		if (!EncodeTone(ogg)) {
+			FAIL(-1, "unable to encode the test tone.");
+		}
+
+		PlayResult r;
+		if (!Play(ogg, false, r)) {
+			FAIL(-1, "unable to open the encoded test tone.");
+		}
+
+		Print("underrun", r);
+
+		if (!CheckDecoded("underrun", r))
+			return;
+
+		// every tick after the first drains the queue, at most kNumBuffers blocks a tick.
+		const int kMinUnderruns = (r.counters.numBlocks / kNumBuffers) - 1;
+		if (r.counters.numUnderruns < std::max(1, kMinUnderruns)) {
+			FAIL(-1, "underrun: %d underrun(s) reported, expected at least %d.", r.counters.numUnderruns, std::max(1, kMinUnderruns));
+		}
+	}
+}
+
+	void StreamDecoderTest() {
+		Begin("StreamDecoderTest");
+		DO(StreamDecoderAheadTest());
+		DO(StreamDecoderUnderrunTest());
+	}
+}
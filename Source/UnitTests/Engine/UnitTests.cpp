@@ -20,6 +20,15 @@
 namespace ut
 {
     void TaskManagerTest();
+	void SoftMixerTest();
+	void StreamDecoderTest();
+	void LinkListTest();
+#if defined(RAD_OPT_TOOLS)
+	void FloorsTest();
+#endif
+#if defined(RAD_OPT_PC_TOOLS)
+	void PackageLoaderTest();
+#endif
 }
 
 namespace
@@ -82,6 +91,16 @@ int main(int argc, const char **argv)
 
 	if (argc > 1) { testToRun = argv[1]; }
 
+	RUN("SoftMixerTest", ut::SoftMixerTest());
+	RUN("StreamDecoderTest", ut::StreamDecoderTest());
+	RUN("LinkListTest", ut::LinkListTest());
+#if defined(RAD_OPT_TOOLS)
+	RUN("FloorsTest", ut::FloorsTest());
+#endif
+#if defined(RAD_OPT_PC_TOOLS)
+	RUN("PackageLoaderTest", ut::PackageLoaderTest());
+#endif
+
     rt::Finalize();
 
     END();
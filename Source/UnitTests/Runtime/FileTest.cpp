@@ -5,6 +5,10 @@
 
 #include "../UTCommon.h"
 #include <Runtime/File.h>
+#include <Runtime/Endian/EndianStream.h>
+#include <Runtime/DataCodec/LmpWriter.h>
+#include <Runtime/DataCodec/ZLib.h>
+#include <algorithm>
 
 using namespace file;
 using namespace xtime;
@@ -16,7 +20,10 @@ namespace ut
 namespace
 {
 	enum {
-		kMaxSearchFiles = Kilo
+		kMaxSearchFiles = kKilo,
+		kNumIndexLumps = 300, // enough to share hash buckets
+		kBlockLumpSize = 5*kPakBlockSize+123,
+		kNumBlockMaps = 64
 	};
 
 	void FileSearch(const FileSystem::Ref &fs) {
@@ -66,6 +73,253 @@ namespace
 			std::cout << pak->LumpForIndex(i)->Name() << std::endl;
 		}
 	}
+
+	struct TestLump {
+		String name;
+		String data;
+	};
+
+	typedef zone_vector<TestLump, ZFileT>::type TestLumpVec;
+
+	bool WritePak(const FileSystem::Ref &fs, const char *path, const TestLumpVec &lumps) {
+		FILE *fp = fs->fopen(path, "wb");
+		if (!fp)
+			return false;
+
+		FILEOutputBuffer ob(fp);
+		LittleOutputStream os(ob);
+		data_codec::lmp::Writer lumpWriter;
+
+		lumpWriter.Begin(kDPakSig, kDPakMagic, os);
+		for (TestLumpVec::const_iterator it = lumps.begin(); it != lumps.end(); ++it)
+			lumpWriter.WriteLump((*it).name.c_str, (*it).data.c_str, (*it).data.numBytes, 16);
+		lumpWriter.SortLumps();
+		bool r = lumpWriter.End();
+		
+		fclose(fp);
+		return r;
+	}
+
+	//! Returns true if path resolves to a file containing data.
+	bool FileContains(
+		const FileSystem::Ref &fs, 
+		const char *path, 
+		const String &data, 
+		int exclude = 0
+	) {
+		MMFile::Ref file = fs->OpenFile(path, ZFile, kFileOptions_None, kFileMask_Any, exclude);
+		if (!file || (file->size != (AddrSize)data.numBytes))
+			return false;
+		if (data.empty)
+			return true;
+		MMapping::Ref mm = file->MMap(0, data.numBytes);
+		return mm && !memcmp(mm->data, data.c_str, data.numBytes);
+	}
+
+	void PakIndexTest(const FileSystem::Ref &fs) {
+		std::cout << "Pak index..." << std::endl;
+
+		// "shared" is in both paks, every other lump is in one.
+		TestLumpVec lumps[2];
+		for (int i = 0; i < 2; ++i) {
+			TestLump lump;
+			lump.name = "Shared/shared.txt";
+			lump.data.PrintfASCII("shared in pak %d", i);
+			lumps[i].push_back(lump);
+
+			for (int k = 0; k < kNumIndexLumps; ++k) {
+				lump.name.PrintfASCII("Pak%d/lump%d.txt", i, k);
+				lump.data.PrintfASCII("pak %d lump %d", i, k);
+				lumps[i].push_back(lump);
+			}
+		}
+
+		if (!WritePak(fs, "@r:/FileTestIndex0.pak", lumps[0]) ||
+			!WritePak(fs, "@r:/FileTestIndex1.pak", lumps[1])) {
+			FAIL(-1, "Unable to write the pak index test pak files.");
+		}
+
+		PakFile::Ref paks[2];
+		paks[0] = fs->OpenPakFile("@r:/FileTestIndex0.pak");
+		paks[1] = fs->OpenPakFile("@r:/FileTestIndex1.pak");
+		if (!paks[0] || !paks[1]) {
+			FAIL(-1, "Unable to open the pak index test pak files.");
+		}
+
+		fs->AddPakFile(paks[0], kFileMask_Base);
+		fs->AddPakFile(paks[1], kFileMask_Mod);
+
+		int numFailed = 0;
+
+		for (int i = 0; i < 2; ++i) {
+			for (TestLumpVec::const_iterator it = lumps[i].begin()+1; it != lumps[i].end(); ++it) {
+				if (!FileContains(fs, (*it).name.c_str, (*it).data))
+					++numFailed;
+			}
+		}
+
+		// the first mount wins, unless it's excluded.
+		int resolved;
+		if (!FileContains(fs, "Shared/shared.txt", lumps[0][0].data) ||
+			!fs->FileExists("Shared/shared.txt", kFileOptions_None, kFileMask_Any, 0, &resolved) ||
+			(resolved != kFileMask_Base) ||
+			!FileContains(fs, "Shared/shared.txt", lumps[1][0].data, kFileMask_Base))
+			++numFailed;
+
+		if (fs->FileExists("Shared/missing.txt") || 
+			fs->FileExists("Pak0/lump0.txt", kFileOptions_None, kFileMask_Mod))
+			++numFailed;
+
+		// unmounting rebuilds the index.
+		fs->RemovePakFile(paks[0]);
+		if (fs->FileExists("Pak0/lump0.txt") ||
+			!FileContains(fs, "Shared/shared.txt", lumps[1][0].data))
+			++numFailed;
+
+		fs->RemovePakFiles();
+		if (fs->FileExists("Pak1/lump0.txt"))
+			++numFailed;
+
+		paks[0].reset();
+		paks[1].reset();
+		fs->DeleteFile("@r:/FileTestIndex0.pak");
+		fs->DeleteFile("@r:/FileTestIndex1.pak");
+
+		if (numFailed) {
+			FAIL(-1, "%d pak index lookup(s) failed.", numFailed);
+		}
+	}
+
+	//! Compresses data the way the cooker does, see PakBlockTag.
+	/*! Block 2 is noise, which doesn't compress and is stored raw. */
+	void *CompressBlocks(const U8 *data, AddrSize size, AddrSize &zipSize) {
+		const AddrSize kNumBlocks = (size + kPakBlockSize - 1) / kPakBlockSize;
+		const AddrSize kTableSize = (kNumBlocks + 1) * sizeof(U32);
+
+		zipSize = kTableSize + (kNumBlocks * data_codec::zlib::PredictEncodeSize(kPakBlockSize));
+		U8 *zip = (U8*)safe_zone_malloc(ZFile, zipSize);
+		U32 *offsets = reinterpret_cast<U32*>(zip);
+		AddrSize ofs = kTableSize;
+
+		for (AddrSize i = 0; i < kNumBlocks; ++i) {
+			const U8 *src = data + (i * kPakBlockSize);
+			const AddrSize kSrcSize = std::min<AddrSize>(kPakBlockSize, size - (i * kPakBlockSize));
+			AddrSize dstSize = data_codec::zlib::PredictEncodeSize(kSrcSize);
+			
+			if (!data_codec::zlib::Encode(src, kSrcSize, 9, zip + ofs, &dstSize) || (dstSize >= kSrcSize)) {
+				memcpy(zip + ofs, src, kSrcSize);
+				dstSize = kSrcSize;
+			}
+
+			offsets[i] = (U32)ofs;
+			ofs += dstSize;
+		}
+
+		offsets[kNumBlocks] = (U32)ofs;
+		zipSize = ofs;
+		return zip;
+	}
+
+	bool MappingMatches(const MMFile::Ref &file, const U8 *data, AddrSize ofs, AddrSize size) {
+		MMapping::Ref mm = file->MMap(ofs, size);
+		return mm && (mm->size == size) && !memcmp(mm->data, data + ofs, size);
+	}
+
+	void BlockLumpTest(const FileSystem::Ref &fs) {
+		std::cout << "Block compressed lumps..." << std::endl;
+
+		U8 *data = (U8*)safe_zone_malloc(ZFile, kBlockLumpSize);
+		U32 seed = 0x1234567;
+		for (int i = 0; i < kBlockLumpSize; ++i) {
+			seed = seed * 1664525 + 1013904223;
+			const int kBlock = i / kPakBlockSize;
+			data[i] = (kBlock == 2) ? (U8)(seed >> 24) : (U8)((i / 7) + kBlock);
+		}
+
+		AddrSize zipSize;
+		void *zip = CompressBlocks(data, kBlockLumpSize, zipSize);
+
+		// the same data as a lump from an older pak, zipped whole.
+		AddrSize wholeZipSize = data_codec::zlib::PredictEncodeSize(kBlockLumpSize);
+		void *wholeZip = safe_zone_malloc(ZFile, wholeZipSize);
+		bool r = data_codec::zlib::Encode(data, kBlockLumpSize, 9, wholeZip, &wholeZipSize);
+
+		FILE *fp = r ? fs->fopen("@r:/FileTestBlocks.pak", "wb") : 0;
+		if (fp) {
+			FILEOutputBuffer ob(fp);
+			LittleOutputStream os(ob);
+			data_codec::lmp::Writer lumpWriter;
+
+			lumpWriter.Begin(kDPakSig, kDPakMagic, os);
+			
+			data_codec::lmp::Writer::Lump *l = lumpWriter.WriteLump("blocks.bin", zip, zipSize, 16);
+			PakBlockTag *tag = (PakBlockTag*)l->AllocateTagData(sizeof(PakBlockTag));
+			tag->size = (U32)kBlockLumpSize;
+			tag->blockSize = (U32)kPakBlockSize;
+
+			l = lumpWriter.WriteLump("whole.bin", wholeZip, wholeZipSize, 16);
+			*(data_codec::lmp::LOfs*)l->AllocateTagData(sizeof(data_codec::lmp::LOfs)) = (data_codec::lmp::LOfs)kBlockLumpSize;
+			
+			lumpWriter.SortLumps();
+			r = lumpWriter.End();
+			fclose(fp);
+		} else {
+			r = false;
+		}
+
+		zone_free(zip);
+		zone_free(wholeZip);
+
+		PakFile::Ref pak;
+		if (r)
+			pak = fs->OpenPakFile("@r:/FileTestBlocks.pak");
+
+		if (!pak) {
+			zone_free(data);
+			FAIL(-1, "Unable to write the block compressed lump test pak file.");
+		}
+
+		int numFailed = 0;
+		const char *kLumps[2] = { "blocks.bin", "whole.bin" };
+
+		for (int i = 0; i < 2; ++i) {
+			MMFile::Ref file = pak->OpenFile(kLumps[i]);
+			if (!file || (file->size != (AddrSize)kBlockLumpSize)) {
+				++numFailed;
+				continue;
+			}
+
+			if (!MappingMatches(file, data, 0, kBlockLumpSize))
+				++numFailed;
+
+			// inside one block, across blocks, the raw block, and the partial last block.
+			if (!MappingMatches(file, data, 100, 1000) ||
+				!MappingMatches(file, data, kPakBlockSize-10, 20) ||
+				!MappingMatches(file, data, 2*kPakBlockSize+5, kPakBlockSize) ||
+				!MappingMatches(file, data, kBlockLumpSize-50, 50))
+				++numFailed;
+
+			// random seeks, mappings that are alive share decoded blocks.
+			MMapping::Ref keep = file->MMap(kPakBlockSize, 2*kPakBlockSize);
+			for (int k = 0; k < kNumBlockMaps; ++k) {
+				const AddrSize kOfs = (AddrSize)(rand() % kBlockLumpSize);
+				const AddrSize kSize = std::min<AddrSize>(1 + (rand() % (3*kPakBlockSize)), kBlockLumpSize - kOfs);
+				if (!MappingMatches(file, data, kOfs, kSize))
+					++numFailed;
+			}
+
+			if (!keep || memcmp(keep->data, data + kPakBlockSize, 2*kPakBlockSize))
+				++numFailed;
+		}
+
+		pak.reset();
+		zone_free(data);
+		fs->DeleteFile("@r:/FileTestBlocks.pak");
+
+		if (numFailed) {
+			FAIL(-1, "%d block compressed lump read(s) failed.", numFailed);
+		}
+	}
 }
 	void FileTest() {
         Begin("File Test");
@@ -73,5 +327,7 @@ namespace
         //DO(FileSearch(fs));
         DO(FileCopyTest(fs, "@r:/pak0.pak", "@r:/pak0.copy"));
 		DO(PakFileTest(fs, "@r:/pak0.pak"));
+		DO(PakIndexTest(fs));
+		DO(BlockLumpTest(fs));
 	}
 }
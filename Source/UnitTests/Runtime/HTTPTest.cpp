@@ -0,0 +1,496 @@
+// HTTPTest.cpp
+// Copyright (c) 2013 Sunside Inc., All Rights Reserved
+// Author: Joe Riedel
+// See Radiance/LICENSE for licensing terms.
+
+#include "../UTCommon.h"
+#include <Runtime/Net/HTTP.h>
+#include <Runtime/Thread/Locks.h>
+#include <Runtime/Time.h>
+#include <algorithm>
+
+using namespace net;
+
+namespace ut
+{
+namespace
+{
+	enum {
+		kBodySize = 16*kKilo+13, // chunked bodies end with a short chunk
+		kChunkSize = kKilo,
+		kNumKeepAliveRequests = 16,
+		kNumConcurrent = 8,
+		kNumCancels = 32,
+		kNumThroughputRequests = 256,
+		kNumColdRequests = 32
+	};
+
+	inline U8 BodyByte(int resource, int ofs) {
+		return (U8)(ofs + resource*7);
+	}
+
+	class LoopbackServer;
+
+	//! Answers one connection for the loopback server.
+	class LoopbackConnection : public thread::Thread {
+	public:
+
+		LoopbackConnection(int sd, LoopbackServer &server) : m_sd(sd), m_server(server) {
+			Run();
+		}
+
+		~LoopbackConnection() {
+			Join();
+		}
+
+	protected:
+
+		virtual int ThreadProc();
+
+	private:
+
+		Socket m_sd;
+		LoopbackServer &m_server;
+	};
+
+	//! Serves GET /<n> on the loopback interface, odd resources are sent chunked.
+	/*! GET /stall sends the header and half of the body, then waits for the client to close. */
+	class LoopbackServer : public thread::Thread {
+	public:
+
+		LoopbackServer() : m_port(0), m_numAccepted(0), m_quit(false) {
+			sockaddr_in addr;
+			memset(&addr, 0, sizeof(addr));
+			addr.sin_family = AF_INET;
+			addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+			m_sd = (int)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+			socklen_t len = sizeof(addr);
+
+			if ((bind(m_sd, (const sockaddr*)&addr, sizeof(addr)) == 0) &&
+				(listen(m_sd, 64) == 0) &&
+				(getsockname(m_sd, (sockaddr*)&addr, &len) == 0)) {
+				m_port = ntohs(addr.sin_port);
+				sprintf(m_host, "127.0.0.1:%d", m_port);
+				Run();
+			}
+		}
+
+		~LoopbackServer() {
+			if (m_port) {
+				m_quit = true;
+				Join();
+			}
+
+			for (size_t i = 0; i < m_conns.size(); ++i)
+				delete m_conns[i];
+		}
+
+		int NumAccepted() {
+			Lock L(m_m);
+			return m_numAccepted;
+		}
+
+		int port() const {
+			return m_port;
+		}
+
+		const char *host() const {
+			return m_host;
+		}
+
+		//! Opened when a /stall response has been half sent.
+		thread::Gate stalled;
+
+	protected:
+
+		virtual int ThreadProc() {
+			while (!m_quit) {
+				fd_set fd_read;
+				FD_ZERO(&fd_read);
+				FD_SET(m_sd.get(), &fd_read);
+
+				timeval tm;
+				tm.tv_sec = 0;
+				tm.tv_usec = 100000;
+
+				if (select(m_sd.get()+1, &fd_read, 0, 0, &tm) < 1)
+					continue;
+
+				int sd = (int)accept(m_sd, 0, 0);
+				if (sd == -1)
+					continue;
+
+				Lock L(m_m);
+				++m_numAccepted;
+				m_conns.push_back(new (ZRuntime) LoopbackConnection(sd, *this));
+			}
+
+			return 0;
+		}
+
+	private:
+
+		typedef zone_vector<LoopbackConnection*, ZRuntimeT>::type ConnectionVec;
+		typedef boost::mutex Mutex;
+		typedef boost::lock_guard<Mutex> Lock;
+
+		Socket m_sd;
+		ConnectionVec m_conns;
+		Mutex m_m;
+		char m_host[64];
+		int m_port;
+		int m_numAccepted;
+		volatile bool m_quit;
+	};
+
+	int LoopbackConnection::ThreadProc() {
+		enum { kMaxRequest = 4*kKilo };
+
+		char req[kMaxRequest];
+		int reqLen = 0;
+
+		const AddrSize kMaxResponse = (AddrSize)kBodySize + (kBodySize / kChunkSize + 2) * 16 + kKilo;
+		char *response = (char*)safe_zone_malloc(ZRuntime, kMaxResponse);
+
+		for (;;) {
+			const int kRead = (int)recv(m_sd, req+reqLen, kMaxRequest-reqLen-1, 0);
+			if (kRead <= 0)
+				break; // client closed the connection.
+
+			reqLen += kRead;
+			req[reqLen] = 0;
+
+			char *eoh = strstr(req, "\r\n\r\n");
+			if (!eoh) {
+				if (reqLen >= kMaxRequest-1)
+					break;
+				continue;
+			}
+
+			const bool kStall = strncmp(req, "GET /stall ", 11) == 0;
+			int resource = 0;
+			sscanf(req, "GET /%d ", &resource);
+			const bool kChunked = !kStall && ((resource & 1) != 0);
+
+			int len = sprintf(response,
+				"HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n%s\r\n",
+				kChunked ? "Transfer-Encoding: chunked\r\n" : ""
+			);
+
+			if (!kChunked) {
+				len -= 2;
+				len += sprintf(response+len, "Content-Length: %d\r\n\r\n", (int)kBodySize);
+			}
+
+			const int kBodyLen = kStall ? (kBodySize / 2) : kBodySize;
+
+			for (int ofs = 0; ofs < kBodyLen;) {
+				const int kChunk = kChunked ? std::min(kBodyLen-ofs, (int)kChunkSize) : kBodyLen;
+				if (kChunked)
+					len += sprintf(response+len, "%x\r\n", kChunk);
+				for (int i = 0; i < kChunk; ++i)
+					response[len++] = (char)BodyByte(resource, ofs+i);
+				if (kChunked) {
+					response[len++] = '\r';
+					response[len++] = '\n';
+				}
+				ofs += kChunk;
+			}
+
+			if (kChunked)
+				len += sprintf(response+len, "0\r\n\r\n");
+
+			if (m_sd.send(response, len, 0) != len)
+				break;
+
+			if (kStall)
+				m_server.stalled.Open(); // the next recv() returns when the client gives up.
+
+			eoh += 4;
+			reqLen -= (int)(eoh-req);
+			memmove(req, eoh, reqLen);
+		}
+
+		zone_free(response);
+		return 0;
+	}
+
+	bool CheckBody(const HTTPGet &get, int resource) {
+		if (get.status != kHTTP_OpStatus_Success)
+			return false;
+
+		const HTTPResponse &r = *get.response.get();
+		if ((r.responseCode != 200) || (r.bodySize != (AddrSize)kBodySize))
+			return false;
+
+		const U8 *data = (const U8*)r.bodyData.get();
+		for (int i = 0; i < kBodySize; ++i) {
+			if (data[i] != BodyByte(resource, i))
+				return false;
+		}
+
+		return true;
+	}
+
+	HTTP_OpStatus Get(HTTPGet &get, const char *host, int resource) {
+		char path[32];
+		sprintf(path, "/%d", resource);
+		if (get.SendRequest(host, path, 0) != kHTTP_OpStatus_Pending)
+			return get.status;
+		return get.WaitForCompletion();
+	}
+
+	void KeepAliveTest(LoopbackServer &server) {
+		const int kNumAccepted = server.NumAccepted();
+
+		HTTPClient::Ref client(new (ZRuntime) HTTPClient());
+
+		{
+			HTTPGet get(client);
+			for (int i = 0; i < kNumKeepAliveRequests; ++i) {
+				Get(get, server.host(), i);
+				if (!CheckBody(get, i)) {
+					FAIL(-1, "keep-alive request %d failed (status %d).", i, (int)get.status.get());
+				}
+			}
+		}
+
+		const HTTPClient::Counters &c = *client->counters.get();
+		std::cout << "keep-alive: " << c.numConnects << " connect(s), " << c.numReused << " reused" << std::endl;
+
+		// sequential requests to one host must all go over one connection.
+		if ((c.numConnects != 1) || (c.numReused != kNumKeepAliveRequests-1) || (c.numRetries != 0)) {
+			FAIL(-1, "%d sequential requests made %d connection(s) and reused %d.",
+				(int)kNumKeepAliveRequests, c.numConnects, c.numReused);
+		}
+
+		if (server.NumAccepted() - kNumAccepted != 1) {
+			FAIL(-1, "server accepted %d connections for sequential requests.", server.NumAccepted() - kNumAccepted);
+		}
+
+		// concurrent requests are spread over the pool, but never more than the per host limit.
+		HTTPGet *gets[kNumConcurrent];
+		for (int i = 0; i < kNumConcurrent; ++i) {
+			char path[32];
+			sprintf(path, "/%d", i);
+			gets[i] = new (ZRuntime) HTTPGet(client);
+			gets[i]->SendRequest(server.host(), path, 0);
+		}
+
+		int numBad = 0;
+		for (int i = 0; i < kNumConcurrent; ++i) {
+			gets[i]->WaitForCompletion();
+			if (!CheckBody(*gets[i], i))
+				++numBad;
+			delete gets[i];
+		}
+
+		if (numBad) {
+			FAIL(-1, "%d of %d concurrent requests failed.", numBad, (int)kNumConcurrent);
+		}
+
+		if (c.numConnects > HTTPClient::kDefaultMaxConnectionsPerHost) {
+			FAIL(-1, "client opened %d connections, the per host limit is %d.",
+				c.numConnects, (int)HTTPClient::kDefaultMaxConnectionsPerHost);
+		}
+	}
+
+	void ChunkedTest(LoopbackServer &server) {
+		HTTPClient::Ref client(new (ZRuntime) HTTPClient());
+		HTTPGet get(client);
+
+		// odd resources are chunked, even ones have a Content-Length.
+		for (int i = 0; i < 4; ++i) {
+			Get(get, server.host(), i);
+			if (!CheckBody(get, i)) {
+				FAIL(-1, "allocated body for /%d is wrong (status %d).", i, (int)get.status.get());
+			}
+		}
+
+		void *buf = safe_zone_malloc(ZRuntime, kBodySize);
+		get.SetBodyBuffer(buf, kBodySize);
+
+		for (int i = 0; i < 4; ++i) {
+			Get(get, server.host(), i);
+			if (!CheckBody(get, i) || (get.response->bodyData.get() != buf)) {
+				zone_free(buf);
+				FAIL(-1, "buffered body for /%d is wrong (status %d).", i, (int)get.status.get());
+			}
+		}
+
+		zone_free(buf);
+
+		// bodies that don't fit the caller's buffer must fail cleanly, chunked or not.
+		char small[16];
+		get.SetBodyBuffer(small, sizeof(small));
+
+		for (int i = 0; i < 2; ++i) {
+			if (Get(get, server.host(), i) != kHTTP_OpStatus_BufferError) {
+				FAIL(-1, "/%d into a %d byte buffer returned status %d.", i, (int)sizeof(small), (int)get.status.get());
+			}
+		}
+
+		// and the client must recover from the abandoned connections.
+		get.SetBodyBuffer(0, 0);
+		Get(get, server.host(), 5);
+		if (!CheckBody(get, 5)) {
+			FAIL(-1, "request after a buffer error failed (status %d).", (int)get.status.get());
+		}
+	}
+
+	void CancelTest(LoopbackServer &server) {
+		HTTPClient::Ref client(new (ZRuntime) HTTPClient());
+		const HTTPClient::Counters &c = *client->counters.get();
+
+		// cancel with half of a response read, that connection can't be reused.
+		server.stalled.Close();
+
+		HTTPGet *get = new (ZRuntime) HTTPGet(client);
+		get->SendRequest(server.host(), "/stall", 0);
+
+		if (!server.stalled.Wait(kKilo*5)) {
+			delete get;
+			FAIL(-1, "loopback server never received /stall.");
+		}
+
+		delete get;
+
+		{
+			HTTPGet next(client);
+			Get(next, server.host(), 3);
+			if (!CheckBody(next, 3)) {
+				FAIL(-1, "request after a cancel failed (status %d).", (int)next.status.get());
+			}
+		}
+
+		if (c.numConnects != 2) {
+			FAIL(-1, "request after a cancel made %d connection(s), expected a new one.", c.numConnects);
+		}
+
+		// cancel requests that may still be queued, sending or reading.
+		for (int i = 0; i < kNumCancels; ++i) {
+			HTTPGet cancelled(client);
+			char path[32];
+			sprintf(path, "/%d", i);
+			cancelled.SendRequest(server.host(), path, 0);
+			if (i & 1)
+				thread::Sleep(1);
+		}
+
+		HTTPGet last(client);
+		Get(last, server.host(), 7);
+		if (!CheckBody(last, 7)) {
+			FAIL(-1, "request after %d cancels failed (status %d).", (int)kNumCancels, (int)last.status.get());
+		}
+
+		std::cout << "cancel: " << c.numConnects << " connect(s), " << c.numReused << " reused, " << c.numOpen << " open" << std::endl;
+
+		if (c.numOpen > HTTPClient::kDefaultMaxConnectionsPerHost) {
+			FAIL(-1, "%d connections open after cancels.", c.numOpen);
+		}
+	}
+
+	//! Times requests pipelined over the connection pool against a new client (and so a
+	//! new connection) per request.
+	void ThroughputTest(LoopbackServer &server) {
+		HTTPClient::Ref client(new (ZRuntime) HTTPClient());
+		const HTTPClient::Counters &c = *client->counters.get();
+
+		HTTPGet *gets[kNumConcurrent];
+		int ids[kNumConcurrent];
+		U8 *buffers = (U8*)safe_zone_malloc(ZRuntime, (AddrSize)kBodySize*kNumConcurrent);
+
+		for (int i = 0; i < kNumConcurrent; ++i) {
+			gets[i] = new (ZRuntime) HTTPGet(client);
+			gets[i]->SetBodyBuffer(buffers + (AddrSize)kBodySize*i, kBodySize);
+			ids[i] = -1;
+		}
+
+		xtime::MicroTimer timer;
+		timer.Start();
+
+		int numIssued = 0;
+		int numDone = 0;
+		int numBad = 0;
+
+		while (numDone < kNumThroughputRequests) {
+			for (int i = 0; i < kNumConcurrent; ++i) {
+				if (ids[i] >= 0) {
+					gets[i]->WaitForCompletion();
+					if (!CheckBody(*gets[i], ids[i]))
+						++numBad;
+					++numDone;
+					ids[i] = -1;
+				}
+
+				if (numIssued < kNumThroughputRequests) {
+					char path[32];
+					sprintf(path, "/%d", numIssued);
+					gets[i]->SendRequest(server.host(), path, 0);
+					ids[i] = numIssued++;
+				}
+			}
+		}
+
+		timer.Stop();
+		const double kPooledUs = std::max(1.0, (double)timer.Elapsed());
+
+		for (int i = 0; i < kNumConcurrent; ++i)
+			delete gets[i];
+		zone_free(buffers);
+
+		const int kNumConnects = c.numConnects;
+		client.reset();
+
+		if (numBad) {
+			FAIL(-1, "%d of %d pooled requests failed.", numBad, (int)kNumThroughputRequests);
+		}
+
+		if (kNumConnects > HTTPClient::kDefaultMaxConnectionsPerHost) {
+			FAIL(-1, "pooled requests opened %d connections, the per host limit is %d.",
+				kNumConnects, (int)HTTPClient::kDefaultMaxConnectionsPerHost);
+		}
+
+		timer.Start();
+
+		for (int i = 0; i < kNumColdRequests; ++i) {
+			HTTPClient::Ref cold(new (ZRuntime) HTTPClient());
+			HTTPGet get(cold);
+			Get(get, server.host(), i);
+			if (!CheckBody(get, i))
+				++numBad;
+		}
+
+		timer.Stop();
+		const double kColdUs = std::max(1.0, (double)timer.Elapsed());
+
+		if (numBad) {
+			FAIL(-1, "%d of %d requests on new connections failed.", numBad, (int)kNumColdRequests);
+		}
+
+		const double kPooledRate = kNumThroughputRequests * 1000000.0 / kPooledUs;
+		const double kColdRate = kNumColdRequests * 1000000.0 / kColdUs;
+
+		std::cout << "throughput: " << kNumThroughputRequests << " pooled requests over " << kNumConnects <<
+			" connection(s) in " << (kPooledUs / 1000.0) << " ms, " << kPooledRate << " req/s, " <<
+			(kPooledRate * kBodySize / (double)kMeg) << " MB/s" << std::endl;
+		std::cout << "throughput: " << kNumColdRequests << " requests on new connections in " <<
+			(kColdUs / 1000.0) << " ms, " << kColdRate << " req/s (" << (kPooledRate / kColdRate) << "x slower)" << std::endl;
+	}
+}
+
+	void HTTPTest() {
+		Begin("HTTPTest");
+
+		LoopbackServer server;
+		if (!server.port()) {
+			FAIL(-1, "unable to start the loopback server.");
+		}
+
+		DO(KeepAliveTest(server));
+		DO(ChunkedTest(server));
+		DO(CancelTest(server));
+		DO(ThroughputTest(server));
+	}
+}
@@ -0,0 +1,336 @@
+// ImageCodecTest.cpp
+// Copyright (c) 2013 Sunside Inc., All Rights Reserved
+// Author: Joe Riedel
+// See Radiance/LICENSE for licensing terms.
+
+#include <Runtime/Runtime.h>
+#include <Runtime/ImageCodec/ImageCodec.h>
+#include <Runtime/ImageCodec/Resample.h>
+#include <Runtime/Time.h>
+#include "../UTCommon.h"
+
+using namespace image_codec;
+
+namespace ut
+{
+namespace
+{
+	enum {
+		kSize = 2048,
+		kNumPixels = kSize*kSize+7 // odd tail for the SIMD kernels
+	};
+
+	struct ConvertTest {
+		int srcFormat;
+		int dstFormat;
+		const char *name;
+	};
+
+	const ConvertTest kConvertTests[] = {
+		{ Format_RGB888, Format_RGBA8888, "RGB888 -> RGBA8888" },
+		{ Format_BGR888, Format_RGBA8888, "BGR888 -> RGBA8888" },
+		{ Format_BGRA8888, Format_RGBA8888, "BGRA8888 -> RGBA8888" },
+		{ Format_RGBA8888, Format_RGB888, "RGBA8888 -> RGB888" },
+		{ Format_RGB888, Format_BGR888, "RGB888 -> BGR888" },
+		{ Format_RGBA8888, Format_RGB565, "RGBA8888 -> RGB565" },
+		{ Format_RGBA8888, Format_RGBA4444, "RGBA8888 -> RGBA4444" },
+		{ Format_RGBA8888, Format_RGBA5551, "RGBA8888 -> RGBA5551" },
+		{ Format_RGB888, Format_RGB565, "RGB888 -> RGB565" },
+		{ Format_RGBA8888, Format_A8, "RGBA8888 -> A8" },
+		{ Format_RGB565, Format_RGBA8888, "RGB565 -> RGBA8888" },
+		{ Format_PAL8_RGB888, Format_RGBA8888, "PAL8_RGB888 -> RGBA8888" },
+		{ Format_PAL8_RGBA8888, Format_BGRA8888, "PAL8_RGBA8888 -> BGRA8888" },
+		{ Format_A8, Format_RGBA8888, "A8 -> RGBA8888" }
+	};
+
+	void ConvertPixelDataTest() {
+		U8 *src = (U8*)safe_zone_malloc(ZImageCodec, kNumPixels*4);
+		U8 *refDst = (U8*)safe_zone_malloc(ZImageCodec, kNumPixels*4);
+		U8 *dst = (U8*)safe_zone_malloc(ZImageCodec, kNumPixels*4);
+		U8 pal[256*4];
+
+		U32 seed = 0x1234567;
+		for (int i = 0; i < kNumPixels*4; ++i) {
+			seed = seed * 1664525 + 1013904223;
+			src[i] = (U8)(seed >> 24);
+		}
+
+		for (int i = 0; i < 256*4; ++i) {
+			seed = seed * 1664525 + 1013904223;
+			pal[i] = (U8)(seed >> 24);
+		}
+
+		int numFailed = 0;
+
+		for (size_t i = 0; i < (sizeof(kConvertTests)/sizeof(kConvertTests[0])); ++i) {
+			const ConvertTest &test = kConvertTests[i];
+			const int kSrcBPP = FormatBPP(test.srcFormat);
+			const int kDstBPP = FormatBPP(test.dstFormat);
+
+			unsigned int start = xtime::ReadMicroseconds();
+			{
+				const U8 *s = src;
+				U8 *d = refDst;
+				for (int k = 0; k < kNumPixels; ++k, s += kSrcBPP, d += kDstBPP)
+					ConvertPixel(s, d, pal, test.srcFormat, test.dstFormat);
+			}
+			unsigned int end = xtime::ReadMicroseconds();
+			const unsigned int kRefUs = end-start;
+
+			start = xtime::ReadMicroseconds();
+			ConvertPixelData(src, kNumPixels*kSrcBPP, dst, pal, test.srcFormat, test.dstFormat);
+			end = xtime::ReadMicroseconds();
+
+			const bool kMatch = memcmp(refDst, dst, kNumPixels*kDstBPP) == 0;
+			if (!kMatch)
+				++numFailed;
+
+			std::cout << "(" << test.name << ") ConvertPixel(" << kRefUs << "us), ConvertPixelData(" << (end-start) << "us)" <<
+				(kMatch ? "" : " *** MISMATCH ***") << std::endl;
+		}
+
+		zone_free(src);
+		zone_free(refDst);
+		zone_free(dst);
+
+		if (numFailed) {
+			FAIL(-1, "ConvertPixelData differs from ConvertPixel for %d format pair(s).", numFailed);
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////
+
+	//! Zone allocated mipmap, freed on destruction.
+	class Surface {
+	public:
+		Surface(int width, int height, int format) {
+			mip.width = width;
+			mip.height = height;
+			mip.stride = (AddrSize)(width * FormatBPP(format));
+			mip.dataSize = mip.stride * height;
+			mip.data = safe_zone_malloc(ZImageCodec, mip.dataSize);
+			memset(mip.data, 0, mip.dataSize);
+		}
+
+		~Surface() {
+			zone_free(mip.data);
+		}
+
+		U8 *Pixel(int x, int y, int bpp) const {
+			return reinterpret_cast<U8*>(mip.data) + y*mip.stride + x*bpp;
+		}
+
+		Mipmap mip;
+
+	private:
+		Surface(const Surface&);
+		Surface &operator = (const Surface&);
+	};
+
+	void Fill(Surface &s, const U8 *color, int bpp) {
+		for (int y = 0; y < s.mip.height; ++y) {
+			for (int x = 0; x < s.mip.width; ++x)
+				memcpy(s.Pixel(x, y, bpp), color, bpp);
+		}
+	}
+
+	//! Returns the largest difference between any channel of the mipmap and color.
+	int MaxError(const Mipmap &mip, const U8 *color, int bpp) {
+		int maxError = 0;
+		for (int y = 0; y < mip.height; ++y) {
+			const U8 *p = reinterpret_cast<const U8*>(mip.data) + y*mip.stride;
+			for (int x = 0; x < mip.width*bpp; ++x)
+				maxError = std::max(maxError, abs((int)p[x] - (int)color[x%bpp]));
+		}
+		return maxError;
+	}
+
+	struct ResizeCase {
+		int srcWidth, srcHeight;
+		int dstWidth, dstHeight;
+	};
+
+	const ResizeCase kResizeCases[] = {
+		{ 37, 23, 16, 16 }, // odd -> pow2
+		{ 37, 23, 101, 57 }, // magnify
+		{ 640, 480, 321, 239 }, // large enough to be split into bands
+		{ 1, 1, 5, 3 },
+		{ 255, 1, 17, 1 },
+		{ 7, 5, 3, 2 }
+	};
+
+	const resample::Filter kFilters[] = {
+		resample::kFilter_Box,
+		resample::kFilter_Kaiser,
+		resample::kFilter_Lanczos
+	};
+
+	const char *kFilterNames[] = {
+		"Box",
+		"Kaiser",
+		"Lanczos"
+	};
+
+	const int kResizeFormats[] = {
+		Format_RGBA8888,
+		Format_RGB888,
+		Format_A8
+	};
+
+	//! The filters are normalized so a constant color must come back unchanged
+	//! (to within one step for the sRGB tables) after resizing there and back.
+	void ResizeConstantTest() {
+		const U8 kColor[4] = { 200, 17, 96, 130 };
+
+		for (size_t f = 0; f < (sizeof(kFilters)/sizeof(kFilters[0])); ++f) {
+			for (size_t i = 0; i < (sizeof(kResizeCases)/sizeof(kResizeCases[0])); ++i) {
+				for (size_t k = 0; k < (sizeof(kResizeFormats)/sizeof(kResizeFormats[0])); ++k) {
+					for (int flags = 0; flags <= resample::kFlag_Gamma; flags += resample::kFlag_Gamma) {
+						const ResizeCase &c = kResizeCases[i];
+						const int kFormat = kResizeFormats[k];
+						const int kBPP = FormatBPP(kFormat);
+
+						Surface src(c.srcWidth, c.srcHeight, kFormat);
+						Surface dst(c.dstWidth, c.dstHeight, kFormat);
+						Surface back(c.srcWidth, c.srcHeight, kFormat);
+						Fill(src, kColor, kBPP);
+
+						if (!resample::Resize(src.mip, dst.mip, kFormat, kFilters[f], flags, 0) ||
+							!resample::Resize(dst.mip, back.mip, kFormat, kFilters[f], flags, 0)) {
+							FAIL(-1, "resample::Resize(%s) failed.", kFilterNames[f]);
+						}
+
+						const int kError = std::max(MaxError(dst.mip, kColor, kBPP), MaxError(back.mip, kColor, kBPP));
+						if (kError > 1) {
+							FAIL(
+								-1,
+								"resample::Resize(%s) %dx%d -> %dx%d, bpp %d, flags %d changed a constant color by %d.",
+								kFilterNames[f],
+								c.srcWidth,
+								c.srcHeight,
+								c.dstWidth,
+								c.dstHeight,
+								kBPP,
+								flags,
+								kError
+							);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	//! A 2:1 box filter is an exact average of each 2x2 block.
+	void ResizeBoxTest() {
+		Surface src(8, 6, Format_RGBA8888);
+		Surface dst(4, 3, Format_RGBA8888);
+
+		for (int y = 0; y < src.mip.height; ++y) {
+			for (int x = 0; x < src.mip.width; ++x) {
+				U8 *p = src.Pixel(x, y, 4);
+				p[0] = p[1] = p[2] = ((x+y)&1) ? 254 : 0;
+				p[3] = 255;
+			}
+		}
+
+		if (!resample::Resize(src.mip, dst.mip, Format_RGBA8888, resample::kFilter_Box, 0)) {
+			FAIL(-1, "resample::Resize(Box) failed.");
+		}
+
+		const U8 kAverage[4] = { 127, 127, 127, 255 };
+		if (MaxError(dst.mip, kAverage, 4) != 0) {
+			FAIL(-1, "resample::Resize(Box) 8x6 -> 4x3 is not the average of a 2x2 checkerboard.");
+		}
+	}
+
+	//! Banded resizing must match the single threaded result exactly.
+	void ResizeThreadsTest() {
+		Surface src(640, 480, Format_RGBA8888);
+		Surface single(301, 227, Format_RGBA8888);
+		Surface banded(301, 227, Format_RGBA8888);
+
+		U32 seed = 0x7654321;
+		U8 *p = reinterpret_cast<U8*>(src.mip.data);
+		for (AddrSize i = 0; i < src.mip.dataSize; ++i) {
+			seed = seed * 1664525 + 1013904223;
+			p[i] = (U8)(seed >> 24);
+		}
+
+		if (!resample::Resize(src.mip, single.mip, Format_RGBA8888, resample::kFilter_Kaiser, resample::kFlag_Gamma, 1) ||
+			!resample::Resize(src.mip, banded.mip, Format_RGBA8888, resample::kFilter_Kaiser, resample::kFlag_Gamma, 4)) {
+			FAIL(-1, "resample::Resize(Kaiser) failed.");
+		}
+
+		if (memcmp(single.mip.data, banded.mip.data, single.mip.dataSize)) {
+			FAIL(-1, "resample::Resize() with 4 threads differs from 1 thread.");
+		}
+	}
+
+	//! Fills a non power of two mip chain down to 1x1 from a constant color.
+	void GenerateMipmapsTest() {
+		const int kWidth = 75;
+		const int kHeight = 33;
+		const U8 kColor[4] = { 9, 250, 128, 64 };
+
+		int mipCount = 1;
+		while ((kWidth >> mipCount) > 0 || (kHeight >> mipCount) > 0)
+			++mipCount;
+
+		for (size_t f = 0; f < (sizeof(kFilters)/sizeof(kFilters[0])); ++f) {
+			Surface *surfaces[16];
+			Mipmap mipmaps[16];
+			RAD_VERIFY(mipCount <= 16);
+
+			for (int i = 0; i < mipCount; ++i) {
+				surfaces[i] = new Surface(std::max(1, kWidth >> i), std::max(1, kHeight >> i), Format_RGBA8888);
+				mipmaps[i] = surfaces[i]->mip;
+			}
+
+			Fill(*surfaces[0], kColor, 4);
+
+			Frame frame;
+			frame.mipmaps = mipmaps;
+			frame.mipCount = mipCount;
+			frame.flags = 0;
+
+			const bool kGenerated = resample::GenerateMipmaps(frame, Format_RGBA8888, kFilters[f], resample::kFlag_Gamma, 0);
+
+			int maxError = 0;
+			for (int i = 1; i < mipCount; ++i)
+				maxError = std::max(maxError, MaxError(mipmaps[i], kColor, 4));
+
+			for (int i = 0; i < mipCount; ++i)
+				delete surfaces[i];
+
+			if (!kGenerated) {
+				FAIL(-1, "resample::GenerateMipmaps(%s) failed.", kFilterNames[f]);
+			}
+
+			if (maxError > 1) {
+				FAIL(-1, "resample::GenerateMipmaps(%s) changed a constant color by %d.", kFilterNames[f], maxError);
+			}
+		}
+	}
+
+	void ResizeFormatTest() {
+		Surface src(4, 4, Format_PAL8_RGB888);
+		Surface dst(2, 2, Format_PAL8_RGB888);
+
+		if (resample::Resize(src.mip, dst.mip, Format_PAL8_RGB888, resample::kFilter_Box, 0)) {
+			FAIL(-1, "resample::Resize() accepted a paletted format.");
+		}
+	}
+}
+
+	void ImageCodecTest()
+	{
+		Begin("ImageCodecTest");
+		DO(ConvertPixelDataTest());
+		DO(ResizeConstantTest());
+		DO(ResizeBoxTest());
+		DO(ResizeThreadsTest());
+		DO(GenerateMipmapsTest());
+		DO(ResizeFormatTest());
+	}
+}
@@ -0,0 +1,194 @@
+// JobSchedulerTest.cpp
+// Copyright (c) 2013 Sunside Inc., All Rights Reserved
+// Author: Joe Riedel
+// See Radiance/LICENSE for licensing terms.
+
+#include "../UTCommon.h"
+#include <Runtime/Thread.h>
+#include <Runtime/Thread/JobScheduler.h>
+#include <Runtime/Time.h>
+#include <algorithm>
+
+using namespace thread;
+
+namespace ut
+{
+namespace
+{
+	enum {
+		kNumItems = 10007,
+		kGrain = 13,
+		kNumParents = 16,
+		kNumChildren = 16,
+		kNumScalingItems = 4096,
+		kScalingGrain = 16,
+		kScalingIterations = 20000
+	};
+
+	typedef zone_vector<int, ZRuntimeT>::type IntVec;
+	typedef zone_vector<U32, ZRuntimeT>::type U32Vec;
+
+	//! Counts how many times each item was visited.
+	struct CountItems {
+		CountItems(int count) : hits(count, 0), numBadRanges(0) {
+		}
+
+		void operator () (int first, int count) {
+			// ranges are cut from count and grain only.
+			if ((first % kGrain) || (count != std::min((int)kGrain, kNumItems - first)))
+				++numBadRanges;
+			for (int i = first; i < first+count; ++i)
+				++hits[i];
+		}
+
+		IntVec hits;
+		Interlocked<int> numBadRanges;
+	};
+
+	void ParallelForTest(int numThreads) {
+		JobScheduler jobs(numThreads);
+		CountItems fn(kNumItems);
+
+		jobs.ParallelFor(kNumItems, kGrain, fn);
+
+		if (fn.numBadRanges != 0) {
+			FAIL(-1, "ParallelFor() with %d thread(s) ran %d range(s) not cut by grain.", jobs.numThreads.get(), (int)fn.numBadRanges);
+		}
+
+		for (int i = 0; i < kNumItems; ++i) {
+			if (fn.hits[i] != 1) {
+				FAIL(-1, "ParallelFor() with %d thread(s) ran item %d %d time(s).", jobs.numThreads.get(), i, fn.hits[i]);
+			}
+		}
+	}
+
+	class ChildJob : public Job {
+	public:
+		ChildJob() : m_count(0) {}
+
+		void Init(Interlocked<int> &count) {
+			m_count = &count;
+		}
+
+		virtual void Run() {
+			++(*m_count);
+		}
+
+	private:
+		Interlocked<int> *m_count;
+	};
+
+	//! Submits and waits on its own children from inside a job.
+	class ParentJob : public Job {
+	public:
+		ParentJob() : m_jobs(0), m_count(0) {}
+
+		void Init(JobScheduler &jobs, Interlocked<int> &count) {
+			m_jobs = &jobs;
+			m_count = &count;
+		}
+
+		virtual void Run() {
+			ChildJob children[kNumChildren];
+			Job *ptrs[kNumChildren];
+
+			for (int i = 0; i < kNumChildren; ++i) {
+				children[i].Init(*m_count);
+				ptrs[i] = &children[i];
+			}
+
+			JobGroup group;
+			m_jobs->Submit(group, ptrs, kNumChildren);
+			m_jobs->Wait(group);
+		}
+
+	private:
+		JobScheduler *m_jobs;
+		Interlocked<int> *m_count;
+	};
+
+	void NestedWaitTest(int numThreads) {
+		JobScheduler jobs(numThreads);
+		Interlocked<int> count(0);
+
+		ParentJob parents[kNumParents];
+		Job *ptrs[kNumParents];
+
+		for (int i = 0; i < kNumParents; ++i) {
+			parents[i].Init(jobs, count);
+			ptrs[i] = &parents[i];
+		}
+
+		JobGroup group;
+		jobs.Submit(group, ptrs, kNumParents);
+		jobs.Wait(group);
+
+		if (!group.done || (count != kNumParents*kNumChildren)) {
+			FAIL(-1, "nested Wait() with %d thread(s) ran %d of %d child jobs.", jobs.numThreads.get(), (int)count, (int)(kNumParents*kNumChildren));
+		}
+	}
+
+	//! CPU bound work with a result per item.
+	struct HashItems {
+		HashItems() : results(kNumScalingItems, 0) {
+		}
+
+		void operator () (int first, int count) {
+			for (int i = first; i < first+count; ++i) {
+				U32 h = (U32)i;
+				for (int k = 0; k < kScalingIterations; ++k)
+					h = (h ^ (h >> 15)) * 2246822519u + 1013904223u;
+				results[i] = h;
+			}
+		}
+
+		U32Vec results;
+	};
+
+	//! Times the same ParallelFor() with 1 to NumContexts() threads (at least 4 so the
+	//! results are compared across threads on any machine), the results must not change.
+	void ScalingTest() {
+		const int kMaxThreads = std::max(4, (int)NumContexts());
+		U32Vec reference;
+		double singleThreadedMs = 0.0;
+
+		for (int numThreads = 1;;) {
+			JobScheduler jobs(numThreads);
+			HashItems fn;
+
+			xtime::MicroTimer timer;
+			timer.Start();
+			jobs.ParallelFor(kNumScalingItems, kScalingGrain, fn);
+			timer.Stop();
+
+			const double kMs = std::max(1.0, (double)timer.Elapsed()) / 1000.0;
+
+			if (numThreads == 1) {
+				reference = fn.results;
+				singleThreadedMs = kMs;
+			} else if (fn.results != reference) {
+				FAIL(-1, "ParallelFor() with %d threads gave different results than 1 thread.", numThreads);
+			}
+
+			std::cout << "scaling: " << numThreads << " thread(s): " << kMs << " ms, " << (singleThreadedMs / kMs) << "x" << std::endl;
+
+			if (numThreads == kMaxThreads)
+				break;
+			numThreads = std::min(numThreads*2, kMaxThreads);
+		}
+	}
+}
+
+	void JobSchedulerTest()
+	{
+		Begin("JobSchedulerTest");
+
+		const int kThreadCounts[] = { 1, 2, 4, 0 };
+		for (size_t i = 0; i < (sizeof(kThreadCounts)/sizeof(kThreadCounts[0])); ++i) {
+			DO(ParallelForTest(kThreadCounts[i]));
+			DO(NestedWaitTest(kThreadCounts[i]));
+		}
+
+		DO(ScalingTest());
+	}
+}
@@ -6,6 +6,8 @@
 #include <Runtime/Runtime.h>
 #include <Runtime/Base/SIMD.h>
 #include <Runtime/Time.h>
+#include <Runtime/Math/Vector.h>
+#include <algorithm>
 #include "../UTCommon.h"
 
 const SIMDDriver *SIMD_ref_bind();
@@ -16,8 +18,9 @@ namespace ut
 	enum
 	{
 		NumBones = 256, // must be power of 2
-		NumVerts = 5*Meg,
-		MaxBonesPerVert = 4
+		NumVerts = kMeg,
+		MaxBonesPerVert = 4,
+		VertexFloats = 12 // position, normal, tangent
 	};
 
 	void IdentBone(float *bone)
@@ -29,6 +32,181 @@ namespace ut
 		bone[3*4+2] = 1.f;
 	}
 
+namespace
+{
+	enum
+	{
+		NumBoxes = 4*kKilo+3, // odd tail for the SIMD kernels
+		NumPlanes = 6,
+		NumMixFrames = 4*kKilo+3,
+		NumMixSourceFrames = 4*NumMixFrames+2 // enough for the largest step, plus the frame read ahead
+	};
+
+	//! Random boxes around a box shaped volume with every other plane tilted.
+	struct CullData
+	{
+		CullData()
+		{
+			boxes = (float*)safe_zone_malloc(ZRuntime, NumBoxes*6*sizeof(float));
+			for (int i = 0; i < 6; ++i)
+				boxArrays[i] = boxes + i*NumBoxes;
+
+			for (int i = 0; i < NumBoxes; ++i)
+			{
+				for (int k = 0; k < 3; ++k)
+				{
+					boxes[k*NumBoxes+i] = ((rand() / (float)RAND_MAX) * 2.f - 1.f) * 5000.f;
+					boxes[(k+3)*NumBoxes+i] = boxes[k*NumBoxes+i] + (rand() / (float)RAND_MAX) * 500.f;
+				}
+			}
+
+			for (int i = 0; i < NumPlanes; ++i)
+			{
+				math::Vector3<float> n(0.f, 0.f, 0.f);
+				n[i/2] = (i&1) ? -1.f : 1.f;
+				if (i&1)
+					n[(i/2+1)%3] = 0.5f;
+				n.Normalize();
+				planes[i*4+0] = n[0];
+				planes[i*4+1] = n[1];
+				planes[i*4+2] = n[2];
+				planes[i*4+3] = -2500.f;
+			}
+
+			for (int i = 0; i < 3; ++i)
+			{
+				volumeBounds[i] = -2500.f;
+				volumeBounds[i+3] = 2500.f;
+			}
+		}
+
+		~CullData()
+		{
+			zone_free(boxes);
+		}
+
+		float *boxes;
+		const float *boxArrays[6];
+		float planes[NumPlanes*4];
+		float volumeBounds[6];
+	};
+
+	void CullBoxesTest(const SIMDDriver *refDriver)
+	{
+		CullData data;
+		U8 *visible[2];
+		visible[0] = (U8*)safe_zone_malloc(ZRuntime, NumBoxes);
+		visible[1] = (U8*)safe_zone_malloc(ZRuntime, NumBoxes);
+
+		refDriver->CullBoxes(visible[0], data.boxArrays, NumBoxes, data.planes, NumPlanes, data.volumeBounds);
+		SIMD->CullBoxes(visible[1], data.boxArrays, NumBoxes, data.planes, NumPlanes, data.volumeBounds);
+
+		// both kernels evaluate the same expressions in the same order, so they must agree exactly.
+		int numVisible = 0;
+		int numMismatched = 0;
+		for (int i = 0; i < NumBoxes; ++i)
+		{
+			numVisible += visible[0][i];
+			if (visible[0][i] != visible[1][i])
+				++numMismatched;
+		}
+
+		zone_free(visible[0]);
+		zone_free(visible[1]);
+
+		std::cout << "CullBoxes " << refDriver->name << " vs " << SIMD->name << ": " << numVisible << " of " << NumBoxes << " visible, " << numMismatched << " mismatched" << std::endl;
+
+		if (numMismatched)
+		{
+			FAIL(-1, "%s CullBoxes differs from %s for %d box(es).", SIMD->name, refDriver->name, numMismatched);
+		}
+
+		if (numVisible == 0 || numVisible == NumBoxes)
+		{
+			FAIL(-1, "CullBoxes test data culled %d of %d boxes, expected some of each.", NumBoxes-numVisible, NumBoxes);
+		}
+	}
+
+	void PlaneDistancesTest(const SIMDDriver *refDriver)
+	{
+		CullData data;
+		float *distances[2];
+		distances[0] = (float*)safe_zone_malloc(ZRuntime, NumBoxes*sizeof(float));
+		distances[1] = (float*)safe_zone_malloc(ZRuntime, NumBoxes*sizeof(float));
+
+		// box mins as points, against each plane.
+		float maxError = 0.f;
+		for (int i = 0; i < NumPlanes; ++i)
+		{
+			refDriver->PlaneDistances(distances[0], data.boxArrays, NumBoxes, data.planes + i*4);
+			SIMD->PlaneDistances(distances[1], data.boxArrays, NumBoxes, data.planes + i*4);
+
+			for (int k = 0; k < NumBoxes; ++k)
+				maxError = std::max(maxError, math::Abs(distances[0][k] - distances[1][k]));
+		}
+
+		zone_free(distances[0]);
+		zone_free(distances[1]);
+
+		std::cout << "PlaneDistances " << refDriver->name << " vs " << SIMD->name << ": max error " << maxError << std::endl;
+
+		// distances are up to ~10000, allow a few ulps for fused multiply-add.
+		if (maxError > 0.01f)
+		{
+			FAIL(-1, "%s PlaneDistances differs from %s by %f.", SIMD->name, refDriver->name, maxError);
+		}
+	}
+
+	void ResampleMixTest(const SIMDDriver *refDriver)
+	{
+		S16 *src = (S16*)safe_zone_malloc(ZRuntime, NumMixSourceFrames*2*sizeof(S16));
+		float *out[2];
+		out[0] = (float*)safe_zone_malloc(ZRuntime, NumMixFrames*2*sizeof(float));
+		out[1] = (float*)safe_zone_malloc(ZRuntime, NumMixFrames*2*sizeof(float));
+
+		U32 seed = 0x12345;
+		for (int i = 0; i < NumMixSourceFrames*2; ++i)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			src[i] = (S16)(seed >> 16);
+		}
+
+		const float kGains[2] = { 0.75f, 0.25f };
+		// unity, downsampling, upsampling, and a fractional start.
+		const U32 kSteps[4] = { 1<<16, 0x1c000, 0x8000, 0x3fff7 };
+		float maxError = 0.f;
+
+		for (int channels = 1; channels <= 2; ++channels)
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				// both add into existing output.
+				for (int k = 0; k < NumMixFrames*2; ++k)
+					out[0][k] = out[1][k] = (k&7) * 0.125f;
+
+				const U32 kPos = (i == 3) ? 0x4321 : 0;
+				refDriver->ResampleMix(out[0], NumMixFrames, src, channels, kPos, kSteps[i], kGains);
+				SIMD->ResampleMix(out[1], NumMixFrames, src, channels, kPos, kSteps[i], kGains);
+
+				for (int k = 0; k < NumMixFrames*2; ++k)
+					maxError = std::max(maxError, math::Abs(out[0][k] - out[1][k]));
+			}
+		}
+
+		zone_free(src);
+		zone_free(out[0]);
+		zone_free(out[1]);
+
+		std::cout << "ResampleMix " << refDriver->name << " vs " << SIMD->name << ": max error " << maxError << std::endl;
+
+		// output is full scale at 1.0.
+		if (maxError > 0.0001f)
+		{
+			FAIL(-1, "%s ResampleMix differs from %s by %f.", SIMD->name, refDriver->name, maxError);
+		}
+	}
+}
+
 	void SIMDTest()
 	{
 		Begin("SIMDTest");
@@ -38,21 +216,21 @@ namespace ut
 		const SIMDDriver *refDriver = SIMD_ref_bind();
 		const SIMDDriver *sse2Driver = SIMD_sse2_bind();
 
-		U16 *indexPrecache = (U16*)safe_aligned_malloc(sizeof(U16)*NumBones, 0, SIMDDriver::Alignment);
+		U16 *indexPrecache = (U16*)safe_aligned_malloc(sizeof(U16)*NumBones, 0, SIMDDriver::kAlignment);
 		for (int i = 0; i < NumBones; ++i)
 			indexPrecache[i] = rand() % NumBones;
 
-		U16 *boneIndices = (U16*)safe_aligned_malloc(sizeof(U16)*NumVerts*MaxBonesPerVert, 0, SIMDDriver::Alignment);
+		U16 *boneIndices = (U16*)safe_aligned_malloc(sizeof(U16)*NumVerts*MaxBonesPerVert, 0, SIMDDriver::kAlignment);
 		for (int i = 0; i < NumVerts*MaxBonesPerVert; ++i)
 			boneIndices[i] = indexPrecache[i & (NumBones-1)];
 
-		float *outVerts = (float*)safe_aligned_malloc(sizeof(float)*NumVerts*4, 0, SIMDDriver::Alignment);
-		memset(outVerts, 0, sizeof(float)*NumVerts*4);
+		float *outVerts = (float*)safe_aligned_malloc(sizeof(float)*NumVerts*VertexFloats, 0, SIMDDriver::kAlignment);
+		memset(outVerts, 0, sizeof(float)*NumVerts*VertexFloats);
 
-		float *inVerts = (float*)safe_aligned_malloc(sizeof(float)*NumVerts*MaxBonesPerVert*4, 0, SIMDDriver::Alignment);
-		memset(inVerts, 0, sizeof(float)*NumVerts*MaxBonesPerVert*4);
+		float *inVerts = (float*)safe_aligned_malloc(sizeof(float)*NumVerts*MaxBonesPerVert*VertexFloats, 0, SIMDDriver::kAlignment);
+		memset(inVerts, 0, sizeof(float)*NumVerts*MaxBonesPerVert*VertexFloats);
 
-		float *bones = (float*)safe_aligned_malloc(sizeof(float)*NumBones*16, 0, SIMDDriver::Alignment);
+		float *bones = (float*)safe_aligned_malloc(sizeof(float)*NumBones*16, 0, SIMDDriver::kAlignment);
 		for (int i = 0; i < NumBones; ++i)
 			IdentBone(bones + i*16);
 
@@ -92,5 +270,9 @@ namespace ut
 		aligned_free(outVerts);
 		aligned_free(inVerts);
 		aligned_free(bones);
+
+		DO(CullBoxesTest(refDriver));
+		DO(PlaneDistancesTest(refDriver));
+		DO(ResampleMixTest(refDriver));
 	}
 }
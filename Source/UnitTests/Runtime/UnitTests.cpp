@@ -18,6 +18,9 @@ namespace ut
 	void ReflectTest();
 	void FileTest();
 	void SIMDTest();
+	void ImageCodecTest();
+	void HTTPTest();
+	void JobSchedulerTest();
 }
 
 int main(int argc, const char **argv)
@@ -33,6 +36,9 @@ int main(int argc, const char **argv)
 	RUN("ReflectTest", ut::ReflectTest());
 	RUN("FileTest", ut::FileTest());
 	RUN("SIMDTest", ut::SIMDTest());
+	RUN("ImageCodecTest", ut::ImageCodecTest());
+	RUN("HTTPTest", ut::HTTPTest());
+	RUN("JobSchedulerTest", ut::JobSchedulerTest());
 
     rt::Finalize();
 